@@ -17,22 +17,44 @@
 
 #include <common.h>
 #include <fdt_support.h>
+#include <fdt_batch.h>
 #include <asm/armv7.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
-int arch_fixup_fdt(void *blob)
+static void get_dram_banks(u64 start[], u64 size[])
 {
 	bd_t *bd = gd->bd;
-	int bank, ret;
-	u64 start[CONFIG_NR_DRAM_BANKS];
-	u64 size[CONFIG_NR_DRAM_BANKS];
+	int bank;
 
 	for (bank = 0; bank < CONFIG_NR_DRAM_BANKS; bank++) {
 		start[bank] = bd->bi_dram[bank].start;
 		size[bank] = bd->bi_dram[bank].size;
 	}
+}
+
+#ifdef CONFIG_FDT_BATCH
+int arch_fixup_fdt_batch(struct fdt_batch *batch)
+{
+	u64 start[CONFIG_NR_DRAM_BANKS];
+	u64 size[CONFIG_NR_DRAM_BANKS];
+
+	get_dram_banks(start, size);
+
+	return fdt_batch_fixup_memory_banks(batch, start, size,
+					    CONFIG_NR_DRAM_BANKS);
+}
+#endif
+
+int arch_fixup_fdt(void *blob)
+{
+	int ret;
+	u64 start[CONFIG_NR_DRAM_BANKS];
+	u64 size[CONFIG_NR_DRAM_BANKS];
+
+	get_dram_banks(start, size);
 
+	/* This does nothing if arch_fixup_fdt_batch() has set the banks */
 	ret = fdt_fixup_memory_banks(blob, start, size, CONFIG_NR_DRAM_BANKS);
 #if defined(CONFIG_ARMV7_NONSEC) || defined(CONFIG_ARMV7_VIRT)
 	if (ret)
@@ -25,6 +25,14 @@ int sandbox_main_loop_init(void);
 
 int cleanup_before_linux(void);
 
+/* drivers/mmc/sandbox_mmc.c */
+int sandbox_mmc_init(void);
+void sandbox_mmc_fail_read(long blk);
+void sandbox_mmc_get_counts(ulong *readp, ulong *writtenp);
+
+/* drivers/mtd/nand/sandbox_nand.c */
+void sandbox_nand_get_counts(ulong *page_readsp, ulong *cache_readsp);
+
 /* drivers/video/sandbox_sdl.c */
 int sandbox_lcd_sdl_early_init(void);
 
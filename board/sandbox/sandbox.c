@@ -36,6 +36,13 @@ int dram_init(void)
 	return 0;
 }
 
+#ifdef CONFIG_SANDBOX_MMC
+int board_mmc_init(bd_t *bis)
+{
+	return sandbox_mmc_init();
+}
+#endif
+
 #ifdef CONFIG_BOARD_EARLY_INIT_F
 int board_early_init_f(void)
 {
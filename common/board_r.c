@@ -267,6 +267,11 @@ static int initr_malloc(void)
 	malloc_start = gd->relocaddr - TOTAL_MALLOC_LEN;
 	mem_malloc_init((ulong)map_sysmem(malloc_start, TOTAL_MALLOC_LEN),
 			TOTAL_MALLOC_LEN);
+#ifdef CONFIG_FDTDEC_CACHE
+	/* Any cache built so far is in the early malloc() area */
+	gd->fdt_cache = NULL;
+	gd->fdt_cache_failed = NULL;
+#endif
 	return 0;
 }
 
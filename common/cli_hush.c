@@ -447,6 +447,9 @@ static int run_list_real(struct pipe *pi);
 static void pseudo_exec(struct child_prog *child) __attribute__ ((noreturn));
 #endif
 static int run_pipe_real(struct pipe *pi);
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+static int run_expanded(char **inp, int *nonnull, int flag, int *rcodep);
+#endif
 /*   extended glob support: */
 #ifndef __U_BOOT__
 static int globhack(const char *src, int flags, glob_t *pglob);
@@ -478,7 +481,9 @@ static int parse_string(o_string *dest, struct p_context *ctx, const char *src);
 #endif
 static int parse_stream(o_string *dest, struct p_context *ctx, struct in_str *input0, int end_trigger);
 /*   setup: */
-static int parse_stream_outer(struct in_str *inp, int flag);
+struct script_cache;
+static int parse_stream_outer(struct in_str *inp, int flag,
+			      struct script_cache *sc);
 #ifndef __U_BOOT__
 static int parse_string_outer(const char *s, int flag);
 static int parse_file_outer(FILE *f);
@@ -1531,6 +1536,7 @@ static int run_pipe_real(struct pipe *pi)
 	int flag = do_repeat ? CMD_FLAG_REPEAT : 0;
 	struct child_prog *child;
 	char *p;
+	int sp;
 # if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &i;
@@ -1597,6 +1603,13 @@ static int run_pipe_real(struct pipe *pi)
 			}
 			return EXIT_SUCCESS;   /* don't worry about errors in set_local_var() yet */
 		}
+#ifdef __U_BOOT__
+		/*
+		 * Count substitutions locally: the pipe may be run again if
+		 * it comes from a cached script.
+		 */
+		sp = child->sp;
+#endif
 		for (i = 0; is_assignment(child->argv[i]); i++) {
 			p = insert_var_value(child->argv[i]);
 #ifndef __U_BOOT__
@@ -1605,12 +1618,28 @@ static int run_pipe_real(struct pipe *pi)
 			set_local_var(p, 0);
 #endif
 			if (p != child->argv[i]) {
+#ifndef __U_BOOT__
 				child->sp--;
+#else
+				sp--;
+#endif
 				free(p);
 			}
 		}
+#ifndef __U_BOOT__
 		if (child->sp) {
+#else
+		if (sp) {
+#endif
 			char * str = NULL;
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+			int rcode;
+
+			if (!run_expanded(child->argv + i,
+					  child->argv_nonnull + i, flag,
+					  &rcode))
+				return rcode;
+#endif
 
 			str = make_string(child->argv + i,
 					  child->argv_nonnull + i);
@@ -2377,6 +2406,102 @@ static struct reserved_combo reserved_list[] = {
 };
 #define NRES (sizeof(reserved_list)/sizeof(struct reserved_combo))
 
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+/* Add a word to an argv[] being built by run_expanded() */
+static int add_expanded_word(char **argv, int *argcp, const char *word,
+			     int len)
+{
+	if (*argcp >= CONFIG_SYS_MAXARGS)
+		return -1;
+	argv[*argcp] = xmalloc(len + 1);
+	memcpy(argv[*argcp], word, len);
+	argv[*argcp][len] = '\0';
+	(*argcp)++;
+
+	return 0;
+}
+
+/*
+ * A command with variables in it is normally run by substituting them into
+ * a string and parsing that again (see run_pipe_real()). In the common
+ * case, where nothing in the values needs quoting, splitting the words at
+ * white space gives the same result without the parse. Anything unusual
+ * (quotes, backslashes, a keyword or assignment as the command) is left to
+ * the parser.
+ *
+ * Returns 0 if the command was run, with its exit code in *rcodep, or -1
+ * if it must be parsed.
+ */
+static int run_expanded(char **inp, int *nonnull, int flag, int *rcodep)
+{
+	char *argv[CONFIG_SYS_MAXARGS + 1];
+	char *noeval_str, *p, *word;
+	int argc = 0;
+	int ret = 0;
+	int n, i;
+
+	noeval_str = get_local_var("HUSH_NO_EVAL");
+	if ((noeval_str && *noeval_str != '0' && *noeval_str != '\0') ||
+	    getenv("IFS"))
+		return -1;
+
+	for (n = 0; inp[n] && !ret; n++) {
+		p = insert_var_value_sub(inp[n], 0);
+		for (word = p; *word; word++) {
+			if (strchr("'\"\\#", *word) ||
+			    ((uchar)*word < ' ' && *word != '\t')) {
+				ret = -1;
+				break;
+			}
+		}
+		if (!ret && nonnull[n]) {
+			ret = add_expanded_word(argv, &argc, p, strlen(p));
+		} else if (!ret) {
+			/* Unquoted, so split at white space like the parser */
+			for (word = p; *word && !ret;) {
+				int len = 0;
+
+				while (word[len] && word[len] != ' ' &&
+				       word[len] != '\t')
+					len++;
+				if (len)
+					ret = add_expanded_word(argv, &argc, word,
+								len);
+				word += len;
+				while (*word == ' ' || *word == '\t')
+					word++;
+			}
+		}
+		if (p != inp[n])
+			free(p);
+	}
+
+	if (!ret && (!argc || is_assignment(argv[0]) ||
+		     strchr(argv[0], ';')))
+		ret = -1;
+	for (i = 0; i < NRES && !ret; i++) {
+		if (!strcmp(argv[0], reserved_list[i].literal))
+			ret = -1;
+	}
+	if (!ret) {
+		argv[argc] = NULL;
+		*rcodep = cmd_process(flag, argc, argv, &flag_repeat, NULL);
+		if (*rcodep == -1)
+			flag_repeat = 0;
+		/* As run_list_real() would do for the parsed command */
+		if (*rcodep < -1)
+			last_return_code = -*rcodep - 2;
+		else
+			last_return_code = *rcodep ? 1 : 0;
+		*rcodep = last_return_code;
+	}
+	for (i = 0; i < argc; i++)
+		free(argv[i]);
+
+	return ret;
+}
+#endif /* CONFIG_HUSH_SCRIPT_CACHE */
+
 static int reserved_word(o_string *dest, struct p_context *ctx)
 {
 	struct reserved_combo *r;
@@ -3153,9 +3278,150 @@ static void update_ifs_map(void)
 	mapset(ifs, 2);            /* also flow through if quoted */
 }
 
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+/*
+ * Script cache
+ *
+ * Scripts run with 'run' or 'source' go through parse_string_outer() and
+ * used to be parsed again every time, e.g. for each iteration of a loop
+ * which runs a variable. Parsing is purely lexical (variables are only
+ * substituted when a pipe is run), so the parsed lists of a script can be
+ * kept and run again as they are. Entries hold a copy of the script text,
+ * since run_command_list() hands us a copy at a different address each
+ * time. Its length and CRC32 are checked first, to skip most compares.
+ *
+ * A script is recorded while it is first run, line by line as before, so
+ * that its behaviour does not change. The recording is only kept if the
+ * whole script was parsed without error and not cut short by 'exit' or
+ * Ctrl-C, which can leave a 'for' loop half way through.
+ */
+#ifndef CONFIG_HUSH_SCRIPT_CACHE_SIZE
+#define CONFIG_HUSH_SCRIPT_CACHE_SIZE	8
+#endif
+
+struct script_cache {
+	uint len;		/* Length of script text, 0 if entry unused */
+	uint32_t crc;		/* CRC32 of script text, to skip most compares */
+	char *text;		/* Copy of script text */
+	int flag;		/* FLAG_... used to parse the script */
+	int busy;		/* Script is being recorded or run */
+	ulong last_used;
+	int num_lists;
+	struct pipe **lists;	/* Parsed top-level lists, in order */
+};
+
+static struct script_cache script_cache[CONFIG_HUSH_SCRIPT_CACHE_SIZE];
+static ulong script_cache_tick;
+
+static void script_cache_free(struct script_cache *sc)
+{
+	int i;
+
+	for (i = 0; i < sc->num_lists; i++)
+		free_pipe_list(sc->lists[i], 0);
+	free(sc->lists);
+	sc->lists = NULL;
+	sc->num_lists = 0;
+	free(sc->text);
+	sc->text = NULL;
+	sc->len = 0;
+}
+
+/**
+ * script_cache_get() - Find a script in the cache, or make room for it
+ *
+ * @s:		Script text, ending in a newline
+ * @flag:	Parser flags
+ * @recordp:	Set to 1 if the returned entry is empty and should be
+ *		recorded, 0 if it holds the parsed script
+ * @return cache entry, or NULL if the script cannot be cached (e.g. it is
+ * already running further up the call stack)
+ */
+static struct script_cache *script_cache_get(const char *s, int flag,
+					     int *recordp)
+{
+	struct script_cache *sc, *victim = NULL;
+	uint len = strlen(s);
+	uint32_t crc;
+
+	/* The parse depends on $IFS, and BSS is not usable before reloc */
+	if ((flag & FLAG_REPARSING) || !(gd->flags & GD_FLG_RELOC) ||
+	    getenv("IFS"))
+		return NULL;
+
+	crc = crc32(0, (const unsigned char *)s, len);
+	for (sc = script_cache;
+	     sc < script_cache + CONFIG_HUSH_SCRIPT_CACHE_SIZE; sc++) {
+		if (sc->len == len && sc->crc == crc && sc->flag == flag &&
+		    !memcmp(sc->text, s, len)) {
+			if (sc->busy)
+				return NULL;
+			*recordp = 0;
+			goto found;
+		}
+		if (!sc->busy && (!victim || sc->last_used < victim->last_used))
+			victim = sc;
+	}
+	if (!victim)
+		return NULL;
+	sc = victim;
+	script_cache_free(sc);
+	sc->text = malloc(len);
+	if (!sc->text)
+		return NULL;
+	memcpy(sc->text, s, len);
+	sc->len = len;
+	sc->crc = crc;
+	sc->flag = flag;
+	*recordp = 1;
+found:
+	sc->busy = 1;
+	sc->last_used = ++script_cache_tick;
+
+	return sc;
+}
+
+/* Keep a list that has just been run, return -1 if out of memory */
+static int script_cache_add(struct script_cache *sc, struct pipe *list)
+{
+	struct pipe **lists;
+
+	lists = realloc(sc->lists, (sc->num_lists + 1) * sizeof(*lists));
+	if (!lists)
+		return -1;
+	lists[sc->num_lists++] = list;
+	sc->lists = lists;
+
+	return 0;
+}
+
+/* Run a cached script in the same way as parse_stream_outer() would */
+static int script_cache_run(struct script_cache *sc)
+{
+	int code = 0;
+	int i;
+
+	for (i = 0; i < sc->num_lists; i++) {
+		code = run_list_real(sc->lists[i]);
+		if (code == -2) {	/* exit */
+			/* Any 'for' loop may be left with a loop value */
+			script_cache_free(sc);
+			return 0;
+		}
+		if (code == -1)
+			flag_repeat = 0;
+	}
+	if (had_ctrlc())
+		script_cache_free(sc);
+
+	return (code != 0) ? 1 : 0;
+}
+#endif /* CONFIG_HUSH_SCRIPT_CACHE */
+
 /* most recursion does not come through here, the exeception is
  * from builtin_source() */
-static int parse_stream_outer(struct in_str *inp, int flag)
+static int parse_stream_outer(struct in_str *inp, int flag,
+			      struct script_cache *sc)
 {
 
 	struct p_context ctx;
@@ -3186,8 +3452,22 @@ static int parse_stream_outer(struct in_str *inp, int flag)
 #ifndef __U_BOOT__
 			run_list(ctx.list_head);
 #else
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+			if (sc) {
+				code = run_list_real(ctx.list_head);
+				if (script_cache_add(sc, ctx.list_head)) {
+					free_pipe_list(ctx.list_head, 0);
+					script_cache_free(sc);
+					sc = NULL;
+				}
+			} else
+#endif
 			code = run_list(ctx.list_head);
 			if (code == -2) {	/* exit */
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+				if (sc)
+					script_cache_free(sc);
+#endif
 				b_free(&temp);
 				code = 0;
 				/* XXX hackish way to not allow exit from main loop */
@@ -3213,6 +3493,13 @@ static int parse_stream_outer(struct in_str *inp, int flag)
 			temp.quote = 0;
 			inp->p = NULL;
 			free_pipe_list(ctx.list_head,0);
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+			/* Leave scripts with errors to be parsed each time */
+			if (sc) {
+				script_cache_free(sc);
+				sc = NULL;
+			}
+#endif
 		}
 		b_free(&temp);
 	/* loop on syntax errors, return on EOF */
@@ -3221,6 +3508,10 @@ static int parse_stream_outer(struct in_str *inp, int flag)
 #ifndef __U_BOOT__
 	return 0;
 #else
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+	if (sc && had_ctrlc())
+		script_cache_free(sc);
+#endif
 	return (code != 0) ? 1 : 0;
 #endif /* __U_BOOT__ */
 }
@@ -3233,6 +3524,7 @@ int parse_string_outer(const char *s, int flag)
 {
 	struct in_str input;
 #ifdef __U_BOOT__
+	struct script_cache *sc = NULL;
 	char *p = NULL;
 	int rcode;
 	if ( !s || !*s)
@@ -3241,16 +3533,34 @@ int parse_string_outer(const char *s, int flag)
 		p = xmalloc(strlen(s) + 2);
 		strcpy(p, s);
 		strcat(p, "\n");
-		setup_string_in_str(&input, p);
-		rcode = parse_stream_outer(&input, flag);
-		free(p);
-		return rcode;
+		s = p;
 	} else {
+		p = NULL;
+	}
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+	{
+		int record;
+
+		sc = script_cache_get(s, flag, &record);
+		if (sc && !record) {
+			rcode = script_cache_run(sc);
+			sc->busy = 0;
+			free(p);
+			return rcode;
+		}
+	}
 #endif
 	setup_string_in_str(&input, s);
-	return parse_stream_outer(&input, flag);
-#ifdef __U_BOOT__
-	}
+	rcode = parse_stream_outer(&input, flag, sc);
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+	if (sc)
+		sc->busy = 0;
+#endif
+	free(p);
+	return rcode;
+#else
+	setup_string_in_str(&input, s);
+	return parse_stream_outer(&input, flag, NULL);
 #endif
 }
 
@@ -3267,7 +3577,7 @@ int parse_file_outer(void)
 #else
 	setup_file_in_str(&input);
 #endif
-	rcode = parse_stream_outer(&input, FLAG_PARSE_SEMICOLON);
+	rcode = parse_stream_outer(&input, FLAG_PARSE_SEMICOLON, NULL);
 	return rcode;
 }
 
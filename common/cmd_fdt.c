@@ -15,6 +15,7 @@
 #include <asm/global_data.h>
 #include <libfdt.h>
 #include <fdt_support.h>
+#include <fdtdec.h>
 #include <asm/io.h>
 
 #define MAX_LEVEL	32		/* how deeply nested we will go */
@@ -159,6 +160,12 @@ static int do_fdt(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		return CMD_RET_FAILURE;
 	}
 
+#ifdef CONFIG_OF_CONTROL
+	/* The commands below may change the control FDT in place */
+	if (working_fdt == gd->fdt_blob)
+		fdtdec_cache_invalidate();
+#endif
+
 	/*
 	 * Move the working_fdt
 	 */
@@ -11,8 +11,11 @@
 
 #include <common.h>
 #include <command.h>
+#include <malloc.h>
 #include <linux/ctype.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 /*
  * Use puts() instead of printf() to avoid printf buffer overflow
  * for long help messages
@@ -119,10 +122,94 @@ cmd_tbl_t *find_cmd_tbl (const char *cmd, cmd_tbl_t *table, int table_len)
 	return NULL;	/* not found or ambiguous command */
 }
 
+/*
+ * Index of the linker-list command table sorted by name, so that
+ * find_cmd() can do a binary search rather than compare against every
+ * command. The linker sorts the table by symbol name, which is not
+ * always the command name, so we sort it ourselves. It is built on first
+ * use after relocation and never changes after that.
+ */
+static cmd_tbl_t **cmd_index;
+
+static int cmd_index_cmp(const void *a, const void *b)
+{
+	const cmd_tbl_t *cmd_a = *(const cmd_tbl_t **)a;
+	const cmd_tbl_t *cmd_b = *(const cmd_tbl_t **)b;
+
+	return strcmp(cmd_a->name, cmd_b->name);
+}
+
+static cmd_tbl_t **get_cmd_index(cmd_tbl_t *table, int table_len)
+{
+	int i;
+
+	if (cmd_index || !(gd->flags & GD_FLG_RELOC))
+		return cmd_index;
+
+	cmd_index = malloc(table_len * sizeof(*cmd_index));
+	if (!cmd_index)
+		return NULL;
+	for (i = 0; i < table_len; i++)
+		cmd_index[i] = table + i;
+	qsort(cmd_index, table_len, sizeof(*cmd_index), cmd_index_cmp);
+
+	return cmd_index;
+}
+
+/*
+ * find_cmd_index - find a command in a sorted index
+ *
+ * All names starting with the same prefix are next to each other in the
+ * index, and a full match is always the first of them. So this has the
+ * same exact/unique-abbreviation rules as find_cmd_tbl().
+ */
+static cmd_tbl_t *find_cmd_index(const char *cmd, cmd_tbl_t **index,
+				 int table_len)
+{
+	cmd_tbl_t *cmdtp_temp = NULL;
+	const char *p;
+	int len, low, high, mid;
+	int n_found = 0;
+
+	if (!cmd)
+		return NULL;
+	len = ((p = strchr(cmd, '.')) == NULL) ? strlen(cmd) : (p - cmd);
+
+	/* Find the first name which is not less than the prefix */
+	low = 0;
+	high = table_len;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (strncmp(index[mid]->name, cmd, len) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (; low < table_len && !strncmp(index[low]->name, cmd, len);
+	     low++) {
+		if (len == strlen(index[low]->name))
+			return index[low];	/* full match */
+
+		cmdtp_temp = index[low];	/* abbreviated command ? */
+		n_found++;
+	}
+	if (n_found == 1)			/* exactly one match */
+		return cmdtp_temp;
+
+	return NULL;	/* not found or ambiguous command */
+}
+
 cmd_tbl_t *find_cmd (const char *cmd)
 {
 	cmd_tbl_t *start = ll_entry_start(cmd_tbl_t, cmd);
 	const int len = ll_entry_count(cmd_tbl_t, cmd);
+	cmd_tbl_t **index;
+
+	index = get_cmd_index(start, len);
+	if (index)
+		return find_cmd_index(cmd, index, len);
+
 	return find_cmd_tbl(cmd, start, len);
 }
 
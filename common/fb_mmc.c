@@ -0,0 +1,140 @@
+/*
+ * Fastboot flash and erase of MMC partitions
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <fb_mmc.h>
+#include <image-sparse.h>
+#include <mmc.h>
+#include <part.h>
+
+static block_dev_desc_t *fb_mmc_get_part(const char *name,
+					 disk_partition_t *info,
+					 char *response)
+{
+	block_dev_desc_t *dev_desc;
+
+	dev_desc = get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
+		strcpy(response, "FAILinvalid mmc device");
+		return NULL;
+	}
+	if (get_partition_info_efi_by_name(dev_desc, name, info)) {
+		printf("Partition '%s' not found\n", name);
+		strcpy(response, "FAILpartition does not exist");
+		return NULL;
+	}
+
+	return dev_desc;
+}
+
+static void fb_mmc_write_sparse(block_dev_desc_t *dev_desc,
+				disk_partition_t *info, void *buffer,
+				unsigned int bytes, char *response)
+{
+	struct sparse_storage st;
+	struct mmc *mmc;
+	int ret;
+
+	memset(&st, '\0', sizeof(st));
+	st.dev = dev_desc;
+	st.start = info->start;
+	st.size = info->size;
+	mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (mmc)
+		st.erase_grp = mmc->erase_grp_size;
+
+	ret = write_sparse_image(&st, buffer, bytes);
+	switch (ret) {
+	case 0:
+		printf("Wrote " LBAFU " blocks, erased " LBAFU ", skipped "
+		       LBAFU " in '%s'\n", st.written, st.erased, st.skipped,
+		       info->name);
+		strcpy(response, "OKAY");
+		break;
+	case -EFBIG:
+		strcpy(response, "FAILimage too large for partition");
+		break;
+	case -EINVAL:
+		strcpy(response, "FAILinvalid sparse image");
+		break;
+	default:
+		strcpy(response, "FAILfailed to write partition");
+		break;
+	}
+}
+
+static void fb_mmc_write_raw(block_dev_desc_t *dev_desc,
+			     disk_partition_t *info, void *buffer,
+			     unsigned int bytes, char *response)
+{
+	lbaint_t blkcnt;
+
+	blkcnt = BLOCK_CNT(bytes, dev_desc);
+	if (blkcnt > info->size) {
+		strcpy(response, "FAILimage too large for partition");
+		return;
+	}
+
+	puts("Flashing raw image\n");
+	if (dev_desc->block_write(dev_desc->dev, info->start, blkcnt,
+				  buffer) != blkcnt) {
+		printf("Failed to write " LBAFU " blocks to '%s'\n", blkcnt,
+		       info->name);
+		strcpy(response, "FAILfailed to write partition");
+		return;
+	}
+
+	printf("Wrote " LBAFU " blocks to '%s'\n", blkcnt, info->name);
+	strcpy(response, "OKAY");
+}
+
+void fb_mmc_flash_write(const char *cmd, void *download_buffer,
+			unsigned int download_bytes, char *response)
+{
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+
+	dev_desc = fb_mmc_get_part(cmd, &info, response);
+	if (!dev_desc)
+		return;
+
+	if (download_bytes >= sizeof(sparse_header_t) &&
+	    is_sparse_image(download_buffer))
+		fb_mmc_write_sparse(dev_desc, &info, download_buffer,
+				    download_bytes, response);
+	else
+		fb_mmc_write_raw(dev_desc, &info, download_buffer,
+				 download_bytes, response);
+}
+
+void fb_mmc_erase(const char *cmd, char *response)
+{
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+	lbaint_t blks;
+
+	dev_desc = fb_mmc_get_part(cmd, &info, response);
+	if (!dev_desc)
+		return;
+	if (!dev_desc->block_erase) {
+		strcpy(response, "FAILerase not supported");
+		return;
+	}
+
+	printf("Erasing blocks " LBAFU " to " LBAFU " of '%s'\n", info.start,
+	       info.start + info.size - 1, info.name);
+	blks = dev_desc->block_erase(dev_desc->dev, info.start, info.size);
+	if (blks != info.size) {
+		printf("Failed to erase '%s'\n", info.name);
+		strcpy(response, "FAILfailed to erase partition");
+		return;
+	}
+
+	strcpy(response, "OKAY");
+}
@@ -0,0 +1,555 @@
+/*
+ * Batched device tree edits
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <libfdt.h>
+#include <fdt_support.h>
+#include <fdt_batch.h>
+
+/* Deepest node nesting that fdt_batch_apply() can handle */
+#define FDT_BATCH_MAX_DEPTH	32
+
+/* State of the output tree while it is being written */
+struct batch_out {
+	char *buf;
+	int pos;		/* Next free byte in the structure block */
+	int limit;		/* End of space for the structure block */
+	char *newstr;		/* Names of new properties, not in source */
+	int newstr_size;
+};
+
+static struct fdt_batch_node *batch_alloc_node(const char *name, int len)
+{
+	struct fdt_batch_node *node;
+
+	node = malloc(sizeof(*node) + len + 1);
+	if (!node)
+		return NULL;
+	INIT_LIST_HEAD(&node->children);
+	INIT_LIST_HEAD(&node->props);
+	node->found = false;
+	memcpy(node->name, name, len);
+	node->name[len] = '\0';
+
+	return node;
+}
+
+static void batch_free_node(struct fdt_batch_node *node)
+{
+	struct fdt_batch_node *child, *next_child;
+	struct fdt_batch_prop *prop, *next_prop;
+
+	list_for_each_entry_safe(prop, next_prop, &node->props, sibling)
+		free(prop);
+	list_for_each_entry_safe(child, next_child, &node->children, sibling)
+		batch_free_node(child);
+	free(node);
+}
+
+int fdt_batch_init(struct fdt_batch *batch, const void *fdt)
+{
+	int ret;
+
+	ret = fdt_check_header(fdt);
+	if (ret)
+		return ret;
+
+	memset(batch, '\0', sizeof(*batch));
+	batch->fdt = fdt;
+	batch->root = batch_alloc_node("", 0);
+	if (!batch->root)
+		return -FDT_ERR_NOSPACE;
+
+	return 0;
+}
+
+void fdt_batch_free(struct fdt_batch *batch)
+{
+	if (batch->root)
+		batch_free_node(batch->root);
+	batch->root = NULL;
+}
+
+struct fdt_batch_node *fdt_batch_node(struct fdt_batch *batch,
+				      const char *path)
+{
+	struct fdt_batch_node *node = batch->root, *child;
+	const char *p = path, *end;
+
+	if (*p != '/')
+		return NULL;
+
+	while (*p) {
+		while (*p == '/')
+			p++;
+		if (!*p)
+			break;
+		end = strchr(p, '/');
+		if (!end)
+			end = p + strlen(p);
+		/* Fixups tend to revisit the node they last added */
+		list_for_each_entry_reverse(child, &node->children, sibling) {
+			if (!strncmp(child->name, p, end - p) &&
+			    !child->name[end - p])
+				goto next;
+		}
+		child = batch_alloc_node(p, end - p);
+		if (!child)
+			return NULL;
+		list_add_tail(&child->sibling, &node->children);
+next:
+		node = child;
+		p = end;
+	}
+
+	return node;
+}
+
+static int batch_add_prop(struct fdt_batch *batch, struct fdt_batch_node *node,
+			  const char *name, const void *val, int len)
+{
+	struct fdt_batch_prop *prop;
+	int namelen = strlen(name) + 1;
+
+	list_for_each_entry(prop, &node->props, sibling) {
+		if (!strcmp(prop->name, name)) {
+			list_del(&prop->sibling);
+			free(prop);
+			break;
+		}
+	}
+
+	prop = malloc(sizeof(*prop) + len + namelen);
+	if (!prop)
+		return -FDT_ERR_NOSPACE;
+	prop->len = len;
+	prop->done = false;
+	memcpy(prop->data, val, len);
+	prop->name = prop->data + len;
+	memcpy(prop->name, name, namelen);
+	list_add_tail(&prop->sibling, &node->props);
+	batch->count++;
+
+	return 0;
+}
+
+int fdt_batch_setprop(struct fdt_batch *batch, struct fdt_batch_node *node,
+		      const char *name, const void *val, int len)
+{
+	return batch_add_prop(batch, node, name, val, len);
+}
+
+int fdt_batch_setprop_path(struct fdt_batch *batch, const char *path,
+			   const char *name, const void *val, int len,
+			   int create)
+{
+	struct fdt_batch_node *node;
+	int nodeoff;
+
+	nodeoff = fdt_path_offset(batch->fdt, path);
+	if (nodeoff < 0)
+		return nodeoff;
+
+	if (!create && !fdt_get_property(batch->fdt, nodeoff, name, NULL))
+		return 0; /* create flag not set; so exit quietly */
+
+	node = fdt_batch_node(batch, path);
+	if (!node)
+		return -FDT_ERR_NOSPACE;
+
+	return fdt_batch_setprop(batch, node, name, val, len);
+}
+
+/* Find a string in a string table, returning its offset or -1 */
+static int batch_find_string(const char *strtab, int size, const char *s)
+{
+	const char *p = strtab, *end = strtab + size;
+
+	while (p < end) {
+		if (!strcmp(p, s))
+			return p - strtab;
+		p += strlen(p) + 1;
+	}
+
+	return -1;
+}
+
+/*
+ * Clear the state left by an earlier fdt_batch_apply() and collect the
+ * names of properties which are not in the source string table
+ */
+static void batch_prepare(struct fdt_batch *batch,
+			  struct fdt_batch_node *node, struct batch_out *out)
+{
+	const void *fdt = batch->fdt;
+	struct fdt_batch_node *child;
+	struct fdt_batch_prop *prop;
+
+	node->found = false;
+	list_for_each_entry(prop, &node->props, sibling) {
+		prop->done = false;
+		if (batch_find_string(fdt_string(fdt, 0),
+				      fdt_size_dt_strings(fdt),
+				      prop->name) >= 0 ||
+		    batch_find_string(out->newstr, out->newstr_size,
+				      prop->name) >= 0)
+			continue;
+		strcpy(out->newstr + out->newstr_size, prop->name);
+		out->newstr_size += strlen(prop->name) + 1;
+	}
+	list_for_each_entry(child, &node->children, sibling)
+		batch_prepare(batch, child, out);
+}
+
+/* Count the space needed for the names of all properties in a batch */
+static int batch_name_space(struct fdt_batch_node *node)
+{
+	struct fdt_batch_node *child;
+	struct fdt_batch_prop *prop;
+	int size = 0;
+
+	list_for_each_entry(prop, &node->props, sibling)
+		size += strlen(prop->name) + 1;
+	list_for_each_entry(child, &node->children, sibling)
+		size += batch_name_space(child);
+
+	return size;
+}
+
+static void *batch_grab(struct batch_out *out, int len)
+{
+	char *p = out->buf + out->pos;
+
+	if (out->pos + len > out->limit)
+		return NULL;
+	out->pos += len;
+
+	return p;
+}
+
+static int batch_copy(struct batch_out *out, const void *src, int len)
+{
+	void *p = batch_grab(out, len);
+
+	if (!p)
+		return -FDT_ERR_NOSPACE;
+	memcpy(p, src, len);
+
+	return 0;
+}
+
+static int batch_put_tag(struct batch_out *out, uint32_t tag)
+{
+	fdt32_t *p = batch_grab(out, FDT_TAGSIZE);
+
+	if (!p)
+		return -FDT_ERR_NOSPACE;
+	*p = cpu_to_fdt32(tag);
+
+	return 0;
+}
+
+static int batch_put_prop(struct fdt_batch *batch, struct batch_out *out,
+			  struct fdt_batch_prop *prop)
+{
+	const void *fdt = batch->fdt;
+	struct fdt_property *p;
+	int nameoff;
+
+	prop->done = true;
+	nameoff = batch_find_string(fdt_string(fdt, 0),
+				    fdt_size_dt_strings(fdt), prop->name);
+	if (nameoff < 0)
+		nameoff = fdt_size_dt_strings(fdt) +
+			batch_find_string(out->newstr, out->newstr_size,
+					  prop->name);
+
+	p = batch_grab(out, sizeof(*p) + ALIGN(prop->len, FDT_TAGSIZE));
+	if (!p)
+		return -FDT_ERR_NOSPACE;
+	p->tag = cpu_to_fdt32(FDT_PROP);
+	p->len = cpu_to_fdt32(prop->len);
+	p->nameoff = cpu_to_fdt32(nameoff);
+	memcpy(p->data, prop->data, prop->len);
+	memset(p->data + prop->len, '\0',
+	       ALIGN(prop->len, FDT_TAGSIZE) - prop->len);
+
+	return 0;
+}
+
+/* Write out the properties of a node which were not in the source tree */
+static int batch_flush_props(struct fdt_batch *batch, struct batch_out *out,
+			     struct fdt_batch_node *node)
+{
+	struct fdt_batch_prop *prop;
+	int ret;
+
+	list_for_each_entry(prop, &node->props, sibling) {
+		if (prop->done)
+			continue;
+		ret = batch_put_prop(batch, out, prop);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Write out a node which was not in the source tree, and its subnodes */
+static int batch_put_new_node(struct fdt_batch *batch, struct batch_out *out,
+			      struct fdt_batch_node *node)
+{
+	struct fdt_batch_node *child;
+	struct fdt_node_header *nh;
+	int namelen = strlen(node->name) + 1;
+	int ret;
+
+	nh = batch_grab(out, sizeof(*nh) + ALIGN(namelen, FDT_TAGSIZE));
+	if (!nh)
+		return -FDT_ERR_NOSPACE;
+	nh->tag = cpu_to_fdt32(FDT_BEGIN_NODE);
+	memset(nh->name, '\0', ALIGN(namelen, FDT_TAGSIZE));
+	memcpy(nh->name, node->name, namelen);
+
+	ret = batch_flush_props(batch, out, node);
+	if (ret)
+		return ret;
+	list_for_each_entry(child, &node->children, sibling) {
+		ret = batch_put_new_node(batch, out, child);
+		if (ret)
+			return ret;
+	}
+
+	return batch_put_tag(out, FDT_END_NODE);
+}
+
+/* Write out the subnodes of a node which were not in the source tree */
+static int batch_flush_nodes(struct fdt_batch *batch, struct batch_out *out,
+			     struct fdt_batch_node *node)
+{
+	struct fdt_batch_node *child;
+	int ret;
+
+	list_for_each_entry(child, &node->children, sibling) {
+		if (child->found)
+			continue;
+		ret = batch_put_new_node(batch, out, child);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Find the batch node matching a source node, as fdt_subnode_offset() */
+static struct fdt_batch_node *batch_match(struct fdt_batch_node *parent,
+					  const char *name)
+{
+	struct fdt_batch_node *child;
+	int len;
+
+	if (!parent)
+		return NULL;
+	list_for_each_entry(child, &parent->children, sibling) {
+		if (child->found)
+			continue;
+		len = strlen(child->name);
+		if (strncmp(child->name, name, len))
+			continue;
+		if (name[len] == '\0' ||
+		    (name[len] == '@' && !strchr(child->name, '@'))) {
+			/* Keep the children still to be matched at the front */
+			child->found = true;
+			list_move_tail(&child->sibling, &parent->children);
+			return child;
+		}
+	}
+
+	return NULL;
+}
+
+static struct fdt_batch_prop *batch_find_prop(struct fdt_batch_node *node,
+					      const char *name)
+{
+	struct fdt_batch_prop *prop;
+
+	if (!node)
+		return NULL;
+	list_for_each_entry(prop, &node->props, sibling) {
+		if (!strcmp(prop->name, name))
+			return prop;
+	}
+
+	return NULL;
+}
+
+static int batch_put_rsvmap(struct fdt_batch *batch, struct batch_out *out)
+{
+	const void *fdt = batch->fdt;
+	struct fdt_reserve_entry re;
+	uint64_t addr, size;
+	int i, ret;
+
+	/* The last entry is the terminator */
+	for (i = 0; i <= fdt_num_mem_rsv(fdt); i++) {
+		addr = 0;
+		size = 0;
+		if (i < fdt_num_mem_rsv(fdt))
+			fdt_get_mem_rsv(fdt, i, &addr, &size);
+		re.address = cpu_to_fdt64(addr);
+		re.size = cpu_to_fdt64(size);
+		ret = batch_copy(out, &re, sizeof(re));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int batch_put_struct(struct fdt_batch *batch, struct batch_out *out)
+{
+	struct fdt_batch_node *stack[FDT_BATCH_MAX_DEPTH];
+	const void *fdt = batch->fdt;
+	const struct fdt_property *src;
+	struct fdt_batch_prop *prop;
+	struct fdt_batch_node *node;
+	bool in_props = false;
+	int offset = 0, nextoffset;
+	int depth = -1;
+	uint32_t tag;
+	int ret;
+
+	do {
+		tag = fdt_next_tag(fdt, offset, &nextoffset);
+		if (nextoffset < 0)
+			return nextoffset;
+		node = depth >= 0 ? stack[depth] : NULL;
+
+		/* New properties go before the first subnode */
+		if (in_props && (tag == FDT_BEGIN_NODE ||
+				 tag == FDT_END_NODE)) {
+			in_props = false;
+			if (node) {
+				ret = batch_flush_props(batch, out, node);
+				if (ret)
+					return ret;
+			}
+		}
+
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			if (++depth >= FDT_BATCH_MAX_DEPTH)
+				return -FDT_ERR_BADSTRUCTURE;
+			if (depth == 0)
+				stack[depth] = batch->root;
+			else
+				stack[depth] = batch_match(node,
+						fdt_get_name(fdt, offset,
+							     NULL));
+			in_props = true;
+			break;
+		case FDT_PROP:
+			src = fdt_get_property_by_offset(fdt, offset, NULL);
+			prop = batch_find_prop(node,
+				fdt_string(fdt, fdt32_to_cpu(src->nameoff)));
+			if (prop) {
+				if (!prop->done) {
+					ret = batch_put_prop(batch, out, prop);
+					if (ret)
+						return ret;
+				}
+				offset = nextoffset;
+				continue;
+			}
+			break;
+		case FDT_END_NODE:
+			if (node) {
+				ret = batch_flush_nodes(batch, out, node);
+				if (ret)
+					return ret;
+			}
+			depth--;
+			break;
+		case FDT_NOP:
+			/* Drop these, since the tree is being packed anyway */
+			offset = nextoffset;
+			continue;
+		}
+
+		ret = batch_copy(out, fdt_offset_ptr(fdt, offset,
+						     nextoffset - offset),
+				 nextoffset - offset);
+		if (ret)
+			return ret;
+		offset = nextoffset;
+	} while (tag != FDT_END);
+
+	return 0;
+}
+
+int fdt_batch_apply(struct fdt_batch *batch, void *buf, int bufsize)
+{
+	const void *fdt = batch->fdt;
+	struct batch_out out;
+	int off_struct, strsize;
+	int ret;
+
+	memset(&out, '\0', sizeof(out));
+	out.newstr = malloc(batch_name_space(batch->root) + 1);
+	if (!out.newstr)
+		return -FDT_ERR_NOSPACE;
+	batch_prepare(batch, batch->root, &out);
+
+	/*
+	 * The structure block is written first and then the strings are
+	 * copied after it. The source string table is kept as is, so the
+	 * name offsets of copied properties do not change.
+	 */
+	strsize = fdt_size_dt_strings(fdt) + out.newstr_size;
+	out.buf = buf;
+	out.pos = ALIGN(sizeof(struct fdt_header),
+			sizeof(struct fdt_reserve_entry));
+	out.limit = bufsize - strsize;
+	ret = -FDT_ERR_NOSPACE;
+	if (out.limit < out.pos)
+		goto done;
+
+	ret = batch_put_rsvmap(batch, &out);
+	if (ret)
+		goto done;
+	off_struct = out.pos;
+	ret = batch_put_struct(batch, &out);
+	if (ret)
+		goto done;
+
+	memcpy(out.buf + out.pos, fdt_string(fdt, 0),
+	       fdt_size_dt_strings(fdt));
+	memcpy(out.buf + out.pos + fdt_size_dt_strings(fdt), out.newstr,
+	       out.newstr_size);
+
+	memset(buf, '\0', sizeof(struct fdt_header));
+	fdt_set_magic(buf, FDT_MAGIC);
+	fdt_set_totalsize(buf, bufsize);
+	fdt_set_off_mem_rsvmap(buf, ALIGN(sizeof(struct fdt_header),
+					  sizeof(struct fdt_reserve_entry)));
+	fdt_set_off_dt_struct(buf, off_struct);
+	fdt_set_size_dt_struct(buf, out.pos - off_struct);
+	fdt_set_off_dt_strings(buf, out.pos);
+	fdt_set_size_dt_strings(buf, strsize);
+	fdt_set_version(buf, 17);
+	fdt_set_last_comp_version(buf, 16);
+	fdt_set_boot_cpuid_phys(buf, fdt_boot_cpuid_phys(fdt));
+	debug("%s: %d edits, new size %d\n", __func__, batch->count,
+	      out.pos + strsize);
+
+done:
+	free(out.newstr);
+
+	return ret;
+}
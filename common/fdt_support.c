@@ -14,6 +14,7 @@
 #include <asm/global_data.h>
 #include <libfdt.h>
 #include <fdt_support.h>
+#include <fdt_batch.h>
 #include <exports.h>
 
 /*
@@ -137,12 +138,19 @@ static int fdt_find_or_add_subnode(void *fdt, int parentoffset,
 	return offset;
 }
 
+/*
+ * fdt_stdout_path - get the path to use for linux,stdout-path
+ *
+ * Returns a pointer to the path and sets *lenp to its length including the
+ * terminator, or returns NULL if there is nothing to set. The pointer may
+ * be into the device tree, so is invalidated if the tree is modified.
+ */
 /* rename to CONFIG_OF_STDOUT_PATH ? */
 #if defined(OF_STDOUT_PATH)
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static const void *fdt_stdout_path(const void *fdt, int *lenp)
 {
-	return fdt_setprop(fdt, chosenoff, "linux,stdout-path",
-			      OF_STDOUT_PATH, strlen(OF_STDOUT_PATH) + 1);
+	*lenp = strlen(OF_STDOUT_PATH) + 1;
+	return OF_STDOUT_PATH;
 }
 #elif defined(CONFIG_OF_STDOUT_VIA_ALIAS) && defined(CONFIG_CONS_INDEX)
 static void fdt_fill_multisername(char *sername, size_t maxlen)
@@ -157,14 +165,11 @@ static void fdt_fill_multisername(char *sername, size_t maxlen)
 		strncpy(sername, outname + 1, maxlen);
 }
 
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static const void *fdt_stdout_path(const void *fdt, int *lenp)
 {
-	int err;
 	int aliasoff;
 	char sername[9] = { 0 };
 	const void *path;
-	int len;
-	char tmp[256]; /* long enough */
 
 	fdt_fill_multisername(sername, sizeof(sername) - 1);
 	if (!sername[0])
@@ -172,11 +177,32 @@ static int fdt_fixup_stdout(void *fdt, int chosenoff)
 
 	aliasoff = fdt_path_offset(fdt, "/aliases");
 	if (aliasoff < 0) {
-		err = aliasoff;
-		goto error;
+		*lenp = aliasoff;
+		return NULL;
 	}
 
-	path = fdt_getprop(fdt, aliasoff, sername, &len);
+	path = fdt_getprop(fdt, aliasoff, sername, lenp);
+	if (!path)
+		return NULL;
+
+	return path;
+}
+#else
+static const void *fdt_stdout_path(const void *fdt, int *lenp)
+{
+	*lenp = 0;
+	return NULL;
+}
+#endif
+
+static int fdt_fixup_stdout(void *fdt, int chosenoff)
+{
+	int err;
+	const void *path;
+	int len;
+	char tmp[256]; /* long enough */
+
+	path = fdt_stdout_path(fdt, &len);
 	if (!path) {
 		err = len;
 		goto error;
@@ -193,12 +219,6 @@ error:
 
 	return err;
 }
-#else
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
-{
-	return 0;
-}
-#endif
 
 static inline int fdt_setprop_uxx(void *fdt, int nodeoffset, const char *name,
 				  uint64_t val, int is_u64)
@@ -415,7 +435,8 @@ static int fdt_pack_reg(const void *fdt, void *buf, uint64_t *address,
 int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 {
 	int err, nodeoffset;
-	int len;
+	int len, oldlen;
+	const void *prop;
 	u8 tmp[MEMORY_BANKS_MAX * 16]; /* Up to 64-bit address + 64-bit size */
 
 	if (banks > MEMORY_BANKS_MAX) {
@@ -436,8 +457,13 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 	if (nodeoffset < 0)
 			return nodeoffset;
 
-	err = fdt_setprop(blob, nodeoffset, "device_type", "memory",
-			sizeof("memory"));
+	prop = fdt_getprop(blob, nodeoffset, "device_type", &oldlen);
+	if (prop && oldlen == sizeof("memory") &&
+	    !memcmp(prop, "memory", oldlen))
+		err = 0;
+	else
+		err = fdt_setprop(blob, nodeoffset, "device_type", "memory",
+				  sizeof("memory"));
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n", "device_type",
 				fdt_strerror(err));
@@ -446,6 +472,11 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 
 	len = fdt_pack_reg(blob, tmp, start, size, banks);
 
+	/* Leave the tree alone if a batch has already set the same banks */
+	prop = fdt_getprop(blob, nodeoffset, "reg", &oldlen);
+	if (prop && oldlen == len && !memcmp(prop, tmp, len))
+		return 0;
+
 	err = fdt_setprop(blob, nodeoffset, "reg", tmp, len);
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n",
@@ -460,7 +491,17 @@ int fdt_fixup_memory(void *blob, u64 start, u64 size)
 	return fdt_fixup_memory_banks(blob, &start, &size, 1);
 }
 
-void fdt_fixup_ethernet(void *fdt)
+/*
+ * fdt_for_each_ethaddr - call a function for each MAC address to fix up
+ *
+ * Looks through the ethaddr, eth1addr, ... (or usbethaddr, ...) environment
+ * variables and calls fixup() with the node path of the matching
+ * ethernet<n> alias and the parsed MAC address.
+ */
+static void fdt_for_each_ethaddr(const void *fdt,
+				 void (*fixup)(void *ctx, const char *path,
+					       const unsigned char *mac_addr),
+				 void *ctx)
 {
 	int node, i, j;
 	char enet[16], *tmp, *end;
@@ -499,14 +540,119 @@ void fdt_fixup_ethernet(void *fdt)
 				tmp = (*end) ? end+1 : end;
 		}
 
-		do_fixup_by_path(fdt, path, "mac-address", &mac_addr, 6, 0);
-		do_fixup_by_path(fdt, path, "local-mac-address",
-				&mac_addr, 6, 1);
+		fixup(ctx, path, mac_addr);
 
 		sprintf(mac, "eth%daddr", ++i);
 	}
 }
 
+static void fdt_fixup_ethaddr(void *fdt, const char *alias_path,
+			      const unsigned char *mac_addr)
+{
+	char path[256]; /* long enough */
+
+	/* Setting the property may move the alias, so take a copy */
+	strncpy(path, alias_path, sizeof(path) - 1);
+	path[sizeof(path) - 1] = '\0';
+	do_fixup_by_path(fdt, path, "mac-address", mac_addr, 6, 0);
+	do_fixup_by_path(fdt, path, "local-mac-address", mac_addr, 6, 1);
+}
+
+void fdt_fixup_ethernet(void *fdt)
+{
+	fdt_for_each_ethaddr(fdt, fdt_fixup_ethaddr, fdt);
+}
+
+#ifdef CONFIG_FDT_BATCH
+int fdt_batch_chosen(struct fdt_batch *batch)
+{
+	struct fdt_batch_node *chosen;
+	const void *path;
+	char *str;
+	int len;
+	int err;
+
+	chosen = fdt_batch_node(batch, "/chosen");
+	if (!chosen)
+		return -FDT_ERR_NOSPACE;
+
+	str = getenv("bootargs");
+	if (str) {
+		err = fdt_batch_setprop_string(batch, chosen, "bootargs", str);
+		if (err < 0) {
+			printf("WARNING: could not set bootargs %s.\n",
+			       fdt_strerror(err));
+			return err;
+		}
+	}
+
+	/* The source tree is not changed, so the path stays valid */
+	path = fdt_stdout_path(batch->fdt, &len);
+	if (!path) {
+		err = len;
+	} else {
+		err = fdt_batch_setprop(batch, chosen, "linux,stdout-path",
+					path, len);
+	}
+	if (err < 0)
+		printf("WARNING: could not set linux,stdout-path %s.\n",
+		       fdt_strerror(err));
+
+	return err;
+}
+
+static void fdt_batch_fixup_ethaddr(void *ctx, const char *path,
+				    const unsigned char *mac_addr)
+{
+	struct fdt_batch *batch = ctx;
+	int err;
+
+	err = fdt_batch_setprop_path(batch, path, "mac-address", mac_addr,
+				     6, 0);
+	if (!err)
+		err = fdt_batch_setprop_path(batch, path, "local-mac-address",
+					     mac_addr, 6, 1);
+	if (err)
+		printf("Unable to update property %s:%s, err=%s\n",
+		       path, "local-mac-address", fdt_strerror(err));
+}
+
+void fdt_batch_fixup_ethernet(struct fdt_batch *batch)
+{
+	fdt_for_each_ethaddr(batch->fdt, fdt_batch_fixup_ethaddr, batch);
+}
+
+int fdt_batch_fixup_memory_banks(struct fdt_batch *batch, u64 start[],
+				 u64 size[], int banks)
+{
+	struct fdt_batch_node *memory;
+	u8 tmp[MEMORY_BANKS_MAX * 16]; /* Up to 64-bit address + 64-bit size */
+	int err, len;
+
+	if (banks > MEMORY_BANKS_MAX) {
+		printf("%s: num banks %d exceeds hardcoded limit %d."
+		       " Recompile with higher MEMORY_BANKS_MAX?\n",
+		       __func__, banks, MEMORY_BANKS_MAX);
+		return -1;
+	}
+
+	memory = fdt_batch_node(batch, "/memory");
+	if (!memory)
+		return -FDT_ERR_NOSPACE;
+
+	err = fdt_batch_setprop_string(batch, memory, "device_type", "memory");
+	if (!err) {
+		len = fdt_pack_reg(batch->fdt, tmp, start, size, banks);
+		err = fdt_batch_setprop(batch, memory, "reg", tmp, len);
+	}
+	if (err < 0)
+		printf("WARNING: could not set memory banks %s.\n",
+		       fdt_strerror(err));
+
+	return err;
+}
+#endif /* CONFIG_FDT_BATCH */
+
 /* Resize the fdt to its actual size + a bit of padding */
 int fdt_shrink_to_minimum(void *blob)
 {
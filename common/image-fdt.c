@@ -11,9 +11,11 @@
 
 #include <common.h>
 #include <fdt_support.h>
+#include <fdt_batch.h>
 #include <errno.h>
 #include <image.h>
 #include <libfdt.h>
+#include <malloc.h>
 #include <asm/io.h>
 
 #ifndef CONFIG_SYS_FDT_PAD
@@ -455,6 +457,87 @@ __weak int arch_fixup_fdt(void *blob)
 	return 0;
 }
 
+#ifdef CONFIG_FDT_BATCH
+__weak int arch_fixup_fdt_batch(struct fdt_batch *batch)
+{
+	return 0;
+}
+
+__weak int ft_board_setup_batch(struct fdt_batch *batch, bd_t *bd)
+{
+	return 0;
+}
+
+/* Fixups which come before arch_fixup_fdt() */
+static int image_fdt_batch_early(struct fdt_batch *batch)
+{
+	if (fdt_batch_chosen(batch) < 0) {
+		puts("ERROR: /chosen node create failed");
+		return -1;
+	}
+	if (arch_fixup_fdt_batch(batch) < 0) {
+		puts("ERROR: arch specific fdt fixup failed");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Fixups which come after ft_board_setup() */
+static int image_fdt_batch_late(struct fdt_batch *batch)
+{
+	if (IMAGE_OF_BOARD_SETUP && ft_board_setup_batch(batch, gd->bd) < 0) {
+		puts("ERROR: board fdt fixup failed");
+		return -1;
+	}
+	fdt_batch_fixup_ethernet(batch);
+
+	return 0;
+}
+
+/*
+ * Record fixups in a batch and then write the tree back to @blob in one
+ * pass, instead of splicing the blob once for every property that is
+ * changed.
+ */
+static int image_fixup_fdt_batch(void *blob, int of_size,
+				 int (*record)(struct fdt_batch *batch))
+{
+	struct fdt_batch batch;
+	ulong start;
+	void *src;
+	int ret;
+
+	start = get_timer(0);
+	src = malloc(fdt_totalsize(blob));
+	if (!src) {
+		puts("ERROR: no memory for fdt fixups");
+		return -ENOMEM;
+	}
+	ret = fdt_move(blob, src, fdt_totalsize(blob));
+	if (!ret)
+		ret = fdt_batch_init(&batch, src);
+	if (ret)
+		goto err_free;
+
+	ret = record(&batch);
+	if (ret)
+		goto err;
+
+	ret = fdt_batch_apply(&batch, blob, of_size);
+	if (ret)
+		printf("ERROR: fdt fixup failed: %s", fdt_strerror(ret));
+	debug("   %d fdt fixups applied in %lu ms\n", batch.count,
+	      get_timer(start));
+err:
+	fdt_batch_free(&batch);
+err_free:
+	free(src);
+
+	return ret;
+}
+#endif
+
 int image_setup_libfdt(bootm_headers_t *images, void *blob,
 		       int of_size, struct lmb *lmb)
 {
@@ -462,6 +545,27 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 	ulong *initrd_end = &images->initrd_end;
 	int ret;
 
+#ifdef CONFIG_FDT_BATCH
+	/*
+	 * The fixups run in the usual order. Those which work directly on
+	 * the blob split the others into two batches, each written out in
+	 * a single pass.
+	 */
+	if (image_fixup_fdt_batch(blob, of_size, image_fdt_batch_early) < 0) {
+		puts(" - must RESET the board to recover.\n");
+		return -1;
+	}
+	if (arch_fixup_fdt(blob) < 0) {
+		puts("ERROR: arch specific fdt fixup failed");
+		return -1;
+	}
+	if (IMAGE_OF_BOARD_SETUP)
+		ft_board_setup(blob, gd->bd);
+	if (image_fixup_fdt_batch(blob, of_size, image_fdt_batch_late) < 0) {
+		puts(" - must RESET the board to recover.\n");
+		return -1;
+	}
+#else
 	if (fdt_chosen(blob) < 0) {
 		puts("ERROR: /chosen node create failed");
 		puts(" - must RESET the board to recover.\n");
@@ -474,6 +578,7 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 	if (IMAGE_OF_BOARD_SETUP)
 		ft_board_setup(blob, gd->bd);
 	fdt_fixup_ethernet(blob);
+#endif
 
 	/* Delete the old LMB reservation */
 	lmb_free(lmb, (phys_addr_t)(u32)(uintptr_t)blob,
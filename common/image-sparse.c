@@ -0,0 +1,224 @@
+/*
+ * Writing Android sparse images to block devices
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <div64.h>
+#include <errno.h>
+#include <image-sparse.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
+
+/* Buffer used to write fill chunks, which repeat a 32-bit value */
+#define SPARSE_FILL_BUF_SIZE	(1 << 20)
+
+struct sparse_fill {
+	u32 *buf;
+	lbaint_t blocks;	/* Size of buffer in device blocks */
+	u32 val;		/* Value that the buffer is filled with */
+	bool valid;		/* buf holds val */
+};
+
+static int sparse_write(struct sparse_storage *st, lbaint_t blk,
+			lbaint_t count, const void *buf)
+{
+	block_dev_desc_t *dev = st->dev;
+
+	if (dev->block_write(dev->dev, st->start + blk, count, buf) != count) {
+		printf("%s: Write of " LBAFU " blocks at 0x" LBAF " failed\n",
+		       __func__, count, st->start + blk);
+		return -EIO;
+	}
+	st->written += count;
+
+	return 0;
+}
+
+static int sparse_write_fill(struct sparse_storage *st, lbaint_t blk,
+			     lbaint_t count, struct sparse_fill *fill, u32 val)
+{
+	lbaint_t n;
+	int i, ret;
+
+	if (!fill->valid || fill->val != val) {
+		for (i = 0; i < fill->blocks * st->dev->blksz / sizeof(u32);
+		     i++)
+			fill->buf[i] = val;
+		fill->val = val;
+		fill->valid = true;
+	}
+
+	for (; count; count -= n, blk += n) {
+		n = min(count, fill->blocks);
+		ret = sparse_write(st, blk, n, fill->buf);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Check that erased blocks read back as zero, so erase can replace writes */
+static bool sparse_erase_reads_zero(struct sparse_storage *st, lbaint_t blk)
+{
+	block_dev_desc_t *dev = st->dev;
+	u32 *buf;
+	bool zero;
+	int i;
+
+	buf = memalign(ARCH_DMA_MINALIGN, dev->blksz);
+	if (!buf)
+		return false;
+	zero = dev->block_read(dev->dev, blk, 1, buf) == 1;
+	for (i = 0; zero && i < dev->blksz / sizeof(u32); i++)
+		zero = !buf[i];
+	free(buf);
+
+	return zero;
+}
+
+/*
+ * Zero a run of blocks, erasing whole erase groups where possible. Erasing
+ * takes a fraction of the time of writing zeros, and on eMMC it also tells
+ * the device that the blocks are unused.
+ */
+static int sparse_write_zero(struct sparse_storage *st, lbaint_t blk,
+			     lbaint_t count, struct sparse_fill *fill)
+{
+	block_dev_desc_t *dev = st->dev;
+	lbaint_t grp = st->erase_grp;
+	lbaint_t first, last;
+	int ret;
+
+	if (!grp || !dev->block_erase)
+		return sparse_write_fill(st, blk, count, fill, 0);
+
+	/* the erase groups are aligned on the device, not the partition */
+	first = lldiv(st->start + blk + grp - 1, grp) * grp - st->start;
+	last = lldiv(st->start + blk + count, grp) * grp - st->start;
+	if (last <= first)
+		return sparse_write_fill(st, blk, count, fill, 0);
+
+	if (dev->block_erase(dev->dev, st->start + first, last - first) !=
+	    last - first ||
+	    (!st->erased && !sparse_erase_reads_zero(st, st->start + first))) {
+		debug("%s: Cannot erase, writing zeros instead\n", __func__);
+		st->erase_grp = 0;
+		return sparse_write_fill(st, blk, count, fill, 0);
+	}
+	st->erased += last - first;
+
+	ret = sparse_write_fill(st, blk, first - blk, fill, 0);
+	if (!ret)
+		ret = sparse_write_fill(st, last, blk + count - last, fill, 0);
+
+	return ret;
+}
+
+int write_sparse_image(struct sparse_storage *st, void *data,
+		       unsigned int size)
+{
+	sparse_header_t *hdr = data;
+	struct sparse_fill fill = { .valid = false };
+	chunk_header_t *chunk;
+	u8 *ptr, *end = data + size;
+	lbaint_t blk, count, factor;
+	u32 blk_sz, chunk_sz, total_sz, val;
+	u16 type;
+	unsigned int i;
+	int ret = 0;
+
+	if (size < sizeof(*hdr) || !is_sparse_image(hdr) ||
+	    le16_to_cpu(hdr->major_version) != 1 ||
+	    le16_to_cpu(hdr->file_hdr_sz) < sizeof(sparse_header_t) ||
+	    le16_to_cpu(hdr->chunk_hdr_sz) < sizeof(chunk_header_t)) {
+		puts("Invalid sparse image header\n");
+		return -EINVAL;
+	}
+	blk_sz = le32_to_cpu(hdr->blk_sz);
+	if (!blk_sz || blk_sz % st->dev->blksz) {
+		printf("Sparse block size %u is not a multiple of %lu\n",
+		       blk_sz, st->dev->blksz);
+		return -EINVAL;
+	}
+	factor = blk_sz / st->dev->blksz;
+	if ((u64)le32_to_cpu(hdr->total_blks) * factor > st->size) {
+		printf("Sparse image of %u blocks is too large\n",
+		       le32_to_cpu(hdr->total_blks));
+		return -EFBIG;
+	}
+	debug("%s: %u chunks, %u blocks of %u bytes\n", __func__,
+	      le32_to_cpu(hdr->total_chunks), le32_to_cpu(hdr->total_blks),
+	      blk_sz);
+
+	ptr = data + le16_to_cpu(hdr->file_hdr_sz);
+	blk = 0;
+	for (i = 0; i < le32_to_cpu(hdr->total_chunks) && !ret; i++) {
+		chunk = (chunk_header_t *)ptr;
+		if (ptr + le16_to_cpu(hdr->chunk_hdr_sz) > end)
+			break;
+		chunk_sz = le32_to_cpu(get_unaligned(&chunk->chunk_sz));
+		total_sz = le32_to_cpu(get_unaligned(&chunk->total_sz));
+		if (total_sz < le16_to_cpu(hdr->chunk_hdr_sz) ||
+		    total_sz > end - ptr)
+			break;
+		count = (lbaint_t)chunk_sz * factor;
+		if (blk + count > (lbaint_t)le32_to_cpu(hdr->total_blks) *
+		    factor)
+			break;
+		total_sz -= le16_to_cpu(hdr->chunk_hdr_sz);
+		type = le16_to_cpu(get_unaligned(&chunk->chunk_type));
+		if ((type == CHUNK_TYPE_RAW &&
+		     total_sz != (u64)chunk_sz * blk_sz) ||
+		    (type == CHUNK_TYPE_FILL && total_sz != sizeof(u32)))
+			break;
+		ptr += le16_to_cpu(hdr->chunk_hdr_sz);
+
+		switch (type) {
+		case CHUNK_TYPE_RAW:
+			ret = sparse_write(st, blk, count, ptr);
+			break;
+		case CHUNK_TYPE_FILL:
+			if (!fill.buf) {
+				fill.buf = memalign(ARCH_DMA_MINALIGN,
+						    SPARSE_FILL_BUF_SIZE);
+				fill.blocks = SPARSE_FILL_BUF_SIZE /
+					st->dev->blksz;
+				if (!fill.buf) {
+					ret = -ENOMEM;
+					break;
+				}
+			}
+			/* the value is a byte pattern, used as is */
+			memcpy(&val, ptr, sizeof(val));
+			if (val)
+				ret = sparse_write_fill(st, blk, count, &fill,
+							val);
+			else
+				ret = sparse_write_zero(st, blk, count, &fill);
+			break;
+		case CHUNK_TYPE_DONT_CARE:
+			st->skipped += count;
+			break;
+		case CHUNK_TYPE_CRC32:
+			break;
+		default:
+			printf("Unknown sparse chunk type 0x%x\n", type);
+			ret = -EINVAL;
+			break;
+		}
+		blk += count;
+		ptr += total_sz;
+	}
+	free(fill.buf);
+	if (!ret && i != le32_to_cpu(hdr->total_chunks)) {
+		printf("Sparse image chunk %u is invalid\n", i);
+		ret = -EINVAL;
+	}
+
+	return ret;
+}
@@ -168,7 +168,11 @@ void board_init_r(gd_t *dummy1, ulong dummy2)
 #endif
 #ifdef CONFIG_SPL_NAND_SUPPORT
 	case BOOT_DEVICE_NAND:
+#ifdef CONFIG_SPL_UBI
+		spl_ubi_load_image();
+#else
 		spl_nand_load_image();
+#endif
 		break;
 #endif
 #ifdef CONFIG_SPL_ONENAND_SUPPORT
@@ -0,0 +1,80 @@
+/*
+ * Load U-Boot, or Linux in falcon mode, from UBI volumes on NAND
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <config.h>
+#include <nand.h>
+#include <spl.h>
+#include <ubispl.h>
+
+static int spl_ubi_read(int pnum, int offset, int len, void *dst)
+{
+	return nand_spl_read_block(pnum + CONFIG_SPL_UBI_PEB_OFFSET, offset,
+				   len, dst);
+}
+
+/* Parse the image loaded at @header and move it where it should be run */
+static void spl_ubi_place_image(struct image_header *header)
+{
+	void *src = header;
+
+	spl_parse_image_header(header);
+	if (spl_image.flags & SPL_COPY_PAYLOAD_ONLY)
+		src = header + 1;
+	if (spl_image.load_addr != (ulong)src)
+		memmove((void *)spl_image.load_addr, src, spl_image.size);
+}
+
+void spl_ubi_load_image(void)
+{
+	struct image_header *header;
+	struct ubispl_info info;
+	struct ubispl_load volumes[2];
+	int ret;
+
+	nand_init();
+
+	info.scan = (struct ubispl_scan *)CONFIG_SPL_UBI_INFO_ADDR;
+	info.read = spl_ubi_read;
+	info.peb_size = CONFIG_SYS_NAND_BLOCK_SIZE;
+	info.peb_count = CONFIG_SPL_UBI_MAX_PEBS;
+	info.vid_offset = CONFIG_SPL_UBI_VID_OFFSET;
+	info.leb_start = CONFIG_SPL_UBI_LEB_START;
+	info.fastmap = true;
+
+#ifdef CONFIG_SPL_OS_BOOT
+	if (!spl_start_uboot()) {
+		header = (struct image_header *)CONFIG_SYS_LOAD_ADDR;
+		volumes[0].vol_id = CONFIG_SPL_UBI_LOAD_KERNEL_ID;
+		volumes[0].load_addr = header;
+		volumes[1].vol_id = CONFIG_SPL_UBI_LOAD_ARGS_ID;
+		volumes[1].load_addr = (void *)CONFIG_SYS_SPL_ARGS_ADDR;
+
+		ret = ubispl_load_volumes(&info, volumes, 2);
+		if (!ret && image_get_magic(header) == IH_MAGIC &&
+		    image_get_os(header) == IH_OS_LINUX) {
+			spl_ubi_place_image(header);
+			nand_deselect();
+			return;
+		}
+		puts("Cannot load Linux from UBI, trying U-Boot\n");
+	}
+#endif
+
+	/* Load with the header just below, so that U-Boot need not move */
+	header = (struct image_header *)(CONFIG_SYS_TEXT_BASE -
+					 sizeof(*header));
+	volumes[0].vol_id = CONFIG_SPL_UBI_LOAD_MONITOR_ID;
+	volumes[0].load_addr = header;
+
+	ret = ubispl_load_volumes(&info, volumes, 1);
+	nand_deselect();
+	if (ret)
+		hang();
+	spl_ubi_place_image(header);
+}
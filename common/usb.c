@@ -59,7 +59,7 @@ int usb_init(void)
 {
 	void *ctrl;
 	struct usb_device *dev;
-	int i, start_index = 0;
+	int i;
 	int ret;
 
 	dev_index = 0;
@@ -72,7 +72,11 @@ int usb_init(void)
 		usb_dev[i].devnum = -1;
 	}
 
-	/* init low_level USB */
+	/*
+	 * Init each controller and configure its root hub, which powers the
+	 * root ports. The devices on all buses are then found together so
+	 * that the controllers' power-on and settling delays overlap.
+	 */
 	for (i = 0; i < CONFIG_USB_MAX_CONTROLLER_COUNT; i++) {
 		/* init low_level USB */
 		printf("USB%d:   ", i);
@@ -86,12 +90,6 @@ int usb_init(void)
 			puts("lowlevel init failed\n");
 			continue;
 		}
-		/*
-		 * lowlevel init is OK, now scan the bus for devices
-		 * i.e. search HUBs and configure them
-		 */
-		start_index = dev_index;
-		printf("scanning bus %d for devices... ", i);
 		dev = usb_alloc_new_device(ctrl);
 		/*
 		 * device 0 is always present
@@ -100,13 +98,17 @@ int usb_init(void)
 		if (dev)
 			usb_new_device(dev);
 
-		if (start_index == dev_index)
+		usb_started = 1;
+	}
+
+	if (usb_started) {
+		/* now scan the buses for devices, i.e. search HUBs too */
+		puts("scanning bus for devices... ");
+		usb_hub_scan();
+		if (!dev_index)
 			puts("No USB Device found\n");
 		else
-			printf("%d USB Device(s) found\n",
-				dev_index - start_index);
-
-		usb_started = 1;
+			printf("%d USB Device(s) found\n", dev_index);
 	}
 
 	debug("scan end\n");
@@ -248,6 +250,21 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 }
 
 
+__weak int submit_bulk_queue(struct usb_device *dev,
+			     struct usb_bulk_xfer *xfer, int count)
+{
+	return -ENOSYS;
+}
+
+int usb_bulk_msg_queue(struct usb_device *dev, struct usb_bulk_xfer *xfer,
+		       int count)
+{
+	if (count < 1 || count > USB_MAX_BULK_QUEUE)
+		return -EINVAL;
+
+	return submit_bulk_queue(dev, xfer, count);
+}
+
 /*-------------------------------------------------------------------
  * Max Packet stuff
  */
@@ -337,13 +354,14 @@ static int usb_parse_config(struct usb_device *dev,
 			unsigned char *buffer, int cfgno)
 {
 	struct usb_descriptor_header *head;
-	int index, ifno, epno, curr_if_num;
+	int index, ifno, epno, curr_if_num, curr_alt;
 	u16 ep_wMaxPacketSize;
 	struct usb_interface *if_desc = NULL;
 
 	ifno = -1;
 	epno = -1;
 	curr_if_num = -1;
+	curr_alt = 0;
 
 	dev->configno = cfgno;
 	head = (struct usb_descriptor_header *) &buffer[0];
@@ -391,6 +409,7 @@ static int usb_parse_config(struct usb_device *dev,
 					USB_DT_INTERFACE_SIZE);
 				if_desc->no_of_ep = 0;
 				if_desc->num_altsetting = 1;
+				if_desc->act_altsetting = 0;
 				curr_if_num =
 				     if_desc->desc.bInterfaceNumber;
 			} else {
@@ -400,6 +419,8 @@ static int usb_parse_config(struct usb_device *dev,
 					if_desc->num_altsetting++;
 				}
 			}
+			curr_alt = ((struct usb_interface_descriptor *)
+				    head)->bAlternateSetting;
 			break;
 		case USB_DT_ENDPOINT:
 			if (head->bLength != USB_DT_ENDPOINT_SIZE) {
@@ -427,6 +448,8 @@ static int usb_parse_config(struct usb_device *dev,
 			if_desc->no_of_ep++;
 			memcpy(&if_desc->ep_desc[epno], head,
 				USB_DT_ENDPOINT_SIZE);
+			if_desc->ep_altsetting[epno] = curr_alt;
+			if_desc->ep_pipe_id[epno] = 0;
 			ep_wMaxPacketSize = get_unaligned(&dev->config.\
 							if_desc[ifno].\
 							ep_desc[epno].\
@@ -457,6 +480,13 @@ static int usb_parse_config(struct usb_device *dev,
 			memcpy(&if_desc->ss_ep_comp_desc[epno], head,
 				USB_DT_SS_EP_COMP_SIZE);
 			break;
+		case USB_DT_PIPE_USAGE:
+			/* UAS: which pipe the endpoint before it is for */
+			if (head->bLength < 3 || ifno < 0 || epno < 0)
+				break;
+			if_desc = &dev->config.if_desc[ifno];
+			if_desc->ep_pipe_id[epno] = buffer[index + 2];
+			break;
 		default:
 			if (head->bLength == 0)
 				return 1;
@@ -613,6 +643,7 @@ int usb_set_interface(struct usb_device *dev, int interface, int alternate)
 				USB_CNTL_TIMEOUT * 5);
 	if (ret < 0)
 		return ret;
+	if_face->act_altsetting = alternate;
 
 	return 0;
 }
@@ -872,6 +903,32 @@ __weak int usb_alloc_device(struct usb_device *udev)
 {
 	return 0;
 }
+
+/* Only XHCI has bulk streams */
+__weak int usb_alloc_streams(struct usb_device *dev, int ifnum,
+			     int num_streams)
+{
+	return -ENOSYS;
+}
+
+/* Only EHCI and XHCI have interrupt queues */
+__weak struct int_queue *create_int_queue(struct usb_device *dev,
+					  unsigned long pipe, int queuesize,
+					  int elementsize, void *buffer)
+{
+	return NULL;
+}
+
+__weak void *poll_int_queue(struct usb_device *dev, struct int_queue *queue)
+{
+	return NULL;
+}
+
+__weak int destroy_int_queue(struct usb_device *dev, struct int_queue *queue)
+{
+	return -ENOSYS;
+}
+
 /*
  * By the time we get here, the device has gotten a new device ID
  * and is in the default state. We need to identify the thing and
@@ -24,11 +24,14 @@
 
 #include <common.h>
 #include <command.h>
+#include <errno.h>
 #include <asm/processor.h>
 #include <asm/unaligned.h>
 #include <linux/ctype.h>
 #include <asm/byteorder.h>
 #include <asm/unaligned.h>
+#include <linux/list.h>
+#include <malloc.h>
 
 #include <usb.h>
 #ifdef CONFIG_4xx
@@ -40,6 +43,22 @@
 static struct usb_hub_device hub_dev[USB_MAX_HUB];
 static int usb_hub_index;
 
+/*
+ * A hub port waiting for its device to connect and settle. The ports of all
+ * hubs on all buses are powered as each hub is found and then polled in turn
+ * by usb_hub_scan(), so that the power-on and debounce delays of different
+ * ports overlap rather than add up.
+ */
+struct usb_port_scan {
+	struct usb_hub_device *hub;
+	int port;
+	ulong debounce_end;	/* Time the connection is stable, or 0 */
+	struct list_head list;
+};
+
+static LIST_HEAD(usb_scan_list);
+static int usb_scan_running;
+
 __weak void usb_hub_reset_devices(int port)
 {
 	return;
@@ -135,15 +154,23 @@ static void usb_hub_power_on(struct usb_hub_device *hub)
 	}
 
 	/*
-	 * Wait for power to become stable,
-	 * plus spec-defined max time for device to connect
+	 * Power must be stable before the ports are queried, and devices
+	 * then have the spec-defined maximum time to connect. Rather than
+	 * waiting here, usb_hub_scan() checks these deadlines so that the
+	 * ports of every hub settle at the same time.
 	 */
-	mdelay(pgood_delay + 1000);
+	usb_hub_set_deadlines(hub, get_timer(0), pgood_delay);
 }
 
 void usb_hub_reset(void)
 {
+	struct usb_port_scan *scan, *tmp;
+
 	usb_hub_index = 0;
+	list_for_each_entry_safe(scan, tmp, &usb_scan_list, list) {
+		list_del(&scan->list);
+		free(scan);
+	}
 }
 
 static struct usb_hub_device *usb_hub_allocate(void)
@@ -188,17 +215,28 @@ int hub_port_reset(struct usb_device *dev, int port,
 
 	debug("hub_port_reset: resetting port %d...\n", port);
 	for (tries = 0; tries < MAX_TRIES; tries++) {
+		ulong start;
 
 		usb_set_port_feature(dev, port + 1, USB_PORT_FEAT_RESET);
-		mdelay(200);
 
-		if (usb_get_port_status(dev, port + 1, portsts) < 0) {
-			debug("get_port_status failed status %lX\n",
-			      dev->status);
-			return -1;
-		}
-		portstatus = le16_to_cpu(portsts->wPortStatus);
-		portchange = le16_to_cpu(portsts->wPortChange);
+		/*
+		 * The hub drives reset for 10-20ms and then enables the port,
+		 * so poll for that rather than always waiting the 200ms that
+		 * slow hubs may need.
+		 */
+		start = get_timer(0);
+		do {
+			mdelay(10);
+			if (usb_get_port_status(dev, port + 1, portsts) < 0) {
+				debug("get_port_status failed status %lX\n",
+				      dev->status);
+				return -1;
+			}
+			portstatus = le16_to_cpu(portsts->wPortStatus);
+			portchange = le16_to_cpu(portsts->wPortChange);
+		} while ((portstatus & USB_PORT_STAT_RESET ||
+			  !(portstatus & USB_PORT_STAT_ENABLE)) &&
+			 get_timer(start) < 200);
 
 		debug("portstatus %x, change %x, %s\n", portstatus, portchange,
 							portspeed(portstatus));
@@ -240,12 +278,19 @@ int hub_port_reset(struct usb_device *dev, int port,
 	}
 
 	usb_clear_port_feature(dev, port + 1, USB_PORT_FEAT_C_RESET);
+	/* Reset recovery time, 10ms in the spec, plus some slack */
+	mdelay(50);
 	*portstat = portstatus;
 	return 0;
 }
 
 
-void usb_hub_port_connect_change(struct usb_device *dev, int port)
+/*
+ * Handle a connection change on @port of hub @dev, @debounce_ms after it
+ * was first seen
+ */
+static void usb_hub_port_connect(struct usb_device *dev, int port,
+				 int debounce_ms)
 {
 	struct usb_device *usb;
 	ALLOC_CACHE_ALIGN_BUFFER(struct usb_port_status, portsts, 1);
@@ -274,7 +319,7 @@ void usb_hub_port_connect_change(struct usb_device *dev, int port)
 		if (!(portstatus & USB_PORT_STAT_CONNECTION))
 			return;
 	}
-	mdelay(200);
+	mdelay(debounce_ms);
 
 	/* Reset the port */
 	if (hub_port_reset(dev, port, &portstatus) < 0) {
@@ -315,6 +360,110 @@ void usb_hub_port_connect_change(struct usb_device *dev, int port)
 	}
 }
 
+void usb_hub_port_connect_change(struct usb_device *dev, int port)
+{
+	usb_hub_port_connect(dev, port, USB_HUB_DEBOUNCE_MS);
+
+	/* Scan the ports of the device, if it is a hub */
+	usb_hub_scan();
+}
+
+/*
+ * Poll one port for usb_hub_scan(), returning true when it is finished with
+ * and false if it should be polled again
+ */
+static bool usb_hub_scan_port(struct usb_port_scan *scan)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct usb_port_status, portsts, 1);
+	struct usb_hub_device *hub = scan->hub;
+	struct usb_device *dev = hub->pusb_dev;
+	unsigned short portstatus, portchange;
+	int i = scan->port;
+	ulong now = get_timer(0);
+
+	/* Let the power become stable before talking to the port */
+	if (now < hub->query_delay)
+		return false;
+
+	if (usb_get_port_status(dev, i + 1, portsts) < 0) {
+		debug("get_port_status failed\n");
+		return now >= hub->connect_timeout;
+	}
+	portstatus = le16_to_cpu(portsts->wPortStatus);
+	portchange = le16_to_cpu(portsts->wPortChange);
+	if (!usb_hub_port_settled(hub, &scan->debounce_end, now, portstatus,
+				  portchange))
+		return false;
+
+	debug("Port %d Status %X Change %X\n", i + 1, portstatus, portchange);
+
+	if (portchange & USB_PORT_STAT_C_CONNECTION) {
+		debug("port %d connection change\n", i + 1);
+		usb_hub_port_connect(dev, i, 0);
+	}
+	if (portchange & USB_PORT_STAT_C_ENABLE) {
+		debug("port %d enable change, status %x\n", i + 1, portstatus);
+		usb_clear_port_feature(dev, i + 1, USB_PORT_FEAT_C_ENABLE);
+		/*
+		 * The following hack causes a ghost device problem
+		 * to Faraday EHCI
+		 */
+#ifndef CONFIG_USB_EHCI_FARADAY
+		/* EM interference sometimes causes bad shielded USB
+		 * devices to be shutdown by the hub, this hack enables
+		 * them again. Works at least with mouse driver */
+		if (!(portstatus & USB_PORT_STAT_ENABLE) &&
+		     (portstatus & USB_PORT_STAT_CONNECTION) &&
+		     ((dev->children[i]))) {
+			debug("already running port %i "  \
+			      "disabled by hub (EMI?), " \
+			      "re-enabling...\n", i + 1);
+			usb_hub_port_connect(dev, i, USB_HUB_DEBOUNCE_MS);
+		}
+#endif
+	}
+	if (portstatus & USB_PORT_STAT_SUSPEND) {
+		debug("port %d suspend change\n", i + 1);
+		usb_clear_port_feature(dev, i + 1, USB_PORT_FEAT_SUSPEND);
+	}
+
+	if (portchange & USB_PORT_STAT_C_OVERCURRENT) {
+		debug("port %d over-current change\n", i + 1);
+		usb_clear_port_feature(dev, i + 1,
+				       USB_PORT_FEAT_C_OVER_CURRENT);
+		usb_hub_power_on(hub);
+	}
+
+	if (portchange & USB_PORT_STAT_C_RESET) {
+		debug("port %d reset change\n", i + 1);
+		usb_clear_port_feature(dev, i + 1, USB_PORT_FEAT_C_RESET);
+	}
+
+	return true;
+}
+
+int usb_hub_scan(void)
+{
+	struct usb_port_scan *scan, *tmp;
+
+	/* Hubs found while scanning just add their ports to the list */
+	if (usb_scan_running)
+		return 0;
+
+	usb_scan_running = 1;
+	while (!list_empty(&usb_scan_list)) {
+		list_for_each_entry_safe(scan, tmp, &usb_scan_list, list) {
+			if (usb_hub_scan_port(scan)) {
+				list_del(&scan->list);
+				free(scan);
+			}
+		}
+	}
+	usb_scan_running = 0;
+
+	return 0;
+}
+
 
 static int usb_hub_configure(struct usb_device *dev)
 {
@@ -444,88 +593,19 @@ static int usb_hub_configure(struct usb_device *dev)
 	for (i = 0; i < dev->maxchild; i++)
 		usb_hub_reset_devices(i + 1);
 
+	/* Have usb_hub_scan() look at the ports once they are powered */
 	for (i = 0; i < dev->maxchild; i++) {
-		ALLOC_CACHE_ALIGN_BUFFER(struct usb_port_status, portsts, 1);
-		unsigned short portstatus, portchange;
-		int ret;
-		ulong start = get_timer(0);
+		struct usb_port_scan *scan;
 
-		/*
-		 * Wait for (whichever finishes first)
-		 *  - A maximum of 10 seconds
-		 *    This is a purely observational value driven by connecting
-		 *    a few broken pen drives and taking the max * 1.5 approach
-		 *  - connection_change and connection state to report same
-		 *    state
-		 */
-		do {
-			ret = usb_get_port_status(dev, i + 1, portsts);
-			if (ret < 0) {
-				debug("get_port_status failed\n");
-				break;
-			}
-
-			portstatus = le16_to_cpu(portsts->wPortStatus);
-			portchange = le16_to_cpu(portsts->wPortChange);
-
-			if ((portchange & USB_PORT_STAT_C_CONNECTION) ==
-				(portstatus & USB_PORT_STAT_CONNECTION))
-				break;
-
-		} while (get_timer(start) < CONFIG_SYS_HZ * 10);
-
-		if (ret < 0)
-			continue;
-
-		debug("Port %d Status %X Change %X\n",
-		      i + 1, portstatus, portchange);
-
-		if (portchange & USB_PORT_STAT_C_CONNECTION) {
-			debug("port %d connection change\n", i + 1);
-			usb_hub_port_connect_change(dev, i);
+		scan = calloc(1, sizeof(*scan));
+		if (!scan) {
+			printf("ERROR: cannot scan hub port %d\n", i + 1);
+			return -ENOMEM;
 		}
-		if (portchange & USB_PORT_STAT_C_ENABLE) {
-			debug("port %d enable change, status %x\n",
-			      i + 1, portstatus);
-			usb_clear_port_feature(dev, i + 1,
-						USB_PORT_FEAT_C_ENABLE);
-			/*
-			 * The following hack causes a ghost device problem
-			 * to Faraday EHCI
-			 */
-#ifndef CONFIG_USB_EHCI_FARADAY
-			/* EM interference sometimes causes bad shielded USB
-			 * devices to be shutdown by the hub, this hack enables
-			 * them again. Works at least with mouse driver */
-			if (!(portstatus & USB_PORT_STAT_ENABLE) &&
-			     (portstatus & USB_PORT_STAT_CONNECTION) &&
-			     ((dev->children[i]))) {
-				debug("already running port %i "  \
-				      "disabled by hub (EMI?), " \
-				      "re-enabling...\n", i + 1);
-				      usb_hub_port_connect_change(dev, i);
-			}
-#endif
-		}
-		if (portstatus & USB_PORT_STAT_SUSPEND) {
-			debug("port %d suspend change\n", i + 1);
-			usb_clear_port_feature(dev, i + 1,
-						USB_PORT_FEAT_SUSPEND);
-		}
-
-		if (portchange & USB_PORT_STAT_C_OVERCURRENT) {
-			debug("port %d over-current change\n", i + 1);
-			usb_clear_port_feature(dev, i + 1,
-						USB_PORT_FEAT_C_OVER_CURRENT);
-			usb_hub_power_on(hub);
-		}
-
-		if (portchange & USB_PORT_STAT_C_RESET) {
-			debug("port %d reset change\n", i + 1);
-			usb_clear_port_feature(dev, i + 1,
-						USB_PORT_FEAT_C_RESET);
-		}
-	} /* end for i all ports */
+		scan->hub = hub;
+		scan->port = i;
+		list_add_tail(&scan->list, &usb_scan_list);
+	}
 
 	return 0;
 }
@@ -0,0 +1,44 @@
+/*
+ * Timing of the hub port scan, kept apart from the hub driver so that it
+ * can be tested without a USB controller
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <usb.h>
+
+void usb_hub_set_deadlines(struct usb_hub_device *hub, ulong now,
+			   unsigned pgood_delay)
+{
+	hub->query_delay = now + max(100U, pgood_delay);
+	hub->connect_timeout = hub->query_delay + 1000;
+}
+
+bool usb_hub_port_settled(const struct usb_hub_device *hub,
+			  ulong *debounce_end, ulong now,
+			  unsigned short portstatus, unsigned short portchange)
+{
+	if (!(portchange & USB_PORT_STAT_C_CONNECTION)) {
+		/* Give a device the spec-defined time to connect */
+		return now >= hub->connect_timeout;
+	} else if (!(portstatus & USB_PORT_STAT_CONNECTION)) {
+		/*
+		 * Wait for the connection state to report the same as the
+		 * change, for at most 10 seconds. This is a purely
+		 * observational value driven by connecting a few broken pen
+		 * drives and taking the max * 1.5 approach.
+		 */
+		return now >= hub->query_delay + CONFIG_SYS_HZ * 10;
+	}
+
+	/* Let the connection settle while other ports are polled */
+	if (!*debounce_end) {
+		*debounce_end = now + USB_HUB_DEBOUNCE_MS;
+		return false;
+	}
+
+	return now >= *debounce_end;
+}
@@ -8,6 +8,7 @@
  * SPDX-License-Identifier:	GPL-2.0+
  */
 #include <common.h>
+#include <errno.h>
 #include <malloc.h>
 #include <stdio_dev.h>
 #include <asm/byteorder.h>
@@ -108,6 +109,9 @@ struct usb_kbd_pdata {
 	uint8_t		old[USB_KBD_BOOT_REPORT_SIZE];
 
 	uint8_t		flags;
+
+	/* Interrupt queue receiving reports into new, if there is one */
+	struct int_queue *intq;
 };
 
 extern int __maybe_unused net_busy_flag;
@@ -337,6 +341,14 @@ static inline void usb_kbd_poll_for_event(struct usb_device *dev)
 
 	/* Get the pointer to USB Keyboard device pointer */
 	data = dev->privptr;
+
+	/* Only look for a report which has come in, never wait for one */
+	if (data->intq) {
+		if (poll_int_queue(dev, data->intq))
+			usb_kbd_irq_worker(dev);
+		return;
+	}
+
 	iface = &dev->config.if_desc[0];
 	ep = &iface->ep_desc[0];
 	pipe = usb_rcvintpipe(dev, ep->bEndpointAddress);
@@ -472,6 +484,14 @@ static int usb_kbd_probe(struct usb_device *dev, unsigned int ifnum)
 	usb_set_idle(dev, iface->desc.bInterfaceNumber, REPEAT_RATE, 0);
 
 	debug("USB KBD: enable interrupt pipe...\n");
+#ifdef CONFIG_SYS_USB_EVENT_POLL
+	/* Keep a transfer running, for the console not to wait on the device */
+	data->intq = create_int_queue(dev, pipe, 1,
+				      min(maxp, USB_KBD_BOOT_REPORT_SIZE),
+				      data->new);
+	if (data->intq)
+		return 1;
+#endif
 	if (usb_submit_int_msg(dev, pipe, data->new,
 			       min(maxp, USB_KBD_BOOT_REPORT_SIZE),
 			       ep->bInterval) < 0) {
@@ -558,7 +578,28 @@ int drv_usb_kbd_init(void)
 int usb_kbd_deregister(void)
 {
 #ifdef CONFIG_SYS_STDIO_DEREGISTER
-	return stdio_deregister(DEVNAME);
+	struct stdio_dev *dev;
+	struct usb_device *usb_kbd_dev;
+	struct usb_kbd_pdata *data;
+	int ret;
+
+	dev = stdio_get_by_name(DEVNAME);
+	if (!dev)
+		return -ENODEV;
+
+	usb_kbd_dev = (struct usb_device *)dev->priv;
+	ret = stdio_deregister_dev(dev);
+	if (ret)
+		return ret;
+
+	/* Stop the interrupt queue while the controller is still running */
+	data = usb_kbd_dev->privptr;
+	if (data && data->intq) {
+		destroy_int_queue(usb_kbd_dev, data->intq);
+		data->intq = NULL;
+	}
+
+	return 0;
 #else
 	return 1;
 #endif
@@ -33,8 +33,10 @@
 
 #include <common.h>
 #include <command.h>
+#include <errno.h>
 #include <asm/byteorder.h>
 #include <asm/processor.h>
+#include <asm/unaligned.h>
 
 #include <part.h>
 #include <usb.h>
@@ -49,7 +51,7 @@
 static const unsigned char us_direction[256/8] = {
 	0x28, 0x81, 0x14, 0x14, 0x20, 0x01, 0x90, 0x77,
 	0x0C, 0x20, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01,
+	0x00, 0x01, 0x00, 0x40, 0x00, 0x01, 0x00, 0x01,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
 #define US_DIRECTION(x) ((us_direction[x>>3] >> (x & 7)) & 1)
@@ -98,6 +100,79 @@ typedef struct {
 } umass_bbb_csw_t;
 #define UMASS_BBB_CSW_SIZE	13
 
+#ifdef CONFIG_USB_UAS
+/*
+ * USB Attached SCSI
+ *
+ * Each command goes to the command pipe in an IU tagged with a stream ID, and
+ * its data and status come on that stream of the data and status pipes, so
+ * that the device can have several commands at once.
+ */
+#define UAS_IU_COMMAND		0x01
+#define UAS_IU_SENSE		0x03
+#define UAS_IU_RESPONSE		0x04
+#define UAS_IU_TASK_MGMT	0x05
+
+/* Pipe IDs, from the Pipe Usage descriptor of each endpoint */
+#define UAS_PIPE_COMMAND	1
+#define UAS_PIPE_STATUS		2
+#define UAS_PIPE_DATA_IN	3
+#define UAS_PIPE_DATA_OUT	4
+
+#define UAS_TMF_LU_RESET	0x08
+#define UAS_RC_TMF_COMPLETE	0x00
+#define UAS_RC_TMF_SUCCEEDED	0x08
+
+struct uas_command_iu {
+	__u8	iu_id;
+	__u8	rsvd1;
+	__be16	tag;
+	__u8	prio_attr;		/* 0 for a SIMPLE task */
+	__u8	rsvd5;
+	__u8	len;			/* Additional CDB length */
+	__u8	rsvd7;
+	__u8	lun[8];
+	__u8	cdb[16];
+} __attribute__ ((packed));
+
+struct uas_task_mgmt_iu {
+	__u8	iu_id;
+	__u8	rsvd1;
+	__be16	tag;
+	__u8	function;
+	__u8	rsvd5;
+	__be16	task_tag;
+	__u8	lun[8];
+} __attribute__ ((packed));
+
+struct uas_sense_iu {
+	__u8	iu_id;
+	__u8	rsvd1;
+	__be16	tag;
+	__be16	status_qual;
+	__u8	status;
+	__u8	rsvd7[7];
+	__be16	len;
+	__u8	sense[96];
+} __attribute__ ((packed));
+
+struct uas_response_iu {
+	__u8	iu_id;
+	__u8	rsvd1;
+	__be16	tag;
+	__u8	add_response_info[3];
+	__u8	response_code;
+} __attribute__ ((packed));
+
+/* Largest transfer of a queued command, to fit in a stream ring */
+#define USB_STOR_UAS_MAX_XFER	(2 << 20)
+
+#define USB_STOR_UAS_CMD_STRIDE	\
+	ROUND(sizeof(struct uas_command_iu), ARCH_DMA_MINALIGN)
+#define USB_STOR_UAS_SENSE_STRIDE \
+	ROUND(sizeof(struct uas_sense_iu), ARCH_DMA_MINALIGN)
+#endif
+
 #define USB_MAX_STOR_DEV 5
 static int usb_max_devs; /* number of highest available usb device */
 
@@ -106,16 +181,23 @@ static block_dev_desc_t usb_dev_desc[USB_MAX_STOR_DEV];
 struct us_data;
 typedef int (*trans_cmnd)(ccb *cb, struct us_data *data);
 typedef int (*trans_reset)(struct us_data *data);
+typedef int (*trans_queue)(ccb *srb, struct us_data *data,
+			   block_dev_desc_t *desc, lbaint_t start,
+			   lbaint_t blks, uintptr_t buf_addr, bool write);
 
 struct us_data {
 	struct usb_device *pusb_dev;	 /* this usb_device */
 
 	unsigned int	flags;			/* from filter initially */
 #	define USB_READY	(1 << 0)
+#	define USB_NO_QUEUE	(1 << 1)	/* Host cannot queue transfers */
 	unsigned char	ifnum;			/* interface number */
 	unsigned char	ep_in;			/* in endpoint */
 	unsigned char	ep_out;			/* out ....... */
 	unsigned char	ep_int;			/* interrupt . */
+	unsigned char	ep_cmd;			/* UAS command */
+	unsigned char	ep_status;		/* UAS status */
+	unsigned char	num_streams;		/* UAS streams (tags) */
 	unsigned char	subclass;		/* as in overview */
 	unsigned char	protocol;		/* .............. */
 	unsigned char	attention_done;		/* force attn on first cmd */
@@ -129,6 +211,7 @@ struct us_data {
 	ccb		*srb;			/* current srb */
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
+	trans_queue	queue;			/* queued READ/WRITE routine */
 };
 
 #ifdef CONFIG_USB_EHCI
@@ -142,6 +225,9 @@ struct us_data {
 #define USB_MAX_XFER_BLK	20
 #endif
 
+/* Most READ/WRITE commands run by one call of ss->queue() */
+#define USB_STOR_QUEUE_DEPTH	4
+
 static struct us_data usb_stor[USB_MAX_STOR_DEV];
 
 
@@ -196,6 +282,10 @@ static unsigned int usb_get_max_lun(struct us_data *us)
 {
 	int len;
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, result, 1);
+
+	/* UAS has no such request, and only LUN 0 is used */
+	if (us->protocol == US_PR_UAS)
+		return 0;
 	len = usb_control_msg(us->pusb_dev,
 			      usb_rcvctrlpipe(us->pusb_dev, 0),
 			      US_BBB_GET_MAX_LUN,
@@ -472,6 +562,22 @@ static int usb_stor_CB_reset(struct us_data *us)
 	return 0;
 }
 
+/* Fill in a CBW for the command in @srb */
+static void usb_stor_BBB_setup_cbw(umass_bbb_cbw_t *cbw, ccb *srb)
+{
+	int dir_in = US_DIRECTION(srb->cmd[0]);
+
+	cbw->dCBWSignature = cpu_to_le32(CBWSIGNATURE);
+	cbw->dCBWTag = cpu_to_le32(CBWTag++);
+	cbw->dCBWDataTransferLength = cpu_to_le32(srb->datalen);
+	cbw->bCBWFlags = (dir_in ? CBWFLAGS_IN : CBWFLAGS_OUT);
+	cbw->bCBWLUN = srb->lun;
+	cbw->bCDBLength = srb->cmdlen;
+	/* copy the command data into the CBW command data buffer */
+	/* DST SRC LEN!!! */
+	memcpy(cbw->CBWCDB, srb->cmd, srb->cmdlen);
+}
+
 /*
  * Set up the command for a BBB device. Note that the actual SCSI
  * command is copied into cbw.CBWCDB.
@@ -480,16 +586,13 @@ static int usb_stor_BBB_comdat(ccb *srb, struct us_data *us)
 {
 	int result;
 	int actlen;
-	int dir_in;
 	unsigned int pipe;
 	ALLOC_CACHE_ALIGN_BUFFER(umass_bbb_cbw_t, cbw, 1);
 
-	dir_in = US_DIRECTION(srb->cmd[0]);
-
 #ifdef BBB_COMDAT_TRACE
 	printf("dir %d lun %d cmdlen %d cmd %p datalen %lu pdata %p\n",
-		dir_in, srb->lun, srb->cmdlen, srb->cmd, srb->datalen,
-		srb->pdata);
+		US_DIRECTION(srb->cmd[0]), srb->lun, srb->cmdlen, srb->cmd,
+		srb->datalen, srb->pdata);
 	if (srb->cmdlen) {
 		for (result = 0; result < srb->cmdlen; result++)
 			printf("cmd[%d] %#x ", result, srb->cmd[result]);
@@ -505,15 +608,7 @@ static int usb_stor_BBB_comdat(ccb *srb, struct us_data *us)
 	/* always OUT to the ep */
 	pipe = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
 
-	cbw->dCBWSignature = cpu_to_le32(CBWSIGNATURE);
-	cbw->dCBWTag = cpu_to_le32(CBWTag++);
-	cbw->dCBWDataTransferLength = cpu_to_le32(srb->datalen);
-	cbw->bCBWFlags = (dir_in ? CBWFLAGS_IN : CBWFLAGS_OUT);
-	cbw->bCBWLUN = srb->lun;
-	cbw->bCDBLength = srb->cmdlen;
-	/* copy the command data into the CBW command data buffer */
-	/* DST SRC LEN!!! */
-	memcpy(cbw->CBWCDB, srb->cmd, srb->cmdlen);
+	usb_stor_BBB_setup_cbw(cbw, srb);
 	result = usb_bulk_msg(us->pusb_dev, pipe, cbw, UMASS_BBB_CBW_SIZE,
 			      &actlen, USB_CNTL_TIMEOUT * 5);
 	if (result < 0)
@@ -914,6 +1009,10 @@ static int usb_request_sense(ccb *srb, struct us_data *ss)
 {
 	char *ptr;
 
+	/* The Sense IU of the failed command has left the sense data */
+	if (ss->protocol == US_PR_UAS)
+		return 0;
+
 	ptr = (char *)srb->pdata;
 	memset(&srb->cmd[0], 0, 12);
 	srb->cmd[0] = SCSI_REQ_SENSE;
@@ -979,11 +1078,46 @@ static int usb_read_capacity(ccb *srb, struct us_data *ss)
 	return -1;
 }
 
-static int usb_read_10(ccb *srb, struct us_data *ss, unsigned long start,
-		       unsigned short blocks)
+static int usb_read_capacity_16(ccb *srb, struct us_data *ss)
 {
-	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_READ10;
+	int retry;
+
+	retry = 3;
+	do {
+		memset(&srb->cmd[0], 0, 16);
+		srb->cmd[0] = SCSI_RD_CAPAC16;
+		srb->cmd[1] = 0x10;	/* Service action: READ CAPACITY(16) */
+		srb->cmd[13] = 32;
+		srb->datalen = 32;
+		srb->cmdlen = 16;
+		if (ss->transport(srb, ss) == USB_STOR_TRANSPORT_GOOD)
+			return 0;
+	} while (retry--);
+
+	return -1;
+}
+
+/*
+ * Set up a READ or WRITE of @blocks from @start, using the 16-byte command
+ * for blocks beyond the 32-bit LBAs of the 10-byte one
+ */
+static void usb_setup_rw(ccb *srb, lbaint_t start, unsigned short blocks,
+			 bool write)
+{
+	uint64_t lba = start;
+	int i;
+
+	memset(&srb->cmd[0], 0, 16);
+	if (lba + blocks > 0xffffffffULL) {
+		srb->cmd[0] = write ? SCSI_WRITE16 : SCSI_READ16;
+		for (i = 0; i < 8; i++)
+			srb->cmd[2 + i] = lba >> (56 - i * 8);
+		srb->cmd[12] = (blocks >> 8) & 0xff;
+		srb->cmd[13] = blocks & 0xff;
+		srb->cmdlen = 16;
+		return;
+	}
+	srb->cmd[0] = write ? SCSI_WRITE10 : SCSI_READ10;
 	srb->cmd[1] = srb->lun << 5;
 	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
 	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
@@ -992,27 +1126,358 @@ static int usb_read_10(ccb *srb, struct us_data *ss, unsigned long start,
 	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
 	srb->cmd[8] = (unsigned char) blocks & 0xff;
 	srb->cmdlen = 12;
-	debug("read10: start %lx blocks %x\n", start, blocks);
+}
+
+static int usb_read_blocks(ccb *srb, struct us_data *ss, lbaint_t start,
+			   unsigned short blocks)
+{
+	usb_setup_rw(srb, start, blocks, false);
+	debug("read: start " LBAF " blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
 
-static int usb_write_10(ccb *srb, struct us_data *ss, unsigned long start,
-			unsigned short blocks)
+static int usb_write_blocks(ccb *srb, struct us_data *ss, lbaint_t start,
+			    unsigned short blocks)
 {
-	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_WRITE10;
-	srb->cmd[1] = srb->lun << 5;
-	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
-	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
-	srb->cmd[4] = ((unsigned char) (start >> 8)) & 0xff;
-	srb->cmd[5] = ((unsigned char) (start)) & 0xff;
-	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
-	srb->cmd[8] = (unsigned char) blocks & 0xff;
-	srb->cmdlen = 12;
-	debug("write10: start %lx blocks %x\n", start, blocks);
+	usb_setup_rw(srb, start, blocks, true);
+	debug("write: start " LBAF " blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
 
+/*
+ * Read up to USB_STOR_QUEUE_DEPTH * USB_MAX_XFER_BLK blocks with the CBW,
+ * data and CSW of each READ command queued in the host controller together.
+ * This saves a round trip through software for each stage, and the delay
+ * before the data stage, as the device just NAKs until it is ready. Bulk-only
+ * transport allows no new CBW until the CSW of the previous command has been
+ * received, so each command is queued only once the previous one completes.
+ * Writes are not queued.
+ *
+ * Returns the number of blocks read, 0 if the host controller cannot queue
+ * transfers, or -1 on error, after which the device has been reset.
+ */
+static int usb_stor_BBB_queue(ccb *srb, struct us_data *ss,
+			      block_dev_desc_t *desc, lbaint_t start,
+			      lbaint_t blks, uintptr_t buf_addr, bool write)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(umass_bbb_cbw_t, cbw, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(umass_bbb_csw_t, csw, 1);
+	struct usb_bulk_xfer xfer[3];
+	u8 *buf = (u8 *)buf_addr;
+	unsigned short count;
+	lbaint_t done = 0;
+	u32 tag;
+	int n, ret;
+
+	if (write || (ss->flags & USB_NO_QUEUE))
+		return 0;
+
+	for (n = 0; n < USB_STOR_QUEUE_DEPTH && done < blks; n++) {
+		count = min(blks - done, (lbaint_t)USB_MAX_XFER_BLK);
+		usb_setup_rw(srb, start + done, count, false);
+		srb->datalen = desc->blksz * count;
+		tag = CBWTag;
+		usb_stor_BBB_setup_cbw(cbw, srb);
+
+		memset(xfer, 0, sizeof(xfer));
+		xfer[0].pipe = usb_sndbulkpipe(ss->pusb_dev, ss->ep_out);
+		xfer[0].buffer = cbw;
+		xfer[0].length = UMASS_BBB_CBW_SIZE;
+		xfer[1].pipe = usb_rcvbulkpipe(ss->pusb_dev, ss->ep_in);
+		xfer[1].buffer = buf + done * desc->blksz;
+		xfer[1].length = srb->datalen;
+		xfer[2].pipe = xfer[1].pipe;
+		xfer[2].buffer = csw;
+		xfer[2].length = UMASS_BBB_CSW_SIZE;
+
+		ret = usb_bulk_msg_queue(ss->pusb_dev, xfer, 3);
+		if (!n && (ret == -ENOSYS || ret == -EINVAL)) {
+			/* Nothing was sent, so the tag can be used again */
+			CBWTag = tag;
+			ss->flags |= USB_NO_QUEUE;
+			return 0;
+		}
+		if (ret || xfer[0].status || xfer[1].status ||
+		    xfer[2].status || xfer[1].actual != xfer[1].length ||
+		    xfer[2].actual != UMASS_BBB_CSW_SIZE ||
+		    le32_to_cpu(csw->dCSWSignature) != CSWSIGNATURE ||
+		    le32_to_cpu(csw->dCSWTag) != tag ||
+		    csw->bCSWStatus != CSWSTATUS_GOOD ||
+		    csw->dCSWDataResidue) {
+			debug("queued read failed at command %d\n", n);
+			usb_stor_BBB_reset(ss);
+			return done ? done : -1;
+		}
+		done += count;
+	}
+
+	return done;
+}
+
+#ifdef CONFIG_USB_UAS
+/*
+ * Set up the Command IU for @srb with tag @tag, and the transfers of it, of
+ * the data at @data if there is any, and of its Sense IU on the same stream.
+ * Returns the number of transfers.
+ */
+static int usb_stor_UAS_setup(ccb *srb, struct us_data *us, int tag,
+			      bool dir_in, void *data,
+			      struct uas_command_iu *cmd,
+			      struct uas_sense_iu *sense,
+			      struct usb_bulk_xfer *xfer)
+{
+	struct usb_device *dev = us->pusb_dev;
+	int n = 0;
+
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->iu_id = UAS_IU_COMMAND;
+	cmd->tag = cpu_to_be16(tag);
+	cmd->lun[1] = srb->lun;
+	memcpy(cmd->cdb, srb->cmd, srb->cmdlen);
+	memset(sense, 0, sizeof(*sense));
+
+	memset(xfer, 0, 3 * sizeof(*xfer));
+	xfer[n].pipe = usb_sndbulkpipe(dev, us->ep_cmd);
+	xfer[n].buffer = cmd;
+	xfer[n++].length = sizeof(*cmd);
+	if (srb->datalen) {
+		xfer[n].pipe = dir_in ? usb_rcvbulkpipe(dev, us->ep_in) :
+				usb_sndbulkpipe(dev, us->ep_out);
+		xfer[n].buffer = data;
+		xfer[n].length = srb->datalen;
+		xfer[n++].stream = tag;
+	}
+	xfer[n].pipe = usb_rcvbulkpipe(dev, us->ep_status);
+	xfer[n].buffer = sense;
+	xfer[n].length = sizeof(*sense);
+	xfer[n++].stream = tag;
+
+	return n;
+}
+
+/*
+ * Check the Sense IU received for the command with tag @tag, copying any
+ * sense data to @srb. Returns USB_STOR_TRANSPORT_ERROR if there is no such
+ * Sense IU.
+ */
+static int usb_stor_UAS_status(ccb *srb, struct usb_bulk_xfer *xfer,
+			       struct uas_sense_iu *sense, int tag)
+{
+	int len;
+
+	len = xfer->actual - (int)offsetof(struct uas_sense_iu, sense);
+	if (xfer->status || len < 0 || sense->iu_id != UAS_IU_SENSE ||
+	    be16_to_cpu(sense->tag) != tag) {
+		debug("UAS: no Sense IU for tag %d\n", tag);
+		return USB_STOR_TRANSPORT_ERROR;
+	}
+	if (sense->status == 0)
+		return USB_STOR_TRANSPORT_GOOD;
+
+	debug("UAS: tag %d status %02X\n", tag, sense->status);
+	len = min(len, (int)be16_to_cpu(sense->len));
+	len = min(len, (int)sizeof(srb->sense_buf));
+	memset(srb->sense_buf, 0, sizeof(srb->sense_buf));
+	memcpy(srb->sense_buf, sense->sense, len);
+
+	return USB_STOR_TRANSPORT_FAILED;
+}
+
+/* Reset the logical unit, throwing away any commands it has */
+static int usb_stor_UAS_reset(struct us_data *us)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_task_mgmt_iu, tmf, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_response_iu, rsp, 1);
+	struct usb_device *dev = us->pusb_dev;
+	struct usb_bulk_xfer xfer[2];
+	int ret;
+
+	debug("UAS_reset\n");
+	memset(tmf, 0, sizeof(*tmf));
+	tmf->iu_id = UAS_IU_TASK_MGMT;
+	tmf->tag = cpu_to_be16(1);
+	tmf->function = UAS_TMF_LU_RESET;
+	tmf->lun[1] = usb_ccb.lun;
+	memset(rsp, 0, sizeof(*rsp));
+
+	memset(xfer, 0, sizeof(xfer));
+	xfer[0].pipe = usb_sndbulkpipe(dev, us->ep_cmd);
+	xfer[0].buffer = tmf;
+	xfer[0].length = sizeof(*tmf);
+	xfer[1].pipe = usb_rcvbulkpipe(dev, us->ep_status);
+	xfer[1].buffer = rsp;
+	xfer[1].length = sizeof(*rsp);
+	xfer[1].stream = 1;
+
+	ret = usb_bulk_msg_queue(dev, xfer, 2);
+	if (ret || rsp->iu_id != UAS_IU_RESPONSE ||
+	    (rsp->response_code != UAS_RC_TMF_COMPLETE &&
+	     rsp->response_code != UAS_RC_TMF_SUCCEEDED)) {
+		debug("UAS_reset failed: %d, response %02X\n", ret,
+		      rsp->response_code);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int usb_stor_UAS_transport(ccb *srb, struct us_data *us)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_command_iu, cmd, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct uas_sense_iu, sense, 1);
+	struct usb_bulk_xfer xfer[3];
+	int n, result;
+
+	if (srb->cmdlen > sizeof(cmd->cdb))
+		return USB_STOR_TRANSPORT_FAILED;
+	n = usb_stor_UAS_setup(srb, us, 1, US_DIRECTION(srb->cmd[0]),
+			       srb->pdata, cmd, sense, xfer);
+
+	/*
+	 * A command which fails may send its Sense IU without any data. The
+	 * data transfer then times out, and is thrown away by the host.
+	 */
+	usb_bulk_msg_queue(us->pusb_dev, xfer, n);
+	result = usb_stor_UAS_status(srb, &xfer[n - 1], sense, 1);
+	if (result == USB_STOR_TRANSPORT_ERROR) {
+		usb_stor_UAS_reset(us);
+		return USB_STOR_TRANSPORT_FAILED;
+	}
+	if (result == USB_STOR_TRANSPORT_GOOD && n == 3 && xfer[1].status)
+		return USB_STOR_TRANSPORT_FAILED;
+
+	return result;
+}
+
+/*
+ * Read or write up to USB_STOR_QUEUE_DEPTH chunks of up to
+ * USB_STOR_UAS_MAX_XFER bytes, with one command for each, all queued in the
+ * device at once on their own streams. The device moves the data of each
+ * as soon as it is ready, with no round trip through software in between.
+ *
+ * Returns the number of blocks done, or -1 on error, after which the logical
+ * unit has been reset if the device stopped responding.
+ */
+static int usb_stor_UAS_queue(ccb *srb, struct us_data *ss,
+			      block_dev_desc_t *desc, lbaint_t start,
+			      lbaint_t blks, uintptr_t buf_addr, bool write)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, cmd_buf,
+				 USB_STOR_QUEUE_DEPTH *
+				 USB_STOR_UAS_CMD_STRIDE);
+	ALLOC_CACHE_ALIGN_BUFFER(u8, sense_buf,
+				 USB_STOR_QUEUE_DEPTH *
+				 USB_STOR_UAS_SENSE_STRIDE);
+	struct usb_bulk_xfer xfer[USB_STOR_QUEUE_DEPTH * 3];
+	unsigned short count[USB_STOR_QUEUE_DEPTH];
+	u8 *buf = (u8 *)buf_addr;
+	struct uas_sense_iu *sense;
+	lbaint_t max_blks, done = 0;
+	int i, n, depth, result = USB_STOR_TRANSPORT_GOOD;
+
+	depth = min(USB_STOR_QUEUE_DEPTH, (int)ss->num_streams);
+	max_blks = USB_STOR_UAS_MAX_XFER / desc->blksz;
+	if (max_blks > 0xffff)
+		max_blks = 0xffff;
+
+	for (n = 0; n < depth && done < blks; n++) {
+		count[n] = min(blks - done, max_blks);
+		usb_setup_rw(srb, start + done, count[n], write);
+		srb->datalen = desc->blksz * count[n];
+		usb_stor_UAS_setup(srb, ss, n + 1, !write,
+				   buf + done * desc->blksz,
+				   (struct uas_command_iu *)(cmd_buf +
+					n * USB_STOR_UAS_CMD_STRIDE),
+				   (struct uas_sense_iu *)(sense_buf +
+					n * USB_STOR_UAS_SENSE_STRIDE),
+				   &xfer[n * 3]);
+		done += count[n];
+	}
+
+	usb_bulk_msg_queue(ss->pusb_dev, xfer, n * 3);
+
+	/* Count the commands which completed fully and successfully */
+	done = 0;
+	for (i = 0; i < n; i++) {
+		sense = (struct uas_sense_iu *)(sense_buf +
+						i * USB_STOR_UAS_SENSE_STRIDE);
+		result = usb_stor_UAS_status(srb, &xfer[i * 3 + 2], sense,
+					     i + 1);
+		if (result != USB_STOR_TRANSPORT_GOOD ||
+		    xfer[i * 3 + 1].status ||
+		    xfer[i * 3 + 1].actual != xfer[i * 3 + 1].length)
+			break;
+		done += count[i];
+	}
+	if (i < n) {
+		debug("queued %s failed at command %d of %d\n",
+		      write ? "write" : "read", i, n);
+		if (result == USB_STOR_TRANSPORT_ERROR)
+			usb_stor_UAS_reset(ss);
+		return done ? done : -1;
+	}
+
+	return done;
+}
+
+/*
+ * Use UAS if the interface has an alternate setting for it, and the host
+ * controller can give its endpoints streams. Otherwise the interface is left
+ * for Bulk-Only Transport, if it has that too.
+ */
+static int usb_stor_UAS_probe(struct usb_device *dev,
+			      struct usb_interface *iface, struct us_data *ss)
+{
+	int ifnum = iface->desc.bInterfaceNumber;
+	unsigned char ep;
+	int i, alt = -1, streams;
+
+	if (ss->subclass != US_SC_SCSI)
+		return -ENODEV;
+
+	for (i = 0; i < iface->no_of_ep; i++) {
+		ep = iface->ep_desc[i].bEndpointAddress &
+			USB_ENDPOINT_NUMBER_MASK;
+		switch (iface->ep_pipe_id[i]) {
+		case UAS_PIPE_COMMAND:
+			ss->ep_cmd = ep;
+			break;
+		case UAS_PIPE_STATUS:
+			ss->ep_status = ep;
+			break;
+		case UAS_PIPE_DATA_IN:
+			ss->ep_in = ep;
+			break;
+		case UAS_PIPE_DATA_OUT:
+			ss->ep_out = ep;
+			break;
+		default:
+			continue;
+		}
+		alt = iface->ep_altsetting[i];
+	}
+	if (alt < 0 || !ss->ep_cmd || !ss->ep_status || !ss->ep_in ||
+	    !ss->ep_out)
+		return -ENODEV;
+
+	if (usb_set_interface(dev, ifnum, alt))
+		return -EIO;
+	streams = usb_alloc_streams(dev, ifnum, USB_STOR_QUEUE_DEPTH);
+	if (streams < 1) {
+		debug("UAS: no streams (%d)\n", streams);
+		return -ENOSYS;
+	}
+
+	debug("USB Attached SCSI, %d streams\n", streams);
+	ss->num_streams = min(streams, 255);
+	ss->protocol = US_PR_UAS;
+	ss->transport = usb_stor_UAS_transport;
+	ss->transport_reset = usb_stor_UAS_reset;
+	ss->queue = usb_stor_UAS_queue;
+
+	return 0;
+}
+#endif /* CONFIG_USB_UAS */
 
 #ifdef CONFIG_USB_BIN_FIXUP
 /*
@@ -1042,10 +1507,10 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks = 0;
 	struct usb_device *dev;
 	struct us_data *ss;
-	int retry, i;
+	int retry, i, n;
 	ccb *srb = &usb_ccb;
 
 	if (blkcnt == 0)
@@ -1074,6 +1539,19 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 	      " buffer %lx\n", device, start, blks, buf_addr);
 
 	do {
+		n = 0;
+		if (ss->queue)
+			n = ss->queue(srb, ss, &usb_dev_desc[device], start,
+				      blks, buf_addr, false);
+		if (n > 0) {
+			if (n >= USB_MAX_XFER_BLK)
+				usb_show_progress();
+			start += n;
+			blks -= n;
+			buf_addr += n * usb_dev_desc[device].blksz;
+			continue;
+		}
+
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1086,7 +1564,7 @@ retry_it:
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (usb_read_10(srb, ss, start, smallblks)) {
+		if (usb_read_blocks(srb, ss, start, smallblks)) {
 			debug("Read ERROR\n");
 			usb_request_sense(srb, ss);
 			if (retry--)
@@ -1115,10 +1593,10 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks = 0;
 	struct usb_device *dev;
 	struct us_data *ss;
-	int retry, i;
+	int retry, i, n;
 	ccb *srb = &usb_ccb;
 
 	if (blkcnt == 0)
@@ -1148,6 +1626,19 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 	      " buffer %lx\n", device, start, blks, buf_addr);
 
 	do {
+		n = 0;
+		if (ss->queue)
+			n = ss->queue(srb, ss, &usb_dev_desc[device], start,
+				      blks, buf_addr, true);
+		if (n > 0) {
+			if (n >= USB_MAX_XFER_BLK)
+				usb_show_progress();
+			start += n;
+			blks -= n;
+			buf_addr += n * usb_dev_desc[device].blksz;
+			continue;
+		}
+
 		/* If write fails retry for max retry count else
 		 * return with number of blocks written successfully.
 		 */
@@ -1162,7 +1653,7 @@ retry_it:
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (usb_write_10(srb, ss, start, smallblks)) {
+		if (usb_write_blocks(srb, ss, start, smallblks)) {
 			debug("Write ERROR\n");
 			usb_request_sense(srb, ss);
 			if (retry--)
@@ -1244,6 +1735,13 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		ss->protocol = iface->desc.bInterfaceProtocol;
 	}
 
+#ifdef CONFIG_USB_UAS
+	if (!usb_stor_UAS_probe(dev, iface, ss)) {
+		dev->privptr = (void *)ss;
+		return 1;
+	}
+#endif
+
 	/* set the handler pointers based on the protocol */
 	debug("Transport: ");
 	switch (ss->protocol) {
@@ -1262,6 +1760,7 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		debug("Bulk/Bulk/Bulk\n");
 		ss->transport = usb_stor_BBB_transport;
 		ss->transport_reset = usb_stor_BBB_reset;
+		ss->queue = usb_stor_BBB_queue;
 		break;
 	default:
 		printf("USB Storage Transport unknown / not yet implemented\n");
@@ -1333,9 +1832,10 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 		      block_dev_desc_t *dev_desc)
 {
 	unsigned char perq, modi;
-	ALLOC_CACHE_ALIGN_BUFFER(unsigned long, cap, 2);
+	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, cap, 32);
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, usb_stor_buf, 36);
-	unsigned long *capacity, *blksz;
+	uint64_t capacity;
+	unsigned long blksz;
 	ccb *pccb = &usb_ccb;
 
 	pccb->pdata = usb_stor_buf;
@@ -1381,29 +1881,34 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 		}
 		return 0;
 	}
-	pccb->pdata = (unsigned char *)&cap[0];
+	pccb->pdata = cap;
 	memset(pccb->pdata, 0, 8);
 	if (usb_read_capacity(pccb, ss) != 0) {
 		printf("READ_CAP ERROR\n");
-		cap[0] = 2880;
-		cap[1] = 0x200;
+		capacity = 2880;
+		blksz = 0x200;
+	} else {
+		capacity = get_unaligned_be32(&cap[0]);
+		blksz = get_unaligned_be32(&cap[4]);
+		/* The last LBA does not fit, so READ CAPACITY(16) is needed */
+		if (capacity == 0xffffffff) {
+			memset(pccb->pdata, 0, 32);
+			if (usb_read_capacity_16(pccb, ss) == 0) {
+				capacity = get_unaligned_be64(&cap[0]);
+				blksz = get_unaligned_be32(&cap[8]);
+			}
+		}
+		capacity++;
 	}
 	ss->flags &= ~USB_READY;
-	debug("Read Capacity returns: 0x%lx, 0x%lx\n", cap[0], cap[1]);
-#if 0
-	if (cap[0] > (0x200000 * 10)) /* greater than 10 GByte */
-		cap[0] >>= 16;
-#endif
-	cap[0] = cpu_to_be32(cap[0]);
-	cap[1] = cpu_to_be32(cap[1]);
-
-	/* this assumes bigendian! */
-	cap[0] += 1;
-	capacity = &cap[0];
-	blksz = &cap[1];
-	debug("Capacity = 0x%lx, blocksz = 0x%lx\n", *capacity, *blksz);
-	dev_desc->lba = *capacity;
-	dev_desc->blksz = *blksz;
+	debug("Capacity = 0x%llx, blocksz = 0x%lx\n",
+	      (unsigned long long)capacity, blksz);
+	if ((lbaint_t)capacity != capacity) {
+		printf("Capacity over 2TiB needs CONFIG_SYS_64BIT_LBA\n");
+		capacity = (lbaint_t)-1;
+	}
+	dev_desc->lba = capacity;
+	dev_desc->blksz = blksz;
 	dev_desc->log2blksz = LOG2(dev_desc->blksz);
 	dev_desc->type = perq;
 	debug(" address %d\n", dev_desc->target);
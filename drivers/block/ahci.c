@@ -84,14 +84,21 @@ static void ahci_dcache_invalidate_range(unsigned begin, unsigned len)
 	invalidate_dcache_range(start, end);
 }
 
+/* Command table, holding the command FIS and scatter-gather table, of a slot */
+static inline u32 ahci_cmd_tbl(struct ahci_ioports *pp, int slot)
+{
+	return pp->cmd_tbl + slot * AHCI_CMD_TBL_SZ;
+}
+
 /*
  * Ensure data for SATA controller is flushed out of dcache and
  * written to physical memory.
  */
-static void ahci_dcache_flush_sata_cmd(struct ahci_ioports *pp)
+static void ahci_dcache_flush_sata_cmd(struct ahci_ioports *pp, int slot)
 {
 	ahci_dcache_flush_range((unsigned long)pp->cmd_slot,
-				AHCI_PORT_PRIV_DMA_SZ);
+				AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT);
+	ahci_dcache_flush_range(ahci_cmd_tbl(pp, slot), AHCI_CMD_TBL_SZ);
 }
 
 static int waiting_for_cmd_completed(volatile u8 *offset,
@@ -153,7 +160,11 @@ static int ahci_host_init(struct ahci_probe_ent *probe_ent)
 	debug("ahci_host_init: start\n");
 
 	cap_save = readl(mmio + HOST_CAP);
+#ifdef CONFIG_AHCI_NCQ
+	cap_save &= ((1 << 28) | (1 << 17) | HOST_CAP_NCQ | HOST_CAP_NCS_MASK);
+#else
 	cap_save &= ((1 << 28) | (1 << 17));
+#endif
 	cap_save |= (1 << 27);  /* Staggered Spin-up. Not needed. */
 
 	/* global controller reset */
@@ -434,10 +445,10 @@ static int ahci_init_one(pci_dev_t pdev)
 
 #define MAX_DATA_BYTE_COUNT  (4*1024*1024)
 
-static int ahci_fill_sg(u8 port, unsigned char *buf, int buf_len)
+static int ahci_fill_sg(struct ahci_ioports *pp, int slot, unsigned char *buf,
+			int buf_len)
 {
-	struct ahci_ioports *pp = &(probe_ent->port[port]);
-	struct ahci_sg *ahci_sg = pp->cmd_tbl_sg;
+	struct ahci_sg *ahci_sg;
 	u32 sg_count;
 	int i;
 
@@ -447,6 +458,9 @@ static int ahci_fill_sg(u8 port, unsigned char *buf, int buf_len)
 		return -1;
 	}
 
+	ahci_sg = (struct ahci_sg *)(uintptr_t)(ahci_cmd_tbl(pp, slot) +
+						AHCI_CMD_TBL_HDR);
+
 	for (i = 0; i < sg_count; i++) {
 		ahci_sg->addr =
 		    cpu_to_le32((u32) buf + i * MAX_DATA_BYTE_COUNT);
@@ -463,12 +477,14 @@ static int ahci_fill_sg(u8 port, unsigned char *buf, int buf_len)
 }
 
 
-static void ahci_fill_cmd_slot(struct ahci_ioports *pp, u32 opts)
+static void ahci_fill_cmd_slot(struct ahci_ioports *pp, int slot, u32 opts)
 {
-	pp->cmd_slot->opts = cpu_to_le32(opts);
-	pp->cmd_slot->status = 0;
-	pp->cmd_slot->tbl_addr = cpu_to_le32(pp->cmd_tbl & 0xffffffff);
-	pp->cmd_slot->tbl_addr_hi = 0;
+	struct ahci_cmd_hdr *cmd_slot = &pp->cmd_slot[slot];
+
+	cmd_slot->opts = cpu_to_le32(opts);
+	cmd_slot->status = 0;
+	cmd_slot->tbl_addr = cpu_to_le32(ahci_cmd_tbl(pp, slot) & 0xffffffff);
+	cmd_slot->tbl_addr_hi = 0;
 }
 
 
@@ -489,8 +505,8 @@ static void ahci_set_feature(u8 port)
 	fis[12] = __ilog2(probe_ent->udma_mask + 1) + 0x40 - 0x01;
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, sizeof(fis));
-	ahci_fill_cmd_slot(pp, cmd_fis_len);
-	ahci_dcache_flush_sata_cmd(pp);
+	ahci_fill_cmd_slot(pp, 0, cmd_fis_len);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	writel(1, port_mmio + PORT_CMD_ISSUE);
 	readl(port_mmio + PORT_CMD_ISSUE);
 
@@ -534,7 +550,7 @@ static int ahci_port_start(u8 port)
 	pp->cmd_slot =
 		(struct ahci_cmd_hdr *)(uintptr_t)virt_to_phys((void *)mem);
 	debug("cmd_slot = 0x%x\n", (unsigned)pp->cmd_slot);
-	mem += (AHCI_CMD_SLOT_SZ + 224);
+	mem += AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT;
 
 	/*
 	 * Second item: Received-FIS area
@@ -543,8 +559,8 @@ static int ahci_port_start(u8 port)
 	mem += AHCI_RX_FIS_SZ;
 
 	/*
-	 * Third item: data area for storing a single command
-	 * and its scatter-gather table
+	 * Third item: data area for storing a command and its
+	 * scatter-gather table, for each slot that is used
 	 */
 	pp->cmd_tbl = virt_to_phys((void *)mem);
 	debug("cmd_tbl_dma = 0x%x\n", pp->cmd_tbl);
@@ -596,11 +612,11 @@ static int ahci_device_data_io(u8 port, u8 *fis, int fis_len, u8 *buf,
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, fis_len);
 
-	sg_count = ahci_fill_sg(port, buf, buf_len);
+	sg_count = ahci_fill_sg(pp, 0, buf, buf_len);
 	opts = (fis_len >> 2) | (sg_count << 16) | (is_write << 6);
-	ahci_fill_cmd_slot(pp, opts);
+	ahci_fill_cmd_slot(pp, 0, opts);
 
-	ahci_dcache_flush_sata_cmd(pp);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	ahci_dcache_flush_range((unsigned)buf, (unsigned)buf_len);
 
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
@@ -618,6 +634,196 @@ static int ahci_device_data_io(u8 port, u8 *fis, int fis_len, u8 *buf,
 }
 
 
+#ifdef CONFIG_AHCI_NCQ
+/*
+ * Queue commands on the drive at @port if both it and the controller
+ * support native command queueing, as many at once as both can take.
+ */
+static void ahci_setup_ncq(u8 port, u16 *id)
+{
+	struct ahci_ioports *pp = &(probe_ent->port[port]);
+	int slots;
+	int depth;
+
+	pp->ncq_depth = 0;
+	if (!(probe_ent->cap & HOST_CAP_NCQ) || !ata_id_has_ncq(id))
+		return;
+
+	slots = ((probe_ent->cap & HOST_CAP_NCS_MASK) >> HOST_CAP_NCS_SHIFT) + 1;
+	depth = min3(CONFIG_AHCI_NCQ_DEPTH, slots, ata_id_queue_depth(id));
+	if (depth > 1)
+		pp->ncq_depth = depth;
+	debug("Port %d: NCQ depth %d\n", port, pp->ncq_depth);
+}
+
+/*
+ * Read the NCQ command error log, which takes the drive out of the error
+ * state in which it aborts every command after a queued one fails
+ */
+static int ahci_read_ncq_log(u8 port)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, log, ATA_SECT_SIZE);
+	u8 fis[20];
+
+	memset(fis, 0, sizeof(fis));
+	fis[0] = 0x27;		/* Host to device FIS. */
+	fis[1] = 1 << 7;	/* Command FIS. */
+	fis[2] = ATA_CMD_READ_LOG_EXT;
+	fis[4] = 0x10;		/* Log address: NCQ command error */
+	fis[7] = 1 << 6;	/* device reg: set LBA mode */
+	fis[12] = 1;		/* One page */
+	if (ahci_device_data_io(port, fis, sizeof(fis), log, ATA_SECT_SIZE,
+				0))
+		return -EIO;
+	debug("Port %d: NCQ error on tag %d, status %x, error %x\n", port,
+	      log[0] & 0x1f, log[2], log[3]);
+
+	return 0;
+}
+
+/*
+ * Recover the port after an NCQ error, dropping whatever commands it has
+ * queued. The port is stopped and its errors cleared. If the drive is still
+ * busy the link is reset (COMRESET), otherwise the NCQ error log is read to
+ * clear the error on the drive.
+ */
+static void ahci_port_restart(u8 port)
+{
+	struct ahci_ioports *pp = &(probe_ent->port[port]);
+	volatile u8 *port_mmio = (volatile u8 *)pp->port_mmio;
+	u32 cmd, sctl;
+
+	cmd = readl(port_mmio + PORT_CMD);
+	writel_with_flush(cmd & ~PORT_CMD_START, port_mmio + PORT_CMD);
+	if (waiting_for_cmd_completed(port_mmio + PORT_CMD, 500,
+				      PORT_CMD_LIST_ON))
+		debug("Port command list did not stop\n");
+	writel(readl(port_mmio + PORT_SCR_ERR), port_mmio + PORT_SCR_ERR);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+
+	if (readl(port_mmio + PORT_TFDATA) & (ATA_BUSY | ATA_DRQ)) {
+		debug("Port %d: resetting the link\n", port);
+		sctl = readl(port_mmio + PORT_SCR_CTL) & ~0xf;
+		writel_with_flush(sctl | 1, port_mmio + PORT_SCR_CTL);
+		mdelay(1);
+		writel_with_flush(sctl, port_mmio + PORT_SCR_CTL);
+		if (ahci_link_up(probe_ent, port))
+			printf("scsi_ahci: Link on port %d is down\n", port);
+		if (waiting_for_cmd_completed(port_mmio + PORT_TFDATA,
+					      WAIT_MS_SPINUP,
+					      ATA_BUSY | ATA_DRQ))
+			printf("scsi_ahci: Drive on port %d stays busy\n",
+			       port);
+		writel(readl(port_mmio + PORT_SCR_ERR),
+		       port_mmio + PORT_SCR_ERR);
+		writel(readl(port_mmio + PORT_IRQ_STAT),
+		       port_mmio + PORT_IRQ_STAT);
+		writel_with_flush(cmd | PORT_CMD_START, port_mmio + PORT_CMD);
+		return;
+	}
+
+	writel_with_flush(cmd | PORT_CMD_START, port_mmio + PORT_CMD);
+	if (ahci_read_ncq_log(port))
+		printf("scsi_ahci: Cannot read NCQ error log on port %d\n",
+		       port);
+}
+
+/* Fill in the command for a READ/WRITE FPDMA QUEUED with tag @tag */
+static void ahci_ncq_fill_cmd(struct ahci_ioports *pp, int tag, u32 lba,
+			      u16 blocks, u8 *buf, u8 is_write)
+{
+	u8 *fis = (u8 *)(uintptr_t)ahci_cmd_tbl(pp, tag);
+	int sg_count;
+
+	memset(fis, 0, 20);
+	fis[0] = 0x27;		/* Host to device FIS. */
+	fis[1] = 1 << 7;	/* Command FIS. */
+	fis[2] = is_write ? ATA_CMD_FPDMA_WRITE : ATA_CMD_FPDMA_READ;
+	fis[3] = blocks & 0xff;	/* The block count goes in features */
+	fis[11] = blocks >> 8;
+	fis[4] = (lba >> 0) & 0xff;
+	fis[5] = (lba >> 8) & 0xff;
+	fis[6] = (lba >> 16) & 0xff;
+	fis[7] = 1 << 6;	/* device reg: set LBA mode */
+	fis[8] = (lba >> 24) & 0xff;
+	fis[12] = tag << 3;	/* ...and the tag in the sector count */
+
+	sg_count = ahci_fill_sg(pp, tag, buf, blocks * ATA_SECT_SIZE);
+	ahci_fill_cmd_slot(pp, tag, 5 | (sg_count << 16) | (is_write << 6));
+	ahci_dcache_flush_sata_cmd(pp, tag);
+}
+
+/*
+ * Transfer @blocks blocks from @lba using native command queueing. The
+ * transfer is split into commands of MAX_SATA_BLOCKS_READ_WRITE blocks and
+ * up to ncq_depth of them are kept queued on the drive, each tag being
+ * given the next command as soon as the drive reports it complete in
+ * PORT_SCR_ACT.
+ *
+ * On error the port is recovered and NCQ is turned off for it, so that the
+ * caller can try again one command at a time.
+ */
+static int ahci_ncq_data_io(u8 port, u32 lba, u16 blocks, u8 *buf,
+			    u8 is_write)
+{
+	struct ahci_ioports *pp = &(probe_ent->port[port]);
+	volatile u8 *port_mmio = (volatile u8 *)pp->port_mmio;
+	u32 buf_len = blocks * ATA_SECT_SIZE;
+	u8 *start_buf = buf;
+	u32 busy = 0, done;
+	ulong start;
+	int tag;
+
+	ahci_dcache_flush_range((unsigned)buf, buf_len);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+
+	start = get_timer(0);
+	while (blocks || busy) {
+		for (tag = 0; blocks && tag < pp->ncq_depth; tag++) {
+			u16 now_blocks;
+
+			if (busy & (1U << tag))
+				continue;
+			now_blocks = min(MAX_SATA_BLOCKS_READ_WRITE, blocks);
+			ahci_ncq_fill_cmd(pp, tag, lba, now_blocks, buf,
+					  is_write);
+			busy |= 1U << tag;
+			writel(1U << tag, port_mmio + PORT_SCR_ACT);
+			writel_with_flush(1U << tag, port_mmio + PORT_CMD_ISSUE);
+
+			buf += now_blocks * ATA_SECT_SIZE;
+			blocks -= now_blocks;
+			lba += now_blocks;
+		}
+
+		if (readl(port_mmio + PORT_IRQ_STAT) & PORT_IRQ_FATAL) {
+			printf("scsi_ahci: NCQ error on port %d (tfd %x)\n",
+			       port, readl(port_mmio + PORT_TFDATA));
+			break;
+		}
+		done = busy & ~(readl(port_mmio + PORT_SCR_ACT) |
+				readl(port_mmio + PORT_CMD_ISSUE));
+		if (done) {
+			busy &= ~done;
+			start = get_timer(0);
+		} else if (get_timer(start) > WAIT_MS_DATAIO) {
+			printf("scsi_ahci: NCQ timeout on port %d\n", port);
+			break;
+		}
+	}
+
+	if (busy) {
+		ahci_port_restart(port);
+		pp->ncq_depth = 0;
+		return -EIO;
+	}
+	ahci_dcache_invalidate_range((unsigned)start_buf, buf_len);
+
+	return 0;
+}
+#endif
+
+
 static char *ata_id_strcpy(u16 *target, u16 *src, int len)
 {
 	int i;
@@ -678,6 +884,9 @@ static int ata_scsiop_inquiry(ccb *pccb)
 
 	memcpy(idbuf, tmpid, ATA_ID_WORDS * 2);
 	ata_swap_buf_le16(idbuf, ATA_ID_WORDS);
+#ifdef CONFIG_AHCI_NCQ
+	ahci_setup_ncq(port, idbuf);
+#endif
 
 	memcpy(&pccb->pdata[8], "ATA     ", 8);
 	ata_id_strcpy((u16 *)&pccb->pdata[16], &idbuf[ATA_ID_PROD], 16);
@@ -720,6 +929,22 @@ static int ata_scsiop_read_write(ccb *pccb, u8 is_write)
 	debug("scsi_ahci: %s %d blocks starting from lba 0x%x\n",
 	      is_write ?  "write" : "read", (unsigned)lba, blocks);
 
+#ifdef CONFIG_AHCI_NCQ
+	if (probe_ent->port[pccb->target].ncq_depth) {
+		if (ATA_SECT_SIZE * blocks > user_buffer_size) {
+			printf("scsi_ahci: Error: buffer too small.\n");
+			return -EIO;
+		}
+		if (!ahci_ncq_data_io(pccb->target, lba, blocks, user_buffer,
+				      is_write)) {
+			if (is_write && ata_io_flush(pccb->target))
+				return -EIO;
+			return 0;
+		}
+		printf("scsi_ahci: Retrying without NCQ\n");
+	}
+#endif
+
 	/* Preset the FIS */
 	memset(fis, 0, sizeof(fis));
 	fis[0] = 0x27;		 /* Host to device FIS. */
@@ -755,7 +980,7 @@ static int ata_scsiop_read_write(ccb *pccb, u8 is_write)
 
 		/* Read/Write from ahci */
 		if (ahci_device_data_io(pccb->target, (u8 *) &fis, sizeof(fis),
-					user_buffer, user_buffer_size,
+					user_buffer, transfer_size,
 					is_write)) {
 			debug("scsi_ahci: SCSI %s10 command failure.\n",
 			      is_write ? "WRITE" : "READ");
@@ -985,7 +1210,8 @@ static int ata_io_flush(u8 port)
 	fis[2] = ATA_CMD_FLUSH_EXT;
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, 20);
-	ahci_fill_cmd_slot(pp, cmd_fis_len);
+	ahci_fill_cmd_slot(pp, 0, cmd_fis_len);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
 
 	if (waiting_for_cmd_completed(port_mmio + PORT_CMD_ISSUE,
@@ -0,0 +1,328 @@
+/*
+ * Driver model block device uclass, with a request queue
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <errno.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/root.h>
+
+block_dev_desc_t *blk_get_desc(struct udevice *dev)
+{
+	return dev_get_platdata(dev);
+}
+
+/* Give the driver as many pending requests as it can take */
+static void blk_kick(struct udevice *dev)
+{
+	struct blk_dev_priv *uc_priv = dev->uclass_priv;
+	struct blk_request *req;
+	int ret;
+
+	/* Requests submitted from a completion are picked up below */
+	if (uc_priv->kicking)
+		return;
+
+	uc_priv->kicking = true;
+	while (uc_priv->nactive < uc_priv->max_active &&
+	       !list_empty(&uc_priv->pending)) {
+		req = list_first_entry(&uc_priv->pending, struct blk_request,
+				       node);
+		list_move_tail(&req->node, &uc_priv->active);
+		uc_priv->nactive++;
+
+		ret = blk_get_ops(dev)->start(dev, req);
+		if (ret)
+			blk_complete(dev, req, ret);
+	}
+	uc_priv->kicking = false;
+}
+
+int blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_dev_priv *uc_priv = dev->uclass_priv;
+	block_dev_desc_t *desc = blk_get_desc(dev);
+	lbaint_t blkcnt = 0;
+	int i;
+
+	for (i = 0; i < req->sg_count; i++)
+		blkcnt += req->sg[i].blkcnt;
+	if (!blkcnt || req->start > desc->lba ||
+	    blkcnt > desc->lba - req->start)
+		return -EINVAL;
+
+	req->status = -EINPROGRESS;
+	req->done = 0;
+	list_add_tail(&req->node, &uc_priv->pending);
+	blk_kick(dev);
+
+	return 0;
+}
+
+/*
+ * Fail every request queued on a device whose driver cannot complete those it
+ * has started, including any queued by the completions
+ */
+static void blk_abort(struct udevice *dev, int status)
+{
+	struct blk_dev_priv *uc_priv = dev->uclass_priv;
+	struct blk_request *req;
+
+	/* Keep new requests pending, to be failed below */
+	uc_priv->kicking = true;
+	while (!list_empty(&uc_priv->active)) {
+		req = list_first_entry(&uc_priv->active, struct blk_request,
+				       node);
+		blk_complete(dev, req, status);
+	}
+	while (!list_empty(&uc_priv->pending)) {
+		req = list_first_entry(&uc_priv->pending, struct blk_request,
+				       node);
+		list_del(&req->node);
+		req->status = status;
+		if (req->complete)
+			req->complete(dev, req);
+	}
+	uc_priv->kicking = false;
+}
+
+int blk_poll(struct udevice *dev)
+{
+	struct blk_dev_priv *uc_priv = dev->uclass_priv;
+	struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_request *req;
+	int count = 0;
+	int ret;
+
+	if (uc_priv->nactive) {
+		/* Without poll(), what start() did not complete never will */
+		if (!ops->poll) {
+			blk_abort(dev, -ENOSYS);
+			return -ENOSYS;
+		}
+		ret = ops->poll(dev);
+		if (ret)
+			return ret;
+	}
+	blk_kick(dev);
+
+	list_for_each_entry(req, &uc_priv->pending, node)
+		count++;
+
+	return count + uc_priv->nactive;
+}
+
+int blk_wait(struct udevice *dev, struct blk_request *req)
+{
+	int ret;
+
+	while (req->status == -EINPROGRESS) {
+		ret = blk_poll(dev);
+		if (ret < 0)
+			return ret;
+	}
+
+	return req->status;
+}
+
+void blk_complete(struct udevice *dev, struct blk_request *req, int status)
+{
+	struct blk_dev_priv *uc_priv = dev->uclass_priv;
+
+	list_del(&req->node);
+	uc_priv->nactive--;
+	req->status = status;
+	if (req->complete)
+		req->complete(dev, req);
+}
+
+void blk_run_desc(struct udevice *dev, struct blk_request *req)
+{
+	block_dev_desc_t *desc = blk_get_desc(dev);
+	lbaint_t start = req->start;
+	unsigned long n;
+	int i;
+
+	for (i = 0; i < req->sg_count; i++) {
+		struct blk_sg *sg = &req->sg[i];
+
+		if (req->op == BLK_READ && desc->block_read)
+			n = desc->block_read(desc->dev, start, sg->blkcnt,
+					     sg->buf);
+		else if (req->op == BLK_WRITE && desc->block_write)
+			n = desc->block_write(desc->dev, start, sg->blkcnt,
+					      sg->buf);
+		else
+			n = 0;
+		if (n != sg->blkcnt) {
+			blk_complete(dev, req, -EIO);
+			return;
+		}
+		start += n;
+		req->done += n;
+	}
+	blk_complete(dev, req, 0);
+}
+
+static long blk_xfer(struct udevice *dev, enum blk_op op, lbaint_t start,
+		     lbaint_t blkcnt, void *buf)
+{
+	struct blk_request req;
+	struct blk_sg sg;
+	int ret;
+
+	sg.buf = buf;
+	sg.blkcnt = blkcnt;
+	memset(&req, '\0', sizeof(req));
+	req.op = op;
+	req.start = start;
+	req.sg = &sg;
+	req.sg_count = 1;
+
+	ret = blk_submit(dev, &req);
+	if (!ret)
+		ret = blk_wait(dev, &req);
+
+	return ret ? ret : req.done;
+}
+
+long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+	      void *buf)
+{
+	return blk_xfer(dev, BLK_READ, start, blkcnt, buf);
+}
+
+long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+	       const void *buf)
+{
+	return blk_xfer(dev, BLK_WRITE, start, blkcnt, (void *)buf);
+}
+
+int blk_bind(struct udevice *parent, const char *drv_name, const char *name,
+	     block_dev_desc_t *desc, struct udevice **devp)
+{
+	struct driver *drv;
+
+	drv = lists_driver_lookup_name(drv_name);
+	if (!drv || drv->id != UCLASS_BLK)
+		return -ENOENT;
+
+	return device_bind(parent, drv, name, desc, -1, devp);
+}
+
+int blk_find_desc(block_dev_desc_t *desc, struct udevice **devp)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+	int ret;
+
+	*devp = NULL;
+	ret = uclass_get_bound(UCLASS_BLK, &uc);
+	if (ret)
+		return ret;
+
+	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+		if (dev->platdata == desc) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+/* Names of legacy devices, which must stay in place, by interface type */
+static const char *const blk_if_names[IF_TYPE_MAX] = {
+	[IF_TYPE_UNKNOWN]	= "blk",
+	[IF_TYPE_IDE]		= "ide",
+	[IF_TYPE_SCSI]		= "scsi",
+	[IF_TYPE_ATAPI]		= "atapi",
+	[IF_TYPE_USB]		= "usb",
+	[IF_TYPE_DOC]		= "doc",
+	[IF_TYPE_MMC]		= "mmc",
+	[IF_TYPE_SD]		= "sd",
+	[IF_TYPE_SATA]		= "sata",
+	[IF_TYPE_HOST]		= "host",
+};
+
+int blk_get_from_desc(block_dev_desc_t *desc, struct udevice **devp)
+{
+	struct udevice *dev;
+	const char *name;
+	int ret;
+
+	if (blk_find_desc(desc, &dev)) {
+		name = NULL;
+		if (desc->if_type >= 0 && desc->if_type < IF_TYPE_MAX)
+			name = blk_if_names[desc->if_type];
+		ret = blk_bind(dm_root(), "blk_legacy", name ? name : "blk",
+			       desc, &dev);
+		if (ret)
+			return ret;
+	}
+
+	ret = device_probe(dev);
+	if (ret)
+		return ret;
+	*devp = dev;
+
+	return 0;
+}
+
+static int blk_post_probe(struct udevice *dev)
+{
+	struct blk_dev_priv *uc_priv = dev->uclass_priv;
+
+	if (!uc_priv->max_active)
+		uc_priv->max_active = 1;
+	INIT_LIST_HEAD(&uc_priv->pending);
+	INIT_LIST_HEAD(&uc_priv->active);
+
+	return 0;
+}
+
+/* Finish what is queued before the device goes away */
+static int blk_pre_remove(struct udevice *dev)
+{
+	int ret;
+
+	do {
+		ret = blk_poll(dev);
+	} while (ret > 0);
+
+	/* The queue is empty, as what could not complete has been failed */
+	return ret == -ENOSYS ? 0 : ret;
+}
+
+UCLASS_DRIVER(blk) = {
+	.id		= UCLASS_BLK,
+	.name		= "blk",
+	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
+	.per_device_auto_alloc_size = sizeof(struct blk_dev_priv),
+};
+
+/* The methods of the descriptor wait, so the request completes at once */
+static int blk_legacy_start(struct udevice *dev, struct blk_request *req)
+{
+	blk_run_desc(dev, req);
+
+	return 0;
+}
+
+static const struct blk_ops blk_legacy_ops = {
+	.start	= blk_legacy_start,
+};
+
+U_BOOT_DRIVER(blk_legacy) = {
+	.name	= "blk_legacy",
+	.id	= UCLASS_BLK,
+	.ops	= &blk_legacy_ops,
+};
@@ -6,11 +6,15 @@
 
 #include <config.h>
 #include <common.h>
+#include <blk.h>
+#include <dm.h>
 #include <part.h>
 #include <os.h>
 #include <malloc.h>
 #include <sandboxblockdev.h>
 #include <asm/errno.h>
+#include <dm/device-internal.h>
+#include <dm/root.h>
 
 static struct host_block_dev host_devices[CONFIG_HOST_MAX_DEVICES];
 
@@ -59,6 +63,80 @@ static unsigned long host_block_write(int dev, unsigned long start,
 	return -1;
 }
 
+#ifdef CONFIG_DM_BLK
+/* Number of requests a host device works on at once */
+#define HOST_BLK_MAX_ACTIVE	4
+
+/*
+ * Requests are carried out in poll(), one per call and oldest first, so
+ * that whoever queued them gets on with something else in between
+ */
+static int host_blk_start(struct udevice *dev, struct blk_request *req)
+{
+	return 0;
+}
+
+static int host_blk_poll(struct udevice *dev)
+{
+	struct blk_dev_priv *uc_priv = dev->uclass_priv;
+
+	if (!list_empty(&uc_priv->active))
+		blk_run_desc(dev, list_first_entry(&uc_priv->active,
+						   struct blk_request, node));
+
+	return 0;
+}
+
+static int host_blk_probe(struct udevice *dev)
+{
+	struct blk_dev_priv *uc_priv = dev->uclass_priv;
+
+	uc_priv->max_active = HOST_BLK_MAX_ACTIVE;
+
+	return 0;
+}
+
+static const struct blk_ops host_blk_ops = {
+	.start	= host_blk_start,
+	.poll	= host_blk_poll,
+};
+
+U_BOOT_DRIVER(sandbox_host_blk) = {
+	.name	= "sandbox_host_blk",
+	.id	= UCLASS_BLK,
+	.probe	= host_blk_probe,
+	.ops	= &host_blk_ops,
+};
+
+/* Bind a block device for a host device, or unbind it if not bound */
+static int host_blk_bind(struct host_block_dev *host_dev)
+{
+	struct udevice *dev;
+	int ret;
+
+	if (!blk_find_desc(&host_dev->blk_dev, &dev)) {
+		ret = device_remove(dev);
+		if (!ret)
+			ret = device_unbind(dev);
+		if (ret)
+			return ret;
+	}
+	if (!host_dev->blk_dev.priv)
+		return 0;
+
+	snprintf(host_dev->name, sizeof(host_dev->name), "host%d",
+		 host_dev->blk_dev.dev);
+
+	return blk_bind(dm_root(), "sandbox_host_blk", host_dev->name,
+			&host_dev->blk_dev, &dev);
+}
+#else
+static inline int host_blk_bind(struct host_block_dev *host_dev)
+{
+	return 0;
+}
+#endif
+
 int host_dev_bind(int dev, char *filename)
 {
 	struct host_block_dev *host_dev = find_host_device(dev);
@@ -68,6 +146,7 @@ int host_dev_bind(int dev, char *filename)
 	if (host_dev->blk_dev.priv) {
 		os_close(host_dev->fd);
 		host_dev->blk_dev.priv = NULL;
+		host_blk_bind(host_dev);
 	}
 	if (host_dev->filename)
 		free(host_dev->filename);
@@ -96,7 +175,7 @@ int host_dev_bind(int dev, char *filename)
 	blk_dev->part_type = PART_TYPE_UNKNOWN;
 	init_part(blk_dev);
 
-	return 0;
+	return host_blk_bind(host_dev);
 }
 
 int host_get_dev_err(int dev, block_dev_desc_t **blk_devp)
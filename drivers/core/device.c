@@ -185,6 +185,7 @@ int device_unbind(struct udevice *dev)
 	ret = device_chld_unbind(dev);
 	if (ret)
 		return ret;
+	lists_drop_deferred(NULL, dev);
 
 	ret = uclass_unbind_device(dev);
 	if (ret)
@@ -197,42 +198,86 @@ int device_unbind(struct udevice *dev)
 	return 0;
 }
 
+/* Each part of the block is aligned as malloc() would align it */
+#define DM_AUTO_ALIGN(size)	ALIGN(size, 2 * sizeof(size_t))
+
+/**
+ * device_alloc_auto() - Allocate the data driver model provides for a device
+ *
+ * The driver's private data, the platdata (if DM_FLAG_ALLOC_PDATA), the
+ * uclass's private data and the parent's private data for the device are
+ * all carved out of a single zeroed block. This takes one allocation per
+ * probe instead of up to four, which saves malloc() overhead (particularly
+ * in the small pre-relocation pool) and keeps the data together.
+ *
+ * @dev:	Device to allocate data for
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+static int device_alloc_auto(struct udevice *dev)
+{
+	struct driver *drv = dev->driver;
+	int priv_size, pdata_size = 0, uc_size, parent_size = 0;
+	char *ptr;
+
+	priv_size = DM_AUTO_ALIGN(drv->priv_auto_alloc_size);
+	if (dev->flags & DM_FLAG_ALLOC_PDATA)
+		pdata_size = DM_AUTO_ALIGN(drv->platdata_auto_alloc_size);
+	uc_size = DM_AUTO_ALIGN(dev->uclass->uc_drv->per_device_auto_alloc_size);
+	if (dev->parent)
+		parent_size = dev->parent->driver->per_child_auto_alloc_size;
+	if (!(priv_size + pdata_size + uc_size + parent_size))
+		return 0;
+
+	ptr = calloc(1, priv_size + pdata_size + uc_size + parent_size);
+	if (!ptr)
+		return -ENOMEM;
+	dev->auto_alloc = ptr;
+
+	if (priv_size) {
+		dev->priv = ptr;
+		ptr += priv_size;
+	}
+	if (pdata_size) {
+		dev->platdata = ptr;
+		ptr += pdata_size;
+	}
+	if (uc_size) {
+		dev->uclass_priv = ptr;
+		ptr += uc_size;
+	}
+	if (parent_size)
+		dev->parent_priv = ptr;
+
+	return 0;
+}
+
 /**
  * device_free() - Free memory buffers allocated by a device
  * @dev:	Device that is to be started
  */
 static void device_free(struct udevice *dev)
 {
-	int size;
+	free(dev->auto_alloc);
+	dev->auto_alloc = NULL;
 
-	if (dev->driver->priv_auto_alloc_size) {
-		free(dev->priv);
+	if (dev->driver->priv_auto_alloc_size)
 		dev->priv = NULL;
-	}
-	if (dev->flags & DM_FLAG_ALLOC_PDATA) {
-		free(dev->platdata);
+	if (dev->flags & DM_FLAG_ALLOC_PDATA)
 		dev->platdata = NULL;
-	}
-	size = dev->uclass->uc_drv->per_device_auto_alloc_size;
-	if (size) {
-		free(dev->uclass_priv);
+	if (dev->uclass->uc_drv->per_device_auto_alloc_size)
 		dev->uclass_priv = NULL;
-	}
-	if (dev->parent) {
-		size = dev->parent->driver->per_child_auto_alloc_size;
-		if (size) {
-			free(dev->parent_priv);
-			dev->parent_priv = NULL;
-		}
-	}
+	if (dev->parent && dev->parent->driver->per_child_auto_alloc_size)
+		dev->parent_priv = NULL;
 }
 
 int device_probe(struct udevice *dev)
 {
 	struct driver *drv;
-	int size = 0;
 	int ret;
 	int seq;
+#ifdef CONFIG_DM_PROBE_TIME
+	ulong start;
+#endif
 
 	if (!dev)
 		return -EINVAL;
@@ -243,47 +288,22 @@ int device_probe(struct udevice *dev)
 	drv = dev->driver;
 	assert(drv);
 
-	/* Allocate private data and platdata if requested */
-	if (drv->priv_auto_alloc_size) {
-		dev->priv = calloc(1, drv->priv_auto_alloc_size);
-		if (!dev->priv) {
-			ret = -ENOMEM;
-			goto fail;
-		}
-	}
-	/* Allocate private data if requested */
-	if (dev->flags & DM_FLAG_ALLOC_PDATA) {
-		dev->platdata = calloc(1, drv->platdata_auto_alloc_size);
-		if (!dev->platdata) {
-			ret = -ENOMEM;
-			goto fail;
-		}
-	}
-	size = dev->uclass->uc_drv->per_device_auto_alloc_size;
-	if (size) {
-		dev->uclass_priv = calloc(1, size);
-		if (!dev->uclass_priv) {
-			ret = -ENOMEM;
-			goto fail;
-		}
-	}
+	/* Allocate private data, platdata and parent data if requested */
+	ret = device_alloc_auto(dev);
+	if (ret)
+		goto fail;
 
 	/* Ensure all parents are probed */
 	if (dev->parent) {
-		size = dev->parent->driver->per_child_auto_alloc_size;
-		if (size) {
-			dev->parent_priv = calloc(1, size);
-			if (!dev->parent_priv) {
-				ret = -ENOMEM;
-				goto fail;
-			}
-		}
-
 		ret = device_probe(dev->parent);
 		if (ret)
 			goto fail;
 	}
 
+#ifdef CONFIG_DM_PROBE_TIME
+	/* Count this device's own probe only, not its parents' */
+	start = timer_get_us();
+#endif
 	seq = uclass_resolve_seq(dev);
 	if (seq < 0) {
 		ret = seq;
@@ -316,6 +336,9 @@ int device_probe(struct udevice *dev)
 		dev->flags &= ~DM_FLAG_ACTIVATED;
 		goto fail_uclass;
 	}
+#ifdef CONFIG_DM_PROBE_TIME
+	dev->probe_time_us = timer_get_us() - start;
+#endif
 
 	return 0;
 fail_uclass:
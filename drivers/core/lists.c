@@ -9,6 +9,7 @@
 
 #include <common.h>
 #include <errno.h>
+#include <malloc.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -18,6 +19,8 @@
 #include <fdtdec.h>
 #include <linux/compiler.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 struct driver *lists_driver_lookup_name(const char *name)
 {
 	struct driver *drv =
@@ -118,50 +121,155 @@ static int driver_check_compatible(const void *blob, int offset,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, const void *blob, int offset)
+/**
+ * lists_find_fdt() - Find the driver for a device tree node
+ *
+ * @blob: Device tree pointer
+ * @offset: Offset of node in device tree
+ * @drvp: Returns the driver, if found
+ * @return 0 if found, -ENOENT if no driver matches, -ENODEV if the node
+ * does not have a compatible string, other error <0 if there is a device
+ * tree error
+ */
+static int lists_find_fdt(const void *blob, int offset, struct driver **drvp)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
 	struct driver *entry;
-	struct udevice *dev;
-	bool found = false;
-	const char *name;
-	int result = 0;
-	int ret = 0;
+	int ret;
 
-	dm_dbg("bind node %s\n", fdt_get_name(blob, offset, NULL));
 	for (entry = driver; entry != driver + n_ents; entry++) {
 		ret = driver_check_compatible(blob, offset, entry->of_match);
-		name = fdt_get_name(blob, offset, NULL);
-		if (ret == -ENOENT) {
+		if (ret == -ENOENT)
 			continue;
-		} else if (ret == -ENODEV) {
-			dm_dbg("Device '%s' has no compatible string\n", name);
-			break;
-		} else if (ret) {
-			dm_warn("Device tree error at offset %d\n", offset);
-			if (!result || ret != -ENOENT)
-				result = ret;
-			break;
-		}
+		if (!ret)
+			*drvp = entry;
+		return ret;
+	}
 
-		dm_dbg("   - found match at '%s'\n", entry->name);
-		ret = device_bind(parent, entry, name, NULL, offset, &dev);
-		if (ret) {
-			dm_warn("Error binding driver '%s'\n", entry->name);
-			if (!result || ret != -ENOENT)
-				result = ret;
-		} else {
-			found = true;
-		}
-		break;
+	return -ENOENT;
+}
+
+int lists_bind_fdt(struct udevice *parent, const void *blob, int offset)
+{
+	struct driver *entry;
+	struct udevice *dev;
+	const char *name;
+	int ret;
+
+	name = fdt_get_name(blob, offset, NULL);
+	dm_dbg("bind node %s\n", name);
+	ret = lists_find_fdt(blob, offset, &entry);
+	if (ret == -ENOENT) {
+		dm_dbg("No match for node '%s'\n", name);
+		return 0;
+	} else if (ret == -ENODEV) {
+		dm_dbg("Device '%s' has no compatible string\n", name);
+		return 0;
+	} else if (ret) {
+		dm_warn("Device tree error at offset %d\n", offset);
+		return ret;
 	}
 
-	if (!found && !result && ret != -ENODEV) {
-		dm_dbg("No match for node '%s'\n",
-		       fdt_get_name(blob, offset, NULL));
+	dm_dbg("   - found match at '%s'\n", entry->name);
+	ret = device_bind(parent, entry, name, NULL, offset, &dev);
+	if (ret) {
+		dm_warn("Error binding driver '%s'\n", entry->name);
+		return ret;
 	}
 
-	return result;
+	return 0;
+}
+
+/**
+ * struct lists_deferred - A device tree node waiting for its uclass
+ *
+ * @parent: Parent device to bind the node to
+ * @drv: Driver which matches the node
+ * @blob: Device tree pointer
+ * @of_offset: Offset of node in device tree
+ * @node: Link in the uclass's deferred_head list
+ */
+struct lists_deferred {
+	struct udevice *parent;
+	struct driver *drv;
+	const void *blob;
+	int of_offset;
+	struct list_head node;
+};
+
+int lists_defer_fdt(struct udevice *parent, const void *blob, int offset)
+{
+	struct lists_deferred *def;
+	struct driver *drv;
+	struct uclass *uc;
+	int ret;
+
+	ret = lists_find_fdt(blob, offset, &drv);
+	if (ret == -ENOENT || ret == -ENODEV)
+		return 0;
+	if (ret) {
+		dm_warn("Device tree error at offset %d\n", offset);
+		return ret;
+	}
+
+	ret = uclass_get(drv->id, &uc);
+	if (ret)
+		return ret;
+	def = calloc(1, sizeof(*def));
+	if (!def)
+		return -ENOMEM;
+	def->parent = parent;
+	def->drv = drv;
+	def->blob = blob;
+	def->of_offset = offset;
+	list_add_tail(&def->node, &uc->deferred_head);
+	dm_dbg("defer node %s\n", fdt_get_name(blob, offset, NULL));
+
+	return 0;
+}
+
+int lists_bind_deferred(struct uclass *uc)
+{
+	struct lists_deferred *def;
+	struct udevice *dev;
+	const char *name;
+	int ret;
+
+	/* Binding may look up this uclass again, so take one at a time */
+	while (!list_empty(&uc->deferred_head)) {
+		def = list_first_entry(&uc->deferred_head,
+				       struct lists_deferred, node);
+		list_del(&def->node);
+		name = fdt_get_name(def->blob, def->of_offset, NULL);
+		ret = device_bind(def->parent, def->drv, name, NULL,
+				  def->of_offset, &dev);
+		if (ret)
+			dm_warn("Error binding driver '%s'\n", def->drv->name);
+		free(def);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+void lists_drop_deferred(struct uclass *uc, struct udevice *parent)
+{
+	struct lists_deferred *def, *tmp;
+
+	if (!uc) {
+		list_for_each_entry(uc, &DM_UCLASS_ROOT_NON_CONST,
+				    sibling_node)
+			lists_drop_deferred(uc, parent);
+		return;
+	}
+
+	list_for_each_entry_safe(def, tmp, &uc->deferred_head, node) {
+		if (!parent || def->parent == parent) {
+			list_del(&def->node);
+			free(def);
+		}
+	}
 }
 #endif
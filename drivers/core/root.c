@@ -80,6 +80,20 @@ int dm_scan_platdata(bool pre_reloc_only)
 }
 
 #ifdef CONFIG_OF_CONTROL
+/*
+ * Check whether a node should be left unbound until a device in its uclass
+ * is looked up. The property defers the node's subtree with it, since the
+ * children are only bound once their parent is.
+ */
+static bool dm_fdt_node_deferred(const void *blob, int offset)
+{
+#ifdef CONFIG_DM_DEFER_FDT
+	return true;
+#else
+	return fdt_getprop(blob, offset, "u-boot,dm-defer", NULL) != NULL;
+#endif
+}
+
 int dm_scan_fdt_node(struct udevice *parent, const void *blob, int offset,
 		     bool pre_reloc_only)
 {
@@ -91,7 +105,10 @@ int dm_scan_fdt_node(struct udevice *parent, const void *blob, int offset,
 		if (pre_reloc_only &&
 		    !fdt_getprop(blob, offset, "u-boot,dm-pre-reloc", NULL))
 			continue;
-		err = lists_bind_fdt(parent, blob, offset);
+		if (dm_fdt_node_deferred(blob, offset))
+			err = lists_defer_fdt(parent, blob, offset);
+		else
+			err = lists_bind_fdt(parent, blob, offset);
 		if (err && !ret)
 			ret = err;
 	}
@@ -77,6 +77,7 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	uc->uc_drv = uc_drv;
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
+	INIT_LIST_HEAD(&uc->deferred_head);
 	list_add(&uc->sibling_node, &DM_UCLASS_ROOT_NON_CONST);
 
 	if (uc_drv->init) {
@@ -106,6 +107,7 @@ int uclass_destroy(struct uclass *uc)
 	struct udevice *dev, *tmp;
 	int ret;
 
+	lists_drop_deferred(uc, NULL);
 	list_for_each_entry_safe(dev, tmp, &uc->dev_head, uclass_node) {
 		ret = device_remove(dev);
 		if (ret)
@@ -139,6 +141,17 @@ int uclass_get(enum uclass_id id, struct uclass **ucp)
 	return 0;
 }
 
+int uclass_get_bound(enum uclass_id id, struct uclass **ucp)
+{
+	int ret;
+
+	ret = uclass_get(id, ucp);
+	if (ret)
+		return ret;
+
+	return lists_bind_deferred(*ucp);
+}
+
 int uclass_find_device(enum uclass_id id, int index, struct udevice **devp)
 {
 	struct uclass *uc;
@@ -146,7 +159,7 @@ int uclass_find_device(enum uclass_id id, int index, struct udevice **devp)
 	int ret;
 
 	*devp = NULL;
-	ret = uclass_get(id, &uc);
+	ret = uclass_get_bound(id, &uc);
 	if (ret)
 		return ret;
 
@@ -171,7 +184,7 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 	debug("%s: %d %d\n", __func__, find_req_seq, seq_or_req_seq);
 	if (seq_or_req_seq == -1)
 		return -ENODEV;
-	ret = uclass_get(id, &uc);
+	ret = uclass_get_bound(id, &uc);
 	if (ret)
 		return ret;
 
@@ -199,7 +212,7 @@ static int uclass_find_device_by_of_offset(enum uclass_id id, int node,
 	*devp = NULL;
 	if (node < 0)
 		return -ENODEV;
-	ret = uclass_get(id, &uc);
+	ret = uclass_get_bound(id, &uc);
 	if (ret)
 		return ret;
 
@@ -283,7 +296,7 @@ int uclass_first_device(enum uclass_id id, struct udevice **devp)
 	int ret;
 
 	*devp = NULL;
-	ret = uclass_get(id, &uc);
+	ret = uclass_get_bound(id, &uc);
 	if (ret)
 		return ret;
 	if (list_empty(&uc->dev_head))
@@ -402,15 +415,11 @@ int uclass_pre_remove_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	uc_drv = uc->uc_drv;
-	if (uc->uc_drv->pre_remove) {
-		ret = uc->uc_drv->pre_remove(dev);
+	if (uc_drv->pre_remove) {
+		ret = uc_drv->pre_remove(dev);
 		if (ret)
 			return ret;
 	}
-	if (uc_drv->per_device_auto_alloc_size) {
-		free(dev->uclass_priv);
-		dev->uclass_priv = NULL;
-	}
 	dev->seq = -1;
 
 	return 0;
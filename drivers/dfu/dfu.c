@@ -90,11 +90,31 @@ int dfu_init_env_entities(char *interface, char *devstr)
 
 static unsigned char *dfu_buf;
 static unsigned long dfu_buf_size = CONFIG_SYS_DFU_DATA_BUF_SIZE;
+static int dfu_buf_num;		/* Number of dfu_buf_size buffers in dfu_buf */
+
+/*
+ * Buffers which are full and waiting to be written to the medium, oldest
+ * first. They are written out by dfu_write_poll() in the main loop while
+ * the next buffer fills from USB. The buffers are used in turn, so the
+ * queue always holds those just before the one being filled.
+ */
+static struct dfu_write_buf {
+	u8 *start;
+	long len;
+	long done;		/* Bytes already written to the medium */
+} dfu_wq[CONFIG_SYS_DFU_NUM_BUFS];
+static int dfu_wq_head;
+static int dfu_wq_count;
+static struct dfu_entity *dfu_wq_entity;
+static int dfu_wq_err;
 
 unsigned char *dfu_free_buf(void)
 {
 	free(dfu_buf);
 	dfu_buf = NULL;
+	dfu_buf_num = 0;
+	dfu_wq_count = 0;
+	dfu_wq_entity = NULL;
 	return dfu_buf;
 }
 
@@ -103,7 +123,16 @@ unsigned long dfu_get_buf_size(void)
 	return dfu_buf_size;
 }
 
-unsigned char *dfu_get_buf(struct dfu_entity *dfu)
+/**
+ * dfu_alloc_buf() - Allocate up to @count buffers of dfu_buf_size bytes
+ *
+ * If there is not enough memory for all of them, fewer are allocated.
+ *
+ * @dfu:	Entity which will use the buffers
+ * @count:	Number of buffers wanted
+ * @return pointer to first buffer, or NULL if none could be allocated
+ */
+static unsigned char *dfu_alloc_buf(struct dfu_entity *dfu, int count)
 {
 	char *s;
 
@@ -116,7 +145,12 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	if (dfu->max_buf_size && dfu_buf_size > dfu->max_buf_size)
 		dfu_buf_size = dfu->max_buf_size;
 
-	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
+	for (dfu_buf_num = count; dfu_buf_num > 0; dfu_buf_num--) {
+		dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+				   dfu_buf_num * dfu_buf_size);
+		if (dfu_buf)
+			break;
+	}
 	if (dfu_buf == NULL)
 		printf("%s: Could not memalign 0x%lx bytes\n",
 		       __func__, dfu_buf_size);
@@ -124,6 +158,11 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	return dfu_buf;
 }
 
+unsigned char *dfu_get_buf(struct dfu_entity *dfu)
+{
+	return dfu_alloc_buf(dfu, 1);
+}
+
 static char *dfu_get_hash_algo(void)
 {
 	char *s;
@@ -141,39 +180,96 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
-static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+/**
+ * dfu_write_step() - Write the next part of the oldest queued buffer
+ *
+ * @return 0 if OK, -ve on error
+ */
+static int dfu_write_step(void)
 {
+	struct dfu_write_buf *wb = &dfu_wq[dfu_wq_head];
+	struct dfu_entity *dfu = dfu_wq_entity;
 	long w_size;
 	int ret;
 
-	/* flush size? */
-	w_size = dfu->i_buf - dfu->i_buf_start;
-	if (w_size == 0)
-		return 0;
-
-	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
+	w_size = wb->len - wb->done;
+	if (dfu->write_slice && w_size > dfu->write_slice)
+		w_size = dfu->write_slice;
 
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
-	if (ret)
+	ret = dfu->write_medium(dfu, dfu->offset, wb->start + wb->done,
+				&w_size);
+	if (ret) {
 		debug("%s: Write error!\n", __func__);
-
-	/* point back */
-	dfu->i_buf = dfu->i_buf_start;
+		dfu_wq_err = ret;
+		dfu_wq_count = 0;
+		return ret;
+	}
 
 	/* update offset */
 	dfu->offset += w_size;
+	wb->done += w_size;
+	if (wb->done >= wb->len) {
+		dfu_wq_head = (dfu_wq_head + 1) % dfu_buf_num;
+		dfu_wq_count--;
+		puts("#");
+	}
+
+	return 0;
+}
 
-	puts("#");
+int dfu_write_wait(int count)
+{
+	int ret;
 
-	return ret;
+	while (dfu_wq_count > count) {
+		ret = dfu_write_step();
+		if (ret)
+			return ret;
+	}
+
+	return dfu_wq_err;
+}
+
+void dfu_write_poll(void)
+{
+	if (dfu_wq_count && !dfu_wq_err)
+		dfu_write_step();
+}
+
+static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+{
+	struct dfu_write_buf *wb;
+	long w_size;
+	int next;
+
+	/* flush size? */
+	w_size = dfu->i_buf - dfu->i_buf_start;
+	if (w_size == 0)
+		return 0;
+
+	/* queue the buffer behind any others still being written */
+	next = (dfu_wq_head + dfu_wq_count) % dfu_buf_num;
+	wb = &dfu_wq[next];
+	wb->start = dfu->i_buf_start;
+	wb->len = w_size;
+	wb->done = 0;
+	dfu_wq_entity = dfu;
+	dfu_wq_count++;
+
+	/* and wait for the next one to become free */
+	next = (next + 1) % dfu_buf_num;
+	dfu->i_buf_start = dfu_buf + next * dfu_buf_size;
+	dfu->i_buf_end = dfu->i_buf_start + dfu_buf_size;
+	dfu->i_buf = dfu->i_buf_start;
+
+	return dfu_write_wait(dfu_buf_num - 1);
 }
 
 void dfu_write_transaction_cleanup(struct dfu_entity *dfu)
 {
 	/* clear everything */
 	dfu_free_buf();
+	dfu_wq_err = 0;
 	dfu->crc = 0;
 	dfu->offset = 0;
 	dfu->i_blk_seq_num = 0;
@@ -188,8 +284,12 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	int ret = 0;
 
 	ret = dfu_write_buffer_drain(dfu);
-	if (ret)
+	if (!ret)
+		ret = dfu_write_wait(0);
+	if (ret) {
+		dfu_write_transaction_cleanup(dfu);
 		return ret;
+	}
 
 	if (dfu->flush_medium)
 		ret = dfu->flush_medium(dfu);
@@ -217,15 +317,25 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		dfu->offset = 0;
 		dfu->bad_skip = 0;
 		dfu->i_blk_seq_num = 0;
-		dfu->i_buf_start = dfu_get_buf(dfu);
+		dfu_free_buf();
+		dfu_wq_head = 0;
+		dfu_wq_err = 0;
+		dfu->i_buf_start = dfu_alloc_buf(dfu, CONFIG_SYS_DFU_NUM_BUFS);
 		if (dfu->i_buf_start == NULL)
 			return -ENOMEM;
-		dfu->i_buf_end = dfu_get_buf(dfu) + dfu_buf_size;
+		dfu->i_buf_end = dfu->i_buf_start + dfu_buf_size;
 		dfu->i_buf = dfu->i_buf_start;
 
 		dfu->inited = 1;
 	}
 
+	/* report a failed write from dfu_write_poll() */
+	if (dfu_wq_err) {
+		ret = dfu_wq_err;
+		dfu_write_transaction_cleanup(dfu);
+		return ret;
+	}
+
 	if (dfu->i_blk_seq_num != blk_seq_num) {
 		printf("%s: Wrong sequence number! [%d] [%d]\n",
 		       __func__, dfu->i_blk_seq_num, blk_seq_num);
@@ -269,6 +379,11 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	memcpy(dfu->i_buf, buf, size);
 	dfu->i_buf += size;
 
+	/* update the checksum of the whole file, printed by dfu_flush() */
+	if (dfu_hash_algo)
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc, buf,
+					   size, 0);
+
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
 		ret = dfu_write_buffer_drain(dfu);
@@ -341,6 +456,8 @@ int dfu_read(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	       __func__, dfu->name, buf, size, blk_seq_num, dfu->i_buf);
 
 	if (!dfu->inited) {
+		/* drop anything left over from an aborted download */
+		dfu_free_buf();
 		dfu->i_buf_start = dfu_get_buf(dfu);
 		if (dfu->i_buf_start == NULL)
 			return -ENOMEM;
@@ -422,6 +539,7 @@ static int dfu_fill_entity(struct dfu_entity *dfu, char *s, int alt,
 
 	dfu->alt = alt;
 	dfu->max_buf_size = 0;
+	dfu->write_slice = 0;
 	dfu->free_entity = NULL;
 
 	/* Specific for mmc device */
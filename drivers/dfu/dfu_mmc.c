@@ -16,6 +16,9 @@
 #include <fat.h>
 #include <mmc.h>
 
+/* Amount to write at a time from dfu_write_poll(), a multiple of any blksz */
+#define DFU_MMC_WRITE_SLICE	(256 * 1024)
+
 static unsigned char __aligned(CONFIG_SYS_CACHELINE_SIZE)
 				dfu_file_buf[CONFIG_SYS_DFU_MAX_FILE_SIZE];
 static long dfu_file_buf_len;
@@ -75,8 +78,17 @@ static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
 					      blk_count, buf);
 		break;
 	case DFU_OP_WRITE:
-		n = mmc->block_dev.block_write(dfu->data.mmc.dev_num, blk_start,
-					       blk_count, buf);
+		if (!dfu->data.mmc.update) {
+			n = mmc->block_dev.block_write(dfu->data.mmc.dev_num,
+						       blk_start, blk_count,
+						       buf);
+			break;
+		}
+		if (!offset)
+			memset(&dfu->data.mmc.update_stats, '\0',
+			       sizeof(dfu->data.mmc.update_stats));
+		n = mmc_bupdate(dfu->data.mmc.dev_num, blk_start, blk_count,
+				buf, &dfu->data.mmc.update_stats);
 		break;
 	default:
 		error("Operation not supported\n");
@@ -203,6 +215,11 @@ int dfu_flush_medium_mmc(struct dfu_entity *dfu)
 {
 	int ret = 0;
 
+	if (dfu->layout == DFU_RAW_ADDR && dfu->data.mmc.update)
+		printf("\n%s: %llu bytes written, %llu bytes skipped\n",
+		       dfu->name, dfu->data.mmc.update_stats.written,
+		       dfu->data.mmc.update_stats.skipped);
+
 	if (dfu->layout != DFU_RAW_ADDR) {
 		/* Do stuff here. */
 		ret = mmc_file_op(DFU_OP_WRITE, dfu, &dfu_file_buf,
@@ -267,8 +284,9 @@ int dfu_read_medium_mmc(struct dfu_entity *dfu, u64 offset, void *buf,
  *	2nd and 3rd:
  *		lba_start and lba_size, for raw write
  *		mmc_dev and mmc_part, for filesystems and part
- *	4th (optional):
- *		mmcpart <num> (access to HW eMMC partitions)
+ *	then (optional, for raw and part):
+ *		mmcpart <num> (access to HW eMMC partitions, raw only)
+ *		update (only write blocks which have changed)
  */
 int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 {
@@ -322,10 +340,11 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 		 * Check for an extra entry at dfu_alt_info env variable
 		 * specifying the mmc HW defined partition number
 		 */
-		if (s)
-			if (!strcmp(strsep(&s, " "), "mmcpart"))
-				dfu->data.mmc.hw_partition =
-					simple_strtoul(s, NULL, 0);
+		if (s && !strncmp(s, "mmcpart ", 8)) {
+			strsep(&s, " ");
+			dfu->data.mmc.hw_partition =
+				simple_strtoul(strsep(&s, " "), NULL, 0);
+		}
 
 	} else if (!strcmp(entity_type, "part")) {
 		disk_partition_t partinfo;
@@ -352,12 +371,20 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 		return -ENODEV;
 	}
 
+	dfu->data.mmc.update = false;
+	if (dfu->layout == DFU_RAW_ADDR && s && !strcmp(s, "update"))
+		dfu->data.mmc.update = true;
+
 	/* if it's NOT a raw write */
 	if (strcmp(entity_type, "raw")) {
 		dfu->data.mmc.dev = second_arg;
 		dfu->data.mmc.part = third_arg;
 	}
 
+	/* a whole buffer can take a long time to write, so split it up */
+	if (dfu->layout == DFU_RAW_ADDR)
+		dfu->write_slice = DFU_MMC_WRITE_SLICE;
+
 	dfu->dev_type = DFU_DEV_MMC;
 	dfu->get_medium_size = dfu_get_medium_size_mmc;
 	dfu->read_medium = dfu_read_medium_mmc;
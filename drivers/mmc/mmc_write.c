@@ -10,8 +10,12 @@
 #include <config.h>
 #include <common.h>
 #include <part.h>
+#include <malloc.h>
 #include "mmc_private.h"
 
+/* Amount to read back at a time in mmc_bupdate() */
+#define MMC_UPDATE_BATCH_SIZE	(1 << 20)
+
 static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
 {
 	struct mmc_cmd cmd;
@@ -178,3 +182,94 @@ ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 
 	return blkcnt;
 }
+
+/* Compare a block read back from the card with the data to write */
+static bool mmc_block_equal(const void *blk, const void *src, uint len)
+{
+	const ulong *a = blk, *b = src;
+	uint i;
+
+	/* blk is from memalign(), but src may be anywhere */
+	if ((ulong)src & (sizeof(ulong) - 1))
+		return !memcmp(blk, src, len);
+
+	for (i = 0; i < len / sizeof(ulong); i += 4) {
+		if ((a[i] ^ b[i]) | (a[i + 1] ^ b[i + 1]) |
+		    (a[i + 2] ^ b[i + 2]) | (a[i + 3] ^ b[i + 3]))
+			return false;
+	}
+
+	return true;
+}
+
+ulong mmc_bupdate(int dev_num, lbaint_t start, lbaint_t blkcnt,
+		  const void *src, struct mmc_update_stats *stats)
+{
+	struct mmc *mmc = find_mmc_device(dev_num);
+	lbaint_t batch, cur, done, i, run_start = 0, run_len = 0;
+	u64 written = 0, skipped = 0;
+	uint blksz;
+	void *buf;
+
+	if (!mmc)
+		return 0;
+
+	blksz = mmc->write_bl_len;
+	batch = min(blkcnt, (lbaint_t)(MMC_UPDATE_BATCH_SIZE / blksz));
+	buf = memalign(ARCH_DMA_MINALIGN, batch * blksz);
+	if (!buf || mmc->read_bl_len != blksz) {
+		free(buf);
+		if (mmc_bwrite(dev_num, start, blkcnt, src) != blkcnt)
+			return 0;
+		written = (u64)blkcnt * blksz;
+		goto done;
+	}
+
+	/*
+	 * Read back a batch at a time and write runs of blocks which differ,
+	 * coalesced into multi-block writes. A run can span batches.
+	 */
+	for (done = 0; done < blkcnt; done += cur) {
+		cur = min(blkcnt - done, batch);
+		if (mmc->block_dev.block_read(dev_num, start + done, cur,
+					      buf) != cur)
+			goto err;
+		for (i = 0; i < cur; i++) {
+			if (!mmc_block_equal(buf + i * blksz,
+					     src + (done + i) * blksz, blksz)) {
+				if (!run_len)
+					run_start = done + i;
+				run_len++;
+				continue;
+			}
+			skipped += blksz;
+			if (!run_len)
+				continue;
+			if (mmc_bwrite(dev_num, start + run_start, run_len,
+				       src + run_start * blksz) != run_len)
+				goto err;
+			written += (u64)run_len * blksz;
+			run_len = 0;
+		}
+	}
+	if (run_len) {
+		if (mmc_bwrite(dev_num, start + run_start, run_len,
+			       src + run_start * blksz) != run_len)
+			goto err;
+		written += (u64)run_len * blksz;
+	}
+	free(buf);
+
+done:
+	if (stats) {
+		stats->written += written;
+		stats->skipped += skipped;
+	}
+
+	return blkcnt;
+
+err:
+	free(buf);
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Simulate an SD card
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <mmc.h>
+#include <os.h>
+#include <part.h>
+
+/* An SDHC card of 4MiB, which is 8 units of 512KiB in its CSD */
+#define SB_MMC_BLOCK_SIZE	512
+#define SB_MMC_C_SIZE		7
+#define SB_MMC_BLOCKS		((SB_MMC_C_SIZE + 1) << 10)
+#define SB_MMC_RCA		0x1234
+
+struct sandbox_mmc {
+	u8 *mem;
+	bool app_cmd;			/* Last command was APP_CMD */
+	long fail_read;			/* Block whose reads fail, or -1 */
+	ulong blocks_read;
+	ulong blocks_written;
+};
+
+static struct sandbox_mmc sb_mmc = {
+	.fail_read = -1,
+};
+
+static int sb_mmc_data(struct sandbox_mmc *sm, struct mmc_cmd *cmd,
+		       struct mmc_data *data)
+{
+	ulong start = cmd->cmdarg, count;
+
+	if (!data || data->blocksize != SB_MMC_BLOCK_SIZE)
+		return COMM_ERR;
+	count = data->blocks;
+	if (start >= SB_MMC_BLOCKS || count > SB_MMC_BLOCKS - start)
+		return COMM_ERR;
+
+	if (data->flags & MMC_DATA_READ) {
+		if (sm->fail_read >= (long)start &&
+		    sm->fail_read < (long)(start + count))
+			return COMM_ERR;
+		memcpy(data->dest, sm->mem + start * SB_MMC_BLOCK_SIZE,
+		       count * SB_MMC_BLOCK_SIZE);
+		sm->blocks_read += count;
+	} else {
+		memcpy(sm->mem + start * SB_MMC_BLOCK_SIZE, data->src,
+		       count * SB_MMC_BLOCK_SIZE);
+		sm->blocks_written += count;
+	}
+
+	return 0;
+}
+
+static int sb_mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+			   struct mmc_data *data)
+{
+	struct sandbox_mmc *sm = mmc->priv;
+	bool app_cmd = sm->app_cmd;
+	u32 *scr;
+
+	sm->app_cmd = false;
+	memset(cmd->response, '\0', sizeof(cmd->response));
+
+	if (app_cmd) {
+		switch (cmd->cmdidx) {
+		case SD_CMD_APP_SEND_OP_COND:
+			cmd->response[0] = OCR_BUSY | OCR_HCS |
+				(cmd->cmdarg & OCR_VOLTAGE_MASK);
+			return 0;
+		case SD_CMD_APP_SEND_SCR:
+			/* SD 2.0, 4-bit bus */
+			if (!data || data->blocksize != 8)
+				return COMM_ERR;
+			scr = (u32 *)data->dest;
+			scr[0] = cpu_to_be32(2 << 24 | SD_DATA_4BIT);
+			scr[1] = 0;
+			return 0;
+		case SD_CMD_APP_SET_BUS_WIDTH:
+			return 0;
+		}
+	}
+
+	switch (cmd->cmdidx) {
+	case MMC_CMD_GO_IDLE_STATE:
+		break;
+	case SD_CMD_SEND_IF_COND:
+		cmd->response[0] = cmd->cmdarg;
+		break;
+	case MMC_CMD_APP_CMD:
+		sm->app_cmd = true;
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA;
+		break;
+	case MMC_CMD_ALL_SEND_CID:
+		cmd->response[0] = 0x00534253;		/* 'SBS' */
+		cmd->response[1] = 0x414e4442;		/* 'ANDB' */
+		cmd->response[2] = 0x10000001;
+		cmd->response[3] = 0x00000000;
+		break;
+	case SD_CMD_SEND_RELATIVE_ADDR:
+		cmd->response[0] = SB_MMC_RCA << 16;
+		break;
+	case MMC_CMD_SEND_CSD:
+		/* CSD version 2.0, 25MHz, 512-byte blocks */
+		cmd->response[0] = 0x40000032;
+		cmd->response[1] = 9 << 16 | SB_MMC_C_SIZE >> 16;
+		cmd->response[2] = (SB_MMC_C_SIZE & 0xffff) << 16;
+		cmd->response[3] = 0;
+		break;
+	case MMC_CMD_SELECT_CARD:
+	case MMC_CMD_SET_BLOCKLEN:
+	case MMC_CMD_STOP_TRANSMISSION:
+		break;
+	case MMC_CMD_SEND_STATUS:
+		/* always ready, in the transfer state */
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA | 4 << 9;
+		break;
+	case SD_CMD_SWITCH_FUNC:
+		/* no high-speed support */
+		if (!data)
+			return COMM_ERR;
+		memset(data->dest, '\0', data->blocksize);
+		break;
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		return sb_mmc_data(sm, cmd, data);
+	default:
+		debug("sandbox_mmc: Unsupported command %d\n", cmd->cmdidx);
+		return TIMEOUT;
+	}
+
+	return 0;
+}
+
+static void sb_mmc_set_ios(struct mmc *mmc)
+{
+}
+
+static int sb_mmc_init(struct mmc *mmc)
+{
+	return 0;
+}
+
+static const struct mmc_ops sb_mmc_ops = {
+	.send_cmd	= sb_mmc_send_cmd,
+	.set_ios	= sb_mmc_set_ios,
+	.init		= sb_mmc_init,
+};
+
+static struct mmc_config sb_mmc_cfg = {
+	.name		= "sandbox_mmc",
+	.ops		= &sb_mmc_ops,
+	.host_caps	= MMC_MODE_4BIT | MMC_MODE_HC,
+	.voltages	= MMC_VDD_32_33 | MMC_VDD_33_34,
+	.f_min		= 400000,
+	.f_max		= 25000000,
+	/* small, so that long transfers are split */
+	.b_max		= 64,
+	.part_type	= PART_TYPE_UNKNOWN,
+};
+
+void sandbox_mmc_fail_read(long blk)
+{
+	sb_mmc.fail_read = blk;
+}
+
+void sandbox_mmc_get_counts(ulong *readp, ulong *writtenp)
+{
+	*readp = sb_mmc.blocks_read;
+	*writtenp = sb_mmc.blocks_written;
+}
+
+int sandbox_mmc_init(void)
+{
+	struct sandbox_mmc *sm = &sb_mmc;
+	ulong size = (ulong)SB_MMC_BLOCKS * SB_MMC_BLOCK_SIZE;
+
+	if (!sm->mem) {
+		sm->mem = os_malloc(size);
+		if (!sm->mem)
+			return -ENOMEM;
+		memset(sm->mem, '\0', size);
+	}
+	if (!mmc_create(&sb_mmc_cfg, sm))
+		return -ENOMEM;
+
+	return 0;
+}
@@ -636,12 +636,17 @@ static int nand_block_checkbad(struct mtd_info *mtd, loff_t ofs, int getchip,
 			       int allowbbt)
 {
 	struct nand_chip *chip = mtd->priv;
+	int ret;
 
 	if (!chip->bbt)
 		return chip->block_bad(mtd, ofs, getchip);
 
 	/* Return info from the table */
-	return nand_isbad_bbt(mtd, ofs, allowbbt);
+	ret = nand_isbad_bbt(mtd, ofs, allowbbt);
+	if (!ret)
+		ret = nand_bbt_check_stashed(mtd, ofs, getchip);
+
+	return ret;
 }
 
 #ifndef __UBOOT__
@@ -1665,6 +1670,28 @@ static int nand_setup_read_retry(struct mtd_info *mtd, int retry_mode)
 	return chip->setup_read_retry(mtd, retry_mode);
 }
 
+/**
+ * nand_cache_read_pages - [INTERN] Count pages to read with read cache
+ * @mtd: MTD device structure
+ * @page: page which is about to be read
+ * @readlen: number of bytes left to read, starting at the beginning of @page
+ *
+ * Returns the number of pages after @page which can be fetched with read
+ * cache sequential, i.e. which are read in full and are in the same block.
+ */
+static int nand_cache_read_pages(struct mtd_info *mtd, int page,
+				 uint32_t readlen)
+{
+	struct nand_chip *chip = mtd->priv;
+	int ppb = 1 << (chip->phys_erase_shift - chip->page_shift);
+
+	if (!NAND_HAS_CACHERD(chip))
+		return 0;
+
+	return min_t(int, (readlen >> chip->page_shift) - 1,
+		     ppb - 1 - (page & (ppb - 1)));
+}
+
 /**
  * nand_do_read_ops - [INTERN] Read data with ECC
  * @mtd: MTD device structure
@@ -1687,6 +1714,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	uint8_t *bufpoi, *oob, *buf;
 	unsigned int max_bitflips = 0;
 	int retry_mode = 0;
+	int cache_pages = 0;
 	bool ecc_fail = false;
 
 	chipnr = (int)(from >> chip->chip_shift);
@@ -1709,11 +1737,31 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		aligned = (bytes == mtd->writesize);
 
 		/* Is the current page in the buffer? */
-		if (realpage != chip->pagebuf || oob) {
+		if (realpage != chip->pagebuf || oob || cache_pages) {
 			bufpoi = aligned ? buf : chip->buffers->databuf;
 
 read_retry:
-			chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+			if (cache_pages) {
+				/* The page is already in the data register */
+				cache_pages--;
+				chip->cmdfunc(mtd, cache_pages ?
+					      NAND_CMD_READCACHESEQ :
+					      NAND_CMD_READCACHEEND, -1, -1);
+			} else {
+				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+
+				/*
+				 * Have the chip read the next page while this
+				 * one is transferred and corrected
+				 */
+				if (aligned && !oob)
+					cache_pages = nand_cache_read_pages(mtd,
+							page, readlen);
+				if (cache_pages)
+					chip->cmdfunc(mtd,
+						      NAND_CMD_READCACHESEQ,
+						      -1, -1);
+			}
 
 			/*
 			 * Now read the page into the buffer.  Absent an error,
@@ -1823,6 +1871,9 @@ read_retry:
 			chip->select_chip(mtd, chipnr);
 		}
 	}
+	/* Leave read cache mode if the read was stopped by an error */
+	if (cache_pages)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
 	chip->select_chip(mtd, -1);
 
 	ops->retlen = ops->len - (size_t) readlen;
@@ -3361,6 +3412,9 @@ static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
 	chip->chipsize *= (uint64_t)mtd->erasesize * p->lun_count;
 	chip->bits_per_cell = p->bits_per_cell;
 
+	if (le16_to_cpu(p->opt_cmd) & ONFI_OPT_CMD_READ_CACHE)
+		chip->options |= NAND_CACHERD;
+
 	if (onfi_feature(chip) & ONFI_FEATURE_16_BIT_BUS)
 		*busw = NAND_BUSWIDTH_16;
 	else
@@ -4286,6 +4340,19 @@ int nand_scan_tail(struct mtd_info *mtd)
 	if ((ecc->mode == NAND_ECC_SOFT) && (chip->page_shift > 9))
 		chip->options |= NAND_SUBPAGE_READ;
 
+	/*
+	 * Read cache sequential needs the large page command set and page
+	 * read methods which only transfer data, without issuing commands of
+	 * their own. It cannot re-read a page for read retry either.
+	 */
+	if (chip->cmdfunc != nand_command_lp ||
+	    (ecc->read_page != nand_read_page_raw &&
+	     ecc->read_page != nand_read_page_swecc &&
+	     ecc->read_page != nand_read_page_hwecc) ||
+	    ecc->read_page_raw != nand_read_page_raw ||
+	    (chip->options & NAND_NEED_READRDY) || chip->read_retries > 1)
+		chip->options &= ~NAND_CACHERD;
+
 	/* Fill in remaining MTD driver data */
 	mtd->type = nand_is_slc(chip) ? MTD_NANDFLASH : MTD_MLCNANDFLASH;
 	mtd->flags = (chip->options & NAND_ROM) ? MTD_CAP_ROM :
@@ -4387,6 +4454,7 @@ void nand_release(struct mtd_info *mtd)
 
 	/* Free bad block table memory */
 	kfree(chip->bbt);
+	kfree(chip->bbt_unchecked);
 	if (!(chip->options & NAND_OWN_BUFFERS))
 		kfree(chip->buffers);
 
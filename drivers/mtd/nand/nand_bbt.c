@@ -75,7 +75,10 @@
 #else
 #include <common.h>
 #include <malloc.h>
+#include <nand.h>
+#include <asm/io.h>
 #include <linux/compat.h>
+#include <u-boot/crc.h>
 
  #include <linux/mtd/mtd.h>
  #include <linux/mtd/bbm.h>
@@ -93,6 +96,10 @@
 #define BBT_ENTRY_MASK		0x03
 #define BBT_ENTRY_SHIFT		2
 
+#if defined(CONFIG_NAND_BBT_STASH_ADDR) && CONFIG_SYS_MAX_NAND_DEVICE > 1
+#error "CONFIG_NAND_BBT_STASH_ADDR only supports a single NAND device"
+#endif
+
 static int nand_update_bbt(struct mtd_info *mtd, loff_t offs);
 
 static inline uint8_t bbt_get_entry(struct nand_chip *chip, int block)
@@ -1088,6 +1095,142 @@ static void verify_bbt_descr(struct mtd_info *mtd, struct nand_bbt_descr *bd)
 	BUG_ON(table_size > (1 << this->bbt_erase_shift));
 }
 
+static int nand_bbt_stash_len(struct mtd_info *mtd)
+{
+	struct nand_chip *this = mtd->priv;
+
+	return mtd->size >> (this->bbt_erase_shift + 2);
+}
+
+static uint32_t nand_bbt_stash_crc(struct nand_bbt_stash *hdr)
+{
+	return crc32(0, (uint8_t *)&hdr->size,
+		     sizeof(*hdr) - offsetof(struct nand_bbt_stash, size) +
+		     hdr->len);
+}
+
+/**
+ * nand_bbt_stash - [NAND Interface] Copy the bad block table to RAM
+ * @mtd: MTD device structure
+ * @base: start of the stash area
+ * @size: size of the stash area
+ *
+ * The stash is checked by nand_bbt_unstash(), which may be run by a later boot
+ * stage. If the device has no table at present, the stash is invalidated.
+ */
+int nand_bbt_stash(struct mtd_info *mtd, void *base, int size)
+{
+	struct nand_chip *this = mtd->priv;
+	struct nand_bbt_stash *hdr = base;
+	int len = nand_bbt_stash_len(mtd);
+
+	if (size < (int)sizeof(*hdr))
+		return -ENOSPC;
+	hdr->magic = 0;
+	if (!this->bbt)
+		return -ENOENT;
+	if (size < (int)sizeof(*hdr) + len) {
+		debug("%s: Not enough space for %d bytes of BBT\n", __func__,
+		      len);
+		return -ENOSPC;
+	}
+
+	hdr->size = mtd->size;
+	hdr->erasesize = mtd->erasesize;
+	hdr->len = len;
+	memcpy(hdr + 1, this->bbt, len);
+	hdr->crc = nand_bbt_stash_crc(hdr);
+	hdr->magic = NAND_BBT_STASH_MAGIC;
+
+	return 0;
+}
+
+/**
+ * nand_bbt_unstash - [NAND Interface] Take the bad block table from RAM
+ * @mtd: MTD device structure
+ * @base: start of the stash area
+ * @size: size of the stash area
+ *
+ * Fills in the memory based BBT from a stash made for a device of the same
+ * geometry, allocating the table if there is none yet. Since blocks may have
+ * been marked bad after the stash was made, each block's marker is still read
+ * the first time it is used, see nand_bbt_check_stashed().
+ */
+int nand_bbt_unstash(struct mtd_info *mtd, void *base, int size)
+{
+	struct nand_chip *this = mtd->priv;
+	struct nand_bbt_stash *hdr = base;
+	int len = nand_bbt_stash_len(mtd);
+	int map_len = (len * 4 + 7) / 8;
+
+	if (size < (int)sizeof(*hdr) + len)
+		return -ENOSPC;
+	if (hdr->magic != NAND_BBT_STASH_MAGIC || hdr->size != mtd->size ||
+	    hdr->erasesize != mtd->erasesize || hdr->len != len) {
+		debug("%s: No stashed BBT for this device\n", __func__);
+		return -ENOENT;
+	}
+	if (hdr->crc != nand_bbt_stash_crc(hdr)) {
+		debug("%s: Stashed BBT is corrupt\n", __func__);
+		return -EINVAL;
+	}
+
+	if (!this->bbt_unchecked) {
+		this->bbt_unchecked = kmalloc(map_len, GFP_KERNEL);
+		if (!this->bbt_unchecked)
+			return -ENOMEM;
+	}
+	if (!this->bbt) {
+		this->bbt = kmalloc(len, GFP_KERNEL);
+		if (!this->bbt)
+			return -ENOMEM;
+	}
+	memcpy(this->bbt, hdr + 1, len);
+	memset(this->bbt_unchecked, 0xff, map_len);
+
+	return 0;
+}
+
+/**
+ * nand_bbt_update_stash - [NAND Interface] Refresh the stash, if configured
+ * @mtd: MTD device structure
+ *
+ * Only memory based tables are stashed, since a flash based one is quick to
+ * read back.
+ */
+void nand_bbt_update_stash(struct mtd_info *mtd)
+{
+#ifdef CONFIG_NAND_BBT_STASH_ADDR
+	struct nand_chip *this = mtd->priv;
+	void *base;
+
+	if (this->bbt_td)
+		return;
+	base = map_sysmem(CONFIG_NAND_BBT_STASH_ADDR,
+			  CONFIG_NAND_BBT_STASH_SIZE);
+	nand_bbt_stash(mtd, base, CONFIG_NAND_BBT_STASH_SIZE);
+	unmap_sysmem(base);
+#endif
+}
+
+/* Use a table stashed earlier in this power cycle instead of scanning */
+static int nand_bbt_from_stash(struct mtd_info *mtd)
+{
+#ifdef CONFIG_NAND_BBT_STASH_ADDR
+	void *base;
+	int ret;
+
+	base = map_sysmem(CONFIG_NAND_BBT_STASH_ADDR,
+			  CONFIG_NAND_BBT_STASH_SIZE);
+	ret = nand_bbt_unstash(mtd, base, CONFIG_NAND_BBT_STASH_SIZE);
+	unmap_sysmem(base);
+
+	return ret;
+#else
+	return -ENOENT;
+#endif
+}
+
 /**
  * nand_scan_bbt - [NAND Interface] scan, find, read and maybe create bad block table(s)
  * @mtd: MTD device structure
@@ -1122,10 +1265,14 @@ int nand_scan_bbt(struct mtd_info *mtd, struct nand_bbt_descr *bd)
 	 * memory based bad block table.
 	 */
 	if (!td) {
+		if (!nand_bbt_from_stash(mtd))
+			return 0;
 		if ((res = nand_memory_bbt(mtd, bd))) {
 			pr_err("nand_bbt: can't scan flash and build the RAM-based BBT\n");
 			kfree(this->bbt);
 			this->bbt = NULL;
+		} else {
+			nand_bbt_update_stash(mtd);
 		}
 		return res;
 	}
@@ -1376,8 +1523,77 @@ int nand_markbad_bbt(struct mtd_info *mtd, loff_t offs)
 	/* Update flash-based bad block table */
 	if (this->bbt_options & NAND_BBT_USE_FLASH)
 		ret = nand_update_bbt(mtd, offs);
+	else
+		nand_bbt_update_stash(mtd);
 
 	return ret;
 }
 
+/**
+ * nand_bbt_next_good - [NAND Interface] Find the next good block in the BBT
+ * @mtd: MTD device structure
+ * @offs: offset in the device
+ *
+ * Returns the offset of the first good block at or after the one containing
+ * @offs, or the size of the device if there is none. Reserved blocks count as
+ * bad, as they do for nand_isbad_bbt() without @allowbbt.
+ */
+loff_t nand_bbt_next_good(struct mtd_info *mtd, loff_t offs)
+{
+	struct nand_chip *this = mtd->priv;
+	int block = (int)(offs >> this->bbt_erase_shift);
+	int blocks = (int)(mtd->size >> this->bbt_erase_shift);
+	uint8_t entry;
+
+	while (block < blocks) {
+		/* Step over whole bytes with no good (zero) entry at once */
+		entry = this->bbt[block >> BBT_ENTRY_SHIFT];
+		if (!(block & BBT_ENTRY_MASK) &&
+		    ((entry | entry >> 1) & 0x55) == 0x55) {
+			block += 1 << BBT_ENTRY_SHIFT;
+			continue;
+		}
+		if (bbt_get_entry(this, block) == BBT_BLOCK_GOOD &&
+		    !nand_bbt_check_stashed(mtd, (loff_t)block <<
+					    this->bbt_erase_shift, 1))
+			break;
+		block++;
+	}
+
+	return (loff_t)min(block, blocks) << this->bbt_erase_shift;
+}
+
+/**
+ * nand_bbt_check_stashed - [NAND Interface] Check a block's marker once
+ * @mtd: MTD device structure
+ * @offs: offset of a block which the table says is good
+ * @getchip: 0, if the chip is already selected
+ *
+ * A table taken from the RAM stash may not know about blocks marked bad since
+ * it was made, e.g. by an operating system before a warm reset. So the first
+ * time such a block is used its bad block marker is read, and the table (and
+ * stash) updated if it is marked bad.
+ *
+ * Returns 1 if the block is marked bad, 0 otherwise.
+ */
+int nand_bbt_check_stashed(struct mtd_info *mtd, loff_t offs, int getchip)
+{
+	struct nand_chip *this = mtd->priv;
+	int block = (int)(offs >> this->bbt_erase_shift);
+	uint8_t mask = 1 << (block & 7);
+
+	if (!this->bbt_unchecked || !(this->bbt_unchecked[block / 8] & mask))
+		return 0;
+	this->bbt_unchecked[block / 8] &= ~mask;
+	if (!this->block_bad(mtd, offs, getchip))
+		return 0;
+
+	pr_info("nand_bbt: block %d is marked bad, unlike in the stash\n",
+		block);
+	bbt_mark_entry(this, block, BBT_BLOCK_WORN);
+	nand_bbt_update_stash(mtd);
+
+	return 1;
+}
+
 EXPORT_SYMBOL(nand_scan_bbt);
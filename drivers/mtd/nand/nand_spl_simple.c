@@ -6,9 +6,11 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <nand.h>
 #include <asm/io.h>
 #include <linux/mtd/nand_ecc.h>
+#include <u-boot/crc.h>
 
 static int nand_ecc_pos[] = CONFIG_SYS_NAND_ECCPOS;
 static nand_info_t mtd;
@@ -18,6 +20,24 @@ static struct nand_chip nand_chip;
 					CONFIG_SYS_NAND_ECCSIZE)
 #define ECCTOTAL	(ECCSTEPS * CONFIG_SYS_NAND_ECCBYTES)
 
+#if defined(CONFIG_SPL_NAND_CACHE_READ) && \
+	(CONFIG_SYS_NAND_PAGE_SIZE <= 512 || \
+	 defined(CONFIG_SYS_NAND_HW_ECC_OOBFIRST))
+#error "CONFIG_SPL_NAND_CACHE_READ needs large pages with ECC after the data"
+#endif
+
+#ifdef CONFIG_SPL_NAND_BBT_STASH
+#define BBT_BLOCKS	(CONFIG_SYS_NAND_SIZE / CONFIG_SYS_NAND_BLOCK_SIZE)
+#define BBT_LEN		(BBT_BLOCKS / 4)
+
+#ifndef CONFIG_NAND_BBT_STASH_ADDR
+#error "CONFIG_SPL_NAND_BBT_STASH needs CONFIG_NAND_BBT_STASH_ADDR and _SIZE"
+#endif
+
+/* Bad block table shared with U-Boot, once it has been set up */
+static struct nand_bbt_stash *bbt_stash;
+#endif
+
 
 #if (CONFIG_SYS_NAND_PAGE_SIZE <= 512)
 /*
@@ -112,7 +132,7 @@ static int nand_command(int block, int page, uint32_t offs,
 }
 #endif
 
-static int nand_is_bad_block(int block)
+static int nand_read_bad_marker(int block)
 {
 	struct nand_chip *this = mtd.priv;
 
@@ -133,6 +153,43 @@ static int nand_is_bad_block(int block)
 	return 0;
 }
 
+#ifdef CONFIG_SPL_NAND_BBT_STASH
+static uint32_t nand_bbt_stash_crc(struct nand_bbt_stash *hdr)
+{
+	return crc32(0, (u8 *)&hdr->size,
+		     sizeof(*hdr) - offsetof(struct nand_bbt_stash, size) +
+		     hdr->len);
+}
+
+/*
+ * The stash may be older than a block's bad block marker, e.g. if an OS marked
+ * the block bad before a warm reset, so the marker of a block which the stash
+ * says is good is read too, and the block recorded as worn if it is bad.
+ */
+static int nand_is_bad_block(int block)
+{
+	u8 *bbt;
+
+	if (!bbt_stash)
+		return nand_read_bad_marker(block);
+
+	bbt = (u8 *)(bbt_stash + 1);
+	if ((bbt[block / 4] >> (block % 4) * 2) & 3)
+		return 1;
+	if (!nand_read_bad_marker(block))
+		return 0;
+	bbt[block / 4] |= 1 << (block % 4) * 2;
+	bbt_stash->crc = nand_bbt_stash_crc(bbt_stash);
+
+	return 1;
+}
+#else
+static int nand_is_bad_block(int block)
+{
+	return nand_read_bad_marker(block);
+}
+#endif
+
 #if defined(CONFIG_SYS_NAND_HW_ECC_OOBFIRST)
 static int nand_read_page(int block, int page, uchar *dst)
 {
@@ -165,7 +222,8 @@ static int nand_read_page(int block, int page, uchar *dst)
 	return 0;
 }
 #else
-static int nand_read_page(int block, int page, void *dst)
+/* Transfer and correct a page which the chip has read from the array */
+static int nand_read_page_data(void *dst)
 {
 	struct nand_chip *this = mtd.priv;
 	u_char ecc_calc[ECCTOTAL];
@@ -177,8 +235,6 @@ static int nand_read_page(int block, int page, void *dst)
 	int eccsteps = ECCSTEPS;
 	uint8_t *p = dst;
 
-	nand_command(block, page, 0, NAND_CMD_READ0);
-
 	for (i = 0; eccsteps; eccsteps--, i += eccbytes, p += eccsize) {
 		if (this->ecc.mode != NAND_ECC_SOFT)
 			this->ecc.hwctl(&mtd, NAND_ECC_READ);
@@ -204,6 +260,46 @@ static int nand_read_page(int block, int page, void *dst)
 
 	return 0;
 }
+
+static int nand_read_page(int block, int page, void *dst)
+{
+	nand_command(block, page, 0, NAND_CMD_READ0);
+
+	return nand_read_page_data(dst);
+}
+
+#ifdef CONFIG_SPL_NAND_CACHE_READ
+/* Send read cache sequential or read cache end, which take no address */
+static void nand_cache_command(u8 cmd)
+{
+	struct nand_chip *this = mtd.priv;
+
+	this->cmd_ctrl(&mtd, cmd, NAND_CTRL_CLE | NAND_CTRL_CHANGE);
+	this->cmd_ctrl(&mtd, NAND_CMD_NONE, NAND_NCE | NAND_CTRL_CHANGE);
+
+	while (!this->dev_ready(&mtd))
+		;
+}
+
+/*
+ * Read the pages from @page to the end of @block, with the chip reading each
+ * page from the array while the previous one is transferred and corrected
+ */
+static void nand_read_block_cached(int block, int page, uchar *dst)
+{
+	bool cached = page < CONFIG_SYS_NAND_PAGE_COUNT - 1;
+
+	nand_command(block, page, 0, NAND_CMD_READ0);
+	for (; page < CONFIG_SYS_NAND_PAGE_COUNT; page++) {
+		if (cached)
+			nand_cache_command(page < CONFIG_SYS_NAND_PAGE_COUNT - 1 ?
+					   NAND_CMD_READCACHESEQ :
+					   NAND_CMD_READCACHEEND);
+		nand_read_page_data(dst);
+		dst += CONFIG_SYS_NAND_PAGE_SIZE;
+	}
+}
+#endif
 #endif
 
 int nand_spl_load_image(uint32_t offs, unsigned int size, void *dst)
@@ -223,6 +319,12 @@ int nand_spl_load_image(uint32_t offs, unsigned int size, void *dst)
 			/*
 			 * Skip bad blocks
 			 */
+#ifdef CONFIG_SPL_NAND_CACHE_READ
+			nand_read_block_cached(block, page, dst);
+			dst += (CONFIG_SYS_NAND_PAGE_COUNT - page) *
+				CONFIG_SYS_NAND_PAGE_SIZE;
+			page = CONFIG_SYS_NAND_PAGE_COUNT;
+#endif
 			while (page < CONFIG_SYS_NAND_PAGE_COUNT) {
 				nand_read_page(block, page, dst);
 				dst += CONFIG_SYS_NAND_PAGE_SIZE;
@@ -240,6 +342,76 @@ int nand_spl_load_image(uint32_t offs, unsigned int size, void *dst)
 	return 0;
 }
 
+/*
+ * Read part of a block, whether or not it is bad, for users such as UBI
+ * which handle bad blocks themselves
+ */
+int nand_spl_read_block(int block, int offset, int len, void *dst)
+{
+	static uchar page_buf[CONFIG_SYS_NAND_PAGE_SIZE];
+	int page = offset / CONFIG_SYS_NAND_PAGE_SIZE;
+	int col = offset % CONFIG_SYS_NAND_PAGE_SIZE;
+	int chunk;
+
+	if (offset + len > CONFIG_SYS_NAND_BLOCK_SIZE)
+		return -EINVAL;
+
+	while (len > 0) {
+		chunk = min(len, CONFIG_SYS_NAND_PAGE_SIZE - col);
+		if (chunk < CONFIG_SYS_NAND_PAGE_SIZE) {
+			nand_read_page(block, page, page_buf);
+			memcpy(dst, page_buf + col, chunk);
+		} else {
+			nand_read_page(block, page, dst);
+		}
+		dst += chunk;
+		len -= chunk;
+		col = 0;
+		page++;
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_SPL_NAND_BBT_STASH
+/*
+ * Find the bad blocks, unless they are stashed already from earlier in this
+ * power cycle, and leave them in the stash for U-Boot to pick up
+ */
+static void nand_bbt_init(void)
+{
+	struct nand_bbt_stash *hdr;
+	u8 *bbt;
+	int block;
+
+	if (CONFIG_NAND_BBT_STASH_SIZE < sizeof(*hdr) + BBT_LEN)
+		return;
+	hdr = map_sysmem(CONFIG_NAND_BBT_STASH_ADDR,
+			 CONFIG_NAND_BBT_STASH_SIZE);
+	if (hdr->magic == NAND_BBT_STASH_MAGIC &&
+	    hdr->size == CONFIG_SYS_NAND_SIZE &&
+	    hdr->erasesize == CONFIG_SYS_NAND_BLOCK_SIZE &&
+	    hdr->len == BBT_LEN && hdr->crc == nand_bbt_stash_crc(hdr)) {
+		bbt_stash = hdr;
+		return;
+	}
+
+	bbt = (u8 *)(hdr + 1);
+	memset(bbt, '\0', BBT_LEN);
+	for (block = 0; block < BBT_BLOCKS; block++) {
+		/* Mark as factory bad, as U-Boot does when it scans */
+		if (nand_read_bad_marker(block))
+			bbt[block / 4] |= 3 << (block % 4) * 2;
+	}
+	hdr->size = CONFIG_SYS_NAND_SIZE;
+	hdr->erasesize = CONFIG_SYS_NAND_BLOCK_SIZE;
+	hdr->len = BBT_LEN;
+	hdr->crc = nand_bbt_stash_crc(hdr);
+	hdr->magic = NAND_BBT_STASH_MAGIC;
+	bbt_stash = hdr;
+}
+#endif
+
 /* nand_init() - initialize data to make nand usable by SPL */
 void nand_init(void)
 {
@@ -260,6 +432,10 @@ void nand_init(void)
 
 	if (nand_chip.select_chip)
 		nand_chip.select_chip(&mtd, 0);
+
+#ifdef CONFIG_SPL_NAND_BBT_STASH
+	nand_bbt_init();
+#endif
 }
 
 /* Unselect after operation */
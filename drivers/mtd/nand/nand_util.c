@@ -91,6 +91,10 @@ int nand_erase_opts(nand_info_t *meminfo, const nand_erase_options_t *opts)
 			kfree(chip->bbt);
 		}
 		chip->bbt = NULL;
+		kfree(chip->bbt_unchecked);
+		chip->bbt_unchecked = NULL;
+		/* ...nor any copy of it stashed in RAM */
+		nand_bbt_update_stash(meminfo);
 	}
 
 	for (erased_length = 0;
@@ -394,6 +398,30 @@ int nand_unlock(struct mtd_info *mtd, loff_t start, size_t length,
 }
 #endif
 
+/**
+ * nand_next_good_block:
+ *
+ * Find the first good block at or after the block containing offset,
+ * stepping over runs of bad blocks in the bad block table if there is one.
+ *
+ * @param nand NAND device
+ * @param offset offset in flash
+ * @return start of the good block, or the size of the device if there is none
+ */
+loff_t nand_next_good_block(nand_info_t *nand, loff_t offset)
+{
+	struct nand_chip *chip = nand->priv;
+
+	offset &= ~(loff_t)(nand->erasesize - 1);
+	if (chip->bbt)
+		return nand_bbt_next_good(nand, offset);
+
+	while (offset < nand->size && nand_block_isbad(nand, offset))
+		offset += nand->erasesize;
+
+	return offset;
+}
+
 /**
  * check_skip_len
  *
@@ -416,7 +444,7 @@ static int check_skip_len(nand_info_t *nand, loff_t offset, size_t length,
 
 	while (len_excl_bad < length) {
 		size_t block_len, block_off;
-		loff_t block_start;
+		loff_t block_start, good;
 
 		if (offset >= nand->size)
 			return -1;
@@ -425,11 +453,16 @@ static int check_skip_len(nand_info_t *nand, loff_t offset, size_t length,
 		block_off = offset & (nand->erasesize - 1);
 		block_len = nand->erasesize - block_off;
 
-		if (!nand_block_isbad(nand, block_start))
-			len_excl_bad += block_len;
-		else
+		good = nand_next_good_block(nand, block_start);
+		if (good != block_start) {
+			/* Skip the whole run of bad blocks */
+			*used += good - offset;
+			offset = good;
 			ret = 1;
+			continue;
+		}
 
+		len_excl_bad += block_len;
 		offset += block_len;
 		*used += block_len;
 	}
@@ -0,0 +1,399 @@
+/*
+ * Simulate an ONFI NAND flash chip
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <nand.h>
+#include <os.h>
+
+/* Geometry of the emulated chip: 2KiB pages, 128KiB blocks, 32MiB */
+#define SB_NAND_PAGE_SIZE	2048
+#define SB_NAND_OOB_SIZE	64
+#define SB_NAND_PAGES_PER_BLOCK	64
+#define SB_NAND_BLOCKS		256
+#define SB_NAND_PAGES		(SB_NAND_BLOCKS * SB_NAND_PAGES_PER_BLOCK)
+#define SB_NAND_RAW_SIZE	(SB_NAND_PAGE_SIZE + SB_NAND_OOB_SIZE)
+
+/* Array read time and read cache busy time, in us */
+#define SB_NAND_T_R		25
+#define SB_NAND_T_RCBSY		3
+
+#define SB_NAND_MFR_ID		NAND_MFR_MICRON
+#define SB_NAND_DEV_ID		0xf1
+
+#define SB_NAND_MAX_ADDR	5
+
+/* Factory bad blocks, marked in the OOB of their first page */
+static const int sb_nand_bad_blocks[] = { 200, 201, 202, 203, 204, 210 };
+
+struct sandbox_nand {
+	u8 *mem;			/* Pages including their OOB */
+	u8 cmd;				/* Last command latched */
+	u8 addr[SB_NAND_MAX_ADDR];	/* Address cycles since the command */
+	int naddr;
+
+	u8 data[SB_NAND_RAW_SIZE];	/* Data register, loaded from array */
+	u8 cache[SB_NAND_RAW_SIZE];	/* Cache register, seen by the host */
+	u8 *out;			/* Next byte for the host to read */
+	u8 *out_end;
+	int page;			/* Page in the data register, or -1 */
+	bool cache_read;		/* Read cache sequential in progress */
+	int col;			/* Column for program data */
+	int prog_page;
+
+	ulong loaded_at;		/* When the data register is loaded */
+	ulong busy_until;		/* When R/B# goes back to ready */
+
+	struct nand_onfi_params param;
+	u8 status;
+
+	ulong page_reads;		/* Reads waiting for tR (30h) */
+	ulong cache_reads;		/* Read cache sequential (31h) */
+};
+
+static struct sandbox_nand sb_nand;
+
+static u8 *sb_nand_page(struct sandbox_nand *sn, int page)
+{
+	return sn->mem + (ulong)page * SB_NAND_RAW_SIZE;
+}
+
+static void sb_nand_set_out(struct sandbox_nand *sn, void *buf, int len)
+{
+	sn->out = buf;
+	sn->out_end = sn->out + len;
+}
+
+/* Decode the column and row address cycles of a page operation */
+static void sb_nand_decode(struct sandbox_nand *sn, int *col, int *row)
+{
+	int i;
+
+	*col = sn->addr[0] | sn->addr[1] << 8;
+	*row = 0;
+	for (i = sn->naddr - 1; i >= 2; i--)
+		*row = *row << 8 | sn->addr[i];
+}
+
+static int sb_nand_decode_row(struct sandbox_nand *sn)
+{
+	int i, row = 0;
+
+	for (i = sn->naddr - 1; i >= 0; i--)
+		row = row << 8 | sn->addr[i];
+
+	return row;
+}
+
+/* Start loading @page from the array into the data register */
+static void sb_nand_load(struct sandbox_nand *sn, int page, ulong start)
+{
+	sn->page = page;
+	memcpy(sn->data, sb_nand_page(sn, page), SB_NAND_RAW_SIZE);
+	sn->loaded_at = start + SB_NAND_T_R;
+}
+
+/* Move the data register to the cache register, once it is loaded */
+static ulong sb_nand_to_cache(struct sandbox_nand *sn)
+{
+	ulong start = max(timer_get_us(), sn->loaded_at);
+
+	memcpy(sn->cache, sn->data, SB_NAND_RAW_SIZE);
+	sb_nand_set_out(sn, sn->cache, SB_NAND_RAW_SIZE);
+	sn->busy_until = start + SB_NAND_T_RCBSY;
+
+	return start;
+}
+
+static void sb_nand_error(struct sandbox_nand *sn, const char *msg)
+{
+	printf("sandbox_nand: %s (cmd %02x, page %d)\n", msg, sn->cmd,
+	       sn->page);
+	/* make the host see garbage rather than plausible data */
+	memset(sn->cache, '\0', SB_NAND_RAW_SIZE);
+	sb_nand_set_out(sn, sn->cache, SB_NAND_RAW_SIZE);
+	sn->page = -1;
+	sn->cache_read = false;
+}
+
+static void sb_nand_command(struct sandbox_nand *sn, u8 cmd)
+{
+	int col, row;
+	ulong start;
+
+	switch (cmd) {
+	case NAND_CMD_READSTART:
+		sb_nand_decode(sn, &col, &row);
+		if (sn->cmd != NAND_CMD_READ0 || row >= SB_NAND_PAGES ||
+		    col >= SB_NAND_RAW_SIZE) {
+			sb_nand_error(sn, "invalid read");
+			break;
+		}
+		sn->cache_read = false;
+		sn->page_reads++;
+		sb_nand_load(sn, row, timer_get_us());
+		sn->busy_until = sn->loaded_at;
+		memcpy(sn->cache, sn->data, SB_NAND_RAW_SIZE);
+		sb_nand_set_out(sn, sn->cache + col, SB_NAND_RAW_SIZE - col);
+		break;
+	case NAND_CMD_READCACHESEQ:
+		if (sn->page < 0) {
+			sb_nand_error(sn, "read cache without read");
+			break;
+		}
+		if (!((sn->page + 1) % SB_NAND_PAGES_PER_BLOCK)) {
+			sb_nand_error(sn, "read cache crosses a block");
+			break;
+		}
+		start = sb_nand_to_cache(sn);
+		sn->cache_read = true;
+		sn->cache_reads++;
+		sb_nand_load(sn, sn->page + 1, start + SB_NAND_T_RCBSY);
+		break;
+	case NAND_CMD_READCACHEEND:
+		if (!sn->cache_read) {
+			sb_nand_error(sn, "read cache end without read cache");
+			break;
+		}
+		sb_nand_to_cache(sn);
+		sn->cache_read = false;
+		break;
+	case NAND_CMD_RNDOUTSTART:
+		sb_nand_decode(sn, &col, &row);
+		if (col >= SB_NAND_RAW_SIZE) {
+			sb_nand_error(sn, "invalid column");
+			break;
+		}
+		sb_nand_set_out(sn, sn->cache + col, SB_NAND_RAW_SIZE - col);
+		break;
+	case NAND_CMD_SEQIN:
+		memset(sn->cache, 0xff, SB_NAND_RAW_SIZE);
+		sn->prog_page = -1;
+		break;
+	case NAND_CMD_PAGEPROG:
+	case NAND_CMD_CACHEDPROG:
+		if (sn->prog_page < 0 || sn->prog_page >= SB_NAND_PAGES) {
+			sn->status |= NAND_STATUS_FAIL;
+			break;
+		}
+		for (col = 0; col < SB_NAND_RAW_SIZE; col++)
+			sb_nand_page(sn, sn->prog_page)[col] &= sn->cache[col];
+		sn->status &= ~NAND_STATUS_FAIL;
+		break;
+	case NAND_CMD_ERASE2:
+		row = sb_nand_decode_row(sn);
+		if (sn->cmd != NAND_CMD_ERASE1 || row >= SB_NAND_PAGES) {
+			sn->status |= NAND_STATUS_FAIL;
+			break;
+		}
+		row -= row % SB_NAND_PAGES_PER_BLOCK;
+		memset(sb_nand_page(sn, row), 0xff,
+		       SB_NAND_PAGES_PER_BLOCK * SB_NAND_RAW_SIZE);
+		sn->status &= ~NAND_STATUS_FAIL;
+		break;
+	case NAND_CMD_STATUS:
+		sb_nand_set_out(sn, &sn->status, 1);
+		break;
+	case NAND_CMD_RESET:
+		sn->page = -1;
+		sn->cache_read = false;
+		sn->status = NAND_STATUS_WP | NAND_STATUS_READY |
+			NAND_STATUS_TRUE_READY;
+		sb_nand_set_out(sn, NULL, 0);
+		break;
+	case NAND_CMD_READ0:
+	case NAND_CMD_RNDOUT:
+	case NAND_CMD_RNDIN:
+	case NAND_CMD_ERASE1:
+	case NAND_CMD_READID:
+	case NAND_CMD_PARAM:
+		/* These take an address first */
+		break;
+	default:
+		printf("sandbox_nand: Unsupported command %02x\n", cmd);
+		break;
+	}
+
+	/* Commands which end a sequence keep the one which started it */
+	switch (cmd) {
+	case NAND_CMD_READSTART:
+	case NAND_CMD_RNDOUTSTART:
+	case NAND_CMD_PAGEPROG:
+	case NAND_CMD_CACHEDPROG:
+	case NAND_CMD_ERASE2:
+		break;
+	default:
+		sn->cmd = cmd;
+	}
+	sn->naddr = 0;
+}
+
+/* Act on an address once it is complete, i.e. when data is transferred */
+static void sb_nand_address_done(struct sandbox_nand *sn)
+{
+	static const u8 onfi_sig[] = { 'O', 'N', 'F', 'I' };
+	static u8 id[8] = { SB_NAND_MFR_ID, SB_NAND_DEV_ID, 0x00, 0x15 };
+	int col, row;
+
+	if (!sn->naddr)
+		return;
+
+	switch (sn->cmd) {
+	case NAND_CMD_READID:
+		if (sn->addr[0] == 0x20)
+			sb_nand_set_out(sn, (u8 *)onfi_sig, sizeof(onfi_sig));
+		else
+			sb_nand_set_out(sn, id, sizeof(id));
+		break;
+	case NAND_CMD_PARAM:
+		/* the chip holds three copies; one is enough to emulate */
+		sb_nand_set_out(sn, &sn->param, sizeof(sn->param));
+		break;
+	case NAND_CMD_SEQIN:
+		sb_nand_decode(sn, &col, &row);
+		sn->prog_page = row;
+		sn->col = col;
+		break;
+	case NAND_CMD_RNDIN:
+		sb_nand_decode(sn, &col, &row);
+		sn->col = col;
+		break;
+	}
+	sn->naddr = 0;
+}
+
+static void sb_nand_cmd_ctrl(struct mtd_info *mtd, int dat, unsigned int ctrl)
+{
+	struct sandbox_nand *sn = &sb_nand;
+
+	if (dat == NAND_CMD_NONE)
+		return;
+
+	if (ctrl & NAND_CLE) {
+		sb_nand_command(sn, dat);
+	} else if (ctrl & NAND_ALE) {
+		if (sn->naddr < SB_NAND_MAX_ADDR)
+			sn->addr[sn->naddr++] = dat;
+	}
+}
+
+static uint8_t sb_nand_read_byte(struct mtd_info *mtd)
+{
+	struct sandbox_nand *sn = &sb_nand;
+
+	sb_nand_address_done(sn);
+	if (sn->cmd == NAND_CMD_STATUS)
+		return sn->status;
+	if (sn->out >= sn->out_end)
+		return 0xff;
+
+	return *sn->out++;
+}
+
+static void sb_nand_read_buf(struct mtd_info *mtd, uint8_t *buf, int len)
+{
+	while (len--)
+		*buf++ = sb_nand_read_byte(mtd);
+}
+
+static void sb_nand_write_buf(struct mtd_info *mtd, const uint8_t *buf,
+			      int len)
+{
+	struct sandbox_nand *sn = &sb_nand;
+
+	sb_nand_address_done(sn);
+	if (sn->cmd != NAND_CMD_SEQIN && sn->cmd != NAND_CMD_RNDIN)
+		return;
+	len = min(len, SB_NAND_RAW_SIZE - sn->col);
+	memcpy(sn->cache + sn->col, buf, len);
+	sn->col += len;
+}
+
+static int sb_nand_dev_ready(struct mtd_info *mtd)
+{
+	return timer_get_us() >= sb_nand.busy_until;
+}
+
+/* ONFI CRC-16, polynomial 0x8005, first bit in the MSB */
+static u16 sb_nand_crc16(u16 crc, const u8 *p, int len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^ ((crc & 0x8000) ? 0x8005 : 0);
+	}
+
+	return crc;
+}
+
+static void sb_nand_init_param(struct nand_onfi_params *p)
+{
+	memset(p, '\0', sizeof(*p));
+	memcpy(p->sig, "ONFI", 4);
+	p->revision = cpu_to_le16(1 << 2);		/* ONFI 2.0 */
+	p->opt_cmd = cpu_to_le16(ONFI_OPT_CMD_READ_CACHE);
+	memcpy(p->manufacturer, "SANDBOX     ", sizeof(p->manufacturer));
+	memcpy(p->model, "SANDBOX NAND 32MIB  ", sizeof(p->model));
+	p->jedec_id = SB_NAND_MFR_ID;
+	p->byte_per_page = cpu_to_le32(SB_NAND_PAGE_SIZE);
+	p->spare_bytes_per_page = cpu_to_le16(SB_NAND_OOB_SIZE);
+	p->pages_per_block = cpu_to_le32(SB_NAND_PAGES_PER_BLOCK);
+	p->blocks_per_lun = cpu_to_le32(SB_NAND_BLOCKS);
+	p->lun_count = 1;
+	p->addr_cycles = 0x22;
+	p->bits_per_cell = 1;
+	p->programs_per_page = 4;
+	p->ecc_bits = 1;
+	p->t_r = cpu_to_le16(SB_NAND_T_R);
+	p->crc = cpu_to_le16(sb_nand_crc16(ONFI_CRC_BASE, (u8 *)p, 254));
+}
+
+void sandbox_nand_get_counts(ulong *page_readsp, ulong *cache_readsp)
+{
+	*page_readsp = sb_nand.page_reads;
+	*cache_readsp = sb_nand.cache_reads;
+}
+
+int board_nand_init(struct nand_chip *nand)
+{
+	struct sandbox_nand *sn = &sb_nand;
+	ulong size = (ulong)SB_NAND_PAGES * SB_NAND_RAW_SIZE;
+	int i, page;
+
+	if (!sn->mem) {
+		sn->mem = os_malloc(size);
+		if (!sn->mem)
+			return -ENOMEM;
+		memset(sn->mem, 0xff, size);
+		for (i = 0; i < ARRAY_SIZE(sb_nand_bad_blocks); i++) {
+			page = sb_nand_bad_blocks[i] * SB_NAND_PAGES_PER_BLOCK;
+			sb_nand_page(sn, page)[SB_NAND_PAGE_SIZE] = 0;
+		}
+	}
+	sb_nand_init_param(&sn->param);
+	sb_nand_command(sn, NAND_CMD_RESET);
+
+	nand->cmd_ctrl = sb_nand_cmd_ctrl;
+	nand->dev_ready = sb_nand_dev_ready;
+	nand->read_byte = sb_nand_read_byte;
+	nand->read_buf = sb_nand_read_buf;
+	nand->write_buf = sb_nand_write_buf;
+	nand->chip_delay = 0;
+#ifdef CONFIG_NAND_ECC_BCH
+	/* 8-bit correction per 512 bytes, as MLC chips need */
+	nand->ecc.mode = NAND_ECC_SOFT_BCH;
+	nand->ecc.size = 512;
+	nand->ecc.bytes = 13;
+#else
+	nand->ecc.mode = NAND_ECC_SOFT;
+#endif
+
+	return 0;
+}
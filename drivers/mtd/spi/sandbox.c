@@ -34,12 +34,14 @@ enum sandbox_sf_state {
 	SF_ERASE, /* erase the flash */
 	SF_READ_STATUS, /* read the flash's status register */
 	SF_READ_STATUS1, /* read the flash's status register upper 8 bits*/
+	SF_WRITE_STATUS, /* write the flash's status register */
 };
 
 static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 {
 	static const char * const states[] = {
 		"CMD", "ID", "ADDR", "READ", "WRITE", "ERASE", "READ_STATUS",
+		"READ_STATUS1", "WRITE_STATUS",
 	};
 	return states[state];
 }
@@ -56,7 +58,7 @@ struct sandbox_spi_flash_erase_commands {
 	u32 size;
 };
 #define IDCODE_LEN 5
-#define MAX_ERASE_CMDS 3
+#define MAX_ERASE_CMDS 4
 struct sandbox_spi_flash_data {
 	const char *name;
 	u8 idcode[IDCODE_LEN];
@@ -78,6 +80,7 @@ static const struct sandbox_spi_flash_data sandbox_sf_flashes[] = {
 		"W25Q32", { 0xef, 0x40, 0x16 }, (4 << 20),
 		{	/* erase commands */
 			{ 0x20, (4 << 10), }, /* 4KB */
+			{ 0x52, (32 << 10), }, /* 32KB */
 			{ 0xd8, (64 << 10), }, /* sector */
 			{ 0xc7, (4 << 20), }, /* bulk */
 		},
@@ -86,6 +89,7 @@ static const struct sandbox_spi_flash_data sandbox_sf_flashes[] = {
 		"W25Q128", { 0xef, 0x40, 0x18 }, (16 << 20),
 		{	/* erase commands */
 			{ 0x20, (4 << 10), }, /* 4KB */
+			{ 0x52, (32 << 10), }, /* 32KB */
 			{ 0xd8, (64 << 10), }, /* sector */
 			{ 0xc7, (16 << 20), }, /* bulk */
 		},
@@ -204,6 +208,22 @@ static void sandbox_sf_cs_deactivate(void *priv)
 	debug("sandbox_sf: CS deactivated; cmd done processing!\n");
 }
 
+int sandbox_erase_part(struct sandbox_spi_flash *sbsf, int size)
+{
+	int todo;
+	int ret;
+
+	while (size > 0) {
+		todo = min(size, sizeof(sandbox_sf_0xff));
+		ret = os_write(sbsf->fd, sandbox_sf_0xff, todo);
+		if (ret != todo)
+			return ret;
+		size -= todo;
+	}
+
+	return 0;
+}
+
 /* Figure out what command this stream is telling us to do */
 static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 				  u8 *tx)
@@ -219,7 +239,13 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		sbsf->state = SF_ID;
 		sbsf->cmd = SF_ID;
 		break;
+	case CMD_READ_QUAD_IO_FAST:
+		sbsf->pad_addr_bytes = 2;
+		goto state_addr;
 	case CMD_READ_ARRAY_FAST:
+	case CMD_READ_DUAL_OUTPUT_FAST:
+	case CMD_READ_DUAL_IO_FAST:
+	case CMD_READ_QUAD_OUTPUT_FAST:
 		sbsf->pad_addr_bytes = 1;
 	case CMD_READ_ARRAY_SLOW:
 	case CMD_PAGE_PROGRAM:
@@ -236,6 +262,9 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 	case CMD_READ_STATUS1:
 		sbsf->state = SF_READ_STATUS1;
 		break;
+	case CMD_WRITE_STATUS:
+		sbsf->state = SF_WRITE_STATUS;
+		break;
 	case CMD_WRITE_ENABLE:
 		debug(" write enabled\n");
 		sbsf->status |= STAT_WEL;
@@ -254,7 +283,22 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 				continue;
 
 			sbsf->cmd_data = erase_cmd;
-			goto state_addr;
+			if (erase_cmd->size != sbsf->data->size)
+				goto state_addr;
+
+			/* a bulk erase has no address, so do it now */
+			if (!(sbsf->status & STAT_WEL)) {
+				puts("sandbox_sf: write enable not set before erase\n");
+				return 1;
+			}
+			debug(" bulk erase\n");
+			sbsf->status &= ~STAT_WEL;
+			if (os_lseek(sbsf->fd, 0, OS_SEEK_SET) < 0 ||
+			    sandbox_erase_part(sbsf, erase_cmd->size)) {
+				debug("sandbox_sf: Erase failed\n");
+				return 1;
+			}
+			break;
 		}
 
 		debug(" cmd unknown: %#x\n", sbsf->cmd);
@@ -269,22 +313,6 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 	return 0;
 }
 
-int sandbox_erase_part(struct sandbox_spi_flash *sbsf, int size)
-{
-	int todo;
-	int ret;
-
-	while (size > 0) {
-		todo = min(size, sizeof(sandbox_sf_0xff));
-		ret = os_write(sbsf->fd, sandbox_sf_0xff, todo);
-		if (ret != todo)
-			return ret;
-		size -= todo;
-	}
-
-	return 0;
-}
-
 static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 		uint bytes)
 {
@@ -341,6 +369,10 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 			switch (sbsf->cmd) {
 			case CMD_READ_ARRAY_FAST:
 			case CMD_READ_ARRAY_SLOW:
+			case CMD_READ_DUAL_OUTPUT_FAST:
+			case CMD_READ_DUAL_IO_FAST:
+			case CMD_READ_QUAD_OUTPUT_FAST:
+			case CMD_READ_QUAD_IO_FAST:
 				sbsf->state = SF_READ;
 				break;
 			case CMD_PAGE_PROGRAM:
@@ -381,6 +413,23 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 			memset(tx + pos, sbsf->status >> 8, cnt);
 			pos += cnt;
 			break;
+		case SF_WRITE_STATUS:
+			/* the status register, then optionally its upper half */
+			debug(" write status: %#x\n", rx[pos]);
+			if (sbsf->off == 0) {
+				if (!(sbsf->status & STAT_WEL)) {
+					puts("sandbox_sf: write enable not set before status write\n");
+					goto done;
+				}
+				sbsf->status = (sbsf->status & 0xff00) |
+					(rx[pos] & ~(STAT_WIP | STAT_WEL));
+			} else if (sbsf->off == 1) {
+				sbsf->status = (sbsf->status & 0xff) |
+					rx[pos] << 8;
+			}
+			++sbsf->off;
+			sandbox_spi_tristate(&tx[pos++], 1);
+			break;
 		case SF_WRITE:
 			/*
 			 * XXX: need to handle exotic behavior:
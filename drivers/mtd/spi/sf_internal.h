@@ -68,6 +68,9 @@
 #define SPI_FLASH_PROG_TIMEOUT		(2 * CONFIG_SYS_HZ)
 #define SPI_FLASH_PAGE_ERASE_TIMEOUT	(5 * CONFIG_SYS_HZ)
 #define SPI_FLASH_SECTOR_ERASE_TIMEOUT	(10 * CONFIG_SYS_HZ)
+/* Large parts take up to several seconds per MiB to erase completely */
+#define SPI_FLASH_CHIP_ERASE_TIMEOUT(size)	\
+	(SPI_FLASH_SECTOR_ERASE_TIMEOUT + ((size) >> 20) * 8 * CONFIG_SYS_HZ)
 
 /* SST specific */
 #ifdef CONFIG_SPI_FLASH_SST
@@ -156,6 +159,17 @@ int spi_flash_cmd_write_ops(struct spi_flash *flash, u32 offset,
 int spi_flash_read_common(struct spi_flash *flash, const u8 *cmd,
 		size_t cmd_len, void *data, size_t data_len);
 
+/*
+ * Choose the erase command for the next part of the range offset..len,
+ * returning its size and setting *cmd
+ */
+u32 spi_flash_erase_step(struct spi_flash *flash, u32 offset,
+		size_t len, u8 *cmd);
+
+/* Describe a read with the command chosen at probe time, at addr */
+void spi_flash_read_op(struct spi_flash *flash, u32 addr,
+		struct spi_read_op *op);
+
 /* Flash read operation, support all possible read commands */
 int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		size_t len, void *data);
@@ -211,7 +211,9 @@ int spi_flash_write_common(struct spi_flash *flash, const u8 *cmd,
 	unsigned long timeout = SPI_FLASH_PROG_TIMEOUT;
 	int ret;
 
-	if (buf == NULL)
+	if (buf == NULL && cmd[0] == CMD_ERASE_CHIP)
+		timeout = SPI_FLASH_CHIP_ERASE_TIMEOUT(flash->size);
+	else if (buf == NULL)
 		timeout = SPI_FLASH_PAGE_ERASE_TIMEOUT;
 
 	ret = spi_claim_bus(flash->spi);
@@ -245,6 +247,43 @@ int spi_flash_write_common(struct spi_flash *flash, const u8 *cmd,
 	return ret;
 }
 
+/*
+ * Each erase command erases its size in not much more time than a 4K
+ * sector erase takes, so the largest one which is aligned and fits is
+ * always the quickest.
+ */
+u32 spi_flash_erase_step(struct spi_flash *flash, u32 offset,
+		size_t len, u8 *cmd)
+{
+	u32 size;
+
+	/*
+	 * Dual stacked flashes would need a chip erase for each, and some
+	 * controllers only send the commands they know
+	 */
+	if (!offset && len == flash->size &&
+	    !(flash->dual_flash & SF_DUAL_STACKED_FLASH) &&
+	    !(flash->spi->op_mode_tx & SPI_OPM_TX_NO_CHIP_ERASE)) {
+		*cmd = CMD_ERASE_CHIP;
+		return len;
+	}
+
+	size = flash->sector_size;
+	if (!(offset % size) && len >= size) {
+		*cmd = CMD_ERASE_64K;
+		return size;
+	}
+
+	size = 32768 << flash->shift;
+	if (flash->erase_flags & SECT_32K && !(offset % size) && len >= size) {
+		*cmd = CMD_ERASE_32K;
+		return size;
+	}
+
+	*cmd = flash->erase_cmd;
+	return flash->erase_size;
+}
+
 int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 {
 	u32 erase_size, erase_addr;
@@ -257,8 +296,15 @@ int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 		return -1;
 	}
 
-	cmd[0] = flash->erase_cmd;
 	while (len) {
+		erase_size = spi_flash_erase_step(flash, offset, len, cmd);
+		if (cmd[0] == CMD_ERASE_CHIP) {
+			debug("SF: chip erase\n");
+			ret = spi_flash_write_common(flash, cmd, 1, NULL, 0);
+			if (ret < 0)
+				debug("SF: erase failed\n");
+			break;
+		}
 		erase_addr = offset;
 
 #ifdef CONFIG_SF_DUAL_FLASH
@@ -359,6 +405,63 @@ int spi_flash_read_common(struct spi_flash *flash, const u8 *cmd,
 	return ret;
 }
 
+void spi_flash_read_op(struct spi_flash *flash, u32 addr,
+		struct spi_read_op *op)
+{
+	op->cmd = flash->read_cmd;
+	op->addr = addr;
+	op->addr_len = SPI_FLASH_CMD_LEN - 1;
+	op->dummy_len = flash->dummy_byte;
+	op->addr_lines = flash->addr_lines;
+	op->data_lines = flash->data_lines;
+}
+
+/* Hand a whole read to a controller which can do it without spi_xfer() */
+static int spi_flash_read_bulk(struct spi_flash *flash, u32 addr,
+		void *data, size_t len)
+{
+	struct spi_slave *spi = flash->spi;
+	struct spi_read_op op;
+	int ret;
+
+	spi_flash_read_op(flash, addr, &op);
+
+	ret = spi_claim_bus(spi);
+	if (ret) {
+		debug("SF: unable to claim SPI bus\n");
+		return ret;
+	}
+
+	ret = spi_read_bulk(spi, &op, data, len);
+	if (ret < 0)
+		debug("SF: bulk read failed\n");
+
+	spi_release_bus(spi);
+
+	return ret;
+}
+
+void *spi_flash_mmap(struct spi_flash *flash, u32 offset, size_t len)
+{
+	if (!flash->memory_map || offset > flash->size ||
+	    len > flash->size - offset)
+		return NULL;
+
+	if (spi_claim_bus(flash->spi)) {
+		debug("SF: unable to claim SPI bus\n");
+		return NULL;
+	}
+	spi_xfer(flash->spi, 0, NULL, NULL, SPI_XFER_MMAP);
+
+	return flash->memory_map + offset;
+}
+
+void spi_flash_munmap(struct spi_flash *flash)
+{
+	spi_xfer(flash->spi, 0, NULL, NULL, SPI_XFER_MMAP_END);
+	spi_release_bus(flash->spi);
+}
+
 int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		size_t len, void *data)
 {
@@ -369,15 +472,12 @@ int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 
 	/* Handle memory-mapped SPI */
 	if (flash->memory_map) {
-		ret = spi_claim_bus(flash->spi);
-		if (ret) {
-			debug("SF: unable to claim SPI bus\n");
-			return ret;
-		}
-		spi_xfer(flash->spi, 0, NULL, NULL, SPI_XFER_MMAP);
-		memcpy(data, flash->memory_map + offset, len);
-		spi_xfer(flash->spi, 0, NULL, NULL, SPI_XFER_MMAP_END);
-		spi_release_bus(flash->spi);
+		void *src = spi_flash_mmap(flash, offset, len);
+
+		if (!src)
+			return -EINVAL;
+		memcpy(data, src, len);
+		spi_flash_munmap(flash);
 		return 0;
 	}
 
@@ -408,9 +508,16 @@ int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		else
 			read_len = remain_len;
 
-		spi_flash_addr(read_addr, cmd);
-
-		ret = spi_flash_read_common(flash, cmd, cmdsz, data, read_len);
+		ret = -ENOSYS;
+		if (flash->spi->op_mode_rx & SPI_OPM_RX_BULK)
+			ret = spi_flash_read_bulk(flash, read_addr, data,
+						  read_len);
+		/* fall back to spi_xfer() if the controller cannot do it */
+		if (ret == -ENOSYS) {
+			spi_flash_addr(read_addr, cmd);
+			ret = spi_flash_read_common(flash, cmd, cmdsz, data,
+						    read_len);
+		}
 		if (ret < 0) {
 			debug("SF: read failed\n");
 			break;
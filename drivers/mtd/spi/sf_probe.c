@@ -19,13 +19,26 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
-/* Read commands array */
-static u8 spi_read_cmds_array[] = {
-	CMD_READ_ARRAY_SLOW,
-	CMD_READ_DUAL_OUTPUT_FAST,
-	CMD_READ_DUAL_IO_FAST,
-	CMD_READ_QUAD_OUTPUT_FAST,
-	CMD_READ_QUAD_IO_FAST,
+/*
+ * Read commands array, in the order of enum spi_read_cmds. The dummy bytes
+ * are determined based on the dummy cycles of a particular command.
+ * Fast commands - dummy_byte = dummy_cycles/8
+ * I/O commands- dummy_byte = (dummy_cycles * no.of lines)/8
+ * For I/O commands except cmd[0] everything goes on no.of lines
+ * based on particular command but incase of fast commands except
+ * data all go on single line irrespective of command.
+ */
+static const struct {
+	u8 cmd;
+	u8 dummy_byte;
+	u8 addr_lines;
+	u8 data_lines;
+} spi_read_cmds_array[] = {
+	{ CMD_READ_ARRAY_SLOW,		0, 1, 1 },
+	{ CMD_READ_DUAL_OUTPUT_FAST,	1, 1, 2 },
+	{ CMD_READ_DUAL_IO_FAST,	1, 2, 2 },
+	{ CMD_READ_QUAD_OUTPUT_FAST,	1, 1, 4 },
+	{ CMD_READ_QUAD_IO_FAST,	2, 4, 4 },
 };
 
 #ifdef CONFIG_SPI_FLASH_MACRONIX
@@ -169,6 +182,7 @@ static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 #endif
 
 	/* Compute erase sector and command */
+	flash->erase_flags = params->flags & (SECT_4K | SECT_32K);
 	if (params->flags & SECT_4K) {
 		flash->erase_cmd = CMD_ERASE_4K;
 		flash->erase_size = 4096 << flash->shift;
@@ -180,14 +194,22 @@ static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 		flash->erase_size = flash->sector_size;
 	}
 
-	/* Look for the fastest read cmd */
+	/*
+	 * Look for the fastest read cmd which both the flash and the
+	 * controller support
+	 */
 	cmd = fls(params->e_rd_cmd & flash->spi->op_mode_rx);
 	if (cmd) {
-		cmd = spi_read_cmds_array[cmd - 1];
-		flash->read_cmd = cmd;
+		flash->read_cmd = spi_read_cmds_array[cmd - 1].cmd;
+		flash->dummy_byte = spi_read_cmds_array[cmd - 1].dummy_byte;
+		flash->addr_lines = spi_read_cmds_array[cmd - 1].addr_lines;
+		flash->data_lines = spi_read_cmds_array[cmd - 1].data_lines;
 	} else {
 		/* Go for default supported read cmd */
 		flash->read_cmd = CMD_READ_ARRAY_FAST;
+		flash->dummy_byte = 1;
+		flash->addr_lines = 1;
+		flash->data_lines = 1;
 	}
 
 	/* Not require to look for fastest only two write cmds yet */
@@ -197,25 +219,6 @@ static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 		/* Go for default supported write cmd */
 		flash->write_cmd = CMD_PAGE_PROGRAM;
 
-	/* Read dummy_byte: dummy byte is determined based on the
-	 * dummy cycles of a particular command.
-	 * Fast commands - dummy_byte = dummy_cycles/8
-	 * I/O commands- dummy_byte = (dummy_cycles * no.of lines)/8
-	 * For I/O commands except cmd[0] everything goes on no.of lines
-	 * based on particular command but incase of fast commands except
-	 * data all go on single line irrespective of command.
-	 */
-	switch (flash->read_cmd) {
-	case CMD_READ_QUAD_IO_FAST:
-		flash->dummy_byte = 2;
-		break;
-	case CMD_READ_ARRAY_SLOW:
-		flash->dummy_byte = 0;
-		break;
-	default:
-		flash->dummy_byte = 1;
-	}
-
 	/* Poll cmd selection */
 	flash->poll_cmd = CMD_READ_STATUS;
 #ifdef CONFIG_SPI_FLASH_STMICRO
@@ -345,22 +348,22 @@ static struct spi_flash *spi_flash_probe_slave(struct spi_slave *spi)
 	if (!flash)
 		goto err_read_id;
 
-	/* Set the quad enable bit - only for quad commands */
-	if ((flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST) ||
-	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST) ||
-	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)) {
-		if (spi_flash_set_qeb(flash, idcode[0])) {
-			debug("SF: Fail to set QEB for %02x\n", idcode[0]);
-			return NULL;
-		}
-	}
-
 #ifdef CONFIG_OF_CONTROL
 	if (spi_flash_decode_fdt(gd->fdt_blob, flash)) {
 		debug("SF: FDT decode error\n");
 		goto err_read_id;
 	}
 #endif
+	/* Make the memory-mapped window use the read command chosen above */
+	if (flash->memory_map) {
+		struct spi_read_op op;
+
+		spi_flash_read_op(flash, 0, &op);
+		if (spi_mmap_config(spi, &op)) {
+			debug("SF: Failed to set up memory-mapped reads\n");
+			flash->memory_map = NULL;
+		}
+	}
 #ifndef CONFIG_SPL_BUILD
 	printf("SF: Detected %s with page size ", flash->name);
 	print_size(flash->page_size, ", erase size ");
@@ -385,6 +388,20 @@ static struct spi_flash *spi_flash_probe_slave(struct spi_slave *spi)
 	/* Release spi bus */
 	spi_release_bus(spi);
 
+	/*
+	 * Set the quad enable bit - only for quad commands. This claims the
+	 * bus itself, like the other register accesses.
+	 */
+	if ((flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST) ||
+	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST) ||
+	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)) {
+		if (spi_flash_set_qeb(flash, idcode[0])) {
+			debug("SF: Fail to set QEB for %02x\n", idcode[0]);
+			free(flash);
+			goto err_claim_bus;
+		}
+	}
+
 	return flash;
 
 err_read_id:
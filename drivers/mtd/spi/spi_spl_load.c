@@ -42,10 +42,40 @@ static int spi_load_image_os(struct spi_flash *flash,
 }
 #endif
 
+/*
+ * Load an image which starts with a mkimage header (or U-Boot without one).
+ * If the flash is memory-mapped and the image was built to run from its
+ * place in the window, nothing is copied: the window is left enabled and
+ * the image runs in place.
+ */
+static void spi_load_image(struct spi_flash *flash, u32 offs,
+			   struct image_header *header)
+{
+	struct image_header *mapped;
+
+	mapped = spi_flash_mmap(flash, offs, sizeof(*mapped));
+	if (mapped) {
+		spl_parse_image_header(mapped);
+		if (spl_image.load_addr == (ulong)mapped &&
+		    offs + spl_image.size <= flash->size) {
+			debug("SPI: executing in place at %p\n", mapped);
+			return;
+		}
+		spi_flash_munmap(flash);
+	} else {
+		/* Load u-boot, mkimage header is 64 bytes. */
+		spi_flash_read(flash, offs, 0x40, (void *)header);
+		spl_parse_image_header(header);
+	}
+	spi_flash_read(flash, offs, spl_image.size,
+		       (void *)spl_image.load_addr);
+}
+
 /*
  * The main entry for SPI booting. It's necessary that SDRAM is already
  * configured and available since this code loads the main U-Boot image
- * from SPI into SDRAM and starts it from there.
+ * from SPI into SDRAM and starts it from there, unless it can run in place
+ * from a memory-mapped flash.
  */
 void spl_spi_load_image(void)
 {
@@ -69,12 +99,5 @@ void spl_spi_load_image(void)
 #ifdef CONFIG_SPL_OS_BOOT
 	if (spl_start_uboot() || spi_load_image_os(flash, header))
 #endif
-	{
-		/* Load u-boot, mkimage header is 64 bytes. */
-		spi_flash_read(flash, CONFIG_SYS_SPI_U_BOOT_OFFS, 0x40,
-			       (void *)header);
-		spl_parse_image_header(header);
-		spi_flash_read(flash, CONFIG_SYS_SPI_U_BOOT_OFFS,
-			       spl_image.size, (void *)spl_image.load_addr);
-	}
+		spi_load_image(flash, CONFIG_SYS_SPI_U_BOOT_OFFS, header);
 }
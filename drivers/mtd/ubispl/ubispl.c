@@ -0,0 +1,403 @@
+/*
+ * Minimal read-only UBI attach for SPL
+ *
+ * Only the LEBs of the volumes being loaded are tracked. With a valid
+ * fastmap, the VID headers read are those in the fastmap search area, the
+ * fastmap's own blocks, the LEBs of those volumes and the fastmap pools;
+ * otherwise every PEB's VID header is read. EC headers are not read at all.
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <ubispl.h>
+#include <u-boot/crc.h>
+#include "../ubi/ubi-media.h"
+
+static u32 ubispl_crc(const void *buf, int len)
+{
+	return crc32_no_comp(UBI_CRC32_INIT, buf, len);
+}
+
+static int ubispl_leb_size(struct ubispl_info *info)
+{
+	return info->peb_size - info->leb_start;
+}
+
+static struct ubispl_vol *ubispl_find_vol(struct ubispl_info *info,
+					  int vol_id)
+{
+	struct ubispl_scan *scan = info->scan;
+	int i;
+
+	for (i = 0; i < scan->nvols; i++) {
+		if (scan->vols[i].vol_id == vol_id)
+			return &scan->vols[i];
+	}
+
+	return NULL;
+}
+
+/* Read and check a VID header, returning -ENOENT if the PEB has none */
+static int ubispl_read_vid(struct ubispl_info *info, int pnum,
+			   struct ubi_vid_hdr *vh)
+{
+	int ret;
+
+	info->hdr_reads++;
+	ret = info->read(pnum, info->vid_offset, sizeof(*vh), vh);
+	if (ret)
+		return ret;
+	if (be32_to_cpu(vh->magic) != UBI_VID_HDR_MAGIC)
+		return -ENOENT;
+	if (be32_to_cpu(vh->hdr_crc) != ubispl_crc(vh, UBI_VID_HDR_SIZE_CRC)) {
+		debug("%s: bad VID header CRC in PEB %d\n", __func__, pnum);
+		return -EBADMSG;
+	}
+	if (vh->version != UBI_VERSION)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Check the data of a LEB copied by wear-levelling, which may be partial */
+static bool ubispl_copy_ok(struct ubispl_info *info, struct ubispl_leb *leb)
+{
+	u8 *buf = info->scan->crc_buf;
+	u32 crc = UBI_CRC32_INIT;
+	int offset, len, max = sizeof(info->scan->crc_buf);
+
+	if (!leb->copy_flag)
+		return true;
+	if (leb->data_size > ubispl_leb_size(info))
+		return false;
+	for (offset = 0; offset < leb->data_size; offset += len) {
+		len = min(leb->data_size - offset, max);
+		if (info->read(leb->pnum, info->leb_start + offset, len, buf))
+			return false;
+		crc = crc32_no_comp(crc, buf, len);
+	}
+	if (crc != leb->data_crc)
+		return false;
+	leb->copy_flag = false;
+
+	return true;
+}
+
+/*
+ * Note a PEB holding a LEB of a volume being loaded. If there is already
+ * another copy of the LEB, the newer one is used, unless it is a copy which
+ * was never completed.
+ */
+static void ubispl_add_leb(struct ubispl_info *info, int pnum,
+			   struct ubi_vid_hdr *vh)
+{
+	struct ubispl_vol *vol;
+	struct ubispl_leb new, *leb;
+	int lnum = be32_to_cpu(vh->lnum);
+
+	vol = ubispl_find_vol(info, be32_to_cpu(vh->vol_id));
+	if (!vol || lnum < 0 || lnum >= CONFIG_SPL_UBI_MAX_VOL_LEBS)
+		return;
+
+	new.pnum = pnum;
+	new.data_size = be32_to_cpu(vh->data_size);
+	new.data_crc = be32_to_cpu(vh->data_crc);
+	new.copy_flag = vh->copy_flag;
+	new.sqnum = be64_to_cpu(vh->sqnum);
+
+	leb = &vol->lebs[lnum];
+	if (leb->pnum == pnum)
+		return;
+	if (leb->pnum >= 0) {
+		if (leb->sqnum > new.sqnum) {
+			if (ubispl_copy_ok(info, leb))
+				return;
+		} else if (!ubispl_copy_ok(info, &new)) {
+			return;
+		}
+	}
+	*leb = new;
+
+	vol->vol_type = vh->vol_type;
+	vol->data_pad = be32_to_cpu(vh->data_pad);
+	if (vh->vol_type == UBI_VID_STATIC)
+		vol->used_ebs = be32_to_cpu(vh->used_ebs);
+	if (lnum > vol->last_lnum)
+		vol->last_lnum = lnum;
+}
+
+/*
+ * Read the VID headers of a range of PEBs, returning the fastmap anchor with
+ * the highest sequence number among them, or -1 if there is none
+ */
+static int ubispl_scan_pebs(struct ubispl_info *info, int first, int last)
+{
+	unsigned long long sqnum, anchor_sqnum = 0;
+	struct ubi_vid_hdr vh;
+	int pnum, anchor = -1;
+
+	for (pnum = first; pnum < last; pnum++) {
+		if (ubispl_read_vid(info, pnum, &vh))
+			continue;
+		sqnum = be64_to_cpu(vh.sqnum);
+		if (be32_to_cpu(vh.vol_id) == UBI_FM_SB_VOLUME_ID) {
+			if (anchor < 0 || sqnum > anchor_sqnum) {
+				anchor = pnum;
+				anchor_sqnum = sqnum;
+			}
+			continue;
+		}
+		ubispl_add_leb(info, pnum, &vh);
+	}
+
+	return anchor;
+}
+
+/* Add the LEBs written since the fastmap, which are in its pools */
+static void ubispl_scan_pool(struct ubispl_info *info,
+			     struct ubi_fm_scan_pool *pool)
+{
+	struct ubi_vid_hdr vh;
+	int i, pnum;
+
+	for (i = 0; i < be16_to_cpu(pool->size); i++) {
+		pnum = be32_to_cpu(pool->pebs[i]);
+		if (pnum >= 0 && pnum < info->peb_count &&
+		    !ubispl_read_vid(info, pnum, &vh))
+			ubispl_add_leb(info, pnum, &vh);
+	}
+}
+
+/* Read all the fastmap blocks into fm_buf, returning the fastmap size */
+static int ubispl_read_fastmap(struct ubispl_info *info, int anchor)
+{
+	u8 *buf = info->scan->fm_buf;
+	int leb_size = ubispl_leb_size(info);
+	struct ubi_fm_sb *fmsb = (struct ubi_fm_sb *)buf;
+	struct ubi_vid_hdr vh;
+	int i, pnum, used_blocks, fm_size;
+	u32 crc;
+
+	if (info->read(anchor, info->leb_start, sizeof(*fmsb), fmsb))
+		return -EIO;
+	if (be32_to_cpu(fmsb->magic) != UBI_FM_SB_MAGIC ||
+	    fmsb->version != UBI_FM_FMT_VERSION)
+		return -EINVAL;
+	used_blocks = be32_to_cpu(fmsb->used_blocks);
+	if (used_blocks < 1 || used_blocks > UBI_FM_MAX_BLOCKS)
+		return -EINVAL;
+	fm_size = used_blocks * leb_size;
+	if (fm_size > CONFIG_SPL_UBI_MAX_FM_SIZE) {
+		debug("%s: fastmap of %d bytes is too large\n", __func__,
+		      fm_size);
+		return -EFBIG;
+	}
+
+	if (be32_to_cpu(fmsb->block_loc[0]) != anchor)
+		return -EINVAL;
+
+	/* The block list is overwritten as the blocks are read in */
+	for (i = used_blocks - 1; i >= 0; i--) {
+		pnum = be32_to_cpu(fmsb->block_loc[i]);
+		if (pnum < 0 || pnum >= info->peb_count)
+			return -EINVAL;
+		if (i && (ubispl_read_vid(info, pnum, &vh) ||
+			  be32_to_cpu(vh.vol_id) != UBI_FM_DATA_VOLUME_ID))
+			return -EINVAL;
+		if (info->read(pnum, info->leb_start, leb_size,
+			       buf + i * leb_size))
+			return -EIO;
+	}
+
+	crc = be32_to_cpu(fmsb->data_crc);
+	fmsb->data_crc = 0;
+	if (ubispl_crc(buf, fm_size) != crc) {
+		debug("%s: bad fastmap CRC\n", __func__);
+		return -EBADMSG;
+	}
+
+	return fm_size;
+}
+
+/* Find the volumes being loaded in the fastmap */
+static int ubispl_attach_fastmap(struct ubispl_info *info, int anchor)
+{
+	u8 *buf = info->scan->fm_buf;
+	struct ubi_fm_scan_pool *pool1, *pool2;
+	struct ubi_fm_volhdr *fmvhdr;
+	struct ubi_fm_hdr *fmhdr;
+	struct ubi_fm_eba *fm_eba;
+	struct ubispl_vol *vol;
+	struct ubi_vid_hdr vh;
+	int fm_size, fm_pos, i, j, pnum, count;
+
+	fm_size = ubispl_read_fastmap(info, anchor);
+	if (fm_size < 0)
+		return fm_size;
+
+	fm_pos = sizeof(struct ubi_fm_sb);
+	fmhdr = (struct ubi_fm_hdr *)(buf + fm_pos);
+	fm_pos += sizeof(*fmhdr);
+	pool1 = (struct ubi_fm_scan_pool *)(buf + fm_pos);
+	fm_pos += sizeof(*pool1);
+	pool2 = (struct ubi_fm_scan_pool *)(buf + fm_pos);
+	fm_pos += sizeof(*pool2);
+	if (fm_pos >= fm_size ||
+	    be32_to_cpu(fmhdr->magic) != UBI_FM_HDR_MAGIC ||
+	    be32_to_cpu(pool1->magic) != UBI_FM_POOL_MAGIC ||
+	    be32_to_cpu(pool2->magic) != UBI_FM_POOL_MAGIC ||
+	    be16_to_cpu(pool1->size) > UBI_FM_MAX_POOL_SIZE ||
+	    be16_to_cpu(pool2->size) > UBI_FM_MAX_POOL_SIZE)
+		return -EINVAL;
+
+	/* Erase counters are of no interest here */
+	count = be32_to_cpu(fmhdr->free_peb_count) +
+		be32_to_cpu(fmhdr->used_peb_count) +
+		be32_to_cpu(fmhdr->scrub_peb_count) +
+		be32_to_cpu(fmhdr->erase_peb_count);
+	if (count > info->peb_count)
+		return -EINVAL;
+	fm_pos += count * sizeof(struct ubi_fm_ec);
+
+	for (i = 0; i < be32_to_cpu(fmhdr->vol_count); i++) {
+		fmvhdr = (struct ubi_fm_volhdr *)(buf + fm_pos);
+		fm_pos += sizeof(*fmvhdr);
+		fm_eba = (struct ubi_fm_eba *)(buf + fm_pos);
+		fm_pos += sizeof(*fm_eba);
+		if (fm_pos >= fm_size ||
+		    be32_to_cpu(fmvhdr->magic) != UBI_FM_VHDR_MAGIC ||
+		    be32_to_cpu(fm_eba->magic) != UBI_FM_EBA_MAGIC)
+			return -EINVAL;
+		count = be32_to_cpu(fm_eba->reserved_pebs);
+		if (count > info->peb_count)
+			return -EINVAL;
+		fm_pos += count * sizeof(__be32);
+		if (fm_pos > fm_size)
+			return -EINVAL;
+
+		vol = ubispl_find_vol(info, be32_to_cpu(fmvhdr->vol_id));
+		if (!vol)
+			continue;
+		vol->vol_type = fmvhdr->vol_type;
+		vol->data_pad = be32_to_cpu(fmvhdr->data_pad);
+		if (vol->vol_type == UBI_VID_STATIC)
+			vol->used_ebs = be32_to_cpu(fmvhdr->used_ebs);
+
+		/* Check each LEB's header, which also gives its data size */
+		for (j = 0; j < count && j < CONFIG_SPL_UBI_MAX_VOL_LEBS; j++) {
+			pnum = be32_to_cpu(fm_eba->pnum[j]);
+			if (pnum < 0)
+				continue;
+			if (pnum >= info->peb_count ||
+			    ubispl_read_vid(info, pnum, &vh) ||
+			    be32_to_cpu(vh.vol_id) != vol->vol_id ||
+			    be32_to_cpu(vh.lnum) != j) {
+				debug("%s: fastmap is out of date at PEB %d\n",
+				      __func__, pnum);
+				return -EINVAL;
+			}
+			ubispl_add_leb(info, pnum, &vh);
+		}
+	}
+
+	ubispl_scan_pool(info, pool1);
+	ubispl_scan_pool(info, pool2);
+
+	return 0;
+}
+
+static int ubispl_load_vol(struct ubispl_info *info, struct ubispl_vol *vol,
+			   struct ubispl_load *lvol)
+{
+	int leb_size = ubispl_leb_size(info) - vol->data_pad;
+	struct ubispl_leb *leb;
+	u8 *dst = lvol->load_addr;
+	int lnum, count, len;
+
+	if (!vol->vol_type)
+		return -ENOENT;
+	if (vol->vol_type == UBI_VID_STATIC)
+		count = vol->used_ebs;
+	else
+		count = vol->last_lnum + 1;
+	if (count > CONFIG_SPL_UBI_MAX_VOL_LEBS)
+		return -EFBIG;
+
+	for (lnum = 0; lnum < count; lnum++) {
+		leb = &vol->lebs[lnum];
+		if (vol->vol_type == UBI_VID_STATIC) {
+			if (leb->pnum < 0) {
+				printf("UBI: volume %d LEB %d is missing\n",
+				       vol->vol_id, lnum);
+				return -ENOENT;
+			}
+			len = leb->data_size;
+			if (len > leb_size)
+				return -EINVAL;
+		} else {
+			len = leb_size;
+		}
+
+		if (leb->pnum < 0)
+			memset(dst, 0xff, len);
+		else if (info->read(leb->pnum, info->leb_start, len, dst))
+			return -EIO;
+		dst += len;
+	}
+	lvol->size = dst - (u8 *)lvol->load_addr;
+
+	return 0;
+}
+
+int ubispl_load_volumes(struct ubispl_info *info, struct ubispl_load *lvols,
+			int nrvols)
+{
+	struct ubispl_scan *scan = info->scan;
+	struct ubispl_vol *vol;
+	int i, j, ret, first = 0, anchor;
+
+	if (nrvols > UBISPL_MAX_VOLS ||
+	    info->vid_offset + UBI_VID_HDR_SIZE > info->leb_start ||
+	    info->leb_start >= info->peb_size)
+		return -EINVAL;
+
+	scan->nvols = nrvols;
+	for (i = 0; i < nrvols; i++) {
+		vol = &scan->vols[i];
+		vol->vol_id = lvols[i].vol_id;
+		vol->vol_type = 0;
+		vol->used_ebs = 0;
+		vol->data_pad = 0;
+		vol->last_lnum = -1;
+		for (j = 0; j < CONFIG_SPL_UBI_MAX_VOL_LEBS; j++)
+			vol->lebs[j].pnum = -1;
+	}
+	info->fastmap_used = false;
+	info->hdr_reads = 0;
+
+	if (info->fastmap) {
+		first = min(UBI_FM_MAX_START, info->peb_count);
+		anchor = ubispl_scan_pebs(info, 0, first);
+		if (anchor >= 0 && !ubispl_attach_fastmap(info, anchor))
+			info->fastmap_used = true;
+		else
+			debug("UBI: no usable fastmap, scanning\n");
+	}
+	if (!info->fastmap_used)
+		ubispl_scan_pebs(info, first, info->peb_count);
+
+	for (i = 0; i < nrvols; i++) {
+		ret = ubispl_load_vol(info, &scan->vols[i], &lvols[i]);
+		if (ret) {
+			printf("UBI: cannot load volume %d: %d\n",
+			       lvols[i].vol_id, ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
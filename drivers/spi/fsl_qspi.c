@@ -28,6 +28,7 @@
 #define SEQID_CHIP_ERASE	5
 #define SEQID_PP		6
 #define SEQID_RDID		7
+#define SEQID_BULK_READ		8
 
 /* Flash opcodes */
 #define OPCODE_PP		0x02	/* Page program (up to 256 bytes) */
@@ -176,6 +177,50 @@ static void qspi_set_lut(struct fsl_qspi *qspi)
 	qspi_write32(&regs->lckcr, QSPI_LCKCR_LOCK);
 }
 
+static u32 qspi_lut_pad(u8 lines)
+{
+	switch (lines) {
+	case 4:
+		return LUT_PAD4;
+	case 2:
+		return LUT_PAD2;
+	default:
+		return LUT_PAD1;
+	}
+}
+
+/* Set up SEQID_BULK_READ for the read command chosen by the flash layer */
+static void qspi_set_lut_bulk_read(struct fsl_qspi *qspi,
+				   const struct spi_read_op *op)
+{
+	struct fsl_qspi_regs *regs = (struct fsl_qspi_regs *)qspi->reg_base;
+	u32 lut_base = SEQID_BULK_READ * 4;
+	u32 addr_pad = qspi_lut_pad(op->addr_lines);
+	u32 data_pad = qspi_lut_pad(op->data_lines);
+	u32 dummy_cycles = op->dummy_len * 8 / op->addr_lines;
+
+	qspi_write32(&regs->lutkey, LUT_KEY_VALUE);
+	qspi_write32(&regs->lckcr, QSPI_LCKCR_UNLOCK);
+
+	qspi_write32(&regs->lut[lut_base], OPRND0(op->cmd) | PAD0(LUT_PAD1) |
+		INSTR0(LUT_CMD) |
+		OPRND1(op->addr_len == 4 ? ADDR32BIT : ADDR24BIT) |
+		PAD1(addr_pad) | INSTR1(LUT_ADDR));
+	if (dummy_cycles)
+		qspi_write32(&regs->lut[lut_base + 1], OPRND0(dummy_cycles) |
+			PAD0(addr_pad) | INSTR0(LUT_DUMMY) |
+			OPRND1(RX_BUFFER_SIZE) | PAD1(data_pad) |
+			INSTR1(LUT_READ));
+	else
+		qspi_write32(&regs->lut[lut_base + 1], OPRND0(RX_BUFFER_SIZE) |
+			PAD0(data_pad) | INSTR0(LUT_READ));
+	qspi_write32(&regs->lut[lut_base + 2], 0);
+	qspi_write32(&regs->lut[lut_base + 3], 0);
+
+	qspi_write32(&regs->lutkey, LUT_KEY_VALUE);
+	qspi_write32(&regs->lckcr, QSPI_LCKCR_LOCK);
+}
+
 void spi_init()
 {
 	/* do nothing */
@@ -200,6 +245,14 @@ struct spi_slave *spi_setup_slave(unsigned int bus, unsigned int cs,
 	qspi->amba_base = amba_bases[bus];
 
 	qspi->slave.max_write_size = TX_BUFFER_SIZE;
+	/*
+	 * No quad reads: they need the flash's quad enable bit, and spi_xfer()
+	 * has no LUT sequences for the RDCR/WRSR commands which set it
+	 */
+	qspi->slave.op_mode_rx = SPI_OPM_RX_AS | SPI_OPM_RX_DOUT |
+		SPI_OPM_RX_DIO | SPI_OPM_RX_BULK;
+	/* spi_xfer() has no LUT sequence for a chip erase */
+	qspi->slave.op_mode_tx = SPI_OPM_TX_NO_CHIP_ERASE;
 
 	regs = (struct fsl_qspi_regs *)qspi->reg_base;
 	qspi_write32(&regs->mcr, QSPI_MCR_RESERVED_MASK | QSPI_MCR_MDIS_MASK);
@@ -278,7 +331,8 @@ static void qspi_op_rdid(struct fsl_qspi *qspi, u32 *rxbuf, u32 len)
 	qspi_write32(&regs->mcr, mcr_reg);
 }
 
-static void qspi_op_read(struct fsl_qspi *qspi, u32 *rxbuf, u32 len)
+static void qspi_op_read(struct fsl_qspi *qspi, u32 *rxbuf, u32 len,
+			 u8 seqid)
 {
 	struct fsl_qspi_regs *regs = (struct fsl_qspi_regs *)qspi->reg_base;
 	u32 mcr_reg, data;
@@ -299,7 +353,7 @@ static void qspi_op_read(struct fsl_qspi *qspi, u32 *rxbuf, u32 len)
 			RX_BUFFER_SIZE : len;
 
 		qspi_write32(&regs->ipcr,
-			(SEQID_FAST_READ << QSPI_IPCR_SEQID_SHIFT) | size);
+			(seqid << QSPI_IPCR_SEQID_SHIFT) | size);
 		while (qspi_read32(&regs->sr) & QSPI_SR_BUSY_MASK)
 			;
 
@@ -310,7 +364,7 @@ static void qspi_op_read(struct fsl_qspi *qspi, u32 *rxbuf, u32 len)
 		while ((RX_BUFFER_SIZE >= size) && (size > 0)) {
 			data = qspi_read32(&regs->rbdr[i]);
 			data = qspi_endian_xchg(data);
-			memcpy(rxbuf, &data, 4);
+			memcpy(rxbuf, &data, min(size, 4));
 			rxbuf++;
 			size -= 4;
 			i++;
@@ -466,7 +520,7 @@ int spi_xfer(struct spi_slave *slave, unsigned int bitlen,
 
 	if (din) {
 		if (qspi->cur_seqid == OPCODE_FAST_READ)
-			qspi_op_read(qspi, din, bytes);
+			qspi_op_read(qspi, din, bytes, SEQID_FAST_READ);
 		else if (qspi->cur_seqid == OPCODE_RDID)
 			qspi_op_rdid(qspi, din, bytes);
 		else if (qspi->cur_seqid == OPCODE_RDSR)
@@ -476,6 +530,22 @@ int spi_xfer(struct spi_slave *slave, unsigned int bitlen,
 	return 0;
 }
 
+int spi_read_bulk(struct spi_slave *slave, const struct spi_read_op *op,
+		  void *buf, size_t len)
+{
+	struct fsl_qspi *qspi = to_qspi_spi(slave);
+
+	/*
+	 * The controller sequences the command, address and dummy cycles
+	 * itself and fills its RX buffer a whole burst at a time
+	 */
+	qspi_set_lut_bulk_read(qspi, op);
+	qspi->sf_addr = op->addr;
+	qspi_op_read(qspi, buf, len, SEQID_BULK_READ);
+
+	return 0;
+}
+
 void spi_release_bus(struct spi_slave *slave)
 {
 	/* Nothing to do */
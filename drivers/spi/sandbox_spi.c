@@ -103,6 +103,9 @@ struct spi_slave *spi_setup_slave(unsigned int bus, unsigned int cs,
 		return NULL;
 	}
 
+	/* the emulated bus has as many lines as the flash wants */
+	sss->slave.op_mode_rx = SPI_OPM_RX_EXTN | SPI_OPM_RX_BULK;
+
 	return &sss->slave;
 }
 
@@ -203,6 +206,41 @@ int spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 	return ret;
 }
 
+int spi_read_bulk(struct spi_slave *slave, const struct spi_read_op *op,
+		  void *buf, size_t len)
+{
+	struct sandbox_spi_slave *sss = to_sandbox_spi_slave(slave);
+	u8 hdr[1 + 4 + 4], scratch[sizeof(hdr)];
+	uint hdr_len, i;
+	int ret;
+
+	hdr_len = 1 + op->addr_len + op->dummy_len;
+	if (hdr_len > sizeof(hdr))
+		return -EINVAL;
+
+	debug("sandbox_spi: bulk read: cmd %02x addr %x len %zu (1-%u-%u)\n",
+	      op->cmd, op->addr, len, op->addr_lines, op->data_lines);
+
+	hdr[0] = op->cmd;
+	for (i = 0; i < op->addr_len; i++)
+		hdr[1 + i] = op->addr >> (8 * (op->addr_len - 1 - i));
+	memset(hdr + 1 + op->addr_len, '\0', op->dummy_len);
+
+	/*
+	 * Like a controller with DMA, send the header and then move all of
+	 * the data straight into the caller's buffer in one transfer. What
+	 * we send during the data phase is ignored by the flash, so the
+	 * buffer itself is used rather than a scratch copy.
+	 */
+	spi_cs_activate(slave);
+	ret = sss->ops->xfer(sss->priv, hdr, scratch, hdr_len);
+	if (!ret && len)
+		ret = sss->ops->xfer(sss->priv, buf, buf, len);
+	spi_cs_deactivate(slave);
+
+	return ret ? -EIO : 0;
+}
+
 /**
  * Set up a new SPI slave for an fdt node
  *
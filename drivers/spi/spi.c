@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <fdtdec.h>
 #include <malloc.h>
 #include <spi.h>
@@ -21,6 +22,18 @@ int spi_set_wordlen(struct spi_slave *slave, unsigned int wordlen)
 	return 0;
 }
 
+__weak int spi_read_bulk(struct spi_slave *slave, const struct spi_read_op *op,
+			 void *buf, size_t len)
+{
+	return -ENOSYS;
+}
+
+__weak int spi_mmap_config(struct spi_slave *slave,
+			   const struct spi_read_op *op)
+{
+	return 0;
+}
+
 void *spi_do_alloc_slave(int offset, int size, unsigned int bus,
 			 unsigned int cs)
 {
@@ -7,6 +7,7 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <asm/io.h>
 #include <asm/arch/omap.h>
 #include <malloc.h>
@@ -51,7 +52,10 @@
 #define QSPI_SETUP0_NUM_A_BYTES         (0x2 << 8)
 #define QSPI_SETUP0_NUM_D_BYTES_NO_BITS (0x0 << 10)
 #define QSPI_SETUP0_NUM_D_BYTES_8_BITS  (0x1 << 10)
+#define QSPI_SETUP0_NUM_A_BYTES_N(n)    (((n) - 1) << 8)
+#define QSPI_SETUP0_NUM_D_BYTES_N(n)    ((n) << 10)
 #define QSPI_SETUP0_READ_NORMAL         (0x0 << 12)
+#define QSPI_SETUP0_READ_DUAL           (0x1 << 12)
 #define QSPI_SETUP0_READ_QUAD           (0x3 << 12)
 #define QSPI_CMD_WRITE                  (0x2 << 16)
 #define QSPI_NUM_DUMMY_BITS             (0x0 << 24)
@@ -117,6 +121,38 @@ static void ti_spi_setup_spi_register(struct ti_qspi_slave *qslave)
 	writel(memval, &qslave->base->setup0);
 }
 
+#ifdef CONFIG_TI_SPI_MMAP
+int spi_mmap_config(struct spi_slave *slave, const struct spi_read_op *op)
+{
+	struct ti_qspi_slave *qslave = to_ti_qspi_slave(slave);
+	u32 memval;
+
+	/* The address and dummy bytes always go out on a single line */
+	if (op->addr_lines != 1 || op->dummy_len > 3)
+		return -EINVAL;
+
+	memval = op->cmd | QSPI_SETUP0_NUM_A_BYTES_N(op->addr_len) |
+			QSPI_SETUP0_NUM_D_BYTES_N(op->dummy_len) |
+			QSPI_CMD_WRITE | QSPI_NUM_DUMMY_BITS;
+	switch (op->data_lines) {
+	case 4:
+		memval |= QSPI_SETUP0_READ_QUAD;
+		break;
+	case 2:
+		memval |= QSPI_SETUP0_READ_DUAL;
+		break;
+	default:
+		memval |= QSPI_SETUP0_READ_NORMAL;
+		break;
+	}
+
+	debug("spi_mmap_config: setup0 %08x\n", memval);
+	writel(memval, &qslave->base->setup0);
+
+	return 0;
+}
+#endif
+
 static void ti_spi_set_speed(struct spi_slave *slave, uint hz)
 {
 	struct ti_qspi_slave *qslave = to_ti_qspi_slave(slave);
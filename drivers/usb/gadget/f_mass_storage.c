@@ -305,6 +305,36 @@ inline void clear_bit(int nr, volatile void *addr)
 struct fsg_dev;
 struct fsg_common;
 
+/* Sectors read ahead between two polls of the UDC */
+#define FSG_RA_SLICE	(16384 / SECTOR_SIZE)
+
+#ifdef CONFIG_SYS_UMS_WRITE_BEHIND
+#define FSG_WRITE_BEHIND	1
+#else
+#define FSG_WRITE_BEHIND	0
+#endif
+
+enum fsg_cache_state {
+	FSG_CACHE_EMPTY = 0,
+	FSG_CACHE_READ,		/* Read-ahead, @count of @want sectors done */
+	FSG_CACHE_WRITE,	/* Write-behind of @count sectors */
+};
+
+/*
+ * A spare buffer of FSG_BUFLEN bytes, swapped with a pipeline buffer to
+ * avoid copying. It holds either the sectors following a sequential READ,
+ * read from the medium while waiting for the next command, or the last
+ * part of a WRITE, which is only written to the medium once the data for
+ * the next command is on its way.
+ */
+struct fsg_cache {
+	void			*buf;
+	enum fsg_cache_state	state;
+	u32			lba;
+	u32			count;
+	u32			want;
+};
+
 /* Data shared by all the FSG instances. */
 struct fsg_common {
 	struct usb_gadget	*gadget;
@@ -318,6 +348,9 @@ struct fsg_common {
 	struct fsg_buffhd	*next_buffhd_to_drain;
 	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
 
+	struct fsg_cache	cache;
+	u32			next_read_lba;	/* To spot sequential READs */
+
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
 
@@ -697,6 +730,120 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/* Give @bh the spare buffer, which becomes its old one */
+static void fsg_cache_swap(struct fsg_common *common, struct fsg_buffhd *bh)
+{
+	void *buf = bh->buf;
+
+	bh->buf = common->cache.buf;
+	bh->inreq->buf = bh->outreq->buf = bh->buf;
+	common->cache.buf = buf;
+}
+
+/**
+ * fsg_cache_flush() - Write out the data left behind by the last WRITE
+ *
+ * @return 0 if OK or there was nothing to write, -EIO on error
+ */
+static int fsg_cache_flush(struct fsg_common *common)
+{
+	struct fsg_cache *cache = &common->cache;
+	int rc;
+
+	if (cache->state != FSG_CACHE_WRITE)
+		return 0;
+
+	cache->state = FSG_CACHE_EMPTY;
+	rc = ums->write_sector(ums, cache->lba, cache->count, cache->buf);
+	if (rc != cache->count) {
+		printf("UMS: error writing %u sectors at %u\n", cache->count,
+		       cache->lba);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/*
+ * Write out the data left behind by the last WRITE for a command which asks
+ * for that, so a failure is the command's own error
+ */
+static int fsg_cache_sync(struct fsg_common *common, struct fsg_lun *curlun)
+{
+	if (!fsg_cache_flush(common))
+		return 0;
+
+	curlun->sense_data = SS_WRITE_ERROR;
+	curlun->sense_data_info = common->cache.lba;
+	curlun->info_valid = 1;
+
+	return -EIO;
+}
+
+/*
+ * Report a failure to write out the data left behind by the last WRITE,
+ * which has completed already, as a deferred error on the current command
+ */
+static void fsg_cache_deferred_error(struct fsg_common *common,
+				     struct fsg_lun *curlun)
+{
+	curlun->sense_data = SS_WRITE_ERROR;
+	curlun->sense_data_info = common->cache.lba;
+	curlun->info_valid = 1;
+	curlun->sense_deferred = 1;
+}
+
+/**
+ * fsg_read_ahead() - Read the next slice of the read-ahead, if any
+ *
+ * This is done in slices so that the UDC can be serviced in between.
+ *
+ * @return true if a slice was read, false if there is nothing to do
+ */
+static bool fsg_read_ahead(struct fsg_common *common)
+{
+	struct fsg_cache *cache = &common->cache;
+	u32 n;
+
+	if (cache->state != FSG_CACHE_READ || cache->count == cache->want)
+		return false;
+
+	n = min(cache->want - cache->count, (u32)FSG_RA_SLICE);
+	if (ums->read_sector(ums, cache->lba + cache->count, n,
+			     cache->buf + cache->count * SECTOR_SIZE) != n) {
+		/* Keep what we have, do_read() will meet the error */
+		cache->want = cache->count;
+		return false;
+	}
+	cache->count += n;
+
+	return true;
+}
+
+/*
+ * Read @count sectors at @lba into @bh, starting with those already read
+ * ahead. Returns the number of sectors read, 0 on error.
+ */
+static int fsg_read_sectors(struct fsg_common *common, struct fsg_buffhd *bh,
+			    u32 lba, u32 count)
+{
+	struct fsg_cache *cache = &common->cache;
+	u32 n = 0;
+
+	if (cache->state == FSG_CACHE_READ) {
+		if (cache->lba == lba && cache->count) {
+			n = min(cache->count, count);
+			fsg_cache_swap(common, bh);
+		}
+		cache->state = FSG_CACHE_EMPTY;
+	}
+	if (n == count)
+		return n;
+
+	return n + ums->read_sector(ums, lba + n, count - n,
+				    bh->buf + n * SECTOR_SIZE);
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = &common->luns[common->lun];
@@ -708,6 +855,8 @@ static int do_read(struct fsg_common *common)
 	unsigned int		amount;
 	unsigned int		partial_page;
 	ssize_t			nread;
+	struct fsg_cache	*cache = &common->cache;
+	bool			sequential;
 
 	/* Get the starting Logical Block Address and check that it's
 	 * not too big */
@@ -729,6 +878,7 @@ static int do_read(struct fsg_common *common)
 		return -EINVAL;
 	}
 	file_offset = ((loff_t) lba) << 9;
+	sequential = (lba == common->next_read_lba);
 
 	/* Carry out the file reads */
 	amount_left = common->data_size_from_cmnd;
@@ -771,10 +921,9 @@ static int do_read(struct fsg_common *common)
 		}
 
 		/* Perform the read */
-		rc = ums->read_sector(ums,
+		rc = fsg_read_sectors(common, bh,
 				      file_offset / SECTOR_SIZE,
-				      amount / SECTOR_SIZE,
-				      (char __user *)bh->buf);
+				      amount / SECTOR_SIZE);
 		if (!rc)
 			return -EIO;
 
@@ -819,6 +968,18 @@ static int do_read(struct fsg_common *common)
 		common->next_buffhd_to_fill = bh->next;
 	}
 
+	/* If this READ carried on from the last one, read the sectors
+	 * after it while waiting for the next command */
+	lba = file_offset >> 9;
+	if (sequential && amount_left == 0 && lba < curlun->num_sectors) {
+		cache->state = FSG_CACHE_READ;
+		cache->lba = lba;
+		cache->count = 0;
+		cache->want = min(curlun->num_sectors - lba,
+				  (loff_t)(FSG_BUFLEN / SECTOR_SIZE));
+	}
+	common->next_read_lba = lba;
+
 	return -EIO;		/* No default reply */
 }
 
@@ -836,6 +997,8 @@ static int do_write(struct fsg_common *common)
 	unsigned int		partial_page;
 	ssize_t			nwritten;
 	int			rc;
+	struct fsg_cache	*cache = &common->cache;
+	int			fua = 0;
 
 	if (curlun->ro) {
 		curlun->sense_data = SS_WRITE_PROTECTED;
@@ -852,17 +1015,22 @@ static int do_write(struct fsg_common *common)
 		/* We allow DPO (Disable Page Out = don't save data in the
 		 * cache) and FUA (Force Unit Access = write directly to the
 		 * medium).  We don't implement DPO; we implement FUA by
-		 * performing synchronous output. */
+		 * not leaving any of the data behind. */
 		if (common->cmnd[1] & ~0x18) {
 			curlun->sense_data = SS_INVALID_FIELD_IN_CDB;
 			return -EINVAL;
 		}
+		fua = common->cmnd[1] & 0x08;
 	}
 	if (lba >= curlun->num_sectors) {
 		curlun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
 		return -EINVAL;
 	}
 
+	/* Whatever was read ahead may be about to change */
+	if (cache->state == FSG_CACHE_READ)
+		cache->state = FSG_CACHE_EMPTY;
+
 	/* Carry out the file writes */
 	get_some_more = 1;
 	file_offset = usb_offset = ((loff_t) lba) << 9;
@@ -927,6 +1095,16 @@ static int do_write(struct fsg_common *common)
 			continue;
 		}
 
+		/* Now that data for this WRITE is on its way, write out what
+		 * the last one left behind */
+		if (cache->state == FSG_CACHE_WRITE) {
+			if (fsg_cache_flush(common)) {
+				fsg_cache_deferred_error(common, curlun);
+				break;
+			}
+			continue;
+		}
+
 		/* Write the received data to the backing file */
 		bh = common->next_buffhd_to_drain;
 		if (bh->state == BUF_STATE_EMPTY && !get_some_more)
@@ -944,11 +1122,22 @@ static int do_write(struct fsg_common *common)
 
 			amount = bh->outreq->actual;
 
-			/* Perform the write */
-			rc = ums->write_sector(ums,
-					       file_offset / SECTOR_SIZE,
-					       amount / SECTOR_SIZE,
-					       (char __user *)bh->buf);
+			/* Perform the write, leaving the last part of it until
+			 * the next command if enabled, unless FUA is set */
+			if (FSG_WRITE_BEHIND && !fua &&
+			    amount == amount_left_to_write &&
+			    amount == bh->outreq->length) {
+				fsg_cache_swap(common, bh);
+				cache->state = FSG_CACHE_WRITE;
+				cache->lba = file_offset / SECTOR_SIZE;
+				cache->count = amount / SECTOR_SIZE;
+				rc = cache->count;
+			} else {
+				rc = ums->write_sector(ums,
+						file_offset / SECTOR_SIZE,
+						amount / SECTOR_SIZE,
+						(char __user *)bh->buf);
+			}
 			if (!rc)
 				return -EIO;
 			nwritten = rc * SECTOR_SIZE;
@@ -1001,7 +1190,9 @@ static int do_write(struct fsg_common *common)
 
 static int do_synchronize_cache(struct fsg_common *common)
 {
-	return 0;
+	struct fsg_lun	*curlun = &common->luns[common->lun];
+
+	return fsg_cache_sync(common, curlun);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -1126,7 +1317,7 @@ static int do_request_sense(struct fsg_common *common, struct fsg_buffhd *bh)
 	struct fsg_lun	*curlun = &common->luns[common->lun];
 	u8		*buf = (u8 *) bh->buf;
 	u32		sd, sdinfo;
-	int		valid;
+	int		valid, deferred;
 
 	/*
 	 * From the SCSI-2 spec., section 7.9 (Unit attention condition):
@@ -1155,15 +1346,20 @@ static int do_request_sense(struct fsg_common *common, struct fsg_buffhd *bh)
 		sd = SS_LOGICAL_UNIT_NOT_SUPPORTED;
 		sdinfo = 0;
 		valid = 0;
+		deferred = 0;
 	} else {
 		sd = curlun->sense_data;
+		sdinfo = curlun->sense_data_info;
 		valid = curlun->info_valid << 7;
+		deferred = curlun->sense_deferred;
 		curlun->sense_data = SS_NO_SENSE;
 		curlun->info_valid = 0;
+		curlun->sense_deferred = 0;
 	}
 
 	memset(buf, 0, 18);
-	buf[0] = valid | 0x70;			/* Valid, current error */
+	/* Valid, current or deferred error */
+	buf[0] = valid | (deferred ? 0x71 : 0x70);
 	buf[2] = SK(sd);
 	put_unaligned_be32(sdinfo, &buf[3]);	/* Sense information */
 	buf[7] = 18 - 8;			/* Additional sense length */
@@ -1327,9 +1523,14 @@ static int do_start_stop(struct fsg_common *common)
 {
 	struct fsg_lun	*curlun = &common->luns[common->lun];
 
-	if (!curlun) {
+	if (!curlun)
 		return -EINVAL;
-	} else if (!curlun->removable) {
+
+	/* Stopping or ejecting the medium writes out any data left behind */
+	if (!(common->cmnd[4] & 0x01) && fsg_cache_sync(common, curlun))
+		return -EIO;
+
+	if (!curlun->removable) {
 		curlun->sense_data = SS_INVALID_COMMAND;
 		return -EINVAL;
 	}
@@ -1746,6 +1947,7 @@ static int check_command(struct fsg_common *common, int cmnd_size,
 		if (common->cmnd[0] != SC_REQUEST_SENSE) {
 			curlun->sense_data = SS_NO_SENSE;
 			curlun->info_valid = 0;
+			curlun->sense_deferred = 0;
 		}
 	} else {
 		curlun = NULL;
@@ -1780,6 +1982,28 @@ static int check_command(struct fsg_common *common, int cmnd_size,
 		}
 	}
 
+	/* Write out any data left behind by the last WRITE before running
+	 * this command, which fails with a deferred error if that does.
+	 * do_write() does it itself once the new data is on its way, and
+	 * SYNCHRONIZE CACHE and START-STOP UNIT as their own operation.
+	 * REQUEST SENSE goes on to report the error. */
+	switch (common->cmnd[0]) {
+	case SC_WRITE_6:
+	case SC_WRITE_10:
+	case SC_WRITE_12:
+	case SC_SYNCHRONIZE_CACHE:
+	case SC_START_STOP_UNIT:
+		break;
+	default:
+		if (!fsg_cache_flush(common))
+			break;
+		if (!curlun)
+			return -EINVAL;
+		fsg_cache_deferred_error(common, curlun);
+		if (common->cmnd[0] != SC_REQUEST_SENSE)
+			return -EINVAL;
+	}
+
 	return 0;
 }
 
@@ -2144,8 +2368,12 @@ static int get_next_command(struct fsg_common *common)
 	 * can reuse it for the next filling.  No need to advance
 	 * next_buffhd_to_fill. */
 
-	/* Wait for the CBW to arrive */
+	/* Wait for the CBW to arrive, reading ahead in the meantime */
 	while (bh->state != BUF_STATE_FULL) {
+		if (fsg_read_ahead(common)) {
+			usb_gadget_handle_interrupts();
+			continue;
+		}
 		rc = sleep_thread(common);
 		if (rc)
 			return rc;
@@ -2285,6 +2513,9 @@ static int fsg_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 static void fsg_disable(struct usb_function *f)
 {
 	struct fsg_dev *fsg = fsg_from_func(f);
+
+	/* The host has gone, so write out any data left behind now */
+	fsg_cache_flush(fsg->common);
 	fsg->common->new_fsg = NULL;
 	raise_exception(fsg->common, FSG_STATE_CONFIG_CHANGE);
 }
@@ -2349,6 +2580,7 @@ static void handle_exception(struct fsg_common *common)
 			curlun = &common->luns[i];
 			curlun->sense_data = SS_NO_SENSE;
 			curlun->info_valid = 0;
+			curlun->sense_deferred = 0;
 		}
 		common->state = FSG_STATE_IDLE;
 	}
@@ -2524,6 +2756,12 @@ buffhds_first_it:
 	} while (--i);
 	bh->next = common->buffhds;
 
+	common->cache.buf = memalign(CONFIG_SYS_CACHELINE_SIZE, FSG_BUFLEN);
+	if (unlikely(!common->cache.buf)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
+
 	snprintf(common->inquiry_string, sizeof common->inquiry_string,
 		 "%-8s%-16s%04x",
 		 "Linux   ",
@@ -2589,6 +2827,7 @@ static void fsg_common_release(struct kref *ref)
 			kfree(bh->buf);
 		} while (++bh, --i);
 	}
+	kfree(common->cache.buf);
 
 	if (common->free_storage_on_release)
 		kfree(common);
@@ -2651,6 +2890,10 @@ static void fsg_unbind(struct usb_configuration *c, struct usb_function *f)
 	struct fsg_dev		*fsg = fsg_from_func(f);
 
 	DBG(fsg, "unbind\n");
+
+	/* Don't lose data left behind by the last WRITE */
+	fsg_cache_flush(fsg->common);
+
 	if (fsg->common->fsg == fsg) {
 		fsg->common->new_fsg = NULL;
 		raise_exception(fsg->common, FSG_STATE_CONFIG_CHANGE);
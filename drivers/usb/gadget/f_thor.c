@@ -30,6 +30,8 @@
 
 static void thor_tx_data(unsigned char *data, int len);
 static void thor_set_dma(void *addr, int len);
+static int thor_rx_start(void);
+static int thor_rx_finish(int len);
 static int thor_rx_data(void);
 
 static struct f_thor *thor_func;
@@ -138,95 +140,96 @@ static int process_rqt_cmd(const struct rqt_box *rqt)
 
 static long long int download_head(unsigned long long total,
 				   unsigned int packet_size,
-				   long long int *left,
 				   int *cnt)
 {
-	long long int rcv_cnt = 0, left_to_rcv, ret_rcv;
+	struct thor_dev *dev = thor_func->dev;
 	struct dfu_entity *dfu_entity = dfu_get_entity(alt_setting_num);
-	void *transfer_buffer = dfu_get_buf(dfu_entity);
-	void *buf = transfer_buffer;
-	int usb_pkt_cnt = 0, ret;
+	long long int rcv_cnt = 0;
+	int usb_pkt_cnt = 0, size, ret;
+	void *buf;
+
+	if (!total)
+		return 0;
+
+	if (!dev->rx_buf) {
+		dev->rx_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+				       2 * packet_size);
+		if (!dev->rx_buf)
+			return -ENOMEM;
+	}
 
 	/*
-	 * Files smaller than THOR_STORE_UNIT_SIZE (now 32 MiB) are stored on
-	 * the medium.
-	 * The packet response is sent on the purpose after successful data
-	 * chunk write. There is a room for improvement when asynchronous write
-	 * is performed.
+	 * Packets are received into the two halves of rx_buf in turn. Each
+	 * one but the last is acknowledged as soon as it has come, with the
+	 * next one already queued, and only then handed to DFU. The medium is
+	 * written from dfu_write_poll() while waiting for USB, and a write
+	 * error shows up at the next packet.
 	 */
-	while (total - rcv_cnt >= packet_size) {
-		thor_set_dma(buf, packet_size);
-		buf += packet_size;
-		ret_rcv = thor_rx_data();
-		if (ret_rcv < 0)
-			return ret_rcv;
-		rcv_cnt += ret_rcv;
+	thor_set_dma(dev->rx_buf, packet_size);
+	ret = thor_rx_start();
+	if (ret)
+		return ret;
+
+	while (rcv_cnt < total) {
+		buf = dev->rx_buf + (usb_pkt_cnt % 2) * packet_size;
+		ret = thor_rx_finish(packet_size);
+		if (ret < 0)
+			return ret;
+
+		size = min_t(unsigned long long, total - rcv_cnt, packet_size);
+		rcv_cnt += size;
 		debug("%d: RCV data count: %llu cnt: %d\n", usb_pkt_cnt,
 		      rcv_cnt, *cnt);
 
-		if ((rcv_cnt % THOR_STORE_UNIT_SIZE) == 0) {
-			ret = dfu_write(dfu_get_entity(alt_setting_num),
-					transfer_buffer, THOR_STORE_UNIT_SIZE,
-					(*cnt)++);
-			if (ret) {
-				error("DFU write failed [%d] cnt: %d",
-				      ret, *cnt);
+		if (rcv_cnt < total) {
+			thor_set_dma(dev->rx_buf +
+				     ((usb_pkt_cnt + 1) % 2) * packet_size,
+				     packet_size);
+			ret = thor_rx_start();
+			if (ret)
 				return ret;
-			}
-			buf = transfer_buffer;
+			send_data_rsp(0, ++usb_pkt_cnt);
 		}
-		send_data_rsp(0, ++usb_pkt_cnt);
-	}
 
-	/* Calculate the amount of data to arrive from PC (in bytes) */
-	left_to_rcv = total - rcv_cnt;
+		ret = dfu_write(dfu_entity, buf, size, (*cnt)++);
+		if (ret) {
+			error("DFU write failed [%d] cnt: %d", ret, *cnt);
+			return ret;
+		}
+	}
 
 	/*
-	 * Calculate number of data already received. but not yet stored
-	 * on the medium (they are smaller than THOR_STORE_UNIT_SIZE)
+	 * The last packet is acknowledged once the full buffers are on the
+	 * medium, so a write error fails it. What is left in the DFU buffer
+	 * is written by dfu_flush() at the end of the file.
 	 */
-	*left = left_to_rcv + buf - transfer_buffer;
-	debug("%s: left: %llu left_to_rcv: %llu buf: 0x%p\n", __func__,
-	      *left, left_to_rcv, buf);
-
-	if (left_to_rcv) {
-		thor_set_dma(buf, packet_size);
-		ret_rcv = thor_rx_data();
-		if (ret_rcv < 0)
-			return ret_rcv;
-		rcv_cnt += ret_rcv;
-		send_data_rsp(0, ++usb_pkt_cnt);
+	ret = dfu_write_wait(0);
+	if (ret) {
+		error("DFU write failed [%d] cnt: %d", ret, *cnt);
+		return ret;
 	}
+	send_data_rsp(0, ++usb_pkt_cnt);
 
 	debug("%s: %llu total: %llu cnt: %d\n", __func__, rcv_cnt, total, *cnt);
 
 	return rcv_cnt;
 }
 
-static int download_tail(long long int left, int cnt)
+static int download_tail(int cnt)
 {
 	struct dfu_entity *dfu_entity = dfu_get_entity(alt_setting_num);
-	void *transfer_buffer = dfu_get_buf(dfu_entity);
 	int ret;
 
-	debug("%s: left: %llu cnt: %d\n", __func__, left, cnt);
-
-	if (left) {
-		ret = dfu_write(dfu_entity, transfer_buffer, left, cnt++);
-		if (ret) {
-			error("DFU write failed [%d]: left: %llu", ret, left);
-			return ret;
-		}
-	}
+	debug("%s: cnt: %d\n", __func__, cnt);
 
 	/*
 	 * To store last "packet" or write file from buffer to filesystem
 	 * DFU storage backend requires dfu_flush
 	 *
-	 * This also frees memory malloc'ed by dfu_get_buf(), so no explicit
-	 * need fo call dfu_free_buf() is needed.
+	 * This also waits for the writes still queued, and frees the DFU
+	 * buffers.
 	 */
-	ret = dfu_flush(dfu_entity, transfer_buffer, 0, cnt);
+	ret = dfu_flush(dfu_entity, NULL, 0, cnt);
 	if (ret)
 		error("DFU flush failed!");
 
@@ -236,7 +239,7 @@ static int download_tail(long long int left, int cnt)
 static long long int process_rqt_download(const struct rqt_box *rqt)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(struct rsp_box, rsp, sizeof(struct rsp_box));
-	static long long int left, ret_head;
+	static long long int ret_head;
 	int file_type, ret = 0;
 	static int cnt;
 
@@ -277,17 +280,14 @@ static long long int process_rqt_download(const struct rqt_box *rqt)
 	case RQT_DL_FILE_START:
 		send_rsp(rsp);
 		ret_head = download_head(thor_file_size, THOR_PACKET_SIZE,
-					 &left, &cnt);
-		if (ret_head < 0) {
-			left = 0;
+					 &cnt);
+		if (ret_head < 0)
 			cnt = 0;
-		}
 		return ret_head;
 	case RQT_DL_FILE_END:
 		debug("DL FILE_END\n");
-		rsp->ack = download_tail(left, cnt);
+		rsp->ack = download_tail(cnt);
 		ret = rsp->ack;
-		left = 0;
 		cnt = 0;
 		break;
 	case RQT_DL_EXIT:
@@ -520,36 +520,65 @@ static struct usb_request *alloc_ep_req(struct usb_ep *ep, unsigned length)
 	return req;
 }
 
-static int thor_rx_data(void)
+/* Queue the receipt of the data set up by thor_set_dma() */
+static int thor_rx_start(void)
 {
 	struct thor_dev *dev = thor_func->dev;
-	int data_to_rx, tmp, status;
+	int status;
 
-	data_to_rx = dev->out_req->length;
-	tmp = data_to_rx;
-	do {
-		dev->out_req->length = data_to_rx;
-		debug("dev->out_req->length:%d dev->rxdata:%d\n",
-		      dev->out_req->length, dev->rxdata);
-
-		status = usb_ep_queue(dev->out_ep, dev->out_req, 0);
-		if (status) {
-			error("kill %s:  resubmit %d bytes --> %d",
-			      dev->out_ep->name, dev->out_req->length, status);
-			usb_ep_set_halt(dev->out_ep);
-			return -EAGAIN;
-		}
+	debug("dev->out_req->length:%d dev->rxdata:%d\n",
+	      dev->out_req->length, dev->rxdata);
+
+	status = usb_ep_queue(dev->out_ep, dev->out_req, 0);
+	if (status) {
+		error("kill %s:  resubmit %d bytes --> %d",
+		      dev->out_ep->name, dev->out_req->length, status);
+		usb_ep_set_halt(dev->out_ep);
+		return -EAGAIN;
+	}
+
+	return 0;
+}
+
+/*
+ * Wait for the data queued by thor_rx_start(), queueing again for whatever
+ * is missing until @len bytes have come. Queued DFU writes are carried out
+ * meanwhile.
+ */
+static int thor_rx_finish(int len)
+{
+	struct thor_dev *dev = thor_func->dev;
+	int data_to_rx = len, ret;
 
+	for (;;) {
 		while (!dev->rxdata) {
 			usb_gadget_handle_interrupts();
+			dfu_write_poll();
 			if (ctrlc())
 				return -1;
 		}
 		dev->rxdata = 0;
 		data_to_rx -= dev->out_req->actual;
-	} while (data_to_rx);
+		if (!data_to_rx)
+			return len;
+
+		dev->out_req->length = data_to_rx;
+		ret = thor_rx_start();
+		if (ret)
+			return ret;
+	}
+}
+
+static int thor_rx_data(void)
+{
+	int len = thor_func->dev->out_req->length;
+	int ret;
+
+	ret = thor_rx_start();
+	if (ret)
+		return ret;
 
-	return tmp;
+	return thor_rx_finish(len);
 }
 
 static void thor_tx_data(unsigned char *data, int len)
@@ -857,6 +886,7 @@ static void thor_unbind(struct usb_configuration *c, struct usb_function *f)
 	struct f_thor *f_thor = func_to_thor(f);
 	struct thor_dev *dev = f_thor->dev;
 
+	free(dev->rx_buf);
 	free(dev);
 	memset(thor_func, 0, sizeof(*thor_func));
 	thor_func = NULL;
@@ -107,6 +107,9 @@ struct thor_dev {
 	struct usb_ep *in_ep, *out_ep, *int_ep;
 	struct usb_request *in_req, *out_req;
 
+	/* Two packets of a download, received into in turn */
+	void *rx_buf;
+
 	/* Control flow variables */
 	unsigned char configuration_done;
 	unsigned char rxdata;
@@ -120,5 +123,4 @@ struct f_thor {
 
 #define F_NAME_BUF_SIZE 32
 #define THOR_PACKET_SIZE SZ_1M      /* 1 MiB */
-#define THOR_STORE_UNIT_SIZE SZ_32M /* 32 MiB */
 #endif /* _USB_THOR_H_ */
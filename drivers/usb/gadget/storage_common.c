@@ -285,6 +285,7 @@ struct fsg_lun {
 	unsigned int	registered:1;
 	unsigned int	info_valid:1;
 	unsigned int	nofua:1;
+	unsigned int	sense_deferred:1;	/* Error of an earlier command */
 
 	u32		sense_data;
 	u32		sense_data_info;
@@ -306,10 +307,18 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
 /* Number of buffers we will use.  2 is enough for double-buffering */
+#ifdef CONFIG_SYS_UMS_NUM_BUFS
+#define FSG_NUM_BUFFERS	CONFIG_SYS_UMS_NUM_BUFS
+#else
 #define FSG_NUM_BUFFERS	2
+#endif
 
 /* Default size of buffer length. */
+#ifdef CONFIG_SYS_UMS_BUF_SIZE
+#define FSG_BUFLEN	((u32)CONFIG_SYS_UMS_BUF_SIZE)
+#else
 #define FSG_BUFLEN	((u32)16384)
+#endif
 
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	8
@@ -273,6 +273,145 @@ static inline u8 ehci_encode_speed(enum usb_device_speed speed)
 	return QH_FULL_SPEED;
 }
 
+#define PKT_ALIGN	512
+
+/*
+ * Return @count zeroed qTDs. The controller keeps a pool that grows to the
+ * largest transfer seen, rather than allocating qTDs for every transfer.
+ */
+static struct qTD *ehci_alloc_tds(struct ehci_ctrl *ctrl, int count)
+{
+	if (count > ctrl->td_pool_size) {
+		free(ctrl->td_pool);
+		ctrl->td_pool = memalign(USB_DMA_MINALIGN,
+					 count * sizeof(struct qTD));
+		if (!ctrl->td_pool) {
+			ctrl->td_pool_size = 0;
+			printf("unable to allocate TDs\n");
+			return NULL;
+		}
+		ctrl->td_pool_size = count;
+	}
+	memset(ctrl->td_pool, 0, count * sizeof(struct qTD));
+
+	return ctrl->td_pool;
+}
+
+/* Return the number of qTDs needed for a data payload of @length bytes */
+static int ehci_data_td_count(void *buffer, int length)
+{
+	/*
+	 * Determine the qTD transfer size that will be used for the
+	 * data payload (not considering the first qTD transfer, which
+	 * may be longer or shorter, and the final one, which may be
+	 * shorter).
+	 *
+	 * In order to keep each packet within a qTD transfer, the qTD
+	 * transfer size is aligned to PKT_ALIGN, which is a multiple of
+	 * wMaxPacketSize (except in some cases for interrupt transfers,
+	 * see comment in submit_int_msg()).
+	 *
+	 * By default, i.e. if the input buffer is aligned to PKT_ALIGN,
+	 * QT_BUFFER_CNT full pages will be used.
+	 */
+	int xfr_sz = QT_BUFFER_CNT;
+	/*
+	 * However, if the input buffer is not aligned to PKT_ALIGN, the
+	 * qTD transfer size will be one page shorter, and the first qTD
+	 * data buffer of each transfer will be page-unaligned.
+	 */
+	if ((uint32_t)buffer & (PKT_ALIGN - 1))
+		xfr_sz--;
+	/* Convert the qTD transfer size to bytes. */
+	xfr_sz *= EHCI_PAGE_SIZE;
+	/*
+	 * Approximate by excess the number of qTDs that will be
+	 * required for the data payload. The exact formula is way more
+	 * complicated and saves at most 2 qTDs, i.e. a total of 128
+	 * bytes.
+	 */
+	return 2 + length / xfr_sz;
+}
+
+/*
+ * Set up qTDs from @qtd for a data payload of @length bytes at @buffer,
+ * linking the first from *@tdp and leaving *@tdp pointing at the link of the
+ * last. @toggle is updated for the packets sent. Returns the number of qTDs
+ * used, or -1 on error.
+ */
+static int ehci_data_tds(struct usb_device *dev, struct qTD *qtd,
+			 uint32_t **tdp, unsigned long pipe, void *buffer,
+			 int length, uint32_t *toggle, int ioc)
+{
+	uint32_t maxpacket = usb_maxpacket(dev, pipe);
+	uint8_t *buf_ptr = buffer;
+	int left_length = length;
+	int qtd_counter = 0;
+	uint32_t token;
+
+	do {
+		/*
+		 * Determine the size of this qTD transfer. By default,
+		 * QT_BUFFER_CNT full pages can be used.
+		 */
+		int xfr_bytes = QT_BUFFER_CNT * EHCI_PAGE_SIZE;
+		/*
+		 * However, if the input buffer is not page-aligned, the
+		 * portion of the first page before the buffer start
+		 * offset within that page is unusable.
+		 */
+		xfr_bytes -= (uint32_t)buf_ptr & (EHCI_PAGE_SIZE - 1);
+		/*
+		 * In order to keep each packet within a qTD transfer,
+		 * align the qTD transfer size to PKT_ALIGN.
+		 */
+		xfr_bytes &= ~(PKT_ALIGN - 1);
+		/*
+		 * This transfer may be shorter than the available qTD
+		 * transfer size that has just been computed.
+		 */
+		xfr_bytes = min(xfr_bytes, left_length);
+
+		/*
+		 * Setup request qTD (3.5 in ehci-r10.pdf)
+		 *
+		 *   qt_next ................ 03-00 H
+		 *   qt_altnext ............. 07-04 H
+		 *   qt_token ............... 0B-08 H
+		 *
+		 *   [ buffer, buffer_hi ] loaded with "buffer".
+		 */
+		qtd[qtd_counter].qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+		qtd[qtd_counter].qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+		token = QT_TOKEN_DT(*toggle) |
+			QT_TOKEN_TOTALBYTES(xfr_bytes) |
+			QT_TOKEN_IOC(ioc) | QT_TOKEN_CPAGE(0) |
+			QT_TOKEN_CERR(3) |
+			QT_TOKEN_PID(usb_pipein(pipe) ?
+				QT_TOKEN_PID_IN : QT_TOKEN_PID_OUT) |
+			QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE);
+		qtd[qtd_counter].qt_token = cpu_to_hc32(token);
+		if (ehci_td_buffer(&qtd[qtd_counter], buf_ptr, xfr_bytes)) {
+			printf("unable to construct DATA TD\n");
+			return -1;
+		}
+		/* Update previous qTD! */
+		**tdp = cpu_to_hc32((uint32_t)&qtd[qtd_counter]);
+		*tdp = &qtd[qtd_counter++].qt_next;
+		/*
+		 * Data toggle has to be adjusted since the qTD transfer
+		 * size is not always an even multiple of
+		 * wMaxPacketSize.
+		 */
+		if ((xfr_bytes / maxpacket) & 1)
+			*toggle ^= 1;
+		buf_ptr += xfr_bytes;
+		left_length -= xfr_bytes;
+	} while (left_length > 0);
+
+	return qtd_counter;
+}
+
 static int
 ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		   int length, struct devrequest *req)
@@ -300,7 +439,6 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		      le16_to_cpu(req->value), le16_to_cpu(req->value),
 		      le16_to_cpu(req->index));
 
-#define PKT_ALIGN	512
 	/*
 	 * The USB transfer is split into qTD transfers. Eeach qTD transfer is
 	 * described by a transfer descriptor (the qTD). The qTDs form a linked
@@ -319,39 +457,8 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	if (req != NULL)
 		/* 1 qTD will be needed for SETUP, and 1 for ACK. */
 		qtd_count += 1 + 1;
-	if (length > 0 || req == NULL) {
-		/*
-		 * Determine the qTD transfer size that will be used for the
-		 * data payload (not considering the first qTD transfer, which
-		 * may be longer or shorter, and the final one, which may be
-		 * shorter).
-		 *
-		 * In order to keep each packet within a qTD transfer, the qTD
-		 * transfer size is aligned to PKT_ALIGN, which is a multiple of
-		 * wMaxPacketSize (except in some cases for interrupt transfers,
-		 * see comment in submit_int_msg()).
-		 *
-		 * By default, i.e. if the input buffer is aligned to PKT_ALIGN,
-		 * QT_BUFFER_CNT full pages will be used.
-		 */
-		int xfr_sz = QT_BUFFER_CNT;
-		/*
-		 * However, if the input buffer is not aligned to PKT_ALIGN, the
-		 * qTD transfer size will be one page shorter, and the first qTD
-		 * data buffer of each transfer will be page-unaligned.
-		 */
-		if ((uint32_t)buffer & (PKT_ALIGN - 1))
-			xfr_sz--;
-		/* Convert the qTD transfer size to bytes. */
-		xfr_sz *= EHCI_PAGE_SIZE;
-		/*
-		 * Approximate by excess the number of qTDs that will be
-		 * required for the data payload. The exact formula is way more
-		 * complicated and saves at most 2 qTDs, i.e. a total of 128
-		 * bytes.
-		 */
-		qtd_count += 2 + length / xfr_sz;
-	}
+	if (length > 0 || req == NULL)
+		qtd_count += ehci_data_td_count(buffer, length);
 /*
  * Threshold value based on the worst-case total size of the allocated qTDs for
  * a mass-storage transfer of 65535 blocks of 512 bytes.
@@ -359,14 +466,11 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 #if CONFIG_SYS_MALLOC_LEN <= 64 + 128 * 1024
 #warning CONFIG_SYS_MALLOC_LEN may be too small for EHCI
 #endif
-	qtd = memalign(USB_DMA_MINALIGN, qtd_count * sizeof(struct qTD));
-	if (qtd == NULL) {
-		printf("unable to allocate TDs\n");
+	qtd = ehci_alloc_tds(ctrl, qtd_count);
+	if (qtd == NULL)
 		return -1;
-	}
 
 	memset(qh, 0, sizeof(struct QH));
-	memset(qtd, 0, qtd_count * sizeof(*qtd));
 
 	toggle = usb_gettoggle(dev, usb_pipeendpoint(pipe), usb_pipeout(pipe));
 
@@ -427,71 +531,12 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	}
 
 	if (length > 0 || req == NULL) {
-		uint8_t *buf_ptr = buffer;
-		int left_length = length;
-
-		do {
-			/*
-			 * Determine the size of this qTD transfer. By default,
-			 * QT_BUFFER_CNT full pages can be used.
-			 */
-			int xfr_bytes = QT_BUFFER_CNT * EHCI_PAGE_SIZE;
-			/*
-			 * However, if the input buffer is not page-aligned, the
-			 * portion of the first page before the buffer start
-			 * offset within that page is unusable.
-			 */
-			xfr_bytes -= (uint32_t)buf_ptr & (EHCI_PAGE_SIZE - 1);
-			/*
-			 * In order to keep each packet within a qTD transfer,
-			 * align the qTD transfer size to PKT_ALIGN.
-			 */
-			xfr_bytes &= ~(PKT_ALIGN - 1);
-			/*
-			 * This transfer may be shorter than the available qTD
-			 * transfer size that has just been computed.
-			 */
-			xfr_bytes = min(xfr_bytes, left_length);
-
-			/*
-			 * Setup request qTD (3.5 in ehci-r10.pdf)
-			 *
-			 *   qt_next ................ 03-00 H
-			 *   qt_altnext ............. 07-04 H
-			 *   qt_token ............... 0B-08 H
-			 *
-			 *   [ buffer, buffer_hi ] loaded with "buffer".
-			 */
-			qtd[qtd_counter].qt_next =
-					cpu_to_hc32(QT_NEXT_TERMINATE);
-			qtd[qtd_counter].qt_altnext =
-					cpu_to_hc32(QT_NEXT_TERMINATE);
-			token = QT_TOKEN_DT(toggle) |
-				QT_TOKEN_TOTALBYTES(xfr_bytes) |
-				QT_TOKEN_IOC(req == NULL) | QT_TOKEN_CPAGE(0) |
-				QT_TOKEN_CERR(3) |
-				QT_TOKEN_PID(usb_pipein(pipe) ?
-					QT_TOKEN_PID_IN : QT_TOKEN_PID_OUT) |
-				QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE);
-			qtd[qtd_counter].qt_token = cpu_to_hc32(token);
-			if (ehci_td_buffer(&qtd[qtd_counter], buf_ptr,
-						xfr_bytes)) {
-				printf("unable to construct DATA TD\n");
-				goto fail;
-			}
-			/* Update previous qTD! */
-			*tdp = cpu_to_hc32((uint32_t)&qtd[qtd_counter]);
-			tdp = &qtd[qtd_counter++].qt_next;
-			/*
-			 * Data toggle has to be adjusted since the qTD transfer
-			 * size is not always an even multiple of
-			 * wMaxPacketSize.
-			 */
-			if ((xfr_bytes / maxpacket) & 1)
-				toggle ^= 1;
-			buf_ptr += xfr_bytes;
-			left_length -= xfr_bytes;
-		} while (left_length > 0);
+		ret = ehci_data_tds(dev, &qtd[qtd_counter], &tdp, pipe,
+				    buffer, length, &toggle, req == NULL);
+		if (ret < 0)
+			goto fail;
+		qtd_counter += ret;
+		ret = 0;
 	}
 
 	if (req != NULL) {
@@ -628,11 +673,9 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 #endif
 	}
 
-	free(qtd);
 	return (dev->status != USB_ST_NOT_PROC) ? 0 : -1;
 
 fail:
-	free(qtd);
 	return -1;
 }
 
@@ -920,6 +963,9 @@ unknown:
 int usb_lowlevel_stop(int index)
 {
 	ehci_shutdown(&ehcic[index]);
+	free(ehcic[index].td_pool);
+	ehcic[index].td_pool = NULL;
+	ehcic[index].td_pool_size = 0;
 	return ehci_hcd_stop(index);
 }
 
@@ -1063,6 +1109,240 @@ submit_bulk_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 	return ehci_submit_async(dev, pipe, buffer, length, NULL);
 }
 
+/* Convert the status of a halted or completed qTD to a USB_ST_... value */
+static unsigned long ehci_token_status(uint32_t token)
+{
+	switch (QT_TOKEN_GET_STATUS(token) &
+		~(QT_TOKEN_STATUS_SPLITXSTATE | QT_TOKEN_STATUS_PERR)) {
+	case 0:
+		return 0;
+	case QT_TOKEN_STATUS_HALTED:
+		return USB_ST_STALLED;
+	case QT_TOKEN_STATUS_ACTIVE | QT_TOKEN_STATUS_DATBUFERR:
+	case QT_TOKEN_STATUS_DATBUFERR:
+		return USB_ST_BUF_ERR;
+	case QT_TOKEN_STATUS_HALTED | QT_TOKEN_STATUS_BABBLEDET:
+	case QT_TOKEN_STATUS_BABBLEDET:
+		return USB_ST_BABBLE_DET;
+	default:
+		if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)
+			return USB_ST_NOT_PROC;
+		if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
+			return USB_ST_CRC_ERR | USB_ST_STALLED;
+		return USB_ST_CRC_ERR;
+	}
+}
+
+/*
+ * Run the bulk transfers with one QH for each of the two pipes, both in the
+ * async schedule at once. The data toggle is kept in the QH, and a short
+ * packet moves on to the next transfer on the same pipe.
+ */
+int submit_bulk_queue(struct usb_device *dev, struct usb_bulk_xfer *xfer,
+		      int count)
+{
+	struct ehci_ctrl *ctrl = dev->controller;
+	unsigned long pipes[2] = { 0, 0 };
+	int first[USB_MAX_BULK_QUEUE + 1];
+	uint32_t *tdp[2], *link;
+	int last[2] = { -1, -1 };
+	uint32_t token, endpt, toggle, cmd;
+	int qtd_count = 0, qtd_counter = 0;
+	int i, q, ep, ret, timeout;
+	struct qTD *qtd;
+	struct QH *qh;
+	bool busy;
+	ulong ts;
+
+	if (count > USB_MAX_BULK_QUEUE)
+		return -EINVAL;
+	/* Each QH handles one pipe, so there can be one IN and one OUT */
+	for (i = 0; i < count; i++) {
+		q = usb_pipein(xfer[i].pipe);
+		if (usb_pipetype(xfer[i].pipe) != PIPE_BULK || xfer[i].stream ||
+		    (pipes[q] && pipes[q] != xfer[i].pipe))
+			return -EINVAL;
+		pipes[q] = xfer[i].pipe;
+		qtd_count += ehci_data_td_count(xfer[i].buffer,
+						xfer[i].length);
+	}
+	qtd = ehci_alloc_tds(ctrl, qtd_count);
+	if (!qtd)
+		return -ENOMEM;
+
+	/* Set up the QHs, linked into the async schedule after qh_list */
+	link = &ctrl->qh_list.qh_link;
+	for (q = 0; q < 2; q++) {
+		if (!pipes[q])
+			continue;
+		qh = &ctrl->bulk_qh[q];
+		memset(qh, 0, sizeof(*qh));
+		ep = usb_pipeendpoint(pipes[q]);
+		endpt = QH_ENDPT1_RL(8) | QH_ENDPT1_C(0) |
+			QH_ENDPT1_MAXPKTLEN(usb_maxpacket(dev, pipes[q])) |
+			QH_ENDPT1_H(0) |
+			QH_ENDPT1_DTC(QH_ENDPT1_DTC_IGNORE_QTD_TD) |
+			QH_ENDPT1_EPS(ehci_encode_speed(dev->speed)) |
+			QH_ENDPT1_ENDPT(ep) | QH_ENDPT1_I(0) |
+			QH_ENDPT1_DEVADDR(usb_pipedevice(pipes[q]));
+		qh->qh_endpt1 = cpu_to_hc32(endpt);
+		endpt = QH_ENDPT2_MULT(1) | QH_ENDPT2_PORTNUM(dev->portnr) |
+			QH_ENDPT2_HUBADDR(dev->parent->devnum) |
+			QH_ENDPT2_UFCMASK(0) | QH_ENDPT2_UFSMASK(0);
+		qh->qh_endpt2 = cpu_to_hc32(endpt);
+		qh->qh_overlay.qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+		qh->qh_overlay.qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+		toggle = usb_gettoggle(dev, ep, usb_pipeout(pipes[q]));
+		qh->qh_overlay.qt_token = cpu_to_hc32(QT_TOKEN_DT(toggle));
+		tdp[q] = &qh->qh_overlay.qt_next;
+		*link = cpu_to_hc32((uint32_t)qh | QH_LINK_TYPE_QH);
+		link = &qh->qh_link;
+	}
+	*link = cpu_to_hc32((uint32_t)&ctrl->qh_list | QH_LINK_TYPE_QH);
+
+	for (i = 0; i < count; i++) {
+		q = usb_pipein(xfer[i].pipe);
+		/* The QH ignores the toggle in the qTDs */
+		toggle = 0;
+		first[i] = qtd_counter;
+		ret = ehci_data_tds(dev, &qtd[qtd_counter], &tdp[q],
+				    xfer[i].pipe, xfer[i].buffer,
+				    xfer[i].length, &toggle, 0);
+		if (ret < 0)
+			return -EINVAL;
+		qtd_counter += ret;
+		last[q] = qtd_counter - 1;
+		xfer[i].actual = 0;
+		xfer[i].status = USB_ST_NOT_PROC;
+	}
+	first[count] = qtd_counter;
+
+	/* After a short packet, go on to the next transfer on the pipe */
+	for (i = 0; i < count; i++) {
+		uint32_t altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+		int j;
+
+		for (j = i + 1; j < count; j++) {
+			if (xfer[j].pipe == xfer[i].pipe) {
+				altnext = cpu_to_hc32((uint32_t)&qtd[first[j]]);
+				break;
+			}
+		}
+		for (j = first[i]; j < first[i + 1]; j++)
+			qtd[j].qt_altnext = altnext;
+	}
+
+	flush_dcache_range((uint32_t)&ctrl->qh_list,
+		ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+	flush_dcache_range((uint32_t)ctrl->bulk_qh,
+		ALIGN_END_ADDR(struct QH, ctrl->bulk_qh, 2));
+	flush_dcache_range((uint32_t)qtd,
+			   ALIGN_END_ADDR(struct qTD, qtd, qtd_count));
+
+	ehci_writel(&ctrl->hcor->or_asynclistaddr, (uint32_t)&ctrl->qh_list);
+	ehci_writel(&ctrl->hcor->or_usbsts,
+		    ehci_readl(&ctrl->hcor->or_usbsts) & 0x3f);
+	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+	ehci_writel(&ctrl->hcor->or_usbcmd, cmd | CMD_ASE);
+	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, STS_ASS,
+			100 * 1000);
+	if (ret < 0) {
+		printf("EHCI fail timeout STS_ASS set\n");
+		return ret;
+	}
+
+	/*
+	 * Wait for the last qTD on each pipe, or for either pipe to halt, as
+	 * the device then needs recovery before the other pipe can go on.
+	 */
+	ts = get_timer(0);
+	timeout = count * USB_TIMEOUT_MS(xfer[0].pipe);
+	do {
+		invalidate_dcache_range((uint32_t)ctrl->bulk_qh,
+			ALIGN_END_ADDR(struct QH, ctrl->bulk_qh, 2));
+		invalidate_dcache_range((uint32_t)qtd,
+			ALIGN_END_ADDR(struct qTD, qtd, qtd_count));
+		busy = false;
+		for (q = 0; q < 2; q++) {
+			if (!pipes[q])
+				continue;
+			qh = &ctrl->bulk_qh[q];
+			token = hc32_to_cpu(qh->qh_overlay.qt_token);
+			if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
+				break;
+			token = hc32_to_cpu(qtd[last[q]].qt_token);
+			if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)
+				busy = true;
+		}
+		if (q < 2)
+			break;
+		WATCHDOG_RESET();
+	} while (busy && get_timer(ts) < timeout);
+
+	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+	ehci_writel(&ctrl->hcor->or_usbcmd, cmd & ~CMD_ASE);
+	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, 0,
+			100 * 1000);
+	if (ret < 0) {
+		printf("EHCI fail timeout STS_ASS reset\n");
+		return ret;
+	}
+	if (busy)
+		printf("EHCI timed out on queued TDs\n");
+
+	invalidate_dcache_range((uint32_t)ctrl->bulk_qh,
+		ALIGN_END_ADDR(struct QH, ctrl->bulk_qh, 2));
+	invalidate_dcache_range((uint32_t)qtd,
+		ALIGN_END_ADDR(struct qTD, qtd, qtd_count));
+
+	/*
+	 * A short packet leaves the rest of the transfer's qTDs active, but
+	 * they still hold their full length.
+	 */
+	ret = 0;
+	dev->status = 0;
+	for (i = 0; i < count; i++) {
+		bool short_pkt = false;
+		int j, left = 0;
+
+		xfer[i].status = 0;
+		for (j = first[i]; j < first[i + 1]; j++) {
+			token = hc32_to_cpu(qtd[j].qt_token);
+			left += QT_TOKEN_GET_TOTALBYTES(token);
+			if (short_pkt)
+				continue;
+			xfer[i].status = ehci_token_status(token);
+			if (xfer[i].status)
+				break;
+			if (QT_TOKEN_GET_TOTALBYTES(token))
+				short_pkt = true;
+		}
+		for (j++; j < first[i + 1]; j++)
+			left += QT_TOKEN_GET_TOTALBYTES(
+					hc32_to_cpu(qtd[j].qt_token));
+		xfer[i].actual = xfer[i].length - left;
+		if (usb_pipein(xfer[i].pipe))
+			invalidate_dcache_range((uint32_t)xfer[i].buffer,
+				ALIGN((uint32_t)xfer[i].buffer +
+				      xfer[i].length, ARCH_DMA_MINALIGN));
+		if (xfer[i].status && !ret) {
+			dev->status = xfer[i].status;
+			ret = -EIO;
+		}
+	}
+	dev->act_len = xfer[count - 1].actual;
+
+	for (q = 0; q < 2; q++) {
+		if (!pipes[q])
+			continue;
+		token = hc32_to_cpu(ctrl->bulk_qh[q].qh_overlay.qt_token);
+		usb_settoggle(dev, usb_pipeendpoint(pipes[q]),
+			      usb_pipeout(pipes[q]), QT_TOKEN_GET_DT(token));
+	}
+
+	return ret;
+}
+
 int
 submit_control_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 		   int length, struct devrequest *setup)
@@ -1087,6 +1367,8 @@ struct int_queue {
 	struct QH *current;
 	struct QH *last;
 	struct qTD *tds;
+	unsigned long pipe;
+	int elementsize;
 };
 
 #define NEXT_QH(qh) (struct QH *)(hc32_to_cpu((qh)->qh_link) & ~0x1f)
@@ -1134,6 +1416,41 @@ disable_periodic(struct ehci_ctrl *ctrl)
 
 static int periodic_schedules;
 
+/*
+ * Makes each qTD of a queue active again, with the data toggles following on
+ * from the last transfer on the pipe, and points its QH at it
+ */
+static void arm_int_queue(struct usb_device *dev, struct int_queue *queue)
+{
+	unsigned long pipe = queue->pipe;
+	int queuesize = queue->last - queue->first + 1;
+	int toggle, i;
+
+	toggle = usb_gettoggle(dev, usb_pipeendpoint(pipe), usb_pipeout(pipe));
+	for (i = 0; i < queuesize; i++) {
+		struct QH *qh = queue->first + i;
+		struct qTD *td = queue->tds + i;
+
+		td->qt_token = cpu_to_hc32(QT_TOKEN_DT(toggle) |
+			QT_TOKEN_TOTALBYTES(queue->elementsize) |
+			QT_TOKEN_PID(usb_pipein(pipe) ? QT_TOKEN_PID_IN :
+				     QT_TOKEN_PID_OUT) |
+			QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE));
+		toggle ^= 1;
+
+		qh->qh_overlay.qt_next = cpu_to_hc32((uint32_t)td);
+		qh->qh_overlay.qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+		qh->qh_overlay.qt_token = 0;
+	}
+
+	/* The qTDs first, the controller may look at a QH at any time */
+	flush_dcache_range((uint32_t)queue->tds,
+			   ALIGN_END_ADDR(struct qTD, queue->tds, queuesize));
+	flush_dcache_range((uint32_t)queue->first,
+			   ALIGN_END_ADDR(struct QH, queue->first, queuesize));
+	queue->current = queue->first;
+}
+
 struct int_queue *
 create_int_queue(struct usb_device *dev, unsigned long pipe, int queuesize,
 		 int elementsize, void *buffer)
@@ -1212,9 +1529,6 @@ create_int_queue(struct usb_device *dev, unsigned long pipe, int queuesize,
 		td->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
 		debug("communication direction is '%s'\n",
 		      usb_pipein(pipe) ? "in" : "out");
-		td->qt_token = cpu_to_hc32((elementsize << 16) |
-			((usb_pipein(pipe) ? 1 : 0) << 8) | /* IN/OUT token */
-			0x80); /* active */
 		td->qt_buffer[0] =
 		    cpu_to_hc32((uint32_t)buffer + i * elementsize);
 		td->qt_buffer[1] =
@@ -1232,12 +1546,9 @@ create_int_queue(struct usb_device *dev, unsigned long pipe, int queuesize,
 	flush_dcache_range((uint32_t)buffer,
 			   ALIGN_END_ADDR(char, buffer,
 					  queuesize * elementsize));
-	flush_dcache_range((uint32_t)result->first,
-			   ALIGN_END_ADDR(struct QH, result->first,
-					  queuesize));
-	flush_dcache_range((uint32_t)result->tds,
-			   ALIGN_END_ADDR(struct qTD, result->tds,
-					  queuesize));
+	result->pipe = pipe;
+	result->elementsize = elementsize;
+	arm_int_queue(dev, result);
 
 	if (disable_periodic(ctrl) < 0) {
 		debug("FATAL: periodic should never fail, but did");
@@ -1277,27 +1588,38 @@ fail1:
 void *poll_int_queue(struct usb_device *dev, struct int_queue *queue)
 {
 	struct QH *cur = queue->current;
+	uint32_t token;
 
-	/* depleted queue */
+	/* depleted queue, give it back to the controller */
 	if (cur == NULL) {
 		debug("Exit poll_int_queue with completed queue\n");
+		arm_int_queue(dev, queue);
 		return NULL;
 	}
 	/* still active */
 	invalidate_dcache_range((uint32_t)cur,
 				ALIGN_END_ADDR(struct QH, cur, 1));
-	if (cur->qh_overlay.qt_token & cpu_to_hc32(0x80)) {
+	token = hc32_to_cpu(cur->qh_overlay.qt_token);
+	if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE) {
 		debug("Exit poll_int_queue with no completed intr transfer. "
-		      "token is %x\n", cur->qh_overlay.qt_token);
+		      "token is %x\n", token);
 		return NULL;
 	}
-	if (!(cur->qh_link & QH_LINK_TERMINATE))
+	if (cur != queue->last)
 		queue->current++;
 	else
 		queue->current = NULL;
 	debug("Exit poll_int_queue with completed intr transfer. "
-	      "token is %x at %p (first at %p)\n", cur->qh_overlay.qt_token,
+	      "token is %x at %p (first at %p)\n", token,
 	      &cur->qh_overlay.qt_token, queue->first);
+	if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
+		return NULL;
+
+	usb_dotoggle(dev, usb_pipeendpoint(queue->pipe),
+		     usb_pipeout(queue->pipe));
+	invalidate_dcache_range((uint32_t)cur->buffer,
+				ALIGN_END_ADDR(char, cur->buffer,
+					       queue->elementsize));
 	return cur->buffer;
 }
 
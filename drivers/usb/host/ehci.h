@@ -245,8 +245,12 @@ struct ehci_ctrl {
 	uint16_t portreset;
 	struct QH qh_list __aligned(USB_DMA_MINALIGN);
 	struct QH periodic_queue __aligned(USB_DMA_MINALIGN);
+	/* For submit_bulk_queue(), one for each direction */
+	struct QH bulk_qh[2] __aligned(USB_DMA_MINALIGN);
 	uint32_t *periodic_list;
 	int ntds;
+	struct qTD *td_pool;		/* qTDs for async transfers */
+	int td_pool_size;
 };
 
 /* Low level init functions */
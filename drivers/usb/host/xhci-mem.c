@@ -94,6 +94,31 @@ static void xhci_ring_free(struct xhci_ring *ring)
 	free(ring);
 }
 
+/**
+ * frees the rings of an endpoint, and its streams if it has them
+ *
+ * @param ep	pointer to the endpoint whose rings are to be freed
+ * @return none
+ */
+void xhci_free_ep_rings(struct xhci_virt_ep *ep)
+{
+	unsigned int i;
+
+	if (ep->ring)
+		xhci_ring_free(ep->ring);
+	ep->ring = NULL;
+
+	if (!ep->stream_ctx)
+		return;
+	for (i = 1; i <= ep->num_streams; i++)
+		xhci_ring_free(ep->stream_rings[i]);
+	free(ep->stream_rings);
+	free(ep->stream_ctx);
+	ep->stream_rings = NULL;
+	ep->stream_ctx = NULL;
+	ep->num_streams = 0;
+}
+
 /**
  * frees the "xhci_container_ctx" pointer passed
  *
@@ -130,8 +155,7 @@ static void xhci_free_virt_devices(struct xhci_ctrl *ctrl)
 		ctrl->dcbaa->dev_context_ptrs[slot_id] = 0;
 
 		for (i = 0; i < 31; ++i)
-			if (virt_dev->eps[i].ring)
-				xhci_ring_free(virt_dev->eps[i].ring);
+			xhci_free_ep_rings(&virt_dev->eps[i]);
 
 		if (virt_dev->in_ctx)
 			xhci_free_container_ctx(virt_dev->in_ctx);
@@ -318,6 +342,39 @@ struct xhci_ring *xhci_ring_alloc(unsigned int num_segs, bool link_trbs)
 	return ring;
 }
 
+/**
+ * Allocates a Linear Stream Array for an endpoint, with a ring for each of
+ * its streams. Stream 0 is reserved, so the array has one entry more than
+ * there are streams. See section 4.12.2 of XHCI Spec rev1.0.
+ *
+ * @param ep		pointer to the endpoint, which must have no rings
+ * @param num_streams	number of streams, one less than a power of two
+ * @return none
+ */
+void xhci_alloc_streams(struct xhci_virt_ep *ep, unsigned int num_streams)
+{
+	struct xhci_ring *ring;
+	unsigned int i;
+	u64 val_64;
+
+	ep->stream_ctx = xhci_malloc((num_streams + 1) *
+				     sizeof(struct xhci_stream_ctx));
+	ep->stream_rings = calloc(num_streams + 1, sizeof(struct xhci_ring *));
+	BUG_ON(!ep->stream_rings);
+
+	for (i = 1; i <= num_streams; i++) {
+		ring = xhci_ring_alloc(1, true);
+		ep->stream_rings[i] = ring;
+		val_64 = (uintptr_t)ring->enqueue;
+		ep->stream_ctx[i].stream_ring = cpu_to_le64(val_64 |
+				SCT_FOR_CTX(SCT_PRI_TR) | ring->cycle_state);
+	}
+	ep->num_streams = num_streams;
+
+	xhci_flush_cache((uint32_t)ep->stream_ctx,
+			 (num_streams + 1) * sizeof(struct xhci_stream_ctx));
+}
+
 /**
  * Allocates the Container context
  *
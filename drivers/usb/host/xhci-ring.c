@@ -345,12 +345,13 @@ static u32 xhci_v1_0_td_remainder(int running_total,
  *
  * @param udev		pointer to the USB device structure
  * @param ep_index	index of the endpoint
+ * @param stream_id	stream of the endpoint, or 0
  * @param start_cycle	cycle flag of the first TRB
  * @param start_trb	pionter to the first TRB
  * @return none
  */
 static void giveback_first_trb(struct usb_device *udev, int ep_index,
-				int start_cycle,
+				unsigned int stream_id, int start_cycle,
 				struct xhci_generic_trb *start_trb)
 {
 	struct xhci_ctrl *ctrl = udev->controller;
@@ -368,7 +369,7 @@ static void giveback_first_trb(struct usb_device *udev, int ep_index,
 
 	/* Ringing EP doorbell here */
 	xhci_writel(&ctrl->dba->doorbell[udev->slot_id],
-				DB_VALUE(ep_index, 0));
+				DB_VALUE(ep_index, stream_id));
 
 	return;
 }
@@ -393,8 +394,85 @@ void xhci_acknowledge_event(struct xhci_ctrl *ctrl)
 		(uintptr_t)ctrl->event_ring->dequeue | ERST_EHB);
 }
 
+/*
+ * Checks whether a TRB is one of those from @first to @last on a ring of one
+ * segment, where a TD may wrap around the end of the segment
+ */
+static bool trb_in_td(struct xhci_ring *ring, struct xhci_generic_trb *first,
+		      struct xhci_generic_trb *last, void *trb)
+{
+	void *start = ring->first_seg->trbs;
+
+	if (trb < start || trb >= start + SEGMENT_SIZE)
+		return false;
+	if ((void *)first <= (void *)last)
+		return trb >= (void *)first && trb <= (void *)last;
+
+	return trb >= (void *)first || trb <= (void *)last;
+}
+
+/* An element of an interrupt queue, a TD of its own on the ring */
+struct int_queue_td {
+	struct xhci_generic_trb *first;
+	struct xhci_generic_trb *last;
+	int code;		/* Completion code, or -1 while running */
+};
+
+struct int_queue {
+	struct usb_device *udev;
+	unsigned long pipe;
+	int ep_index;
+	int queuesize;
+	int elementsize;
+	void *buffer;
+	int next;		/* Element to return next, queuesize for none */
+	struct int_queue_td tds[];
+};
+
+/*
+ * Records the completion of an element of an interrupt queue, which cannot
+ * wait for the next poll_int_queue() on the event ring
+ *
+ * @param ctrl	Host controller data structure
+ * @param event	event TRB
+ * @return true if the event was for an interrupt queue
+ */
+static bool int_queue_event(struct xhci_ctrl *ctrl, union xhci_trb *event)
+{
+	u32 field = le32_to_cpu(event->trans_event.flags);
+	struct xhci_virt_device *virt_dev;
+	struct int_queue *queue;
+	struct int_queue_td *td;
+	struct xhci_ring *ring;
+	void *trb;
+	int i;
+
+	if (TRB_FIELD_TO_TYPE(field) != TRB_TRANSFER)
+		return false;
+	virt_dev = ctrl->devs[TRB_TO_SLOT_ID(field)];
+	if (!virt_dev)
+		return false;
+	queue = virt_dev->eps[TRB_TO_EP_INDEX(field)].intq;
+	if (!queue)
+		return false;
+
+	ring = virt_dev->eps[queue->ep_index].ring;
+	trb = (void *)(uintptr_t)le64_to_cpu(event->trans_event.buffer);
+	for (i = 0; i < queue->queuesize; i++) {
+		td = &queue->tds[i];
+		if (td->code < 0 && trb_in_td(ring, td->first, td->last, trb)) {
+			td->code = GET_COMP_CODE(le32_to_cpu(
+					event->trans_event.transfer_len));
+			break;
+		}
+	}
+
+	return true;
+}
+
 /**
- * Checks if there is a new event to handle on the event ring.
+ * Checks if there is a new event to handle on the event ring. Those for
+ * interrupt queues are handled here and never seen by the caller.
  *
  * @param ctrl	Host controller data structure
  * @return 0 if failure else 1 on success
@@ -403,17 +481,21 @@ static int event_ready(struct xhci_ctrl *ctrl)
 {
 	union xhci_trb *event;
 
-	xhci_inval_cache((uint32_t)ctrl->event_ring->dequeue,
-					sizeof(union xhci_trb));
+	for (;;) {
+		xhci_inval_cache((uint32_t)ctrl->event_ring->dequeue,
+				 sizeof(union xhci_trb));
 
-	event = ctrl->event_ring->dequeue;
+		event = ctrl->event_ring->dequeue;
 
-	/* Does the HC or OS own the TRB? */
-	if ((le32_to_cpu(event->event_cmd.flags) & TRB_CYCLE) !=
-		ctrl->event_ring->cycle_state)
-		return 0;
+		/* Does the HC or OS own the TRB? */
+		if ((le32_to_cpu(event->event_cmd.flags) & TRB_CYCLE) !=
+			ctrl->event_ring->cycle_state)
+			return 0;
 
-	return 1;
+		if (!int_queue_event(ctrl, event))
+			return 1;
+		xhci_acknowledge_event(ctrl);
+	}
 }
 
 /**
@@ -431,11 +513,12 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected)
 	unsigned long ts = get_timer(0);
 
 	do {
-		union xhci_trb *event = ctrl->event_ring->dequeue;
+		union xhci_trb *event;
 
 		if (!event_ready(ctrl))
 			continue;
 
+		event = ctrl->event_ring->dequeue;
 		type = TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags));
 		if (type == expected)
 			return event;
@@ -507,90 +590,61 @@ static void abort_td(struct usb_device *udev, int ep_index)
 	xhci_acknowledge_event(ctrl);
 }
 
-static void record_transfer_result(struct usb_device *udev,
-				   union xhci_trb *event, int length)
+/*
+ * Converts the completion code of a transfer event to a USB_ST_... status
+ *
+ * @param code	completion code
+ * @return USB_ST_... status, 0 on success
+ */
+static unsigned long comp_code_to_status(int code)
 {
-	udev->act_len = min(length, length -
-		EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len)));
-
-	switch (GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len))) {
+	switch (code) {
 	case COMP_SUCCESS:
-		BUG_ON(udev->act_len != length);
-		/* fallthrough */
 	case COMP_SHORT_TX:
-		udev->status = 0;
-		break;
+		return 0;
 	case COMP_STALL:
-		udev->status = USB_ST_STALLED;
-		break;
+		return USB_ST_STALLED;
 	case COMP_DB_ERR:
 	case COMP_TRB_ERR:
-		udev->status = USB_ST_BUF_ERR;
-		break;
+		return USB_ST_BUF_ERR;
 	case COMP_BABBLE:
-		udev->status = USB_ST_BABBLE_DET;
-		break;
+		return USB_ST_BABBLE_DET;
 	default:
-		udev->status = 0x80;  /* USB_ST_TOO_LAZY_TO_MAKE_A_NEW_MACRO */
+		return 0x80;  /* USB_ST_TOO_LAZY_TO_MAKE_A_NEW_MACRO */
 	}
 }
 
+static void record_transfer_result(struct usb_device *udev,
+				   union xhci_trb *event, int length)
+{
+	int code = GET_COMP_CODE(le32_to_cpu(event->trans_event.transfer_len));
+
+	udev->act_len = min(length, length -
+		EVENT_TRB_LEN(le32_to_cpu(event->trans_event.transfer_len)));
+
+	BUG_ON(code == COMP_SUCCESS && udev->act_len != length);
+	udev->status = comp_code_to_status(code);
+}
+
 /**** Bulk and Control transfer methods ****/
 /**
- * Queues up the BULK Request
+ * Counts the TRBs needed for a bulk transfer. The buffer of a TRB must not
+ * cross a 64KB boundary (TABLE 49 and 6.4.1 section of XHCI Spec), so the
+ * transfer is split into one TRB for each 64KB chunk it touches.
  *
- * @param udev		pointer to the USB device structure
- * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param buffer	buffer to be read/written
  * @param length	length of the buffer
- * @param buffer	buffer to be read/written based on the request
- * @return returns 0 if successful else -1 on failure
+ * @return number of TRBs
  */
-int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
-			int length, void *buffer)
+static int bulk_trb_count(void *buffer, int length)
 {
 	int num_trbs = 0;
-	struct xhci_generic_trb *start_trb;
-	bool first_trb = 0;
-	int start_cycle;
-	u32 field = 0;
-	u32 length_field = 0;
-	struct xhci_ctrl *ctrl = udev->controller;
-	int slot_id = udev->slot_id;
-	int ep_index;
-	struct xhci_virt_device *virt_dev;
-	struct xhci_ep_ctx *ep_ctx;
-	struct xhci_ring *ring;		/* EP transfer ring */
-	union xhci_trb *event;
-
-	int running_total, trb_buff_len;
-	unsigned int total_packet_count;
-	int maxpacketsize;
-	u64 addr;
-	int ret;
-	u32 trb_fields[4];
+	int running_total;
 	u64 val_64 = (uintptr_t)buffer;
 
-	debug("dev=%p, pipe=%lx, buffer=%p, length=%d\n",
-		udev, pipe, buffer, length);
-
-	ep_index = usb_pipe_ep_index(pipe);
-	virt_dev = ctrl->devs[slot_id];
-
-	xhci_inval_cache((uint32_t)virt_dev->out_ctx->bytes,
-					virt_dev->out_ctx->size);
-
-	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
-
-	ring = virt_dev->eps[ep_index].ring;
-	/*
-	 * How much data is (potentially) left before the 64KB boundary?
-	 * XHCI Spec puts restriction( TABLE 49 and 6.4.1 section of XHCI Spec)
-	 * that the buffer should not span 64KB boundary. if so
-	 * we send request in more than 1 TRB by chaining them.
-	 */
+	/* How much data is (potentially) left before the 64KB boundary? */
 	running_total = TRB_MAX_BUFF_SIZE -
 			(lower_32_bits(val_64) & (TRB_MAX_BUFF_SIZE - 1));
-	trb_buff_len = running_total;
 	running_total &= TRB_MAX_BUFF_SIZE - 1;
 
 	/*
@@ -606,15 +660,42 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		running_total += TRB_MAX_BUFF_SIZE;
 	}
 
-	/*
-	 * XXX: Calling routine prepare_ring() called in place of
-	 * prepare_trasfer() as there in 'Linux' since we are not
-	 * maintaining multiple TDs/transfer at the same time.
-	 */
-	ret = prepare_ring(ctrl, ring,
-			   le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK);
-	if (ret < 0)
-		return ret;
+	return num_trbs;
+}
+
+/**
+ * Queues the TRBs of a bulk transfer on a ring, without giving them to the
+ * hardware
+ *
+ * @param udev		pointer to the USB device structure
+ * @param ring		endpoint or stream ring
+ * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param length	length of the buffer
+ * @param buffer	buffer to be read/written based on the request
+ * @param start_cycle	set to the cycle flag to give to the first TRB
+ * @param last		if not NULL, set to the last TRB
+ * @return pointer to the first TRB
+ */
+static struct xhci_generic_trb *queue_bulk_trbs(struct usb_device *udev,
+		struct xhci_ring *ring, unsigned long pipe, int length,
+		void *buffer, int *start_cycle, struct xhci_generic_trb **last)
+{
+	int num_trbs;
+	struct xhci_generic_trb *start_trb, *trb;
+	bool first_trb = 0;
+	u32 field = 0;
+	u32 length_field = 0;
+	struct xhci_ctrl *ctrl = udev->controller;
+	int running_total, trb_buff_len;
+	unsigned int total_packet_count;
+	int maxpacketsize;
+	u64 addr;
+	u32 trb_fields[4];
+	u64 val_64 = (uintptr_t)buffer;
+
+	num_trbs = bulk_trb_count(buffer, length);
+	trb_buff_len = TRB_MAX_BUFF_SIZE -
+			(lower_32_bits(val_64) & (TRB_MAX_BUFF_SIZE - 1));
 
 	/*
 	 * Don't give the first TRB to the hardware (by toggling the cycle bit)
@@ -622,7 +703,7 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	 * state may change as we enqueue the other TRBs, so save it too.
 	 */
 	start_trb = &ring->enqueue->generic;
-	start_cycle = ring->cycle_state;
+	*start_cycle = ring->cycle_state;
 
 	running_total = 0;
 	maxpacketsize = usb_maxpacket(udev, pipe);
@@ -630,12 +711,6 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	total_packet_count = DIV_ROUND_UP(length, maxpacketsize);
 
 	/* How much data is in the first TRB? */
-	/*
-	 * How much data is (potentially) left before the 64KB boundary?
-	 * XHCI Spec puts restriction( TABLE 49 and 6.4.1 section of XHCI Spec)
-	 * that the buffer should not span 64KB boundary. if so
-	 * we send request in more than 1 TRB by chaining them.
-	 */
 	addr = val_64;
 
 	if (trb_buff_len > length)
@@ -653,7 +728,7 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		/* Don't change the cycle bit of the first TRB until later */
 		if (first_trb) {
 			first_trb = false;
-			if (start_cycle == 0)
+			if (*start_cycle == 0)
 				field |= TRB_CYCLE;
 		} else {
 			field |= ring->cycle_state;
@@ -692,7 +767,7 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_fields[2] = length_field;
 		trb_fields[3] = field | (TRB_NORMAL << TRB_TYPE_SHIFT);
 
-		queue_trb(ctrl, ring, (num_trbs > 1), trb_fields);
+		trb = queue_trb(ctrl, ring, (num_trbs > 1), trb_fields);
 
 		--num_trbs;
 
@@ -703,7 +778,66 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_buff_len = min((length - running_total), TRB_MAX_BUFF_SIZE);
 	} while (running_total < length);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	if (last)
+		*last = trb;
+
+	return start_trb;
+}
+
+/**
+ * Queues up the BULK Request
+ *
+ * @param udev		pointer to the USB device structure
+ * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param length	length of the buffer
+ * @param buffer	buffer to be read/written based on the request
+ * @return returns 0 if successful else -1 on failure
+ */
+int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
+			int length, void *buffer)
+{
+	struct xhci_generic_trb *start_trb;
+	int start_cycle;
+	u32 field = 0;
+	struct xhci_ctrl *ctrl = udev->controller;
+	int slot_id = udev->slot_id;
+	int ep_index;
+	struct xhci_virt_device *virt_dev;
+	struct xhci_ep_ctx *ep_ctx;
+	struct xhci_ring *ring;		/* EP transfer ring */
+	union xhci_trb *event;
+	int ret;
+
+	debug("dev=%p, pipe=%lx, buffer=%p, length=%d\n",
+		udev, pipe, buffer, length);
+
+	ep_index = usb_pipe_ep_index(pipe);
+	virt_dev = ctrl->devs[slot_id];
+
+	xhci_inval_cache((uint32_t)virt_dev->out_ctx->bytes,
+					virt_dev->out_ctx->size);
+
+	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
+
+	/* An endpoint with streams can only be used by xhci_bulk_queue() */
+	ring = virt_dev->eps[ep_index].ring;
+	if (!ring)
+		return -EINVAL;
+
+	/*
+	 * XXX: Calling routine prepare_ring() called in place of
+	 * prepare_trasfer() as there in 'Linux' since we are not
+	 * maintaining multiple TDs/transfer at the same time.
+	 */
+	ret = prepare_ring(ctrl, ring,
+			   le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK);
+	if (ret < 0)
+		return ret;
+
+	start_trb = queue_bulk_trbs(udev, ring, pipe, length, buffer,
+				    &start_cycle, NULL);
+
+	giveback_first_trb(udev, ep_index, 0, start_cycle, start_trb);
 
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event) {
@@ -727,6 +861,232 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	return (udev->status != USB_ST_NOT_PROC) ? 0 : -1;
 }
 
+/*
+ * Returns the ring of a stream of an endpoint, or that of the endpoint itself
+ * for stream 0, or NULL if there is no such ring
+ */
+static struct xhci_ring *xhci_stream_ring(struct xhci_virt_ep *ep,
+					  unsigned int stream_id)
+{
+	if (!ep->stream_ctx)
+		return stream_id ? NULL : ep->ring;
+	if (!stream_id || stream_id > ep->num_streams)
+		return NULL;
+
+	return ep->stream_rings[stream_id];
+}
+
+/*
+ * Waits for the completion of a command, dropping the transfer events which
+ * come first, e.g. for the TDs stopped by it
+ *
+ * @param ctrl	Host controller data structure
+ * @return completion code of the command
+ */
+static int wait_for_command(struct xhci_ctrl *ctrl)
+{
+	union xhci_trb *event;
+	unsigned long ts = get_timer(0);
+	int code;
+
+	do {
+		if (!event_ready(ctrl))
+			continue;
+
+		event = ctrl->event_ring->dequeue;
+		if (TRB_FIELD_TO_TYPE(le32_to_cpu(event->event_cmd.flags)) ==
+		    TRB_COMPLETION) {
+			code = GET_COMP_CODE(le32_to_cpu(
+						event->event_cmd.status));
+			xhci_acknowledge_event(ctrl);
+			return code;
+		}
+		xhci_acknowledge_event(ctrl);
+	} while (get_timer(ts) < XHCI_TIMEOUT);
+
+	puts("XHCI timeout on command completion... cannot recover.\n");
+	BUG();
+}
+
+/*
+ * Throws away the TDs left on a ring by setting the xHC's dequeue pointer to
+ * our enqueue pointer. The endpoint must be stopped or halted.
+ */
+static void set_ring_deq(struct usb_device *udev, int ep_index,
+			 unsigned int stream_id, struct xhci_ring *ring)
+{
+	struct xhci_ctrl *ctrl = udev->controller;
+	u64 val_64 = (uintptr_t)ring->enqueue;
+	u32 fields[4];
+	int code;
+
+	BUG_ON(prepare_ring(ctrl, ctrl->cmd_ring, EP_STATE_RUNNING));
+
+	fields[0] = lower_32_bits(val_64) | ring->cycle_state;
+	if (stream_id)
+		fields[0] |= SCT_FOR_TRB(SCT_PRI_TR);
+	fields[1] = upper_32_bits(val_64);
+	fields[2] = STREAM_ID_FOR_TRB(stream_id);
+	fields[3] = TRB_TYPE(TRB_SET_DEQ) | EP_ID_FOR_TRB(ep_index) |
+		    SLOT_ID_FOR_TRB(udev->slot_id) |
+		    ctrl->cmd_ring->cycle_state;
+	queue_trb(ctrl, ctrl->cmd_ring, false, fields);
+	xhci_writel(&ctrl->dba->doorbell[0], DB_VALUE_HOST);
+
+	code = wait_for_command(ctrl);
+	if (code != COMP_SUCCESS)
+		debug("Set TR Dequeue returned completion code %d\n", code);
+}
+
+/**
+ * Queues up several BULK Requests at once, each on the ring of its endpoint
+ * or stream, and waits for them all. Those on the same ring run in turn, and
+ * those on different rings independently of each other. A failed transfer
+ * halts its endpoint, leaving the rest on it not run. Their TDs, and those
+ * of transfers which time out, are thrown away.
+ *
+ * @param udev	pointer to the USB device structure
+ * @param xfer	transfers
+ * @param count	number of transfers, at most USB_MAX_BULK_QUEUE
+ * @return 0 if all transfers succeeded, -EINVAL if they cannot be queued
+ * (nothing was sent), -ETIMEDOUT if one did not complete, -EIO if one failed
+ */
+int xhci_bulk_queue(struct usb_device *udev, struct usb_bulk_xfer *xfer,
+		    int count)
+{
+	struct xhci_ctrl *ctrl = udev->controller;
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_generic_trb *first[USB_MAX_BULK_QUEUE];
+	struct xhci_generic_trb *last[USB_MAX_BULK_QUEUE];
+	struct xhci_generic_trb *trb;
+	struct xhci_ring *ring[USB_MAX_BULK_QUEUE];
+	int ep_index[USB_MAX_BULK_QUEUE];
+	u32 ep_state[USB_MAX_BULK_QUEUE];
+	bool done[USB_MAX_BULK_QUEUE];
+	struct xhci_ep_ctx *ep_ctx;
+	union xhci_trb *event;
+	u32 halted = 0, stopped = 0, bit;
+	int i, j, trbs, pending, start_cycle, code, ret;
+	u32 field;
+	u64 addr;
+	ulong ts;
+
+	if (count > USB_MAX_BULK_QUEUE)
+		return -EINVAL;
+
+	/* Check everything first, so that nothing is sent if one is bad */
+	xhci_inval_cache((uint32_t)virt_dev->out_ctx->bytes,
+			 virt_dev->out_ctx->size);
+	for (i = 0; i < count; i++) {
+		if (usb_pipetype(xfer[i].pipe) != PIPE_BULK)
+			return -EINVAL;
+		ep_index[i] = usb_pipe_ep_index(xfer[i].pipe);
+		ring[i] = xhci_stream_ring(&virt_dev->eps[ep_index[i]],
+					   xfer[i].stream);
+		if (!ring[i])
+			return -EINVAL;
+
+		ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index[i]);
+		ep_state[i] = le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK;
+		if (ep_state[i] != EP_STATE_RUNNING &&
+		    ep_state[i] != EP_STATE_STOPPED)
+			return -EINVAL;
+
+		/* The TDs on each ring must fit in its single segment */
+		trbs = 0;
+		for (j = 0; j <= i; j++) {
+			if (ring[j] == ring[i])
+				trbs += bulk_trb_count(xfer[j].buffer,
+						       xfer[j].length);
+		}
+		if (trbs > TRBS_PER_SEGMENT - 2)
+			return -EINVAL;
+	}
+
+	for (i = 0; i < count; i++) {
+		prepare_ring(ctrl, ring[i], ep_state[i]);
+		first[i] = queue_bulk_trbs(udev, ring[i], xfer[i].pipe,
+					   xfer[i].length, xfer[i].buffer,
+					   &start_cycle, &last[i]);
+		giveback_first_trb(udev, ep_index[i], xfer[i].stream,
+				   start_cycle, first[i]);
+		xfer[i].actual = 0;
+		xfer[i].status = USB_ST_NOT_PROC;
+		done[i] = false;
+	}
+
+	ts = get_timer(0);
+	do {
+		/* Count what is left to run, on endpoints still going */
+		pending = 0;
+		for (i = 0; i < count; i++) {
+			if (!done[i] && !(halted & (1 << ep_index[i])))
+				pending++;
+		}
+		if (!pending || !event_ready(ctrl))
+			continue;
+
+		event = ctrl->event_ring->dequeue;
+		field = le32_to_cpu(event->trans_event.flags);
+		if (TRB_FIELD_TO_TYPE(field) != TRB_TRANSFER ||
+		    TRB_TO_SLOT_ID(field) != udev->slot_id) {
+			xhci_acknowledge_event(ctrl);
+			continue;
+		}
+
+		trb = (void *)(uintptr_t)le64_to_cpu(event->trans_event.buffer);
+		for (i = 0; i < count; i++) {
+			if (!done[i] && ep_index[i] == TRB_TO_EP_INDEX(field) &&
+			    trb_in_td(ring[i], first[i], last[i], trb))
+				break;
+		}
+		if (i < count) {
+			code = GET_COMP_CODE(le32_to_cpu(
+					event->trans_event.transfer_len));
+			xfer[i].status = comp_code_to_status(code);
+			if (xfer[i].status)
+				halted |= 1 << ep_index[i];
+
+			/* What came before this TRB, and what it moved */
+			addr = le32_to_cpu(trb->field[0]) |
+			       (u64)le32_to_cpu(trb->field[1]) << 32;
+			xfer[i].actual = addr - (uintptr_t)xfer[i].buffer +
+				(le32_to_cpu(trb->field[2]) & TRB_LEN_MASK) -
+				EVENT_TRB_LEN(le32_to_cpu(
+					event->trans_event.transfer_len));
+			xhci_inval_cache((uint32_t)xfer[i].buffer,
+					 xfer[i].length);
+			done[i] = true;
+		}
+		xhci_acknowledge_event(ctrl);
+	} while (pending && get_timer(ts) < XHCI_TIMEOUT);
+
+	/*
+	 * Get the endpoints going again without what is left on them. The
+	 * dequeue pointer of a halted endpoint is still on the failed TD.
+	 */
+	ret = 0;
+	for (i = 0; i < count; i++) {
+		bit = 1 << ep_index[i];
+		if (xfer[i].status && ret != -ETIMEDOUT)
+			ret = -EIO;
+		if (!done[i] && !(halted & bit))
+			ret = -ETIMEDOUT;
+		if (done[i] && !(halted & bit))
+			continue;
+		if (!(stopped & bit)) {
+			xhci_queue_command(ctrl, NULL, udev->slot_id,
+					   ep_index[i], halted & bit ?
+					   TRB_RESET_EP : TRB_STOP_RING);
+			wait_for_command(ctrl);
+			stopped |= bit;
+		}
+		set_ring_deq(udev, ep_index[i], xfer[i].stream, ring[i]);
+	}
+
+	return ret;
+}
+
 /**
  * Queues up the Control Transfer Request
  *
@@ -900,7 +1260,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 	queue_trb(ctrl, ep_ring, false, trb_fields);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	giveback_first_trb(udev, ep_index, 0, start_cycle, start_trb);
 
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event)
@@ -937,3 +1297,170 @@ abort:
 	udev->act_len = 0;
 	return -ETIMEDOUT;
 }
+
+/**** Interrupt queues ****/
+
+/*
+ * Stops or resets the endpoint of an interrupt queue, throwing away what is
+ * left of it on the ring
+ */
+static void int_queue_stop(struct int_queue *queue)
+{
+	struct usb_device *udev = queue->udev;
+	struct xhci_ctrl *ctrl = udev->controller;
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_ep_ctx *ep_ctx;
+	u32 ep_state;
+
+	xhci_inval_cache((uint32_t)virt_dev->out_ctx->bytes,
+			 virt_dev->out_ctx->size);
+	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, queue->ep_index);
+	ep_state = le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK;
+	if (ep_state == EP_STATE_HALTED || ep_state == EP_STATE_RUNNING) {
+		xhci_queue_command(ctrl, NULL, udev->slot_id, queue->ep_index,
+				   ep_state == EP_STATE_HALTED ?
+				   TRB_RESET_EP : TRB_STOP_RING);
+		wait_for_command(ctrl);
+	}
+	set_ring_deq(udev, queue->ep_index, 0,
+		     virt_dev->eps[queue->ep_index].ring);
+}
+
+/* Queues a TD for each element of an interrupt queue */
+static void int_queue_start(struct int_queue *queue)
+{
+	struct usb_device *udev = queue->udev;
+	struct xhci_ctrl *ctrl = udev->controller;
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_ring *ring = virt_dev->eps[queue->ep_index].ring;
+	struct xhci_ep_ctx *ep_ctx;
+	struct int_queue_td *td;
+	int i, start_cycle;
+
+	xhci_inval_cache((uint32_t)virt_dev->out_ctx->bytes,
+			 virt_dev->out_ctx->size);
+	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, queue->ep_index);
+	prepare_ring(ctrl, ring, le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK);
+
+	for (i = 0; i < queue->queuesize; i++) {
+		td = &queue->tds[i];
+		td->code = -1;
+		td->first = queue_bulk_trbs(udev, ring, queue->pipe,
+					    queue->elementsize,
+					    queue->buffer +
+					    i * queue->elementsize,
+					    &start_cycle, &td->last);
+		giveback_first_trb(udev, queue->ep_index, 0, start_cycle,
+				   td->first);
+	}
+	queue->next = 0;
+}
+
+/**
+ * Creates an interrupt queue on an endpoint, with a TD for each element of
+ * @buffer, and starts it
+ *
+ * @param udev		pointer to the USB device
+ * @param pipe		interrupt pipe
+ * @param queuesize	number of elements
+ * @param elementsize	size of each element
+ * @param buffer	buffer for all elements, one after the other
+ * @return the queue, or NULL if it cannot be created
+ */
+struct int_queue *xhci_create_int_queue(struct usb_device *udev,
+					unsigned long pipe, int queuesize,
+					int elementsize, void *buffer)
+{
+	struct xhci_ctrl *ctrl = udev->controller;
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_virt_ep *virt_ep;
+	struct int_queue *queue;
+	int i, trbs = 0;
+
+	if (usb_pipetype(pipe) != PIPE_INTERRUPT || queuesize < 1)
+		return NULL;
+	virt_ep = &virt_dev->eps[usb_pipe_ep_index(pipe)];
+	if (!virt_ep->ring || virt_ep->intq)
+		return NULL;
+
+	/* The TDs must all fit in the single segment of the ring */
+	for (i = 0; i < queuesize; i++)
+		trbs += bulk_trb_count(buffer + i * elementsize, elementsize);
+	if (trbs > TRBS_PER_SEGMENT - 2)
+		return NULL;
+
+	queue = malloc(sizeof(*queue) + queuesize * sizeof(queue->tds[0]));
+	if (!queue)
+		return NULL;
+	queue->udev = udev;
+	queue->pipe = pipe;
+	queue->ep_index = usb_pipe_ep_index(pipe);
+	queue->queuesize = queuesize;
+	queue->elementsize = elementsize;
+	queue->buffer = buffer;
+
+	virt_ep->intq = queue;
+	int_queue_start(queue);
+
+	return queue;
+}
+
+/**
+ * Returns the next element of an interrupt queue which has completed. A
+ * failed one halts the endpoint, so it and those after it are skipped. Once
+ * they have all been returned, they are queued again by the next call.
+ *
+ * @param udev	pointer to the USB device
+ * @param queue	interrupt queue
+ * @return the element, or NULL if there is none
+ */
+void *xhci_poll_int_queue(struct usb_device *udev, struct int_queue *queue)
+{
+	struct xhci_ctrl *ctrl = udev->controller;
+	struct int_queue_td *td;
+	void *buffer;
+
+	if (queue->next == queue->queuesize) {
+		int_queue_start(queue);
+		return NULL;
+	}
+
+	/* Nothing else is waiting for events, so drop what is not ours */
+	while (event_ready(ctrl))
+		xhci_acknowledge_event(ctrl);
+
+	td = &queue->tds[queue->next];
+	if (td->code < 0)
+		return NULL;
+	if (td->code != COMP_SUCCESS && td->code != COMP_SHORT_TX) {
+		debug("Interrupt transfer failed with completion code %d\n",
+		      td->code);
+		int_queue_stop(queue);
+		queue->next = queue->queuesize;
+		return NULL;
+	}
+
+	buffer = queue->buffer + queue->next * queue->elementsize;
+	queue->next++;
+	xhci_inval_cache((uint32_t)buffer, queue->elementsize);
+
+	return buffer;
+}
+
+/**
+ * Stops an interrupt queue and frees it
+ *
+ * @param udev	pointer to the USB device
+ * @param queue	interrupt queue
+ * @return 0
+ */
+int xhci_destroy_int_queue(struct usb_device *udev, struct int_queue *queue)
+{
+	struct xhci_ctrl *ctrl = udev->controller;
+
+	int_queue_stop(queue);
+	ctrl->devs[udev->slot_id]->eps[queue->ep_index].intq = NULL;
+	free(queue);
+
+	return 0;
+}
@@ -280,6 +280,92 @@ static int xhci_configure_endpoints(struct usb_device *udev, bool ctx_change)
 	return 0;
 }
 
+/**
+ * Fill in the input context of an endpoint, allocating its rings.
+ *
+ * @param udev		pointer to the USB device structure
+ * @param ifdesc	interface the endpoint belongs to
+ * @param cur_ep	index of the endpoint in the interface
+ * @param num_streams	number of streams, one less than a power of two, or
+ *			0 for none
+ * @return index of the endpoint context
+ */
+static int xhci_init_ep_ctx(struct usb_device *udev,
+			    struct usb_interface *ifdesc, int cur_ep,
+			    unsigned int num_streams)
+{
+	struct usb_endpoint_descriptor *endpt_desc = &ifdesc->ep_desc[cur_ep];
+	struct xhci_ctrl *ctrl = udev->controller;
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_virt_ep *virt_ep;
+	struct xhci_ep_ctx *ep_ctx;
+	unsigned int dir;
+	unsigned int ep_type;
+	unsigned int max_burst = 0;
+	int ep_index;
+	u64 trb_64 = 0;
+
+	ep_index = xhci_get_ep_index(endpt_desc);
+	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->in_ctx, ep_index);
+	virt_ep = &virt_dev->eps[ep_index];
+
+	/* Allocate the ep rings */
+	if (num_streams) {
+		xhci_alloc_streams(virt_ep, num_streams);
+		/* The Linear Stream Array has 2^(MaxPStreams + 1) entries */
+		ep_ctx->ep_info = cpu_to_le32(EP_HAS_LSA |
+				EP_MAXPSTREAMS(ffs(num_streams + 1) - 2));
+		trb_64 = (uintptr_t)virt_ep->stream_ctx;
+	} else {
+		virt_ep->ring = xhci_ring_alloc(1, true);
+		ep_ctx->ep_info = 0;
+		trb_64 = (uintptr_t)virt_ep->ring->enqueue |
+			 virt_ep->ring->cycle_state;
+	}
+
+	/* Bursts of more than one packet need the companion descriptor */
+	if (udev->speed == USB_SPEED_SUPER)
+		max_burst = ifdesc->ss_ep_comp_desc[cur_ep].bMaxBurst;
+
+	/*NOTE: ep_desc[0] actually represents EP1 and so on */
+	dir = (((endpt_desc->bEndpointAddress) & (0x80)) >> 7);
+	ep_type = (((endpt_desc->bmAttributes) & (0x3)) | (dir << 2));
+	ep_ctx->ep_info2 =
+		cpu_to_le32(ep_type << EP_TYPE_SHIFT);
+	ep_ctx->ep_info2 |=
+		cpu_to_le32(MAX_PACKET
+		(get_unaligned(&endpt_desc->wMaxPacketSize)));
+
+	ep_ctx->ep_info2 |=
+		cpu_to_le32(((max_burst & MAX_BURST_MASK) << MAX_BURST_SHIFT) |
+		((3 & ERROR_COUNT_MASK) << ERROR_COUNT_SHIFT));
+
+	/*
+	 * The interval is 2^n microframes: bInterval is already an exponent
+	 * at high and super speed, and a number of frames below that.
+	 */
+	if (usb_endpoint_xfer_int(endpt_desc)) {
+		int interval = endpt_desc->bInterval;
+		unsigned int maxp;
+
+		if (udev->speed == USB_SPEED_HIGH ||
+		    udev->speed == USB_SPEED_SUPER)
+			interval = min(max(interval, 1), 16) - 1;
+		else
+			interval = min(max(fls(interval * 8) - 1, 3), 10);
+		ep_ctx->ep_info |= cpu_to_le32(EP_INTERVAL(interval));
+
+		maxp = GET_MAX_PACKET(get_unaligned(
+			&endpt_desc->wMaxPacketSize)) * (max_burst + 1);
+		ep_ctx->tx_info = cpu_to_le32(MAX_ESIT_PAYLOAD_FOR_EP(maxp) |
+					      AVG_TRB_LENGTH_FOR_EP(maxp));
+	}
+
+	ep_ctx->deq = cpu_to_le64(trb_64);
+
+	return ep_index;
+}
+
 /**
  * Configure the endpoint, programming the device contexts.
  *
@@ -292,16 +378,11 @@ static int xhci_set_configuration(struct usb_device *udev)
 	struct xhci_container_ctx *out_ctx;
 	struct xhci_input_control_ctx *ctrl_ctx;
 	struct xhci_slot_ctx *slot_ctx;
-	struct xhci_ep_ctx *ep_ctx[MAX_EP_CTX_NUM];
 	int cur_ep;
 	int max_ep_flag = 0;
-	int ep_index;
-	unsigned int dir;
-	unsigned int ep_type;
 	struct xhci_ctrl *ctrl = udev->controller;
 	int num_of_ep;
 	int ep_flag = 0;
-	u64 trb_64 = 0;
 	int slot_id = udev->slot_id;
 	struct xhci_virt_device *virt_dev = ctrl->devs[slot_id];
 	struct usb_interface *ifdesc;
@@ -319,6 +400,9 @@ static int xhci_set_configuration(struct usb_device *udev)
 
 	/* EP_FLAG gives values 1 & 4 for EP1OUT and EP2IN */
 	for (cur_ep = 0; cur_ep < num_of_ep; cur_ep++) {
+		/* Other alternate settings are set up by usb_alloc_streams() */
+		if (ifdesc->ep_altsetting[cur_ep])
+			continue;
 		ep_flag = xhci_get_ep_index(&ifdesc->ep_desc[cur_ep]);
 		ctrl_ctx->add_flags |= cpu_to_le32(1 << (ep_flag + 1));
 		if (max_ep_flag < ep_flag)
@@ -337,41 +421,114 @@ static int xhci_set_configuration(struct usb_device *udev)
 
 	/* filling up ep contexts */
 	for (cur_ep = 0; cur_ep < num_of_ep; cur_ep++) {
-		struct usb_endpoint_descriptor *endpt_desc = NULL;
-
-		endpt_desc = &ifdesc->ep_desc[cur_ep];
-		trb_64 = 0;
-
-		ep_index = xhci_get_ep_index(endpt_desc);
-		ep_ctx[ep_index] = xhci_get_ep_ctx(ctrl, in_ctx, ep_index);
-
-		/* Allocate the ep rings */
-		virt_dev->eps[ep_index].ring = xhci_ring_alloc(1, true);
-		if (!virt_dev->eps[ep_index].ring)
-			return -ENOMEM;
-
-		/*NOTE: ep_desc[0] actually represents EP1 and so on */
-		dir = (((endpt_desc->bEndpointAddress) & (0x80)) >> 7);
-		ep_type = (((endpt_desc->bmAttributes) & (0x3)) | (dir << 2));
-		ep_ctx[ep_index]->ep_info2 =
-			cpu_to_le32(ep_type << EP_TYPE_SHIFT);
-		ep_ctx[ep_index]->ep_info2 |=
-			cpu_to_le32(MAX_PACKET
-			(get_unaligned(&endpt_desc->wMaxPacketSize)));
-
-		ep_ctx[ep_index]->ep_info2 |=
-			cpu_to_le32(((0 & MAX_BURST_MASK) << MAX_BURST_SHIFT) |
-			((3 & ERROR_COUNT_MASK) << ERROR_COUNT_SHIFT));
-
-		trb_64 = (uintptr_t)
-				virt_dev->eps[ep_index].ring->enqueue;
-		ep_ctx[ep_index]->deq = cpu_to_le64(trb_64 |
-				virt_dev->eps[ep_index].ring->cycle_state);
+		if (!ifdesc->ep_altsetting[cur_ep])
+			xhci_init_ep_ctx(udev, ifdesc, cur_ep, 0);
 	}
 
 	return xhci_configure_endpoints(udev, false);
 }
 
+/* Number of streams a SuperSpeed bulk endpoint can have, or 0 */
+static int xhci_ep_max_streams(struct usb_interface *ifdesc, int cur_ep)
+{
+	if (!usb_endpoint_xfer_bulk(&ifdesc->ep_desc[cur_ep]))
+		return 0;
+
+	return usb_ss_max_streams(&ifdesc->ss_ep_comp_desc[cur_ep]);
+}
+
+/**
+ * Set up the endpoints of the current alternate setting of an interface,
+ * with streams on the bulk endpoints which have them, replacing the
+ * endpoints set up before.
+ *
+ * @param udev		pointer to the USB device structure
+ * @param ifnum		interface number
+ * @param num_streams	number of streams wanted on each endpoint
+ * @return number of streams on each endpoint, or -ve on error
+ */
+int usb_alloc_streams(struct usb_device *udev, int ifnum, int num_streams)
+{
+	struct xhci_ctrl *ctrl = udev->controller;
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_container_ctx *in_ctx = virt_dev->in_ctx;
+	struct xhci_container_ctx *out_ctx = virt_dev->out_ctx;
+	struct xhci_input_control_ctx *ctrl_ctx;
+	struct xhci_slot_ctx *slot_ctx;
+	struct xhci_ep_ctx *ep_ctx;
+	struct usb_interface *ifdesc = NULL;
+	u32 hcc = xhci_readl(&ctrl->hccr->cr_hccparams);
+	int max_streams = 0, entries, streams;
+	int cur_ep, ep_index, max_ep_flag;
+	int i;
+
+	for (i = 0; i < udev->config.no_of_if; i++) {
+		if (udev->config.if_desc[i].desc.bInterfaceNumber == ifnum)
+			ifdesc = &udev->config.if_desc[i];
+	}
+	if (!ifdesc || udev->speed != USB_SPEED_SUPER || !HCC_STREAMS(hcc))
+		return -ENOSYS;
+
+	/* Each endpoint gets as many streams as the smallest one can have */
+	for (cur_ep = 0; cur_ep < ifdesc->no_of_ep; cur_ep++) {
+		if (ifdesc->ep_altsetting[cur_ep] != ifdesc->act_altsetting)
+			continue;
+		streams = xhci_ep_max_streams(ifdesc, cur_ep);
+		if (streams && (!max_streams || streams < max_streams))
+			max_streams = streams;
+	}
+	if (!max_streams)
+		return -ENOSYS;
+
+	/* Stream 0 is reserved, and the array size is a power of two */
+	entries = 2;
+	while (entries - 1 < num_streams && entries * 2 <= HCC_MAX_PSA(hcc) &&
+	       entries * 2 - 1 <= max_streams)
+		entries *= 2;
+	num_streams = entries - 1;
+
+	xhci_inval_cache((uint32_t)out_ctx->bytes, out_ctx->size);
+
+	ctrl_ctx = xhci_get_input_control_ctx(in_ctx);
+	ctrl_ctx->add_flags = 0;
+	ctrl_ctx->drop_flags = 0;
+
+	/* Drop the endpoints of the interface which are enabled now */
+	for (cur_ep = 0; cur_ep < ifdesc->no_of_ep; cur_ep++) {
+		ep_index = xhci_get_ep_index(&ifdesc->ep_desc[cur_ep]);
+		ep_ctx = xhci_get_ep_ctx(ctrl, out_ctx, ep_index);
+		if ((le32_to_cpu(ep_ctx->ep_info) & EP_STATE_MASK) ==
+		    EP_STATE_DISABLED)
+			continue;
+		ctrl_ctx->drop_flags |= cpu_to_le32(1 << (ep_index + 1));
+		xhci_free_ep_rings(&virt_dev->eps[ep_index]);
+	}
+
+	/* slot context */
+	xhci_slot_copy(ctrl, in_ctx, out_ctx);
+	slot_ctx = xhci_get_slot_ctx(ctrl, in_ctx);
+	max_ep_flag = LAST_CTX_TO_EP_NUM(le32_to_cpu(slot_ctx->dev_info));
+
+	/* ...and add those of the current alternate setting */
+	for (cur_ep = 0; cur_ep < ifdesc->no_of_ep; cur_ep++) {
+		if (ifdesc->ep_altsetting[cur_ep] != ifdesc->act_altsetting)
+			continue;
+		streams = xhci_ep_max_streams(ifdesc, cur_ep);
+		ep_index = xhci_init_ep_ctx(udev, ifdesc, cur_ep,
+					    streams ? num_streams : 0);
+		ctrl_ctx->add_flags |= cpu_to_le32(1 << (ep_index + 1));
+		if (max_ep_flag < ep_index)
+			max_ep_flag = ep_index;
+	}
+	slot_ctx->dev_info &= ~(LAST_CTX_MASK);
+	slot_ctx->dev_info |= cpu_to_le32(LAST_CTX(max_ep_flag + 1));
+
+	if (xhci_configure_endpoints(udev, false))
+		return -EIO;
+
+	return num_streams;
+}
+
 /**
  * Issue an Address Device command (which will issue a SetAddress request to
  * the device).
@@ -849,24 +1006,87 @@ unknown:
 }
 
 /**
- * Submits the INT request to XHCI Host cotroller
+ * Submits the INT request to XHCI Host cotroller, as an interrupt queue of
+ * one element
  *
  * @param udev	pointer to the USB device
  * @param pipe		contains the DIR_IN or OUT , devnum
  * @param buffer	buffer to be read/written based on the request
  * @param length	length of the buffer
- * @param interval	interval of the interrupt
- * @return 0
+ * @param interval	interval of the interrupt, that of the endpoint is used
+ * @return 0 if successful, -ve on error
  */
 int
 submit_int_msg(struct usb_device *udev, unsigned long pipe, void *buffer,
 						int length, int interval)
 {
-	/*
-	 * TODO: Not addressing any interrupt type transfer requests
-	 * Add support for it later.
-	 */
-	return -EINVAL;
+	struct int_queue *queue;
+	unsigned long ts;
+	void *data;
+
+	queue = xhci_create_int_queue(udev, pipe, 1, length, buffer);
+	if (!queue) {
+		printf("cannot queue interrupt transfer on pipe %lx\n", pipe);
+		return -EINVAL;
+	}
+
+	ts = get_timer(0);
+	do {
+		data = xhci_poll_int_queue(udev, queue);
+	} while (!data && get_timer(ts) < USB_TIMEOUT_MS(pipe));
+	xhci_destroy_int_queue(udev, queue);
+
+	if (!data) {
+		udev->status = USB_ST_NAK_REC;	/* closest thing to a timeout */
+		udev->act_len = 0;
+		return -ETIMEDOUT;
+	}
+	udev->status = 0;
+	udev->act_len = length;
+
+	return 0;
+}
+
+/**
+ * create a queue of INT requests, which runs until destroyed
+ *
+ * @param udev		pointer to the USB device
+ * @param pipe		interrupt pipe
+ * @param queuesize	number of requests
+ * @param elementsize	size of each request
+ * @param buffer	buffer for all requests, one after the other
+ * @return the queue, or NULL on error
+ */
+struct int_queue *create_int_queue(struct usb_device *udev, unsigned long pipe,
+				   int queuesize, int elementsize,
+				   void *buffer)
+{
+	return xhci_create_int_queue(udev, pipe, queuesize, elementsize,
+				     buffer);
+}
+
+/**
+ * get the next completed request of a queue of INT requests
+ *
+ * @param udev	pointer to the USB device
+ * @param queue	queue of INT requests
+ * @return the buffer of the request, or NULL if there is none
+ */
+void *poll_int_queue(struct usb_device *udev, struct int_queue *queue)
+{
+	return xhci_poll_int_queue(udev, queue);
+}
+
+/**
+ * stop a queue of INT requests and free it
+ *
+ * @param udev	pointer to the USB device
+ * @param queue	queue of INT requests
+ * @return 0 if successful, -ve on error
+ */
+int destroy_int_queue(struct usb_device *udev, struct int_queue *queue)
+{
+	return xhci_destroy_int_queue(udev, queue);
 }
 
 /**
@@ -890,6 +1110,20 @@ submit_bulk_msg(struct usb_device *udev, unsigned long pipe, void *buffer,
 	return xhci_bulk_tx(udev, pipe, length, buffer);
 }
 
+/**
+ * submit several BULK type requests to the USB Device at once
+ *
+ * @param udev	pointer to the USB device
+ * @param xfer	transfers, each on any bulk pipe and stream
+ * @param count	number of transfers
+ * @return 0 if successful, -ve on error
+ */
+int submit_bulk_queue(struct usb_device *udev, struct usb_bulk_xfer *xfer,
+		      int count)
+{
+	return xhci_bulk_queue(udev, xfer, count);
+}
+
 /**
  * submit the control type of request to the Root hub/Device based on the devnum
  *
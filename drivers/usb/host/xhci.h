@@ -141,6 +141,8 @@ struct xhci_hccr {
 #define HCC_NSS(p)		((p) & (1 << 7))
 /* Max size for Primary Stream Arrays - 2^(n+1), where n is bits 12:15 */
 #define HCC_MAX_PSA(p)		(1 << ((((p) >> 12) & 0xf) + 1))
+/* true: HC supports streams (bits 12:15 are not zero) */
+#define HCC_STREAMS(p)		((p) & (0xf << 12))
 /* Extended Capabilities pointer from PCI base - section 5.3.6 */
 #define HCC_EXT_CAPS(p)		XHCI_HCC_EXT_CAPS(p)
 
@@ -671,6 +673,26 @@ struct xhci_ep_ctx {
 /* deq bitmasks */
 #define EP_CTX_CYCLE_MASK		(1 << 0)
 
+/**
+ * struct xhci_stream_ctx
+ * Stream context, one for each entry of a stream context array; see
+ * section 6.2.4.1.
+ *
+ * @stream_ring:	64-bit stream ring address, cycle state, and stream
+ *			context type
+ */
+struct xhci_stream_ctx {
+	__le64	stream_ring;
+	/* offset 0x8 - 0xf reserved for HC internal use */
+	__le32	reserved[2];
+};
+
+/* Stream Context Type - bits 3:1 of the stream ring address */
+#define SCT_FOR_CTX(p)		(((p) & 0x7) << 1)
+#define SCT_FOR_TRB(p)		(((p) & 0x7) << 1)
+/* Primary transfer ring, for a Linear Stream Array */
+#define SCT_PRI_TR		1
+
 
 /**
  * struct xhci_input_control_context
@@ -1064,6 +1086,12 @@ struct xhci_virt_ep {
 #define EP_HAS_STREAMS		(1 << 4)
 /* Transitioning the endpoint to not using streams, don't enqueue URBs */
 #define EP_GETTING_NO_STREAMS	(1 << 5)
+	/* With streams, ring is NULL and each stream has its own ring */
+	struct xhci_stream_ctx		*stream_ctx;
+	struct xhci_ring		**stream_rings;
+	unsigned int			num_streams;
+	/* Interrupt queue running on ring, if any */
+	struct int_queue		*intq;
 };
 
 #define CTX_SIZE(_hcc) (HCC_64BYTE_CONTEXT(_hcc) ? 64 : 32)
@@ -1239,6 +1267,13 @@ void xhci_acknowledge_event(struct xhci_ctrl *ctrl);
 union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected);
 int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		 int length, void *buffer);
+struct int_queue *xhci_create_int_queue(struct usb_device *udev,
+					unsigned long pipe, int queuesize,
+					int elementsize, void *buffer);
+void *xhci_poll_int_queue(struct usb_device *udev, struct int_queue *queue);
+int xhci_destroy_int_queue(struct usb_device *udev, struct int_queue *queue);
+int xhci_bulk_queue(struct usb_device *udev, struct usb_bulk_xfer *xfer,
+		    int count);
 int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 		 struct devrequest *req, int length, void *buffer);
 int xhci_check_maxpacket(struct usb_device *udev);
@@ -1246,6 +1281,8 @@ void xhci_flush_cache(uint32_t addr, u32 type_len);
 void xhci_inval_cache(uint32_t addr, u32 type_len);
 void xhci_cleanup(struct xhci_ctrl *ctrl);
 struct xhci_ring *xhci_ring_alloc(unsigned int num_segs, bool link_trbs);
+void xhci_alloc_streams(struct xhci_virt_ep *ep, unsigned int num_streams);
+void xhci_free_ep_rings(struct xhci_virt_ep *ep);
 int xhci_alloc_virt_device(struct usb_device *udev);
 int xhci_mem_init(struct xhci_ctrl *ctrl, struct xhci_hccr *hccr,
 		  struct xhci_hcor *hcor);
@@ -17,9 +17,24 @@
 #define AHCI_RX_FIS_SZ		256
 #define AHCI_CMD_TBL_HDR	0x80
 #define AHCI_CMD_TBL_CDB	0x40
-#define AHCI_CMD_TBL_SZ		AHCI_CMD_TBL_HDR + (AHCI_MAX_SG * 16)
+#define AHCI_CMD_TBL_SZ		(AHCI_CMD_TBL_HDR + (AHCI_MAX_SG * 16))
+
+/*
+ * With native command queueing each queued command needs a command table
+ * (and so a scatter-gather table) of its own
+ */
+#ifdef CONFIG_AHCI_NCQ
+#ifndef CONFIG_AHCI_NCQ_DEPTH
+#define CONFIG_AHCI_NCQ_DEPTH	AHCI_MAX_CMD_SLOT
+#endif
+#define AHCI_NR_CMD_TBL		CONFIG_AHCI_NCQ_DEPTH
+#else
+#define AHCI_NR_CMD_TBL		1
+#endif
+
 #define AHCI_PORT_PRIV_DMA_SZ	(AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT + \
-				AHCI_CMD_TBL_SZ	+ AHCI_RX_FIS_SZ)
+				AHCI_CMD_TBL_SZ * AHCI_NR_CMD_TBL + \
+				AHCI_RX_FIS_SZ)
 #define AHCI_CMD_ATAPI		(1 << 5)
 #define AHCI_CMD_WRITE		(1 << 6)
 #define AHCI_CMD_PREFETCH	(1 << 7)
@@ -36,6 +51,11 @@
 #define HOST_VERSION		0x10 /* AHCI spec. version compliancy */
 #define HOST_CAP2		0x24 /* host capabilities, extended */
 
+/* HOST_CAP bits */
+#define HOST_CAP_NCQ		(1 << 30) /* native command queueing */
+#define HOST_CAP_NCS_SHIFT	8	  /* number of command slots - 1 */
+#define HOST_CAP_NCS_MASK	(0x1f << HOST_CAP_NCS_SHIFT)
+
 /* HOST_CTL bits */
 #define HOST_RESET		(1 << 0)  /* reset controller; self-clear */
 #define HOST_IRQ_EN		(1 << 1)  /* global IRQ enable */
@@ -82,8 +102,8 @@
 #define PORT_IRQ_PIOS_FIS	(1 << 1) /* PIO Setup FIS rx'd */
 #define PORT_IRQ_D2H_REG_FIS	(1 << 0) /* D2H Register FIS rx'd */
 
-#define PORT_IRQ_FATAL		PORT_IRQ_TF_ERR | PORT_IRQ_HBUS_ERR	\
-				| PORT_IRQ_HBUS_DATA_ERR | PORT_IRQ_IF_ERR
+#define PORT_IRQ_FATAL		(PORT_IRQ_TF_ERR | PORT_IRQ_HBUS_ERR	\
+				| PORT_IRQ_HBUS_DATA_ERR | PORT_IRQ_IF_ERR)
 
 #define DEF_PORT_IRQ		PORT_IRQ_FATAL | PORT_IRQ_PHYRDY	\
 				| PORT_IRQ_CONNECT | PORT_IRQ_SG_DONE	\
@@ -142,6 +162,7 @@ struct ahci_ioports {
 	struct ahci_sg		*cmd_tbl_sg;
 	u32	cmd_tbl;
 	u32	rx_fis;
+	int	ncq_depth;	/* Commands to queue at once, 0 for no NCQ */
 };
 
 struct ahci_probe_ent {
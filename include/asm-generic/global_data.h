@@ -73,6 +73,10 @@ typedef struct global_data {
 	const void *fdt_blob;	/* Our device tree, NULL if none */
 	void *new_fdt;		/* Relocated FDT */
 	unsigned long fdt_size;	/* Space reserved for relocated FDT */
+#ifdef CONFIG_FDTDEC_CACHE
+	struct fdtdec_cache *fdt_cache;	/* Lookup cache for fdt_blob */
+	const void *fdt_cache_failed;	/* Blob the cache cannot be built for */
+#endif
 	void **jt;		/* jump table */
 	char env_buf[32];	/* buffer for getenv() before reloc. */
 #ifdef CONFIG_TRACE
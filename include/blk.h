@@ -0,0 +1,242 @@
+/*
+ * Driver model block device uclass, with a request queue
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _BLK_H
+#define _BLK_H
+
+#include <part.h>
+#include <linux/list.h>
+
+struct udevice;
+
+enum blk_op {
+	BLK_READ,
+	BLK_WRITE,
+};
+
+/**
+ * struct blk_sg - an entry of a scatter list
+ *
+ * @buf:	Buffer for the data
+ * @blkcnt:	Number of blocks to transfer to/from @buf
+ */
+struct blk_sg {
+	void *buf;
+	lbaint_t blkcnt;
+};
+
+/**
+ * struct blk_request - a request to transfer consecutive blocks
+ *
+ * The blocks starting at @start are transferred to/from the buffers of the
+ * scatter list in turn. The request must stay in place until it completes.
+ *
+ * @op:		BLK_READ or BLK_WRITE
+ * @start:	First block
+ * @sg:		Scatter list
+ * @sg_count:	Number of entries in @sg
+ * @complete:	Called when the request completes, if not NULL. This may be
+ *		from within blk_submit(), and may submit further requests.
+ * @priv:	For the submitter
+ * @status:	-EINPROGRESS until the request completes, then 0 or -ve
+ * @done:	Number of blocks transferred
+ * @node:	Entry in the queue of the device
+ */
+struct blk_request {
+	enum blk_op op;
+	lbaint_t start;
+	struct blk_sg *sg;
+	int sg_count;
+	void (*complete)(struct udevice *dev, struct blk_request *req);
+	void *priv;
+
+	int status;
+	lbaint_t done;
+	struct list_head node;
+};
+
+/**
+ * struct blk_dev_priv - information about a device used by the uclass
+ *
+ * Drivers which can work on several requests at once should set
+ * @max_active in their probe method.
+ *
+ * @max_active:	Number of requests the driver can be given at once, 1 if
+ *		left at 0
+ * @nactive:	Number of requests given to the driver
+ * @pending:	Requests not yet given to the driver, oldest first
+ * @active:	Requests given to the driver, oldest first
+ * @kicking:	Set while requests are being given to the driver
+ */
+struct blk_dev_priv {
+	int max_active;
+	int nactive;
+	struct list_head pending;
+	struct list_head active;
+	bool kicking;
+};
+
+/**
+ * struct blk_ops - Driver model block device operations
+ *
+ * The platform data of a block device is its block_dev_desc_t, which gives
+ * the geometry and keeps working with code not using driver model.
+ */
+struct blk_ops {
+	/**
+	 * start() - Start a request
+	 *
+	 * The driver calls blk_complete() when the request is done, which
+	 * may be before returning.
+	 *
+	 * @dev:	Device
+	 * @req:	Request, already checked against the size of the device
+	 * @return 0 if started, -ve on error (the request is then completed
+	 * with this error)
+	 */
+	int (*start)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - Make progress on the requests started (optional)
+	 *
+	 * Drivers which complete requests later than start() do so from
+	 * here. Without it, every request must be completed by start().
+	 *
+	 * @dev:	Device
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
+};
+
+/* Access the block device operations for a device */
+#define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
+
+/**
+ * blk_get_desc() - Get the block device descriptor of a device
+ *
+ * @dev:	Block device
+ * @return descriptor
+ */
+block_dev_desc_t *blk_get_desc(struct udevice *dev);
+
+/**
+ * blk_submit() - Queue a request on a block device
+ *
+ * The request is given to the driver as soon as it can take it.
+ *
+ * @dev:	Block device, probed
+ * @req:	Request
+ * @return 0 if queued, -EINVAL if it goes beyond the end of the device or
+ * has no blocks (nothing is queued)
+ */
+int blk_submit(struct udevice *dev, struct blk_request *req);
+
+/**
+ * blk_poll() - Make progress on the requests queued on a block device
+ *
+ * If the driver has started requests but has no poll() method to complete
+ * them, all queued requests are failed with -ENOSYS.
+ *
+ * @dev:	Block device
+ * @return number of requests still to complete, or -ve on error
+ */
+int blk_poll(struct udevice *dev);
+
+/**
+ * blk_wait() - Wait for a request to complete
+ *
+ * @dev:	Block device
+ * @req:	Request queued with blk_submit()
+ * @return status of the request: 0 if OK, -ve on error, -ENOSYS if the
+ * driver cannot complete it
+ */
+int blk_wait(struct udevice *dev, struct blk_request *req);
+
+/**
+ * blk_complete() - Complete a request given to a driver
+ *
+ * This is for drivers only.
+ *
+ * @dev:	Block device
+ * @req:	Request given to the start() method
+ * @status:	0 if OK, -ve on error
+ */
+void blk_complete(struct udevice *dev, struct blk_request *req, int status);
+
+/**
+ * blk_run_desc() - Carry out a request with the descriptor's methods
+ *
+ * This is for drivers only. The request is completed before returning, with
+ * -EIO if a method is missing or transfers fewer blocks than asked.
+ *
+ * @dev:	Block device
+ * @req:	Request given to the start() method
+ */
+void blk_run_desc(struct udevice *dev, struct blk_request *req);
+
+/**
+ * blk_read() - Read blocks from a device, waiting for them
+ *
+ * @dev:	Block device
+ * @start:	First block
+ * @blkcnt:	Number of blocks
+ * @buf:	Buffer for the data
+ * @return number of blocks read, or -ve on error
+ */
+long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+	      void *buf);
+
+/**
+ * blk_write() - Write blocks to a device, waiting for them
+ *
+ * @dev:	Block device
+ * @start:	First block
+ * @blkcnt:	Number of blocks
+ * @buf:	Data to write
+ * @return number of blocks written, or -ve on error
+ */
+long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+	       const void *buf);
+
+/**
+ * blk_bind() - Bind a block device for a descriptor
+ *
+ * @parent:	Parent device
+ * @drv_name:	Name of the driver
+ * @name:	Name of the device, which must stay in place
+ * @desc:	Descriptor of the device, which must stay in place
+ * @devp:	Returns the device
+ * @return 0 if OK, -ve on error
+ */
+int blk_bind(struct udevice *parent, const char *drv_name, const char *name,
+	     block_dev_desc_t *desc, struct udevice **devp);
+
+/**
+ * blk_find_desc() - Find the block device bound for a descriptor
+ *
+ * @desc:	Descriptor
+ * @devp:	Returns the device, which may not be probed yet
+ * @return 0 if OK, -ENODEV if there is none
+ */
+int blk_find_desc(block_dev_desc_t *desc, struct udevice **devp);
+
+/**
+ * blk_get_from_desc() - Get a probed block device for a descriptor
+ *
+ * If no block device has been bound for @desc, one with the blk_legacy
+ * driver is bound under the root. It uses the block_read() and
+ * block_write() methods of the descriptor, so this works for any device
+ * from get_dev(), e.g. MMC, USB storage, SCSI or IDE.
+ *
+ * @desc:	Descriptor
+ * @devp:	Returns the device
+ * @return 0 if OK, -ve on error
+ */
+int blk_get_from_desc(block_dev_desc_t *desc, struct udevice **devp);
+
+#endif
@@ -30,12 +30,15 @@
 #define CONFIG_DM_DEMO_SIMPLE
 #define CONFIG_DM_DEMO_SHAPE
 #define CONFIG_DM_GPIO
+#define CONFIG_DM_BLK
+#define CONFIG_DM_PROBE_TIME
 #define CONFIG_DM_TEST
 
 /* Number of bits in a C 'long' on this architecture */
 #define CONFIG_SANDBOX_BITS_PER_LONG	64
 
 #define CONFIG_OF_CONTROL
+#define CONFIG_FDTDEC_CACHE
 #define CONFIG_OF_HOSTFILE
 #define CONFIG_OF_LIBFDT
 #define CONFIG_LMB
@@ -43,6 +46,7 @@
 #define CONFIG_FIT_SIGNATURE
 #define CONFIG_RSA
 #define CONFIG_CMD_FDT
+#define CONFIG_FDT_BATCH
 #define CONFIG_DEFAULT_DEVICE_TREE	sandbox
 #define CONFIG_ANDROID_BOOT_IMAGE
 
@@ -75,6 +79,7 @@
 #define CONFIG_SYS_MALLOC_LEN		(32 << 20)	/* 32MB  */
 
 #define CONFIG_SYS_HUSH_PARSER
+#define CONFIG_HUSH_SCRIPT_CACHE
 #define CONFIG_SYS_LONGHELP			/* #undef to save memory */
 #define CONFIG_SYS_CBSIZE		1024	/* Console I/O Buffer Size */
 
@@ -103,6 +108,26 @@
 #define CONFIG_SPI_FLASH_STMICRO
 #define CONFIG_SPI_FLASH_WINBOND
 
+/* NAND */
+#define CONFIG_CMD_NAND
+#define CONFIG_NAND_SANDBOX
+#define CONFIG_SYS_MAX_NAND_DEVICE	1
+#define CONFIG_SYS_NAND_BASE		0
+#define CONFIG_SYS_NAND_ONFI_DETECTION
+#define CONFIG_NAND_BBT_STASH_ADDR	0x00f00000
+#define CONFIG_NAND_BBT_STASH_SIZE	0x1000
+#define CONFIG_BCH
+#define CONFIG_NAND_ECC_BCH
+
+/* MMC */
+#define CONFIG_MMC
+#define CONFIG_GENERIC_MMC
+#define CONFIG_CMD_MMC
+#define CONFIG_SANDBOX_MMC
+
+/* Build the SPL UBI loader so that it can be tested */
+#define CONFIG_SPL_UBI
+
 /* Memory things - we don't really want a memory test */
 #define CONFIG_SYS_LOAD_ADDR		0x00000000
 #define CONFIG_SYS_MEMTEST_START	0x00100000
@@ -139,6 +164,15 @@
 
 #define CONFIG_TPM_TIS_SANDBOX
 
+/* DFU back-end only, for testing; there is no USB gadget support */
+#define CONFIG_DFU_FUNCTION
+#define CONFIG_SYS_CACHELINE_SIZE	64
+#define CONFIG_DFU_RAM
+#define CONFIG_SYS_DFU_NUM_BUFS		2
+
+/* Android sparse image writing only, for testing */
+#define CONFIG_FASTBOOT_FLASH
+
 #define CONFIG_CMD_SANDBOX
 
 #define CONFIG_BOOTARGS ""
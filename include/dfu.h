@@ -51,6 +51,10 @@ struct mmc_internal_data {
 	/* eMMC HW partition access */
 	int hw_partition;
 
+	/* Only write blocks which differ ("update" option) */
+	bool update;
+	struct mmc_update_stats update_stats;
+
 	/* FAT/EXT */
 	unsigned int dev;
 	unsigned int part;
@@ -85,6 +89,9 @@ struct sf_internal_data {
 #ifndef CONFIG_SYS_DFU_DATA_BUF_SIZE
 #define CONFIG_SYS_DFU_DATA_BUF_SIZE		(1024*1024*8)	/* 8 MiB */
 #endif
+#ifndef CONFIG_SYS_DFU_NUM_BUFS
+#define CONFIG_SYS_DFU_NUM_BUFS			1
+#endif
 #ifndef CONFIG_SYS_DFU_MAX_FILE_SIZE
 #define CONFIG_SYS_DFU_MAX_FILE_SIZE CONFIG_SYS_DFU_DATA_BUF_SIZE
 #endif
@@ -102,6 +109,11 @@ struct dfu_entity {
 	enum dfu_device_type    dev_type;
 	enum dfu_layout         layout;
 	unsigned long           max_buf_size;
+	/*
+	 * If non-zero, full buffers are written to the medium in pieces of
+	 * this size, so that USB is serviced between them
+	 */
+	unsigned long		write_slice;
 
 	union {
 		struct mmc_internal_data mmc;
@@ -162,6 +174,28 @@ bool dfu_usb_get_reset(void);
 int dfu_read(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_write(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_flush(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
+
+/**
+ * dfu_write_poll() - Write out part of a buffer filled by dfu_write()
+ *
+ * This should be called regularly from the loop which handles USB
+ * interrupts, so that a full buffer is written to the medium while the
+ * next one is filled. Any error is reported by the next dfu_write() or
+ * dfu_flush().
+ */
+void dfu_write_poll(void);
+
+/**
+ * dfu_write_wait() - Write queued buffers until at most @count remain
+ *
+ * The buffer still being filled by dfu_write() is not queued, and is only
+ * written by dfu_flush().
+ *
+ * @count:	Number of queued buffers which may be left unwritten
+ * @return 0 if OK, -ve on error (including an earlier one from
+ * dfu_write_poll())
+ */
+int dfu_write_wait(int count);
 /* Device specific */
 #ifdef CONFIG_DFU_MMC
 extern int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s);
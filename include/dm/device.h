@@ -41,7 +41,9 @@ struct driver_info;
  *
  * All three of platdata, priv and uclass_priv can be allocated by the
  * driver, or you can use the auto_alloc_size members of struct driver and
- * struct uclass_driver to have driver model do this automatically.
+ * struct uclass_driver to have driver model do this automatically. Driver
+ * model allocates them, along with the parent's private data, as a single
+ * block when the device is probed and frees it when the device is removed.
  *
  * @driver: The driver used by this device
  * @name: Name of device, typically the FDT node name
@@ -52,12 +54,16 @@ struct driver_info;
  * @uclass: Pointer to uclass for this device
  * @uclass_priv: The uclass's private data for this device
  * @parent_priv: The parent's private data for this device
+ * @auto_alloc: Block holding the data driver model allocated for this device
+ * when it was probed, or NULL if none
  * @uclass_node: Used by uclass to link its devices
  * @child_head: List of children of this device
  * @sibling_node: Next device in list of all devices
  * @flags: Flags for this device DM_FLAG_...
  * @req_seq: Requested sequence number for this device (-1 = any)
  * @seq: Allocated sequence number for this device (-1 = none)
+ * @probe_time_us: Time taken by the last probe of this device, in
+ * microseconds, not counting its parents (CONFIG_DM_PROBE_TIME only)
  */
 struct udevice {
 	struct driver *driver;
@@ -69,12 +75,16 @@ struct udevice {
 	struct uclass *uclass;
 	void *uclass_priv;
 	void *parent_priv;
+	void *auto_alloc;
 	struct list_head uclass_node;
 	struct list_head child_head;
 	struct list_head sibling_node;
 	uint32_t flags;
 	int req_seq;
 	int seq;
+#ifdef CONFIG_DM_PROBE_TIME
+	ulong probe_time_us;
+#endif
 };
 
 /* Maximum sequence number supported */
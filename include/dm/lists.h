@@ -12,6 +12,9 @@
 
 #include <dm/uclass-id.h>
 
+struct uclass;
+struct udevice;
+
 /**
  * lists_driver_lookup_name() - Return u_boot_driver corresponding to name
  *
@@ -56,4 +59,48 @@ int lists_bind_drivers(struct udevice *parent, bool pre_reloc_only);
  */
 int lists_bind_fdt(struct udevice *parent, const void *blob, int offset);
 
+#ifdef CONFIG_OF_CONTROL
+/**
+ * lists_defer_fdt() - Find a driver for a node, to bind it when needed
+ *
+ * This looks up the driver for a device tree node like lists_bind_fdt()
+ * but does not bind it. The node is noted in the driver's uclass instead,
+ * and bound by lists_bind_deferred() when a device in that uclass is first
+ * looked up.
+ *
+ * @parent: parent device to bind the node to
+ * @blob: pointer to device tree blob
+ * @offset: offset of the node
+ * @return 0 if OK (including when there is no driver for the node),
+ * -ve on error
+ */
+int lists_defer_fdt(struct udevice *parent, const void *blob, int offset);
+
+/**
+ * lists_bind_deferred() - Bind the nodes deferred for a uclass
+ *
+ * @uc: uclass whose devices are needed
+ * @return 0 if OK, -ve on error
+ */
+int lists_bind_deferred(struct uclass *uc);
+
+/**
+ * lists_drop_deferred() - Forget deferred nodes which will not be needed
+ *
+ * @uc: uclass to drop nodes from, or NULL for all uclasses
+ * @parent: drop only the nodes to be bound to this parent, or NULL for all
+ */
+void lists_drop_deferred(struct uclass *uc, struct udevice *parent);
+#else
+static inline int lists_bind_deferred(struct uclass *uc)
+{
+	return 0;
+}
+
+static inline void lists_drop_deferred(struct uclass *uc,
+				       struct udevice *parent)
+{
+}
+#endif
+
 #endif
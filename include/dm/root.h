@@ -51,6 +51,10 @@ int dm_scan_fdt(const void *blob, bool pre_reloc_only);
  * This scans the subnodes of a device tree node and and creates a driver
  * for each one.
  *
+ * A subnode with a "u-boot,dm-defer" property, or any subnode if
+ * CONFIG_DM_DEFER_FDT is defined, is not bound yet. Its driver is found and
+ * it is bound the first time a device in that driver's uclass is looked up.
+ *
  * @parent: Parent device for the devices that will be created
  * @blob: Pointer to device tree blob
  * @offset: Offset of node to scan
@@ -21,6 +21,7 @@ enum uclass_id {
 
 	/* U-Boot uclasses start here */
 	UCLASS_GPIO,		/* Bank of general-purpose I/O pins */
+	UCLASS_BLK,		/* Block device */
 
 	UCLASS_COUNT,
 	UCLASS_INVALID = -1,
@@ -28,12 +28,15 @@
  * 'struct driver'
  * @dev_head: List of devices in this uclass (devices are attached to their
  * uclass when their bind method is called)
+ * @deferred_head: List of device tree nodes for this uclass which are not
+ * bound until a device in the uclass is looked up (see lists_defer_fdt())
  * @sibling_node: Next uclass in the linked list of uclasses
  */
 struct uclass {
 	void *priv;
 	struct uclass_driver *uc_drv;
 	struct list_head dev_head;
+	struct list_head deferred_head;
 	struct list_head sibling_node;
 };
 
@@ -93,6 +96,19 @@ struct uclass_driver {
  */
 int uclass_get(enum uclass_id key, struct uclass **ucp);
 
+/**
+ * uclass_get_bound() - Get a uclass with all of its devices bound
+ *
+ * Device tree nodes whose binding was deferred are bound here, so that
+ * walking the devices of the uclass finds them. Use this rather than
+ * uclass_get() before looking through uc->dev_head.
+ *
+ * @id: ID to look up
+ * @ucp: Returns pointer to uclass
+ * @return 0 if OK, -ve on error
+ */
+int uclass_get_bound(enum uclass_id id, struct uclass **ucp);
+
 /**
  * uclass_get_device() - Get a uclass device based on an ID and index
  *
@@ -0,0 +1,39 @@
+/*
+ * Fastboot flash and erase of MMC partitions
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __FB_MMC_H
+#define __FB_MMC_H
+
+/* The 64 defined bytes plus \0 */
+#define FASTBOOT_RESPONSE_LEN	(64 + 1)
+
+/**
+ * fb_mmc_flash_write() - Write a downloaded image to an MMC partition
+ *
+ * The partition is looked up by name in the GPT of the MMC device
+ * CONFIG_FASTBOOT_FLASH_MMC_DEV. Android sparse images are expanded as
+ * they are written; anything else is written as is.
+ *
+ * @cmd:		Partition name
+ * @download_buffer:	Image to write
+ * @download_bytes:	Size of image in bytes
+ * @response:		Returns the fastboot response ("OKAY" or "FAIL...").
+ *			It must hold FASTBOOT_RESPONSE_LEN bytes.
+ */
+void fb_mmc_flash_write(const char *cmd, void *download_buffer,
+			unsigned int download_bytes, char *response);
+
+/**
+ * fb_mmc_erase() - Erase an MMC partition
+ *
+ * @cmd:		Partition name
+ * @response:		Returns the fastboot response
+ */
+void fb_mmc_erase(const char *cmd, char *response);
+
+#endif
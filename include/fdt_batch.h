@@ -0,0 +1,192 @@
+/*
+ * Batched device tree edits
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __FDT_BATCH_H
+#define __FDT_BATCH_H
+
+#include <libfdt.h>
+#include <linux/list.h>
+
+/*
+ * Every fdt_setprop()/fdt_add_subnode() on a flat tree splices the blob,
+ * moving everything after the insertion point. With many fixups on a large
+ * tree this is quadratic. A batch instead records the edits against a
+ * read-only source tree and then writes the whole result out in a single
+ * pass with the sequential-write (fdt_sw) functions.
+ *
+ * Nodes are addressed by path, and are resolved while the source tree is
+ * walked, so a node that does not exist yet is simply created at the end
+ * of its parent. As with fdt_subnode_offset(), a name without a unit
+ * address ("memory") matches the first node with any unit address
+ * ("memory@80000000").
+ */
+
+struct fdt_batch_prop {
+	struct list_head sibling;
+	int len;		/* Length of value */
+	bool done;		/* Already written out by fdt_batch_apply() */
+	char *name;
+	char data[];
+};
+
+struct fdt_batch_node {
+	struct list_head sibling;	/* Entry in parent's children list */
+	struct list_head children;	/* Edited or new subnodes */
+	struct list_head props;		/* Edited or new properties */
+	bool found;		/* Matched against a node in the source tree */
+	char name[];
+};
+
+/**
+ * struct fdt_batch - a set of pending edits to a device tree
+ *
+ * @fdt:	Source tree, which is not modified until fdt_batch_apply()
+ * @root:	Edits to the root node and (through its children) below it
+ * @count:	Number of edits recorded, for statistics
+ */
+struct fdt_batch {
+	const void *fdt;
+	struct fdt_batch_node *root;
+	int count;
+};
+
+/**
+ * fdt_batch_init() - Start a new batch of edits
+ *
+ * @batch:	Batch to set up
+ * @fdt:	Source device tree. This must stay valid and unchanged until
+ *		fdt_batch_apply() is called.
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_batch_init(struct fdt_batch *batch, const void *fdt);
+
+/**
+ * fdt_batch_free() - Free all memory used by a batch
+ *
+ * @batch:	Batch to free. It can be reused after fdt_batch_init().
+ */
+void fdt_batch_free(struct fdt_batch *batch);
+
+/**
+ * fdt_batch_node() - Find or add a node in a batch
+ *
+ * Missing intermediate nodes are added too. The node is created in the
+ * output tree only if it does not already exist in the source tree.
+ *
+ * @batch:	Batch to update
+ * @path:	Absolute path of node, e.g. "/chosen"
+ * @return pointer to node, or NULL if out of memory or path is invalid
+ */
+struct fdt_batch_node *fdt_batch_node(struct fdt_batch *batch,
+				      const char *path);
+
+/**
+ * fdt_batch_setprop() - Record a property change
+ *
+ * A later change to the same property replaces an earlier one.
+ *
+ * @batch:	Batch to update
+ * @node:	Node to change, from fdt_batch_node()
+ * @name:	Property name
+ * @val:	Property value (copied)
+ * @len:	Length of property value in bytes
+ * @return 0 if OK, -FDT_ERR_NOSPACE if out of memory
+ */
+int fdt_batch_setprop(struct fdt_batch *batch, struct fdt_batch_node *node,
+		      const char *name, const void *val, int len);
+
+static inline int fdt_batch_setprop_u32(struct fdt_batch *batch,
+					struct fdt_batch_node *node,
+					const char *name, uint32_t val)
+{
+	fdt32_t tmp = cpu_to_fdt32(val);
+
+	return fdt_batch_setprop(batch, node, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_batch_setprop_u64(struct fdt_batch *batch,
+					struct fdt_batch_node *node,
+					const char *name, uint64_t val)
+{
+	fdt64_t tmp = cpu_to_fdt64(val);
+
+	return fdt_batch_setprop(batch, node, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_batch_setprop_string(struct fdt_batch *batch,
+					   struct fdt_batch_node *node,
+					   const char *name, const char *str)
+{
+	return fdt_batch_setprop(batch, node, name, str, strlen(str) + 1);
+}
+
+/**
+ * fdt_batch_setprop_path() - Record a property change by node path
+ *
+ * @batch:	Batch to update
+ * @path:	Absolute path of node
+ * @name:	Property name
+ * @val:	Property value (copied)
+ * @len:	Length of property value in bytes
+ * @create:	If 0, only change the property if it exists in the source
+ * @return 0 if OK (or nothing to do), -FDT_ERR_... on error
+ */
+int fdt_batch_setprop_path(struct fdt_batch *batch, const char *path,
+			   const char *name, const void *val, int len,
+			   int create);
+
+/**
+ * fdt_batch_apply() - Write out the source tree with all edits applied
+ *
+ * The output tree is written in a single pass, so the cost does not
+ * depend on the number of edits. The output buffer must not overlap the
+ * source tree. On success the total size of the output tree is set to
+ * @bufsize.
+ *
+ * @batch:	Batch to apply
+ * @buf:	Buffer to hold the new tree
+ * @bufsize:	Size of buffer in bytes
+ * @return 0 if OK, -FDT_ERR_NOSPACE if the buffer is too small, other
+ *	-FDT_ERR_... on error
+ */
+int fdt_batch_apply(struct fdt_batch *batch, void *buf, int bufsize);
+
+/* Batched versions of the standard fixups in fdt_support.c */
+int fdt_batch_chosen(struct fdt_batch *batch);
+void fdt_batch_fixup_ethernet(struct fdt_batch *batch);
+int fdt_batch_fixup_memory_banks(struct fdt_batch *batch, u64 start[],
+				 u64 size[], int banks);
+
+/**
+ * arch_fixup_fdt_batch() - Architecture-specific fixups recorded in a batch
+ *
+ * This is called from image_setup_libfdt() just before arch_fixup_fdt(),
+ * so an architecture can record its memory bank fixups here instead of
+ * splicing the tree. fdt_fixup_memory_banks() leaves banks which are
+ * already correct alone, so arch_fixup_fdt() need not change.
+ *
+ * @batch:	Batch to add edits to
+ * @return 0 if OK, -ve on error
+ */
+int arch_fixup_fdt_batch(struct fdt_batch *batch);
+
+/**
+ * ft_board_setup_batch() - Board-specific fixups recorded in a batch
+ *
+ * Boards with CONFIG_OF_BOARD_SETUP can implement this in addition to (or
+ * instead of) ft_board_setup() so that their fixups do not each splice the
+ * tree. It is called from image_setup_libfdt() after ft_board_setup() and
+ * before the ethernet fixups.
+ *
+ * @batch:	Batch to add edits to
+ * @bd:		Board info
+ * @return 0 if OK, -ve on error
+ */
+int ft_board_setup_batch(struct fdt_batch *batch, bd_t *bd);
+
+#endif /* __FDT_BATCH_H */
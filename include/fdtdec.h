@@ -15,6 +15,7 @@
  */
 
 #include <libfdt.h>
+#include <asm/errno.h>
 
 /*
  * A typedef for a physical address. Note that fdt data is always big
@@ -353,7 +354,8 @@ int fdtdec_add_aliases_for_id(const void *blob, const char *name,
  * This works out whether a node is pointed to by an alias, and if so, the
  * sequence number of that alias. Aliases are of the form <base><num> where
  * <num> is the sequence number. For example spi2 would be sequence number
- * 2.
+ * 2. The number is taken from the end of the alias name, so i2c0-bus1
+ * would be sequence number 1.
  *
  * @param blob		Device tree blob (if NULL, then error is returned)
  * @param base		Base name for alias (before the underscore)
@@ -365,6 +367,14 @@ int fdtdec_add_aliases_for_id(const void *blob, const char *name,
 int fdtdec_get_alias_seq(const void *blob, const char *base, int node,
 			 int *seqp);
 
+/**
+ * Get the sequence number at the end of an alias name
+ *
+ * @param name		Alias name, e.g. "spi2"
+ * @return sequence number, or -1 if the name does not end in a digit
+ */
+int fdtdec_alias_name_seq(const char *name);
+
 /**
  * Get the offset of the given alias node
  *
@@ -384,6 +394,56 @@ int fdtdec_get_alias_node(const void *blob, const char *name);
  */
 const char *fdtdec_get_compatible(enum fdt_compat_id id);
 
+#ifdef CONFIG_FDTDEC_CACHE
+/**
+ * Drop the lookup cache for the control FDT
+ *
+ * This must be called after editing gd->fdt_blob in place. The cache is
+ * rebuilt on the next lookup.
+ */
+void fdtdec_cache_invalidate(void);
+
+/*
+ * Lookups using the cache for the control FDT. These return -ENOSYS if
+ * there is no cache for this blob, in which case the caller should scan
+ * the tree itself. Otherwise they return the same as the corresponding
+ * fdtdec/libfdt function.
+ */
+int fdtdec_cache_lookup_phandle(const void *blob, uint32_t phandle);
+int fdtdec_cache_next_compatible(const void *blob, int node,
+				 const char *compat);
+int fdtdec_cache_get_alias_seq(const void *blob, const char *base, int node,
+			       int *seqp);
+int fdtdec_cache_get_alias_node(const void *blob, const char *name);
+#else
+static inline void fdtdec_cache_invalidate(void) {}
+
+static inline int fdtdec_cache_lookup_phandle(const void *blob,
+					      uint32_t phandle)
+{
+	return -ENOSYS;
+}
+
+static inline int fdtdec_cache_next_compatible(const void *blob, int node,
+					       const char *compat)
+{
+	return -ENOSYS;
+}
+
+static inline int fdtdec_cache_get_alias_seq(const void *blob,
+					     const char *base, int node,
+					     int *seqp)
+{
+	return -ENOSYS;
+}
+
+static inline int fdtdec_cache_get_alias_node(const void *blob,
+					      const char *name)
+{
+	return -ENOSYS;
+}
+#endif
+
 /* Look up a phandle and follow it to its node. Then return the offset
  * of that node.
  *
@@ -0,0 +1,71 @@
+/*
+ * Writing Android sparse images to block devices
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __IMAGE_SPARSE_H
+#define __IMAGE_SPARSE_H
+
+#include <part.h>
+#include <sparse_format.h>
+
+/**
+ * struct sparse_storage - where to write a sparse image
+ *
+ * @dev:	Block device to write to
+ * @start:	First block of the area to write (e.g. a partition)
+ * @size:	Size of the area in blocks
+ * @erase_grp:	Erase group size in blocks. If non-zero and @dev has a
+ *		block_erase() method, aligned runs of zero-filled blocks are
+ *		erased instead of written, provided that erased blocks read
+ *		back as zero.
+ * @written:	Number of blocks written, updated by write_sparse_image()
+ * @erased:	Number of blocks erased
+ * @skipped:	Number of "don't care" blocks left as they were
+ */
+struct sparse_storage {
+	block_dev_desc_t *dev;
+	lbaint_t start;
+	lbaint_t size;
+	lbaint_t erase_grp;
+
+	lbaint_t written;
+	lbaint_t erased;
+	lbaint_t skipped;
+};
+
+/**
+ * is_sparse_image() - Check for the sparse image magic number
+ *
+ * @buf:	Start of image
+ * @return true if @buf holds a sparse image header
+ */
+static inline bool is_sparse_image(const void *buf)
+{
+	const sparse_header_t *s = buf;
+
+	return le32_to_cpu(s->magic) == SPARSE_HEADER_MAGIC;
+}
+
+/**
+ * write_sparse_image() - Write a sparse image to a block device
+ *
+ * Only the blocks described by raw and fill chunks are written; "don't
+ * care" chunks are skipped. An image which is too big for RAM can be
+ * written as several sparse images, each covering the whole area but with
+ * different parts of it marked "don't care", which is what the fastboot
+ * host tool does when an image exceeds max-download-size.
+ *
+ * @st:		Where to write the image. The statistics are added to.
+ * @data:	The sparse image
+ * @size:	Size of the image in bytes
+ * @return 0 if OK, -EINVAL if the image is invalid, -EFBIG if it does not
+ * fit in the area, -EIO on a write error, -ENOMEM if out of memory
+ */
+int write_sparse_image(struct sparse_storage *st, void *data,
+		       unsigned int size);
+
+#endif
@@ -333,6 +333,34 @@ int board_mmc_getcd(struct mmc *mmc);
 int mmc_getwp(struct mmc *mmc);
 int board_mmc_getwp(struct mmc *mmc);
 int mmc_set_dsr(struct mmc *mmc, u16 val);
+
+/**
+ * struct mmc_update_stats - Counters updated by mmc_bupdate()
+ *
+ * @written:	Number of bytes written
+ * @skipped:	Number of bytes not written since they were already correct
+ */
+struct mmc_update_stats {
+	u64 written;
+	u64 skipped;
+};
+
+/**
+ * mmc_bupdate() - Write blocks, skipping those which are already correct
+ *
+ * The blocks are read back first and only runs of blocks which differ
+ * from @src are written. This saves time and wear when most of an image
+ * is unchanged, but costs a read of every block.
+ *
+ * @dev_num:	MMC device number
+ * @start:	First block to write
+ * @blkcnt:	Number of blocks
+ * @src:	Data to write
+ * @stats:	If not NULL, the byte counts are added to this
+ * @return @blkcnt if OK, 0 on error
+ */
+ulong mmc_bupdate(int dev_num, lbaint_t start, lbaint_t blkcnt,
+		  const void *src, struct mmc_update_stats *stats);
 /* Function to change the size of boot partition and rpmb partitions */
 int mmc_boot_partition_size_change(struct mmc *mmc, unsigned long bootsize,
 					unsigned long rpmbsize);
@@ -139,6 +139,27 @@ int nand_write_skip_bad(nand_info_t *nand, loff_t offset, size_t *length,
 			size_t *actual, loff_t lim, u_char *buffer, int flags);
 int nand_erase_opts(nand_info_t *meminfo, const nand_erase_options_t *opts);
 int nand_torture(nand_info_t *nand, loff_t offset);
+loff_t nand_next_good_block(nand_info_t *nand, loff_t offset);
+
+/*
+ * Bad block table left in RAM by SPL or an earlier U-Boot, so that the device
+ * is only scanned once per power cycle (see CONFIG_NAND_BBT_STASH_ADDR). The
+ * header is followed by @len bytes holding two bits per block, in the same
+ * format as the in-memory table of struct nand_chip: zero for a good block.
+ */
+#define NAND_BBT_STASH_MAGIC	0x5442424e	/* "NBBT" */
+
+struct nand_bbt_stash {
+	uint32_t magic;
+	uint32_t crc;		/* crc32 of everything after this field */
+	uint64_t size;		/* Size of the device */
+	uint32_t erasesize;
+	uint32_t len;		/* Number of bytes in the table */
+};
+
+int nand_bbt_stash(nand_info_t *nand, void *base, int size);
+int nand_bbt_unstash(nand_info_t *nand, void *base, int size);
+void nand_bbt_update_stash(nand_info_t *nand);
 
 #define NAND_LOCK_STATUS_TIGHT	0x01
 #define NAND_LOCK_STATUS_UNLOCK 0x04
@@ -149,6 +170,7 @@ int nand_unlock(nand_info_t *meminfo, loff_t start, size_t length,
 int nand_get_lock_status(nand_info_t *meminfo, loff_t offset);
 
 int nand_spl_load_image(uint32_t offs, unsigned int size, void *dst);
+int nand_spl_read_block(int block, int offset, int len, void *dst);
 void nand_deselect(void);
 
 #ifdef CONFIG_SYS_NAND_SELECT_DEVICE
@@ -11,6 +11,7 @@ struct host_block_dev {
 	block_dev_desc_t blk_dev;
 	char *filename;
 	int fd;
+	char name[8];		/* Of the driver model block device */
 };
 
 int host_dev_bind(int dev, char *filename);
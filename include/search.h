@@ -50,9 +50,20 @@ struct _ENTRY;
 
 /* Data type for reentrant functions.  */
 struct hsearch_data {
-	struct _ENTRY *table;
-	unsigned int size;
-	unsigned int filled;
+	struct _ENTRY **table;
+	unsigned int size;	/* Number of slots in table */
+	unsigned int used;	/* Slots in table used, including deleted */
+	unsigned int filled;	/* Number of entries */
+	/* Previous table, while its entries are moved to the new one */
+	struct _ENTRY **old_table;
+	unsigned int old_size;
+	unsigned int rehash_idx;
+	/* All entries, in key order up to list_sorted */
+	struct _ENTRY **list;
+	unsigned int list_len;
+	unsigned int list_max;
+	unsigned int list_sorted;
+	unsigned int list_holes;
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
@@ -64,7 +75,10 @@ struct hsearch_data {
 		int flag);
 };
 
-/* Create a new hashing table which will at most contain NEL elements.  */
+/*
+ * Create a new hashing table with room for NEL elements. It grows when
+ * more are added.
+ */
 extern int hcreate_r(size_t __nel, struct hsearch_data *__htab);
 
 /* Destroy current internal hashing table.  */
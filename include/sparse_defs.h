@@ -0,0 +1,14 @@
+/*
+ * Types used by sparse_format.h
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _SPARSE_DEFS_H_
+#define _SPARSE_DEFS_H_
+
+#include <linux/types.h>
+
+#endif
@@ -34,6 +34,7 @@
 
 /* SPI TX operation modes */
 #define SPI_OPM_TX_QPP		1 << 0
+#define SPI_OPM_TX_NO_CHIP_ERASE	1 << 1	/* cannot send chip erase */
 
 /* SPI RX operation modes */
 #define SPI_OPM_RX_AS		1 << 0
@@ -44,6 +45,7 @@
 #define SPI_OPM_RX_EXTN		SPI_OPM_RX_AS | SPI_OPM_RX_DOUT | \
 				SPI_OPM_RX_DIO | SPI_OPM_RX_QOF | \
 				SPI_OPM_RX_QIOF
+#define SPI_OPM_RX_BULK		1 << 7	/* spi_read_bulk() is supported */
 
 /* SPI bus connection options */
 #define SPI_CONN_DUAL_SHARED	1 << 0
@@ -82,6 +84,30 @@ struct spi_slave {
 	u8 flags;
 };
 
+/**
+ * struct spi_read_op - A SPI flash read done by the controller in one go
+ *
+ * The opcode is always sent on one line. The address and dummy bytes go
+ * out on @addr_lines lines and the data comes back on @data_lines lines,
+ * so 1-1-4 is a Quad Output read and 1-4-4 a Quad I/O read.
+ *
+ * @cmd:		Read opcode
+ * @addr:		Flash address to read from
+ * @addr_len:		Number of address bytes (3 or 4)
+ * @dummy_len:		Number of dummy bytes after the address, as in
+ *			struct spi_flash (so @addr_lines bits per clock)
+ * @addr_lines:		Bus width used for the address and dummy bytes
+ * @data_lines:		Bus width used for the data
+ */
+struct spi_read_op {
+	u8 cmd;
+	u32 addr;
+	u8 addr_len;
+	u8 dummy_len;
+	u8 addr_lines;
+	u8 data_lines;
+};
+
 /**
  * Initialization, must be called once on start up.
  *
@@ -220,6 +246,40 @@ int spi_set_wordlen(struct spi_slave *slave, unsigned int wordlen);
 int  spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 		void *din, unsigned long flags);
 
+/**
+ * spi_read_bulk() - Read from a SPI flash in a single controller request
+ *
+ * Controllers which set SPI_OPM_RX_BULK in op_mode_rx provide this, so that
+ * the SPI flash layer can hand over a whole read, which the controller then
+ * performs with its own sequencer, FIFOs or DMA and the bus widths given in
+ * @op, rather than a byte at a time through spi_xfer(). The bus must have
+ * been claimed and chip select is handled by the controller. Without such
+ * a controller this returns -ENOSYS and the caller must use spi_xfer().
+ *
+ * @slave:	The SPI slave to read from
+ * @op:		Description of the read command
+ * @buf:	Buffer to fill
+ * @len:	Number of bytes to read
+ * @return 0 if OK, -ENOSYS if not supported, other -ve on error
+ */
+int spi_read_bulk(struct spi_slave *slave, const struct spi_read_op *op,
+		  void *buf, size_t len);
+
+/**
+ * spi_mmap_config() - Set up the memory-mapped window for a SPI flash
+ *
+ * Controllers which expose the flash through memory_map issue a read
+ * command for each access to the window. This tells them which command
+ * the SPI flash layer has chosen, so that the window uses the same bus
+ * widths as other reads rather than a slow single-line read. Controllers
+ * with a fixed window configuration need not provide it.
+ *
+ * @slave:	The SPI slave
+ * @op:		Read command to use; @op->addr is not used
+ * @return 0 if OK, -ve on error
+ */
+int spi_mmap_config(struct spi_slave *slave, const struct spi_read_op *op);
+
 /**
  * Determine if a SPI chipselect is valid.
  * This function is provided by the board if the low-level SPI driver
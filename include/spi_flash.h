@@ -77,6 +77,8 @@ extern const struct spi_flash_params spi_flash_params_table[];
  * @page_size:		Write (page) size
  * @sector_size:	Sector size
  * @erase_size:		Erase size
+ * @erase_flags:	Erase sizes supported besides sector_size (SECT_4K,
+ *			SECT_32K)
  * @bank_read_cmd:	Bank read cmd
  * @bank_write_cmd:	Bank write cmd
  * @bank_curr:		Current flash bank
@@ -85,6 +87,8 @@ extern const struct spi_flash_params spi_flash_params_table[];
  * @read_cmd:		Read cmd - Array Fast, Extn read and quad read.
  * @write_cmd:		Write cmd - page and quad program.
  * @dummy_byte:		Dummy cycles for read operation.
+ * @addr_lines:		Bus width of read_cmd for address and dummy bytes
+ * @data_lines:		Bus width of read_cmd for data
  * @memory_map:		Address of read-only SPI flash access
  * @read:		Flash read ops: Read len bytes at offset into buf
  *			Supported cmds: Fast Array Read
@@ -104,6 +108,7 @@ struct spi_flash {
 	u32 page_size;
 	u32 sector_size;
 	u32 erase_size;
+	u8 erase_flags;
 #ifdef CONFIG_SPI_FLASH_BAR
 	u8 bank_read_cmd;
 	u8 bank_write_cmd;
@@ -114,6 +119,8 @@ struct spi_flash {
 	u8 read_cmd;
 	u8 write_cmd;
 	u8 dummy_byte;
+	u8 addr_lines;
+	u8 data_lines;
 
 	void *memory_map;
 	int (*read)(struct spi_flash *flash, u32 offset, size_t len, void *buf);
@@ -139,6 +146,30 @@ struct spi_flash *spi_flash_probe_fdt(const void *blob, int slave_node,
 
 void spi_flash_free(struct spi_flash *flash);
 
+/**
+ * spi_flash_mmap() - Get a pointer to flash contents in a memory-mapped window
+ *
+ * If the SPI controller exposes the flash through memory_map, this switches
+ * it to memory-mapped reads and claims the bus, so that the caller can use
+ * the data directly (or copy it with memcpy() or DMA) at bus speed. Call
+ * spi_flash_munmap() when done, unless the window is being left enabled to
+ * execute code from the flash.
+ *
+ * @flash:	SPI flash
+ * @offset:	Offset of the data in the flash
+ * @len:	Number of bytes which will be accessed
+ * @return pointer to the data, or NULL if the flash is not memory-mapped,
+ * in which case use spi_flash_read()
+ */
+void *spi_flash_mmap(struct spi_flash *flash, u32 offset, size_t len);
+
+/**
+ * spi_flash_munmap() - Finish with a pointer from spi_flash_mmap()
+ *
+ * @flash:	SPI flash
+ */
+void spi_flash_munmap(struct spi_flash *flash);
+
 static inline int spi_flash_read(struct spi_flash *flash, u32 offset,
 		size_t len, void *buf)
 {
@@ -44,6 +44,9 @@ void spl_display_print(void);
 /* NAND SPL functions */
 void spl_nand_load_image(void);
 
+/* UBI SPL functions */
+void spl_ubi_load_image(void);
+
 /* OneNAND SPL functions */
 void spl_onenand_load_image(void);
 
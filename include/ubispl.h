@@ -0,0 +1,106 @@
+/*
+ * Minimal read-only UBI attach for SPL
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __UBISPL_H
+#define __UBISPL_H
+
+/* Largest volume that can be loaded, in LEBs */
+#ifndef CONFIG_SPL_UBI_MAX_VOL_LEBS
+#define CONFIG_SPL_UBI_MAX_VOL_LEBS	256
+#endif
+
+/* Largest fastmap that can be used, in bytes */
+#ifndef CONFIG_SPL_UBI_MAX_FM_SIZE
+#define CONFIG_SPL_UBI_MAX_FM_SIZE	(256 << 10)
+#endif
+
+/* Number of volumes which can be loaded at once */
+#define UBISPL_MAX_VOLS		4
+
+struct ubispl_leb {
+	int pnum;			/* PEB holding the LEB, or -1 */
+	int data_size;			/* Bytes of data, for static volumes */
+	u32 data_crc;
+	bool copy_flag;			/* Copied by wear-levelling */
+	unsigned long long sqnum;
+};
+
+struct ubispl_vol {
+	int vol_id;
+	int vol_type;			/* UBI_VID_..., or 0 if not found */
+	int used_ebs;			/* Number of LEBs of a static volume */
+	int data_pad;
+	int last_lnum;			/* Highest LEB found, or -1 */
+	struct ubispl_leb lebs[CONFIG_SPL_UBI_MAX_VOL_LEBS];
+};
+
+/* Work area for ubispl_load_volumes(), too large for the SPL stack */
+struct ubispl_scan {
+	struct ubispl_vol vols[UBISPL_MAX_VOLS];
+	int nvols;
+	u8 fm_buf[CONFIG_SPL_UBI_MAX_FM_SIZE];
+	u8 crc_buf[4096];		/* For checking copied LEBs */
+};
+
+/**
+ * struct ubispl_info - a UBI device for ubispl_load_volumes()
+ *
+ * @scan:	Work area, e.g. at an address in SDRAM
+ * @read:	Read @len bytes at @offset in PEB @pnum of the UBI device,
+ *		returning 0 on success. Bad PEBs may read as anything.
+ * @peb_size:	Size of a PEB in bytes
+ * @peb_count:	Number of PEBs in the UBI device
+ * @vid_offset:	Offset of the VID header in each PEB
+ * @leb_start:	Offset of the data in each PEB
+ * @fastmap:	Use the fastmap, if there is one, instead of scanning every
+ *		PEB
+ * @fastmap_used: Set if the fastmap was used
+ * @hdr_reads:	Set to the number of VID headers read
+ */
+struct ubispl_info {
+	struct ubispl_scan *scan;
+	int (*read)(int pnum, int offset, int len, void *dst);
+	int peb_size;
+	int peb_count;
+	int vid_offset;
+	int leb_start;
+	bool fastmap;
+	bool fastmap_used;
+	int hdr_reads;
+};
+
+/**
+ * struct ubispl_load - a volume to load
+ *
+ * @vol_id:	Volume ID
+ * @load_addr:	Where to put the contents
+ * @size:	Set to the number of bytes loaded
+ */
+struct ubispl_load {
+	int vol_id;
+	void *load_addr;
+	int size;
+};
+
+/**
+ * ubispl_load_volumes() - attach a UBI device and load volumes from it
+ *
+ * The fastmap is used to find the volumes if there is a valid one, otherwise
+ * the VID header of every PEB is read. Static volumes are loaded up to their
+ * data size, dynamic volumes up to their last mapped LEB, with unmapped LEBs
+ * reading as 0xff. Nothing is ever written to the device.
+ *
+ * @info:	UBI device
+ * @lvols:	Volumes to load
+ * @nrvols:	Number of volumes, at most UBISPL_MAX_VOLS
+ * @return 0 if all volumes were loaded, -ve on error
+ */
+int ubispl_load_volumes(struct ubispl_info *info, struct ubispl_load *lvols,
+			int nrvols);
+
+#endif
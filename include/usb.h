@@ -65,6 +65,12 @@ struct usb_interface {
 	 * Revision 1.0 June 6th 2011
 	 */
 	struct usb_ss_ep_comp_descriptor ss_ep_comp_desc[USB_MAXENDPOINTS];
+	/*
+	 * Endpoints of all alternate settings are in ep_desc[], each with
+	 * the setting it belongs to, and its UAS Pipe ID (0 if none)
+	 */
+	unsigned char	ep_altsetting[USB_MAXENDPOINTS];
+	unsigned char	ep_pipe_id[USB_MAXENDPOINTS];
 } __attribute__ ((packed));
 
 /* Configuration information.. */
@@ -143,6 +149,28 @@ enum usb_init_type {
  * this is how the lowlevel part communicate with the outer world
  */
 
+/* Largest number of transfers for usb_bulk_msg_queue() */
+#define USB_MAX_BULK_QUEUE	16
+
+/**
+ * struct usb_bulk_xfer - a bulk transfer for usb_bulk_msg_queue()
+ *
+ * @pipe:	Bulk pipe
+ * @buffer:	Data, aligned for DMA
+ * @length:	Number of bytes to transfer
+ * @actual:	Set to the number of bytes transferred
+ * @status:	Set to the USB_ST_... status, USB_ST_NOT_PROC if not run
+ * @stream:	Stream ID, on an endpoint set up by usb_alloc_streams(), or 0
+ */
+struct usb_bulk_xfer {
+	unsigned long pipe;
+	void *buffer;
+	int length;
+	int actual;
+	unsigned long status;
+	unsigned int stream;
+};
+
 #if defined(CONFIG_USB_UHCI) || defined(CONFIG_USB_OHCI) || \
 	defined(CONFIG_USB_EHCI) || defined(CONFIG_USB_OHCI_NEW) || \
 	defined(CONFIG_USB_SL811HS) || defined(CONFIG_USB_ISP116X_HCD) || \
@@ -162,6 +190,55 @@ int submit_control_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 int submit_int_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 			int transfer_len, int interval);
 
+int submit_bulk_queue(struct usb_device *dev, struct usb_bulk_xfer *xfer,
+		      int count);
+
+struct int_queue;
+
+/**
+ * create_int_queue() - start polling an interrupt pipe in the background
+ *
+ * The host controller keeps @queuesize transfers going on the pipe, so that
+ * completed ones can be picked up later with poll_int_queue() at the cost of
+ * a few memory reads, instead of waiting a frame or more for each transfer.
+ * EHCI and XHCI have interrupt queues.
+ *
+ * @dev:	USB device
+ * @pipe:	Interrupt pipe
+ * @queuesize:	Number of transfers
+ * @elementsize: Length of each transfer, at most the endpoint's maximum
+ *		packet size for EHCI
+ * @buffer:	Buffer for all the transfers, one after the other, aligned
+ *		for DMA
+ * @return queue, or NULL if the pipe cannot be polled this way
+ */
+struct int_queue *create_int_queue(struct usb_device *dev, unsigned long pipe,
+				   int queuesize, int elementsize,
+				   void *buffer);
+
+/**
+ * poll_int_queue() - pick up the next completed transfer of a queue
+ *
+ * Transfers are returned in turn. Once all of them have been, the next call
+ * gives them back to the host controller to run again, so the caller must
+ * be done with the data of the last one by then. Failed transfers, and on
+ * XHCI those queued after them, are skipped.
+ *
+ * @dev:	USB device
+ * @queue:	Queue from create_int_queue()
+ * @return the data of the transfer, or NULL if it has not completed
+ */
+void *poll_int_queue(struct usb_device *dev, struct int_queue *queue);
+
+/**
+ * destroy_int_queue() - stop polling an interrupt pipe and free the queue
+ *
+ * @dev:	USB device
+ * @queue:	Queue from create_int_queue()
+ * @return 0 if OK, -ve on error
+ */
+int destroy_int_queue(struct usb_device *dev, struct int_queue *queue);
+
 /* Defines */
 #define USB_UHCI_VEND_ID	0x8086
 #define USB_UHCI_DEV_ID		0x7112
@@ -234,6 +311,28 @@ int usb_control_msg(struct usb_device *dev, unsigned int pipe,
 			void *data, unsigned short size, int timeout);
 int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 			void *data, int len, int *actual_length, int timeout);
+
+/**
+ * usb_bulk_msg_queue() - run several bulk transfers queued together
+ *
+ * The transfers are all handed to the host controller before waiting, so
+ * that each pipe goes on to its next transfer without a round trip through
+ * software. A short packet ends that transfer and moves on to the next one on
+ * the same pipe. If any transfer fails, those after it on the same pipe are
+ * not run. Each stream of a pipe runs its transfers independently. Transfers
+ * on different pipes are not ordered against each other, so a protocol which
+ * must wait for a reply on one pipe before sending on another, such as
+ * bulk-only storage between commands, must not queue across that point. EHCI
+ * handles at most one IN and one OUT pipe, without streams.
+ *
+ * @dev:	USB device
+ * @xfer:	Transfers, in the order they are to run on each pipe
+ * @count:	Number of transfers, at most USB_MAX_BULK_QUEUE
+ * @return 0 if all transfers succeeded, -ENOSYS if the host controller
+ * cannot queue transfers (nothing was sent), other -ve on error
+ */
+int usb_bulk_msg_queue(struct usb_device *dev, struct usb_bulk_xfer *xfer,
+		       int count);
 int usb_submit_int_msg(struct usb_device *dev, unsigned long pipe,
 			void *buffer, int transfer_len, int interval);
 int usb_disable_asynch(int disable);
@@ -403,10 +502,57 @@ struct usb_hub_descriptor {
 struct usb_hub_device {
 	struct usb_device *pusb_dev;
 	struct usb_hub_descriptor desc;
+	ulong query_delay;	/* Time at which port power is stable */
+	ulong connect_timeout;	/* Time by which devices have connected */
 };
 
+/* Time for a connection to be seen as stable before the port is reset */
+#define USB_HUB_DEBOUNCE_MS	200
+
 int usb_hub_probe(struct usb_device *dev, int ifnum);
 void usb_hub_reset(void);
+
+/**
+ * usb_hub_set_deadlines() - set when a hub's newly powered ports settle
+ *
+ * @hub:	Hub whose ports were just powered on
+ * @now:	Current time, from get_timer(0)
+ * @pgood_delay: Time the hub takes for port power to be good, in ms
+ */
+void usb_hub_set_deadlines(struct usb_hub_device *hub, ulong now,
+			   unsigned pgood_delay);
+
+/**
+ * usb_hub_port_settled() - check whether a port scan can finish
+ *
+ * A port with no connection change is finished once devices have had time
+ * to connect. One whose connection state does not yet match the change is
+ * given up to 10 seconds. A connected port must stay connected for
+ * USB_HUB_DEBOUNCE_MS from when it is first seen here.
+ *
+ * @hub:	Hub with the port, its deadlines set by usb_hub_set_deadlines()
+ * @debounce_end: Time the port's connection is stable, or 0 if it has not
+ *		been seen connected yet; updated as needed
+ * @now:	Current time, from get_timer(0), at or after hub->query_delay
+ * @portstatus:	Port status, USB_PORT_STAT_...
+ * @portchange:	Port change status, USB_PORT_STAT_C_...
+ * @return true to handle the port now, false to poll it again later
+ */
+bool usb_hub_port_settled(const struct usb_hub_device *hub,
+			  ulong *debounce_end, ulong now,
+			  unsigned short portstatus, unsigned short portchange);
+
+/**
+ * usb_hub_scan() - enumerate the devices on the ports of all hubs found
+ *
+ * Hubs only power their ports when they are configured. This polls every
+ * port queued so far, and those of hubs found meanwhile, until each has a
+ * device enumerated or has timed out, so that the settling times of all
+ * ports overlap. It does nothing if called while a scan is in progress.
+ *
+ * @return 0
+ */
+int usb_hub_scan(void);
 int hub_port_reset(struct usb_device *dev, int port,
 			  unsigned short *portstat);
 
@@ -416,4 +562,19 @@ int usb_new_device(struct usb_device *dev);
 void usb_free_device(void);
 int usb_alloc_device(struct usb_device *dev);
 
+/**
+ * usb_alloc_streams() - set up bulk streams on an interface
+ *
+ * The host controller sets up the endpoints of the current alternate setting
+ * of the interface, giving those bulk endpoints which support streams the
+ * same number of them, numbered from 1. Call this after usb_set_interface().
+ *
+ * @dev:	USB device
+ * @ifnum:	Interface number
+ * @num_streams: Number of streams wanted on each endpoint
+ * @return number of streams on each endpoint, which may be more or fewer than
+ * wanted, or -ENOSYS if the host controller or device cannot use streams
+ */
+int usb_alloc_streams(struct usb_device *dev, int ifnum, int num_streams);
+
 #endif /*_USB_H_ */
@@ -46,7 +46,9 @@
  * remainder lookup tables.
  *
  * The final stage of decoding involves the following internal steps:
- * a. Syndrome computation
+ * a. Syndrome computation, evaluating the ecc polynomial 8 bits at a time
+ *    with one lookup table per syndrome; decoding stops here if there is no
+ *    error
  * b. Error locator polynomial computation using Berlekamp-Massey algorithm
  * c. Error locator root finding (by far the most expensive step)
  *
@@ -334,31 +336,43 @@ static inline int a_ilog(struct bch_control *bch, unsigned int x)
 static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 			      unsigned int *syn)
 {
-	int i, j, s;
-	unsigned int m;
-	uint32_t poly;
+	int i, j, k;
+	unsigned int m, v, mul, pad;
+	uint32_t w;
+	const uint16_t *tab;
 	const int t = GF_T(bch);
-
-	s = bch->ecc_bits;
+	const int words = DIV_ROUND_UP(bch->ecc_bits, 32);
 
 	/* make sure extra bits in last ecc word are cleared */
-	m = ((unsigned int)s) & 31;
+	m = bch->ecc_bits & 31;
 	if (m)
-		ecc[s/32] &= ~((1u << (32-m))-1);
-	memset(syn, 0, 2*t*sizeof(*syn));
-
-	/* compute v(a^j) for j=1 .. 2t-1 */
-	do {
-		poly = *ecc++;
-		s -= 32;
-		while (poly) {
-			i = deg(poly);
-			for (j = 0; j < 2*t; j += 2)
-				syn[j] ^= a_pow(bch, (j+1)*(i+s));
-
-			poly ^= (1 << i);
+		ecc[words-1] &= ~((1u << (32-m))-1);
+
+	/*
+	 * compute v(a^j) for j=1 .. 2t-1 with Horner's rule, one byte of the
+	 * padded ecc at a time, starting with the most significant byte:
+	 * v'(a^j) = (..(b0.a^8j + b1).a^8j + ..) + bn, then remove the
+	 * padding of the last word: v(a^j) = v'(a^j)/a^(j*pad)
+	 */
+	pad = 32*words-bch->ecc_bits;
+	for (j = 0; j < t; j++) {
+		tab = bch->syn_tab+256*j;
+		mul = modulo(bch, 8*(2*j+1));
+		v = 0;
+		for (k = 0; k < words; k++) {
+			w = ecc[k];
+			for (i = 24; i >= 0; i -= 8) {
+				if (v)
+					v = bch->a_pow_tab[mod_s(bch,
+						bch->a_log_tab[v]+mul)];
+				v ^= tab[(w >> i) & 0xff];
+			}
 		}
-	} while (s > 0);
+		if (v && pad)
+			v = bch->a_pow_tab[mod_s(bch, bch->a_log_tab[v]+
+					GF_N(bch)-modulo(bch, (2*j+1)*pad))];
+		syn[2*j] = v;
+	}
 
 	/* v(a^(2j)) = v(a^j)^2 */
 	for (j = 0; j < t; j++)
@@ -1008,18 +1022,24 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 		if (recv_ecc) {
 			load_ecc8(bch, bch->ecc_buf2, recv_ecc);
 			/* XOR received and calculated ecc */
-			for (i = 0, sum = 0; i < (int)ecc_words; i++) {
+			for (i = 0; i < (int)ecc_words; i++)
 				bch->ecc_buf[i] ^= bch->ecc_buf2[i];
-				sum |= bch->ecc_buf[i];
-			}
-			if (!sum)
-				/* no error found */
-				return 0;
 		}
+		for (i = 0, sum = 0; i < (int)ecc_words; i++)
+			sum |= bch->ecc_buf[i];
+		if (!sum)
+			/* no error found */
+			return 0;
 		compute_syndromes(bch, bch->ecc_buf, bch->syn);
 		syn = bch->syn;
 	}
 
+	/* all syndromes are zero if there is no error */
+	for (i = 0, sum = 0; i < (int)GF_T(bch); i++)
+		sum |= syn[2*i];
+	if (!sum)
+		return 0;
+
 	err = compute_error_locator_polynomial(bch, syn);
 	if (err > 0) {
 		nroots = find_poly_roots(bch, 1, bch->elp, errloc);
@@ -1103,6 +1123,27 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 	}
 }
 
+/*
+ * compute tables for evaluating the ecc polynomial a byte at a time: entry v
+ * of table j holds byte polynomial v(X) evaluated at X=a^(2j+1)
+ */
+static void build_syn_tables(struct bch_control *bch)
+{
+	unsigned int j, b, v, x;
+	uint16_t *tab;
+
+	for (j = 0; j < GF_T(bch); j++) {
+		tab = bch->syn_tab+256*j;
+		tab[0] = 0;
+		for (b = 0; b < 8; b++) {
+			/* entries with bit b set extend those without it */
+			x = a_pow(bch, (2*j+1)*b);
+			for (v = 0; v < (1u << b); v++)
+				tab[(1u << b)|v] = tab[v]^x;
+		}
+	}
+}
+
 /*
  * build a base for factoring degree 2 polynomials
  */
@@ -1299,6 +1340,7 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	bch->ecc_buf2  = bch_alloc(words*sizeof(*bch->ecc_buf2), &err);
 	bch->xi_tab    = bch_alloc(m*sizeof(*bch->xi_tab), &err);
 	bch->syn       = bch_alloc(2*t*sizeof(*bch->syn), &err);
+	bch->syn_tab   = bch_alloc(256*t*sizeof(*bch->syn_tab), &err);
 	bch->cache     = bch_alloc(2*t*sizeof(*bch->cache), &err);
 	bch->elp       = bch_alloc((t+1)*sizeof(struct gf_poly_deg1), &err);
 
@@ -1320,6 +1362,8 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	build_mod8_tables(bch, genpoly);
 	kfree(genpoly);
 
+	build_syn_tables(bch);
+
 	err = build_deg2_base(bch);
 	if (err)
 		goto fail;
@@ -1347,6 +1391,7 @@ void free_bch(struct bch_control *bch)
 		kfree(bch->ecc_buf2);
 		kfree(bch->xi_tab);
 		kfree(bch->syn);
+		kfree(bch->syn_tab);
 		kfree(bch->cache);
 		kfree(bch->elp);
 
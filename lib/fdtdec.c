@@ -160,6 +160,11 @@ enum fdt_compat_id fdtdec_lookup(const void *blob, int node)
 int fdtdec_next_compatible(const void *blob, int node,
 		enum fdt_compat_id id)
 {
+	int ret;
+
+	ret = fdtdec_cache_next_compatible(blob, node, compat_names[id]);
+	if (ret != -ENOSYS)
+		return ret;
 	return fdt_node_offset_by_compatible(blob, node, compat_names[id]);
 }
 
@@ -323,6 +328,18 @@ int fdtdec_add_aliases_for_id(const void *blob, const char *name,
 	return num_found;
 }
 
+int fdtdec_alias_name_seq(const char *name)
+{
+	const char *p = name + strlen(name);
+
+	while (p > name && isdigit(p[-1]))
+		p--;
+	if (!*p)
+		return -1;
+
+	return simple_strtoul(p, NULL, 10);
+}
+
 int fdtdec_get_alias_seq(const void *blob, const char *base, int offset,
 			 int *seqp)
 {
@@ -331,6 +348,11 @@ int fdtdec_get_alias_seq(const void *blob, const char *base, int offset,
 	int find_namelen;
 	int prop_offset;
 	int aliases;
+	int ret;
+
+	ret = fdtdec_cache_get_alias_seq(blob, base, offset, seqp);
+	if (ret != -ENOSYS)
+		return ret;
 
 	find_name = fdt_get_name(blob, offset, &find_namelen);
 	debug("Looking for '%s' at %d, name %s\n", base, offset, find_name);
@@ -342,8 +364,7 @@ int fdtdec_get_alias_seq(const void *blob, const char *base, int offset,
 		const char *prop;
 		const char *name;
 		const char *slash;
-		const char *p;
-		int len;
+		int len, seq;
 
 		prop = fdt_getprop_by_offset(blob, prop_offset, &name, &len);
 		debug("   - %s, %s\n", name, prop);
@@ -354,12 +375,11 @@ int fdtdec_get_alias_seq(const void *blob, const char *base, int offset,
 		slash = strrchr(prop, '/');
 		if (strcmp(slash + 1, find_name))
 			continue;
-		for (p = name; *p; p++) {
-			if (isdigit(*p)) {
-				*seqp = simple_strtoul(p, NULL, 10);
-				debug("Found seq %d\n", *seqp);
-				return 0;
-			}
+		seq = fdtdec_alias_name_seq(name);
+		if (seq >= 0) {
+			*seqp = seq;
+			debug("Found seq %d\n", *seqp);
+			return 0;
 		}
 	}
 
@@ -375,6 +395,9 @@ int fdtdec_get_alias_node(const void *blob, const char *name)
 
 	if (!blob)
 		return -FDT_ERR_NOTFOUND;
+	alias_node = fdtdec_cache_get_alias_node(blob, name);
+	if (alias_node != -ENOSYS)
+		return alias_node;
 	alias_node = fdt_path_offset(blob, "/aliases");
 	prop = fdt_getprop(blob, alias_node, name, &len);
 	if (!prop)
@@ -421,6 +444,9 @@ int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 	if (!phandle)
 		return -FDT_ERR_NOTFOUND;
 
+	lookup = fdtdec_cache_lookup_phandle(blob, fdt32_to_cpu(*phandle));
+	if (lookup != -ENOSYS)
+		return lookup;
 	lookup = fdt_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
 	return lookup;
 }
@@ -0,0 +1,331 @@
+/*
+ * Lookup cache for the control device tree
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <fdtdec.h>
+#include <libfdt.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/*
+ * Looking up a phandle, an alias or a compatible string in a flat tree
+ * means scanning the whole tree. Driver model does this for every device
+ * it binds, so instead we scan the control FDT once and keep hash tables
+ * mapping phandles and compatible strings to node offsets, plus a list of
+ * the aliases with their target nodes resolved.
+ *
+ * The cache is built on first use and only for gd->fdt_blob. Before
+ * relocation it comes from the early malloc() area, if it fits in half of
+ * what is left there, and it is dropped when the full malloc() area is set
+ * up. It is also dropped if the blob moves or changes size, or explicitly
+ * with fdtdec_cache_invalidate() when the tree is edited in place. If it
+ * cannot be built, lookups in that blob scan the tree without trying again.
+ */
+
+/* An entry in a hash chain */
+struct fdtdec_cache_entry {
+	const char *str;	/* Compatible string, NULL for a phandle */
+	uint32_t phandle;
+	int offset;		/* Node offset */
+	int next;		/* Next entry in chain, -1 for none */
+};
+
+struct fdtdec_cache_alias {
+	const char *name;
+	int offset;		/* Target node offset, -ve if not found */
+};
+
+struct fdtdec_cache {
+	const void *blob;
+	bool early;		/* Allocated before relocation */
+	uint32_t size_dt_struct;
+	uint32_t size_dt_strings;
+	uint32_t hash_mask;
+	int *phandle_head;	/* Hash table of phandles */
+	int *compat_head;	/* Hash table of compatible strings */
+	struct fdtdec_cache_entry *entry;
+	int num_entries;
+	struct fdtdec_cache_alias *alias;
+	int num_aliases;
+};
+
+static uint32_t cache_hash_str(const char *str)
+{
+	uint32_t hash = 5381;
+
+	while (*str)
+		hash = hash * 33 + *str++;
+
+	return hash;
+}
+
+static uint32_t cache_hash_phandle(uint32_t phandle)
+{
+	return phandle * 0x9e3779b1;
+}
+
+/* Find the phandle and compatible list of a node in one pass */
+static void cache_scan_node(const void *blob, int node, uint32_t *phandlep,
+			    const char **compatp, int *compat_lenp)
+{
+	const fdt32_t *val;
+	const char *name;
+	int offset, len;
+
+	*phandlep = 0;
+	*compatp = NULL;
+	*compat_lenp = 0;
+	for (offset = fdt_first_property_offset(blob, node);
+	     offset >= 0;
+	     offset = fdt_next_property_offset(blob, offset)) {
+		val = fdt_getprop_by_offset(blob, offset, &name, &len);
+		if (!val)
+			continue;
+		if (!strcmp(name, "compatible")) {
+			*compatp = (const char *)val;
+			*compat_lenp = len;
+		} else if ((!strcmp(name, "phandle") ||
+			    (!*phandlep && !strcmp(name, "linux,phandle"))) &&
+			   len == sizeof(*val)) {
+			*phandlep = fdt32_to_cpu(*val);
+		}
+	}
+}
+
+static void cache_add(struct fdtdec_cache *cache, int *head, int *tail,
+		      uint32_t hash, const char *str, uint32_t phandle,
+		      int offset)
+{
+	struct fdtdec_cache_entry *entry = &cache->entry[cache->num_entries];
+	uint32_t bucket = hash & cache->hash_mask;
+
+	entry->str = str;
+	entry->phandle = phandle;
+	entry->offset = offset;
+	entry->next = -1;
+
+	/* Keep each chain in tree order, for fdtdec_next_compatible() */
+	if (head[bucket] == -1)
+		head[bucket] = cache->num_entries;
+	else
+		cache->entry[tail[bucket]].next = cache->num_entries;
+	tail[bucket] = cache->num_entries++;
+}
+
+static struct fdtdec_cache *cache_build(const void *blob)
+{
+	struct fdtdec_cache *cache;
+	int num_phandles = 0, num_compats = 0, num_aliases = 0;
+	int *phandle_tail, *compat_tail;
+	const char *compat, *p;
+	uint32_t phandle, hash_size;
+	int node, aliases, offset, len, i;
+	ulong start = get_timer(0);
+	size_t size;
+	char *buf;
+
+	for (node = 0; node >= 0; node = fdt_next_node(blob, node, NULL)) {
+		cache_scan_node(blob, node, &phandle, &compat, &len);
+		if (phandle)
+			num_phandles++;
+		for (p = compat; p && p < compat + len; p += strlen(p) + 1)
+			num_compats++;
+	}
+	aliases = fdt_path_offset(blob, "/aliases");
+	for (offset = fdt_first_property_offset(blob, aliases);
+	     offset >= 0;
+	     offset = fdt_next_property_offset(blob, offset))
+		num_aliases++;
+
+	for (hash_size = 16; hash_size < 2 * (num_phandles + num_compats);)
+		hash_size <<= 1;
+
+	size = sizeof(*cache) + hash_size * sizeof(int) * 4 +
+		(num_phandles + num_compats) * sizeof(*cache->entry) +
+		num_aliases * sizeof(*cache->alias);
+#ifdef CONFIG_SYS_MALLOC_F_LEN
+	/* Leave the rest of the early malloc() area for driver model */
+	if (!(gd->flags & GD_FLG_RELOC) &&
+	    size > (gd->malloc_limit - gd->malloc_ptr) / 2)
+		return NULL;
+#endif
+	buf = malloc(size);
+	if (!buf)
+		return NULL;
+	cache = (struct fdtdec_cache *)buf;
+	cache->entry = (struct fdtdec_cache_entry *)(cache + 1);
+	cache->alias = (struct fdtdec_cache_alias *)
+		(cache->entry + num_phandles + num_compats);
+	cache->phandle_head = (int *)(cache->alias + num_aliases);
+	cache->compat_head = cache->phandle_head + hash_size;
+	/* The tails are only needed while building, so are at the end */
+	phandle_tail = cache->compat_head + hash_size;
+	compat_tail = phandle_tail + hash_size;
+
+	cache->blob = blob;
+	cache->early = !(gd->flags & GD_FLG_RELOC);
+	cache->size_dt_struct = fdt_size_dt_struct(blob);
+	cache->size_dt_strings = fdt_size_dt_strings(blob);
+	cache->hash_mask = hash_size - 1;
+	cache->num_entries = 0;
+	for (i = 0; i < hash_size; i++) {
+		cache->phandle_head[i] = -1;
+		cache->compat_head[i] = -1;
+	}
+
+	for (node = 0; node >= 0; node = fdt_next_node(blob, node, NULL)) {
+		cache_scan_node(blob, node, &phandle, &compat, &len);
+		if (phandle) {
+			cache_add(cache, cache->phandle_head, phandle_tail,
+				  cache_hash_phandle(phandle), NULL, phandle,
+				  node);
+		}
+		for (p = compat; p && p < compat + len; p += strlen(p) + 1) {
+			cache_add(cache, cache->compat_head, compat_tail,
+				  cache_hash_str(p), p, 0, node);
+		}
+	}
+
+	cache->num_aliases = 0;
+	for (offset = fdt_first_property_offset(blob, aliases);
+	     offset >= 0;
+	     offset = fdt_next_property_offset(blob, offset)) {
+		struct fdtdec_cache_alias *alias;
+		const char *path;
+
+		alias = &cache->alias[cache->num_aliases++];
+		path = fdt_getprop_by_offset(blob, offset, &alias->name, &len);
+		if (path && len > 0 && *path == '/' && !path[len - 1])
+			alias->offset = fdt_path_offset(blob, path);
+		else
+			alias->offset = -FDT_ERR_NOTFOUND;
+	}
+
+	debug("%s: %d phandles, %d compatible strings, %d aliases in %lu ms\n",
+	      __func__, num_phandles, num_compats, num_aliases,
+	      get_timer(start));
+
+	return cache;
+}
+
+void fdtdec_cache_invalidate(void)
+{
+	/* Memory from the early malloc() area must not go to free() later */
+	if (gd->fdt_cache && !gd->fdt_cache->early)
+		free(gd->fdt_cache);
+	gd->fdt_cache = NULL;
+	gd->fdt_cache_failed = NULL;
+}
+
+/**
+ * cache_get() - Get the lookup cache for a blob, building it if needed
+ *
+ * @blob:	Device tree blob
+ * @return cache, or NULL if @blob is not the control FDT or the cache
+ * cannot be built
+ */
+static struct fdtdec_cache *cache_get(const void *blob)
+{
+	struct fdtdec_cache *cache = gd->fdt_cache;
+
+	if (!blob || blob != gd->fdt_blob || blob == gd->fdt_cache_failed)
+		return NULL;
+
+	/* A tree that was edited in place normally changes size */
+	if (cache && (cache->blob != blob ||
+		      cache->size_dt_struct != fdt_size_dt_struct(blob) ||
+		      cache->size_dt_strings != fdt_size_dt_strings(blob))) {
+		fdtdec_cache_invalidate();
+		cache = NULL;
+	}
+	if (!cache) {
+		cache = cache_build(blob);
+		gd->fdt_cache = cache;
+		if (!cache)
+			gd->fdt_cache_failed = blob;
+	}
+
+	return cache;
+}
+
+int fdtdec_cache_lookup_phandle(const void *blob, uint32_t phandle)
+{
+	struct fdtdec_cache *cache = cache_get(blob);
+	int i;
+
+	if (!cache)
+		return -ENOSYS;
+	for (i = cache->phandle_head[cache_hash_phandle(phandle) &
+				     cache->hash_mask];
+	     i != -1; i = cache->entry[i].next) {
+		if (cache->entry[i].phandle == phandle)
+			return cache->entry[i].offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdtdec_cache_next_compatible(const void *blob, int node,
+				 const char *compat)
+{
+	struct fdtdec_cache *cache = cache_get(blob);
+	struct fdtdec_cache_entry *entry;
+	int i;
+
+	if (!cache)
+		return -ENOSYS;
+	for (i = cache->compat_head[cache_hash_str(compat) &
+				    cache->hash_mask];
+	     i != -1; i = entry->next) {
+		entry = &cache->entry[i];
+		if (entry->offset > node && !strcmp(entry->str, compat))
+			return entry->offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdtdec_cache_get_alias_seq(const void *blob, const char *base, int node,
+			       int *seqp)
+{
+	struct fdtdec_cache *cache = cache_get(blob);
+	int base_len = strlen(base);
+	int i, seq;
+
+	if (!cache)
+		return -ENOSYS;
+	for (i = 0; i < cache->num_aliases; i++) {
+		if (cache->alias[i].offset != node ||
+		    strncmp(cache->alias[i].name, base, base_len))
+			continue;
+		seq = fdtdec_alias_name_seq(cache->alias[i].name);
+		if (seq >= 0) {
+			*seqp = seq;
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+int fdtdec_cache_get_alias_node(const void *blob, const char *name)
+{
+	struct fdtdec_cache *cache = cache_get(blob);
+	int i;
+
+	if (!cache)
+		return -ENOSYS;
+	for (i = 0; i < cache->num_aliases; i++) {
+		if (!strcmp(cache->alias[i].name, name))
+			return cache->alias[i].offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
@@ -55,50 +55,67 @@
  * The reentrant version has no static variables to maintain the state.
  * Instead the interface of all functions is extended to take an argument
  * which describes the current status.
+ *
+ * Entries are allocated one by one and never move, so the ENTRY pointers
+ * returned by hsearch_r() stay valid while the table changes. The hash
+ * table itself only holds pointers to the entries, using open addressing
+ * with linear probing. It doubles in size when it is 3/4 full; the
+ * entries are then moved over to the new table a few slots at a time by
+ * later operations, so no single setenv has to rehash the whole
+ * environment. Until that is done, lookups try both tables.
+ *
+ * A list of the entries is also kept in key order for hexport_r() and
+ * hmatch_r(). New entries are appended to it and only sorted (and merged
+ * with the part that is already in order) when the order is needed. An
+ * environment which is imported from storage is already sorted, so in
+ * the common case nothing needs to be done at all.
  */
 
 typedef struct _ENTRY {
-	int used;
-	ENTRY entry;
+	ENTRY entry;		/* Must be first, see hentry() */
+	unsigned int hval;	/* Hash value of key */
+	unsigned int pos;	/* Position in htab->list */
 } _ENTRY;
 
+/* Marks a hash table slot whose entry was deleted or moved */
+#define HSLOT_DELETED	((_ENTRY *)-1)
+
+/* Number of old slots to move on each operation while resizing */
+#define HREHASH_STEP	16
+
+static inline _ENTRY *hentry(ENTRY *ep)
+{
+	return (_ENTRY *)ep;
+}
 
-static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
-	int idx);
+static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep);
 
 /*
  * hcreate()
  */
 
-/*
- * For the used double hash method the table size has to be a prime. To
- * correct the user given table size we need a prime test.  This trivial
- * algorithm is adequate because
- * a)  the code is (most probably) called a few times per program run and
- * b)  the number is small because the table must fit in the core
- * */
-static int isprime(unsigned int number)
+static unsigned int hash_key(const char *key)
 {
-	/* no even number will be passed */
-	unsigned int div = 3;
+	unsigned int hval = 5381;
 
-	while (div * div < number && number % div != 0)
-		div += 2;
+	while (*key)
+		hval = hval * 33 + (unsigned char)*key++;
 
-	return number % div != 0;
+	/* Fold in the upper bits, since only the lower ones index the table */
+	return hval ^ (hval >> 15);
 }
 
 /*
  * Before using the hash table we must allocate memory for it.
- * Test for an existing table are done. We allocate one element
- * more as the found prime number says. This is done for more effective
- * indexing as explained in the comment for the hsearch function.
- * The contents of the table is zeroed, especially the field used
- * becomes zero.
+ * Test for an existing table are done. The size is rounded up to a
+ * power of two, with room for @nel entries before the table must grow.
+ * The contents of the table is zeroed, i.e. all slots are empty.
  */
 
 int hcreate_r(size_t nel, struct hsearch_data *htab)
 {
+	unsigned int size;
+
 	/* Test for correct arguments.  */
 	if (htab == NULL) {
 		__set_errno(EINVAL);
@@ -109,16 +126,23 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 	if (htab->table != NULL)
 		return 0;
 
-	/* Change nel to the first prime number not smaller as nel. */
-	nel |= 1;		/* make odd */
-	while (!isprime(nel))
-		nel += 2;
+	for (size = 16; size / 4 * 3 <= nel; size <<= 1)
+		;
 
-	htab->size = nel;
+	htab->size = size;
+	htab->used = 0;
 	htab->filled = 0;
+	htab->old_table = NULL;
+	htab->old_size = 0;
+	htab->rehash_idx = 0;
+	htab->list = NULL;
+	htab->list_len = 0;
+	htab->list_max = 0;
+	htab->list_sorted = 0;
+	htab->list_holes = 0;
 
 	/* allocate memory and zero out */
-	htab->table = (_ENTRY *) calloc(htab->size + 1, sizeof(_ENTRY));
+	htab->table = calloc(htab->size, sizeof(_ENTRY *));
 	if (htab->table == NULL)
 		return 0;
 
@@ -146,19 +170,224 @@ void hdestroy_r(struct hsearch_data *htab)
 		return;
 	}
 
-	/* free used memory */
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
+	/* free used memory; every entry is on the list */
+	for (i = 0; i < htab->list_len; ++i) {
+		_ENTRY *ep = htab->list[i];
 
-			free((void *)ep->key);
-			free(ep->data);
+		if (ep) {
+			free((void *)ep->entry.key);
+			free(ep->entry.data);
+			free(ep);
 		}
 	}
+	free(htab->list);
+	free(htab->old_table);
 	free(htab->table);
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
+	htab->old_table = NULL;
+	htab->list = NULL;
+	htab->list_len = 0;
+	htab->list_max = 0;
+	htab->filled = 0;
+}
+
+/*
+ * Helpers for the hash table and the sorted list
+ */
+
+/* Find the slot holding an entry in a table, or NULL if it is not there */
+static _ENTRY **hslot_find(_ENTRY **table, unsigned int size,
+			   const char *key, unsigned int hval)
+{
+	unsigned int mask = size - 1;
+	unsigned int idx;
+	_ENTRY *ep;
+
+	/* There is always at least one empty slot, so this terminates */
+	for (idx = hval & mask; (ep = table[idx]); idx = (idx + 1) & mask) {
+		if (ep != HSLOT_DELETED && ep->hval == hval &&
+		    strcmp(key, ep->entry.key) == 0)
+			return &table[idx];
+	}
+
+	return NULL;
+}
+
+/* Find an entry's slot, looking in the old table too during a resize */
+static _ENTRY **hslot(struct hsearch_data *htab, const char *key,
+		      unsigned int hval)
+{
+	_ENTRY **slot;
+
+	slot = hslot_find(htab->table, htab->size, key, hval);
+	if (!slot && htab->old_table)
+		slot = hslot_find(htab->old_table, htab->old_size, key, hval);
+
+	return slot;
+}
+
+/* Put an entry in the first free slot, return 1 if it was never used */
+static int hslot_put(_ENTRY **table, unsigned int size, _ENTRY *ep)
+{
+	unsigned int mask = size - 1;
+	unsigned int idx;
+
+	for (idx = ep->hval & mask; table[idx] && table[idx] != HSLOT_DELETED;
+	     idx = (idx + 1) & mask)
+		;
+	if (table[idx]) {
+		table[idx] = ep;
+		return 0;
+	}
+	table[idx] = ep;
+
+	return 1;
+}
+
+/* Move up to @count slots from the old table to the current one */
+static void hrehash_step(struct hsearch_data *htab, unsigned int count)
+{
+	_ENTRY *ep;
+
+	while (htab->old_table && count--) {
+		ep = htab->old_table[htab->rehash_idx];
+		if (ep && ep != HSLOT_DELETED) {
+			htab->used += hslot_put(htab->table, htab->size, ep);
+			htab->old_table[htab->rehash_idx] = HSLOT_DELETED;
+		}
+		if (++htab->rehash_idx == htab->old_size) {
+			free(htab->old_table);
+			htab->old_table = NULL;
+			htab->old_size = 0;
+		}
+	}
+}
+
+/*
+ * Make sure that there is room for one more entry in the current table.
+ * When it is 3/4 full (including deleted slots) a new table is started,
+ * twice as big unless most of the used slots are deleted ones.
+ */
+static int hgrow(struct hsearch_data *htab)
+{
+	unsigned int size = htab->size;
+	_ENTRY **table;
+
+	if (htab->used + 1 < size / 4 * 3)
+		return 0;
+
+	/* Finish any resize that is still going on */
+	hrehash_step(htab, htab->old_size);
+	if (htab->used + 1 < size / 4 * 3)
+		return 0;
+
+	if (htab->filled + 1 >= size / 2)
+		size <<= 1;
+	table = calloc(size, sizeof(_ENTRY *));
+	if (!table)
+		return -ENOMEM;
+	debug("hgrow: table %p, %d/%d used, new size %d\n", htab,
+	      htab->filled, htab->size, size);
+
+	htab->old_table = htab->table;
+	htab->old_size = htab->size;
+	htab->rehash_idx = 0;
+	htab->table = table;
+	htab->size = size;
+	htab->used = 0;
+
+	return 0;
+}
+
+/* Add a new entry to the end of the list */
+static int horder_add(struct hsearch_data *htab, _ENTRY *ep)
+{
+	unsigned int pos = htab->list_len;
+
+	if (pos == htab->list_max) {
+		unsigned int max = htab->list_max ? htab->list_max * 2 : 64;
+		_ENTRY **list;
+
+		list = realloc(htab->list, max * sizeof(_ENTRY *));
+		if (!list)
+			return -ENOMEM;
+		htab->list = list;
+		htab->list_max = max;
+	}
+	ep->pos = pos;
+	htab->list[pos] = ep;
+	htab->list_len++;
+
+	/* Entries which arrive in order (e.g. from himport_r()) stay sorted */
+	if (htab->list_sorted == pos && !htab->list_holes &&
+	    (!pos || strcmp(htab->list[pos - 1]->entry.key,
+			    ep->entry.key) < 0))
+		htab->list_sorted++;
+
+	return 0;
+}
+
+static void horder_del(struct hsearch_data *htab, _ENTRY *ep)
+{
+	htab->list[ep->pos] = NULL;
+	htab->list_holes++;
+}
+
+static int horder_cmp(const void *p1, const void *p2)
+{
+	const _ENTRY *e1 = *(const _ENTRY **)p1;
+	const _ENTRY *e2 = *(const _ENTRY **)p2;
+
+	return strcmp(e1->entry.key, e2->entry.key);
+}
+
+/*
+ * Put the list in key order: drop the holes left by deleted entries, sort
+ * the entries added out of order and merge them with the rest.
+ */
+static void horder_sort(struct hsearch_data *htab)
+{
+	_ENTRY **list = htab->list;
+	_ENTRY **merged;
+	unsigned int sorted = 0, len = 0;
+	unsigned int i, j, k;
+
+	if (htab->list_sorted == htab->list_len && !htab->list_holes)
+		return;
+
+	for (i = 0; i < htab->list_len; i++) {
+		if (!list[i])
+			continue;
+		if (i < htab->list_sorted)
+			sorted++;
+		list[len++] = list[i];
+	}
+	qsort(list + sorted, len - sorted, sizeof(_ENTRY *), horder_cmp);
+
+	merged = sorted && len > sorted ?
+		malloc(htab->list_max * sizeof(_ENTRY *)) : NULL;
+	if (merged) {
+		for (i = 0, j = sorted, k = 0; k < len; k++) {
+			if (j == len || (i < sorted &&
+					 horder_cmp(&list[i], &list[j]) < 0))
+				merged[k] = list[i++];
+			else
+				merged[k] = list[j++];
+		}
+		free(list);
+		htab->list = list = merged;
+	} else if (sorted && len > sorted) {
+		/* No memory to merge into, so sort the lot in place */
+		qsort(list, len, sizeof(_ENTRY *), horder_cmp);
+	}
+
+	for (i = 0; i < len; i++)
+		list[i]->pos = i;
+	htab->list_len = len;
+	htab->list_sorted = len;
+	htab->list_holes = 0;
 }
 
 /*
@@ -166,19 +395,11 @@ void hdestroy_r(struct hsearch_data *htab)
  */
 
 /*
- * This is the search function. It uses double hashing with open addressing.
- * The argument item.key has to be a pointer to an zero terminated, most
- * probably strings of chars. The function for generating a number of the
- * strings is simple but fast. It can be replaced by a more complex function
- * like ajw (see [Aho,Sethi,Ullman]) if the needs are shown.
- *
- * We use an trick to speed up the lookup. The table is created by hcreate
- * with one more element available. This enables us to use the index zero
- * special. This index will never be used because we store the first hash
- * index in the field used where zero means not used. Every other value
- * means used. The used field can be used as a first fast comparison for
- * equality of the stored and the parameter value. This helps to prevent
- * unnecessary expensive calls of strcmp.
+ * This is the search function. It uses open addressing with linear
+ * probing, see above. The argument item.key has to be a pointer to an
+ * zero terminated, most probably strings of chars. The full hash value is
+ * kept with each entry and is compared first, which avoids most of the
+ * expensive calls of strcmp.
  *
  * This implementation differs from the standard library version of
  * this function in a number of ways:
@@ -192,10 +413,8 @@ void hdestroy_r(struct hsearch_data *htab)
  * - The standard implementation does not provide a way to update an
  *   existing entry.  This version will create a new entry or update an
  *   existing one when both "action == ENTER" and "item.data != NULL".
- * - Instead of returning 1 on success, we return the index into the
- *   internal hash table, which is also guaranteed to be positive.
- *   This allows us direct access to the found hash table slot for
- *   example for functions like hdelete().
+ * - The table is not limited to the size given to hcreate_r(), but
+ *   grows as needed.
  */
 
 int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
@@ -204,13 +423,32 @@ int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
 	unsigned int idx;
 	size_t key_len = strlen(match);
 
-	for (idx = last_idx + 1; idx < htab->size; ++idx) {
-		if (htab->table[idx].used <= 0)
-			continue;
-		if (!strncmp(match, htab->table[idx].entry.key, key_len)) {
-			*retval = &htab->table[idx].entry;
-			return idx;
+	/*
+	 * The list is in key order, so the matches are all together. On
+	 * the first call find the first one, then return them in turn.
+	 */
+	if (!last_idx) {
+		unsigned int lo = 0, hi;
+
+		horder_sort(htab);
+		for (hi = htab->list_len; lo < hi;) {
+			idx = (lo + hi) / 2;
+			if (strcmp(htab->list[idx]->entry.key, match) < 0)
+				lo = idx + 1;
+			else
+				hi = idx;
 		}
+		idx = lo;
+	} else {
+		idx = last_idx;
+	}
+
+	for (; idx < htab->list_len && !htab->list[idx]; ++idx)
+		;
+	if (idx < htab->list_len &&
+	    !strncmp(match, htab->list[idx]->entry.key, key_len)) {
+		*retval = &htab->list[idx]->entry;
+		return idx + 1;
 	}
 
 	__set_errno(ESRCH);
@@ -219,193 +457,117 @@ int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
 }
 
 /*
- * Compare an existing entry with the desired key, and overwrite if the action
- * is ENTER.  This is simply a helper function for hsearch_r().
+ * Overwrite the value of an existing entry if the action is ENTER.  This is
+ * simply a helper function for hsearch_r().
  */
-static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
-	ENTRY **retval, struct hsearch_data *htab, int flag,
-	unsigned int hval, unsigned int idx)
+static inline int _overwrite_entry(ENTRY item, ACTION action,
+	ENTRY **retval, struct hsearch_data *htab, int flag, ENTRY *ep)
 {
-	if (htab->table[idx].used == hval
-	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
-		/* Overwrite existing value? */
-		if ((action == ENTER) && (item.data != NULL)) {
-			/* check for permission */
-			if (htab->change_ok != NULL && htab->change_ok(
-			    &htab->table[idx].entry, item.data,
-			    env_op_overwrite, flag)) {
-				debug("change_ok() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EPERM);
-				*retval = NULL;
-				return 0;
-			}
+	/* Overwrite existing value? */
+	if ((action == ENTER) && (item.data != NULL)) {
+		/* check for permission */
+		if (htab->change_ok != NULL && htab->change_ok(
+		    ep, item.data, env_op_overwrite, flag)) {
+			debug("change_ok() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EPERM);
+			*retval = NULL;
+			return 0;
+		}
 
-			/* If there is a callback, call it */
-			if (htab->table[idx].entry.callback &&
-			    htab->table[idx].entry.callback(item.key,
-			    item.data, env_op_overwrite, flag)) {
-				debug("callback() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EINVAL);
-				*retval = NULL;
-				return 0;
-			}
+		/* If there is a callback, call it */
+		if (ep->callback && ep->callback(item.key, item.data,
+		    env_op_overwrite, flag)) {
+			debug("callback() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EINVAL);
+			*retval = NULL;
+			return 0;
+		}
 
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
-				__set_errno(ENOMEM);
-				*retval = NULL;
-				return 0;
-			}
+		free(ep->data);
+		ep->data = strdup(item.data);
+		if (!ep->data) {
+			__set_errno(ENOMEM);
+			*retval = NULL;
+			return 0;
 		}
-		/* return found entry */
-		*retval = &htab->table[idx].entry;
-		return idx;
 	}
-	/* keep searching */
-	return -1;
+	/* return found entry */
+	*retval = ep;
+	return 1;
 }
 
 int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 	      struct hsearch_data *htab, int flag)
 {
-	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
-	unsigned int idx;
-	unsigned int first_deleted = 0;
-	int ret;
+	unsigned int hval = hash_key(item.key);
+	_ENTRY **slot;
+	_ENTRY *ep;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
-
-	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
-	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
-
-	/* The first index tried. */
-	idx = hval;
+	/* Carry on with any resize which is in progress */
+	hrehash_step(htab, HREHASH_STEP);
 
-	if (htab->table[idx].used) {
-		/*
-		 * Further action might be required according to the
-		 * action value.
-		 */
-		unsigned hval2;
-
-		if (htab->table[idx].used == -1
-		    && !first_deleted)
-			first_deleted = idx;
+	slot = hslot(htab, item.key, hval);
+	if (slot)
+		return _overwrite_entry(item, action, retval, htab, flag,
+					&(*slot)->entry);
 
-		ret = _compare_and_overwrite_entry(item, action, retval, htab,
-			flag, hval, idx);
-		if (ret != -1)
-			return ret;
-
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
-		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
-
-			/*
-			 * If we visited all entries leave the loop
-			 * unsuccessfully.
-			 */
-			if (idx == hval)
-				break;
-
-			/* If entry is found use it. */
-			ret = _compare_and_overwrite_entry(item, action, retval,
-				htab, flag, hval, idx);
-			if (ret != -1)
-				return ret;
-		}
-		while (htab->table[idx].used);
-	}
-
-	/* An empty bucket has been found. */
 	if (action == ENTER) {
 		/*
-		 * If table is full and another entry should be
-		 * entered return with error.
-		 */
-		if (htab->filled == htab->size) {
-			__set_errno(ENOMEM);
-			*retval = NULL;
-			return 0;
-		}
-
-		/*
-		 * Create new entry;
+		 * Make room for the new entry and create it;
 		 * create copies of item.key and item.data
 		 */
-		if (first_deleted)
-			idx = first_deleted;
-
-		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
-		if (!htab->table[idx].entry.key ||
-		    !htab->table[idx].entry.data) {
+		ep = calloc(1, sizeof(_ENTRY));
+		if (ep != NULL) {
+			ep->hval = hval;
+			ep->entry.key = strdup(item.key);
+			ep->entry.data = strdup(item.data);
+		}
+		if (ep == NULL || !ep->entry.key || !ep->entry.data ||
+		    hgrow(htab) || horder_add(htab, ep)) {
+			if (ep) {
+				free((void *)ep->entry.key);
+				free(ep->entry.data);
+				free(ep);
+			}
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
 		}
-
+		htab->used += hslot_put(htab->table, htab->size, ep);
 		++htab->filled;
 
 		/* This is a new entry, so look up a possible callback */
-		env_callback_init(&htab->table[idx].entry);
+		env_callback_init(&ep->entry);
 		/* Also look for flags */
-		env_flags_init(&htab->table[idx].entry);
+		env_flags_init(&ep->entry);
 
 		/* check for permission */
 		if (htab->change_ok != NULL && htab->change_ok(
-		    &htab->table[idx].entry, item.data, env_op_create, flag)) {
+		    &ep->entry, item.data, env_op_create, flag)) {
 			debug("change_ok() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
+			_hdelete(item.key, htab, &ep->entry);
 			__set_errno(EPERM);
 			*retval = NULL;
 			return 0;
 		}
 
 		/* If there is a callback, call it */
-		if (htab->table[idx].entry.callback &&
-		    htab->table[idx].entry.callback(item.key, item.data,
+		if (ep->entry.callback &&
+		    ep->entry.callback(item.key, item.data,
 		    env_op_create, flag)) {
 			debug("callback() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
+			_hdelete(item.key, htab, &ep->entry);
 			__set_errno(EINVAL);
 			*retval = NULL;
 			return 0;
 		}
 
 		/* return new entry */
-		*retval = &htab->table[idx].entry;
+		*retval = &ep->entry;
 		return 1;
 	}
 
@@ -425,16 +587,20 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
  * do that.
  */
 
-static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
-	int idx)
+static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep)
 {
+	_ENTRY *node = hentry(ep);
+	_ENTRY **slot;
+
 	/* free used ENTRY */
 	debug("hdelete: DELETING key \"%s\"\n", key);
+	slot = hslot(htab, ep->key, node->hval);
+	if (slot)
+		*slot = HSLOT_DELETED;
+	horder_del(htab, node);
 	free((void *)ep->key);
 	free(ep->data);
-	ep->callback = NULL;
-	ep->flags = 0;
-	htab->table[idx].used = -1;
+	free(node);
 
 	--htab->filled;
 }
@@ -442,14 +608,12 @@ static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 {
 	ENTRY e, *ep;
-	int idx;
 
 	debug("hdelete: DELETE key \"%s\"\n", key);
 
 	e.key = (char *)key;
 
-	idx = hsearch_r(e, FIND, &ep, htab, 0);
-	if (idx == 0) {
+	if (hsearch_r(e, FIND, &ep, htab, 0) == 0) {
 		__set_errno(ESRCH);
 		return 0;	/* not found */
 	}
@@ -464,15 +628,14 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 	}
 
 	/* If there is a callback, call it */
-	if (htab->table[idx].entry.callback &&
-	    htab->table[idx].entry.callback(key, NULL, env_op_delete, flag)) {
+	if (ep->callback && ep->callback(key, NULL, env_op_delete, flag)) {
 		debug("callback() rejected deleting variable "
 			"%s, skipping it!\n", key);
 		__set_errno(EINVAL);
 		return 0;
 	}
 
-	_hdelete(key, htab, ep, idx);
+	_hdelete(key, htab, ep);
 
 	return 1;
 }
@@ -520,14 +683,6 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  *		bytes in the string will be '\0'-padded.
  */
 
-static int cmpkey(const void *p1, const void *p2)
-{
-	ENTRY *e1 = *(ENTRY **) p1;
-	ENTRY *e2 = *(ENTRY **) p2;
-
-	return (strcmp(e1->key, e2->key));
-}
-
 static int match_string(int flag, const char *str, const char *pat, void *priv)
 {
 	switch (flag & H_MATCH_METHOD) {
@@ -591,7 +746,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char * const argv[])
 {
-	ENTRY *list[htab->size];
+	ENTRY **list;
 	char *res, *p;
 	size_t totlen;
 	int i, n;
@@ -604,15 +759,25 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	debug("EXPORT  table = %p, htab.size = %d, htab.filled = %d, "
 		"size = %zu\n", htab, htab->size, htab->filled, size);
+
+	list = malloc((htab->filled + 1) * sizeof(ENTRY *));
+	if (list == NULL) {
+		__set_errno(ENOMEM);
+		return (-1);
+	}
+
+	/* Entries are kept in key order, so no sorting is needed here */
+	horder_sort(htab);
+
 	/*
 	 * Pass 1:
 	 * search used entries,
 	 * save addresses and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
+	for (i = 0, n = 0, totlen = 0; i < htab->list_len; ++i) {
 
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
+		if (htab->list[i]) {
+			ENTRY *ep = &htab->list[i]->entry;
 			int found = match_entry(ep, flag, argc, argv);
 
 			if ((argc > 0) && (found == 0))
@@ -643,22 +808,20 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	}
 
 #ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
+	/* Pass 1a: print list */
+	printf("Sorted: n=%d\n", n);
 	for (i = 0; i < n; ++i) {
 		printf("\t%3d: %p ==> %-10s => %s\n",
 		       i, list[i], list[i]->key, list[i]->data);
 	}
 #endif
 
-	/* Sort list by keys */
-	qsort(list, n, sizeof(ENTRY *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
 			printf("Env export buffer too small: %zu, "
 				"but need %zu\n", size, totlen + 1);
+			free(list);
 			__set_errno(ENOMEM);
 			return (-1);
 		}
@@ -675,6 +838,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		/* no, allocate and clear one */
 		*resp = res = calloc(1, size);
 		if (res == NULL) {
+			free(list);
 			__set_errno(ENOMEM);
 			return (-1);
 		}
@@ -701,6 +865,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		*p++ = sep;
 	}
 	*p = '\0';		/* terminate result */
+	free(list);
 
 	return size;
 }
@@ -821,7 +986,8 @@ int himport_r(struct hsearch_data *htab,
 	 * (CONFIG_ENV_SIZE).  This heuristics will result in
 	 * unreasonably large numbers (and thus memory footprint) for
 	 * big flash environments (>8,000 entries for 64 KB
-	 * envrionment size), so we clip it to a reasonable value.
+	 * envrionment size), so we clip it to a reasonable value; the
+	 * table grows anyway if more entries are added.
 	 * On the other hand we need to add some more entries for free
 	 * space when importing very small buffers. Both boundaries can
 	 * be overwritten in the board config file if needed.
@@ -965,9 +1131,10 @@ int hwalk_r(struct hsearch_data *htab, int (*callback)(ENTRY *))
 	int i;
 	int retval;
 
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			retval = callback(&htab->table[i].entry);
+	/* Read the list each time, in case the callback changes the table */
+	for (i = 0; i < htab->list_len; ++i) {
+		if (htab->list[i]) {
+			retval = callback(&htab->list[i]->entry);
 			if (retval)
 				return retval;
 		}
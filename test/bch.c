@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+#include <linux/bch.h>
+
+#define TEST_MAX_DATA	1024
+#define TEST_MAX_ECC	64
+#define TEST_MAX_T	32
+
+/* Codes used for NAND: 512- and 1024-byte ECC steps of varying strength */
+static const struct {
+	int m;
+	int t;
+	int len;
+} test_codes[] = {
+	{ 13, 4, 512 },
+	{ 13, 8, 512 },
+	{ 13, 16, 512 },
+	{ 14, 24, 1024 },
+	{ 14, 32, 1024 },
+};
+
+static unsigned int test_seed;
+
+/* A simple generator, so that failures can be reproduced from the seed */
+static unsigned int test_rand(void)
+{
+	test_seed = test_seed * 1103515245 + 12345;
+
+	return test_seed >> 8;
+}
+
+/*
+ * Compute the syndromes of a received codeword from their definition,
+ * S(j) = c(a^j), where bit p of the codeword is the coefficient of
+ * X^(nbits-1-p)
+ */
+static void test_syndromes(struct bch_control *bch, const u8 *data, int len,
+			   const u8 *ecc, unsigned int *syn)
+{
+	int nbits = 8 * len + bch->ecc_bits;
+	int p, j, bit, deg;
+
+	memset(syn, '\0', 2 * bch->t * sizeof(*syn));
+	for (p = 0; p < nbits; p++) {
+		if (p < 8 * len)
+			bit = data[p / 8] & (0x80 >> (p % 8));
+		else
+			bit = ecc[(p - 8 * len) / 8] & (0x80 >> (p % 8));
+		if (!bit)
+			continue;
+		deg = nbits - 1 - p;
+		for (j = 0; j < 2 * bch->t; j++)
+			syn[j] ^= bch->a_pow_tab[((j + 1) * deg) % bch->n];
+	}
+}
+
+/* Flip @count distinct random bits, returning their locations in @loc */
+static void test_add_errors(struct bch_control *bch, u8 *data, int len,
+			    u8 *ecc, int count, unsigned int *loc)
+{
+	int nbits = 8 * len + bch->ecc_bits;
+	int i, j, p;
+
+	for (i = 0; i < count; i++) {
+		do {
+			p = test_rand() % nbits;
+			for (j = 0; j < i && loc[j] != p; j++)
+				;
+		} while (j < i);
+		loc[i] = p;
+		if (p < 8 * len)
+			data[p / 8] ^= 0x80 >> (p % 8);
+		else
+			ecc[(p - 8 * len) / 8] ^= 0x80 >> (p % 8);
+	}
+}
+
+/* Check that decode_bch() found exactly the bits in @loc */
+static int test_check_errloc(int len, const unsigned int *loc, int count,
+			     const unsigned int *errloc, int found)
+{
+	unsigned int expect;
+	int i, j;
+
+	if (found != count)
+		return -EINVAL;
+	for (i = 0; i < count; i++) {
+		/* decode_bch() numbers the bits of each byte from the LSB */
+		expect = (loc[i] & ~7) | (7 - (loc[i] & 7));
+		for (j = 0; j < count && errloc[j] != expect; j++)
+			;
+		if (j == count)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int test_code(int m, int t, int len, int trials, ulong *usp)
+{
+	struct bch_control *bch;
+	u8 data[TEST_MAX_DATA], ecc[TEST_MAX_ECC], calc_ecc[TEST_MAX_ECC];
+	unsigned int loc[TEST_MAX_T], errloc[TEST_MAX_T];
+	unsigned int syn[2 * TEST_MAX_T];
+	int trial, i, count, ret = 0;
+	ulong start;
+
+	bch = init_bch(m, t, 0);
+	if (!bch) {
+		printf("Cannot set up m=%d t=%d\n", m, t);
+		return -ENOMEM;
+	}
+
+	*usp = 0;
+	for (trial = 0; trial < trials && !ret; trial++) {
+		for (i = 0; i < len; i++)
+			data[i] = test_rand();
+		memset(ecc, '\0', bch->ecc_bytes);
+		encode_bch(bch, data, len, ecc);
+
+		/* every number of errors up to t, with none half the time */
+		count = test_rand() & 1 ? test_rand() % (t + 1) : 0;
+		test_add_errors(bch, data, len, ecc, count, loc);
+
+		start = timer_get_us();
+		ret = decode_bch(bch, data, len, ecc, NULL, NULL, errloc);
+		*usp += timer_get_us() - start;
+		if (ret < 0 ||
+		    test_check_errloc(len, loc, count, errloc, ret)) {
+			printf("m=%d t=%d trial %d: %d errors, decoded %d\n", m,
+			       t, trial, count, ret);
+			ret = -EINVAL;
+			break;
+		}
+
+		/* the syndromes must match their definition */
+		test_syndromes(bch, data, len, ecc, syn);
+		if (count && memcmp(syn, bch->syn, 2 * t * sizeof(*syn))) {
+			printf("m=%d t=%d trial %d: wrong syndromes\n", m, t,
+			       trial);
+			ret = -EINVAL;
+			break;
+		}
+
+		/* decoding from given syndromes must give the same result */
+		ret = decode_bch(bch, NULL, len, NULL, NULL, syn, errloc);
+		if (ret < 0 || test_check_errloc(len, loc, count, errloc, ret)) {
+			printf("m=%d t=%d trial %d: syndrome decode %d\n", m, t,
+			       trial, ret);
+			ret = -EINVAL;
+			break;
+		}
+
+		/* and so must decoding from the calculated ecc */
+		memset(calc_ecc, '\0', bch->ecc_bytes);
+		encode_bch(bch, data, len, calc_ecc);
+		ret = decode_bch(bch, NULL, len, ecc, calc_ecc, NULL, errloc);
+		if (ret < 0 || test_check_errloc(len, loc, count, errloc, ret)) {
+			printf("m=%d t=%d trial %d: ecc decode %d\n", m, t,
+			       trial, ret);
+			ret = -EINVAL;
+			break;
+		}
+		ret = 0;
+	}
+	free_bch(bch);
+
+	return ret;
+}
+
+static int do_ut_bch(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
+{
+	int trials = argc > 1 ? simple_strtoul(argv[1], NULL, 10) : 200;
+	ulong us;
+	int i;
+
+	test_seed = argc > 2 ? simple_strtoul(argv[2], NULL, 16) : 0x1234;
+	printf("Seed %x\n", test_seed);
+	for (i = 0; i < ARRAY_SIZE(test_codes); i++) {
+		if (test_code(test_codes[i].m, test_codes[i].t,
+			      test_codes[i].len, trials, &us))
+			return CMD_RET_FAILURE;
+		printf("m=%d t=%d: %d decodes of %d bytes, %lu us\n",
+		       test_codes[i].m, test_codes[i].t, trials,
+		       test_codes[i].len, us);
+	}
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_bch,	3,	1,	do_ut_bch,
+	"Test BCH decoding with random errors",
+	"[trials [seed]]"
+);
@@ -15,10 +15,118 @@ static const char test_cmd[] = "setenv list 1\n setenv list ${list}2; "
 		"setenv list ${list}3\0"
 		"setenv list ${list}4";
 
+/* Check that find_cmd() agrees with a linear scan of the command table */
+static void test_find_cmd(void)
+{
+	cmd_tbl_t *start = ll_entry_start(cmd_tbl_t, cmd);
+	const int count = ll_entry_count(cmd_tbl_t, cmd);
+	cmd_tbl_t *cmdtp;
+	char name[32];
+	ulong base;
+	int i, len;
+
+	for (cmdtp = start; cmdtp != start + count; cmdtp++) {
+		for (len = 1; len <= strlen(cmdtp->name) &&
+		     len < sizeof(name); len++) {
+			strncpy(name, cmdtp->name, len);
+			name[len] = '\0';
+			assert(find_cmd(name) == find_cmd_tbl(name, start, count));
+		}
+	}
+	assert(find_cmd("setenv.b") == find_cmd("setenv"));
+	assert(!find_cmd("no_such_command"));
+	assert(!find_cmd(""));
+
+	base = get_timer(0);
+	for (i = 0; i < 100000;) {
+		for (cmdtp = start; cmdtp != start + count && i < 100000;
+		     cmdtp++, i++)
+			find_cmd(cmdtp->name);
+	}
+	printf("%s: 100000 lookups in %lu ms\n", __func__, get_timer(base));
+}
+
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+/*
+ * Set the four bytes of @forged at @pos so that it has the same CRC32 as
+ * @script, which has the same length and the same text after those bytes
+ */
+static void forge_crc32(const char *script, char *forged, int pos)
+{
+	uint32_t table[256], state, want;
+	int idx[4];
+	int i, j, k;
+
+	for (i = 0; i < 256; i++) {
+		state = i;
+		for (k = 0; k < 8; k++)
+			state = (state >> 1) ^ (state & 1 ? 0xedb88320 : 0);
+		table[i] = state;
+	}
+
+	/* Work back from the state wanted after the four bytes */
+	want = crc32_no_comp(~0, (const uchar *)script, pos + 4);
+	for (k = 3; k >= 0; k--) {
+		for (j = 0; (table[j] >> 24) != (want >> 24); j++)
+			;
+		idx[k] = j;
+		want = (want ^ table[j]) << 8;
+	}
+	state = crc32_no_comp(~0, (const uchar *)forged, pos);
+	for (k = 0; k < 4; k++) {
+		forged[pos + k] = (state ^ idx[k]) & 0xff;
+		state = crc32_no_comp(state, (uchar *)&forged[pos + k], 1);
+	}
+}
+
+/* Check that a cached script is only run for the very same text */
+static void test_script_cache(void)
+{
+	const char script[] = "setenv cache_test 'abWXYZ'";
+	char forged[sizeof(script)], expect[8];
+	const int pos = strchr(script, '\'') + 1 - script;
+	int i, k;
+
+	/* Find a forged script whose new bytes are plain, quotable text */
+	strcpy(forged, script);
+	for (i = 0; i < 26 * 26; i++) {
+		forged[pos] = 'a' + i / 26;
+		forged[pos + 1] = 'a' + i % 26;
+		if (!strncmp(forged + pos, "ab", 2))
+			continue;
+		forge_crc32(script, forged, pos + 2);
+		for (k = 2; k < 6; k++) {
+			if (forged[pos + k] < ' ' || forged[pos + k] > '~' ||
+			    forged[pos + k] == '\'')
+				break;
+		}
+		if (k == 6)
+			break;
+	}
+	assert(i < 26 * 26);
+	assert(crc32(0, (uchar *)script, strlen(script)) ==
+	       crc32(0, (uchar *)forged, strlen(forged)));
+
+	run_command_list(script, -1, 0);
+	assert(!strcmp("abWXYZ", getenv("cache_test")));
+	run_command_list(forged, -1, 0);
+	memcpy(expect, forged + pos, 6);
+	expect[6] = '\0';
+	assert(!strcmp(expect, getenv("cache_test")));
+	run_command_list(script, -1, 0);
+	assert(!strcmp("abWXYZ", getenv("cache_test")));
+	setenv("cache_test", NULL);
+}
+#endif
+
 static int do_ut_cmd(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	printf("%s: Testing commands\n", __func__);
+	test_find_cmd();
 	run_command("env default -f -a", 0);
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+	test_script_cache();
+#endif
 
 	/* run a single command */
 	run_command("setenv single 1", 0);
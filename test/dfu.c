@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <dfu.h>
+#include <malloc.h>
+#include <u-boot/crc.h>
+
+#define TEST_PACKET_SIZE	4096
+#define TEST_BUF_SIZE		"40000"		/* 256 KiB, in hex */
+#define TEST_RUNS		3
+
+static int (*ram_write_medium)(struct dfu_entity *dfu, u64 offset,
+			       void *buf, long *len);
+static unsigned int slow_delay;		/* us per KiB written */
+
+/* Write to RAM, but as slowly as a real storage device */
+static int slow_write_medium(struct dfu_entity *dfu, u64 offset, void *buf,
+			     long *len)
+{
+	udelay(slow_delay * (*len / 1024));
+
+	return ram_write_medium(dfu, offset, buf, len);
+}
+
+/**
+ * dfu_test_download() - Simulate a DFU download to a slow medium
+ *
+ * The packets are passed to dfu_write() as f_dfu.c would, with one call to
+ * dfu_write_poll() between each, as the "dfu" command loop makes.
+ *
+ * @return longest time in us that USB would have gone unserviced before the
+ * final flush, or -1 on error
+ */
+static long dfu_test_download(const u8 *src, u8 *dst, int size,
+			      unsigned long write_slice, ulong *totalp)
+{
+	struct dfu_entity *dfu;
+	char alt_info[64];
+	ulong start, us, worst = 0, begin;
+	int ret = 0, seq, len, pos;
+	u32 crc = 0;
+
+	snprintf(alt_info, sizeof(alt_info), "test ram %lx %x",
+		 (ulong)dst, size);
+	if (dfu_config_entities(alt_info, "ram", "0"))
+		return -1;
+	dfu = dfu_get_entity(0);
+	ram_write_medium = dfu->write_medium;
+	dfu->write_medium = slow_write_medium;
+	dfu->write_slice = write_slice;
+
+	begin = timer_get_us();
+	for (pos = 0, seq = 0; !ret; pos += len, seq++) {
+		len = min(size - pos, TEST_PACKET_SIZE);
+		start = timer_get_us();
+		if (len) {
+			ret = dfu_write(dfu, (void *)src + pos, len, seq);
+		} else {
+			/* the checksum is updated as data arrives */
+			crc = dfu->crc;
+			ret = dfu_flush(dfu, NULL, 0, seq);
+		}
+		/* the host expects to wait while the last data is written */
+		if (!len)
+			break;
+		us = timer_get_us() - start;
+		worst = max(worst, us);
+
+		start = timer_get_us();
+		dfu_write_poll();
+		us = timer_get_us() - start;
+		worst = max(worst, us);
+	}
+	*totalp = timer_get_us() - begin;
+	if (ret)
+		printf("%s: DFU error %d\n", __func__, ret);
+	else if (crc != crc32(0, src, size))
+		printf("%s: Wrong crc %08x\n", __func__, crc);
+	else if (memcmp(src, dst, size))
+		printf("%s: Data mismatch\n", __func__);
+	else
+		ret = 1;
+	dfu_free_entities();
+
+	return ret == 1 ? worst : -1;
+}
+
+/*
+ * Run dfu_test_download() a few times and keep the shortest stall, so that
+ * the host preempting us once does not decide the result
+ */
+static long dfu_test_best(const u8 *src, u8 *dst, int size,
+			  unsigned long write_slice, ulong *totalp)
+{
+	long best = -1, us;
+	ulong total;
+	int i;
+
+	for (i = 0; i < TEST_RUNS; i++) {
+		memset(dst, '\0', size);
+		us = dfu_test_download(src, dst, size, write_slice, &total);
+		if (us < 0)
+			return -1;
+		if (best < 0 || us < best) {
+			best = us;
+			*totalp = total;
+		}
+	}
+
+	return best;
+}
+
+static int do_ut_dfu(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
+{
+	int size = 4 << 20, i;
+	long whole, sliced;
+	ulong whole_time, sliced_time;
+	u8 *src, *dst;
+
+	slow_delay = argc > 1 ? simple_strtoul(argv[1], NULL, 10) : 20;
+	src = malloc(size);
+	dst = malloc(size);
+	if (!src || !dst) {
+		puts("Out of memory\n");
+		return CMD_RET_FAILURE;
+	}
+	/* not a multiple of the packet size, to check the last packet */
+	size -= 1000;
+	for (i = 0; i < size; i++)
+		src[i] = i * 7 + (i >> 12);
+
+	setenv("dfu_bufsiz", TEST_BUF_SIZE);
+	setenv("dfu_hash_algo", "crc32");
+
+	whole = dfu_test_best(src, dst, size, 0, &whole_time);
+	sliced = dfu_test_best(src, dst, size, 32 << 10, &sliced_time);
+
+	setenv("dfu_bufsiz", NULL);
+	setenv("dfu_hash_algo", NULL);
+	free(src);
+	free(dst);
+	if (whole < 0 || sliced < 0)
+		return CMD_RET_FAILURE;
+
+	printf("\n%d bytes, %d buffers: longest stall %ld us (%lu ms total), with slices %ld us (%lu ms total)\n",
+	       size, CONFIG_SYS_DFU_NUM_BUFS, whole, whole_time / 1000,
+	       sliced, sliced_time / 1000);
+	if (CONFIG_SYS_DFU_NUM_BUFS > 1 && sliced >= whole) {
+		puts("Writes did not overlap with USB\n");
+		return CMD_RET_FAILURE;
+	}
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_dfu,	2,	1,	do_ut_dfu,
+	"Test DFU download with writes overlapping USB transfers",
+	"[us_per_KiB]"
+);
@@ -0,0 +1,320 @@
+/*
+ * Tests for the driver model block device uclass
+ *
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <errno.h>
+#include <os.h>
+#include <sandboxblockdev.h>
+#include <dm/device-internal.h>
+#include <dm/root.h>
+#include <dm/test.h>
+#include <dm/ut.h>
+
+#define TEST_FILE	"dm_test_blk.img"
+#define TEST_BLKS	64
+#define BLKSZ		512
+
+/* Each block is filled with its number */
+static void fill_blocks(u8 *buf, lbaint_t start, lbaint_t blkcnt)
+{
+	lbaint_t i;
+
+	for (i = 0; i < blkcnt; i++)
+		memset(buf + i * BLKSZ, (u8)(start + i), BLKSZ);
+}
+
+static int check_blocks(u8 *buf, lbaint_t start, lbaint_t blkcnt)
+{
+	u8 expect[BLKSZ];
+	lbaint_t i;
+
+	for (i = 0; i < blkcnt; i++) {
+		memset(expect, (u8)(start + i), BLKSZ);
+		if (memcmp(buf + i * BLKSZ, expect, BLKSZ))
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Records the order in which requests complete, in their priv */
+static int complete_count;
+
+static void record_complete(struct udevice *dev, struct blk_request *req)
+{
+	*(int *)req->priv = complete_count++;
+}
+
+/* Queues the request in its priv */
+static void chain_complete(struct udevice *dev, struct blk_request *req)
+{
+	blk_submit(dev, req->priv);
+}
+
+static void init_req(struct blk_request *req, struct blk_sg *sg,
+		     enum blk_op op, lbaint_t start, void *buf,
+		     lbaint_t blkcnt, int *order)
+{
+	memset(req, '\0', sizeof(*req));
+	sg->buf = buf;
+	sg->blkcnt = blkcnt;
+	req->op = op;
+	req->start = start;
+	req->sg = sg;
+	req->sg_count = 1;
+	req->complete = record_complete;
+	req->priv = order;
+}
+
+static int create_test_file(void)
+{
+	u8 buf[TEST_BLKS * BLKSZ];
+	int fd;
+
+	fd = os_open(TEST_FILE, OS_O_RDWR | OS_O_CREAT);
+	if (fd < 0)
+		return -1;
+	fill_blocks(buf, 0, TEST_BLKS);
+	if (os_write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+		os_close(fd);
+		return -1;
+	}
+
+	return os_close(fd);
+}
+
+/* Test that several requests can be queued on the sandbox host device */
+static int dm_test_blk_host(struct dm_test_state *dms)
+{
+	struct blk_request req[5], chained;
+	struct blk_sg sg[5], split[2];
+	struct blk_dev_priv *uc_priv;
+	block_dev_desc_t *desc;
+	struct udevice *dev;
+	u8 buf[5][4 * BLKSZ];
+	int order[5], i;
+
+	ut_assertok(create_test_file());
+	ut_assertok(host_dev_bind(0, TEST_FILE));
+	desc = host_get_dev(0);
+	ut_assert(desc);
+
+	/* The host device has a driver of its own */
+	ut_assertok(blk_get_from_desc(desc, &dev));
+	ut_asserteq_str("host0", dev->name);
+	ut_asserteq_str("sandbox_host_blk", dev->driver->name);
+	ut_asserteq_ptr(desc, blk_get_desc(dev));
+	uc_priv = dev->uclass_priv;
+
+	/* Requests are only carried out as the device is polled */
+	complete_count = 0;
+	for (i = 0; i < 3; i++) {
+		init_req(&req[i], &sg[i], BLK_READ, i * 10, buf[i], 4,
+			 &order[i]);
+		ut_assertok(blk_submit(dev, &req[i]));
+	}
+	for (i = 0; i < 3; i++)
+		ut_asserteq(-EINPROGRESS, req[i].status);
+	ut_asserteq(2, blk_poll(dev));
+	ut_assertok(req[0].status);
+	ut_asserteq(-EINPROGRESS, req[1].status);
+	ut_assertok(blk_wait(dev, &req[2]));
+	ut_asserteq(0, blk_poll(dev));
+	for (i = 0; i < 3; i++) {
+		ut_asserteq(i, order[i]);
+		ut_asserteq(4, req[i].done);
+		ut_assertok(check_blocks(buf[i], i * 10, 4));
+	}
+
+	/* Only so many are given to the driver at once, in order */
+	complete_count = 0;
+	for (i = 0; i < 5; i++) {
+		init_req(&req[i], &sg[i], BLK_READ, i, buf[i], 1, &order[i]);
+		ut_assertok(blk_submit(dev, &req[i]));
+	}
+	ut_asserteq(4, uc_priv->nactive);
+	ut_assertok(blk_wait(dev, &req[4]));
+	for (i = 0; i < 5; i++) {
+		ut_asserteq(i, order[i]);
+		ut_assertok(check_blocks(buf[i], i, 1));
+	}
+
+	/* A scatter list fills its buffers in turn */
+	memset(buf, '\0', sizeof(buf));
+	init_req(&req[0], &sg[0], BLK_READ, 20, NULL, 0, &order[0]);
+	split[0].buf = buf[0];
+	split[0].blkcnt = 1;
+	split[1].buf = buf[1];
+	split[1].blkcnt = 2;
+	req[0].sg = split;
+	req[0].sg_count = 2;
+	ut_assertok(blk_submit(dev, &req[0]));
+	ut_assertok(blk_wait(dev, &req[0]));
+	ut_asserteq(3, req[0].done);
+	ut_assertok(check_blocks(buf[0], 20, 1));
+	ut_assertok(check_blocks(buf[1], 21, 2));
+
+	/* A completion can queue more */
+	init_req(&req[0], &sg[0], BLK_READ, 30, buf[0], 1, NULL);
+	req[0].complete = chain_complete;
+	req[0].priv = &chained;
+	init_req(&chained, &sg[1], BLK_READ, 31, buf[1], 1, &order[1]);
+	ut_assertok(blk_submit(dev, &req[0]));
+	ut_assertok(blk_wait(dev, &req[0]));
+	ut_asserteq(-EINPROGRESS, chained.status);
+	ut_assertok(blk_wait(dev, &chained));
+	ut_assertok(check_blocks(buf[1], 31, 1));
+
+	/* Writes reach the file */
+	fill_blocks(buf[0], 50, 4);
+	ut_asserteq(4, blk_write(dev, 40, 4, buf[0]));
+	memset(buf[1], '\0', sizeof(buf[1]));
+	ut_asserteq(4, desc->block_read(0, 40, 4, buf[1]));
+	ut_assertok(check_blocks(buf[1], 50, 4));
+
+	/* Nothing beyond the end is queued */
+	ut_asserteq(-EINVAL, blk_read(dev, TEST_BLKS - 1, 2, buf[0]));
+	ut_asserteq(-EINVAL, blk_read(dev, 0, 0, buf[0]));
+	ut_asserteq(0, blk_poll(dev));
+
+	/* Unbinding the host device unbinds the block device */
+	ut_assertok(host_dev_bind(0, NULL));
+	ut_asserteq(-ENODEV, blk_find_desc(desc, &dev));
+	ut_assertok(os_unlink(TEST_FILE));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_host, 0);
+
+static u8 ram_disk[16 * BLKSZ];
+static int ram_reads;
+
+static unsigned long ram_block_read(int dev, lbaint_t start, lbaint_t blkcnt,
+				    void *buffer)
+{
+	ram_reads++;
+	if (start + blkcnt > 8)		/* The second half cannot be read */
+		blkcnt = start < 8 ? 8 - start : 0;
+	memcpy(buffer, ram_disk + start * BLKSZ, blkcnt * BLKSZ);
+
+	return blkcnt;
+}
+
+static unsigned long ram_block_write(int dev, lbaint_t start,
+				     lbaint_t blkcnt, const void *buffer)
+{
+	memcpy(ram_disk + start * BLKSZ, buffer, blkcnt * BLKSZ);
+
+	return blkcnt;
+}
+
+/* Test the block device bound for a descriptor without one */
+static int dm_test_blk_legacy(struct dm_test_state *dms)
+{
+	block_dev_desc_t desc;
+	struct blk_request req;
+	struct blk_sg sg[2];
+	struct udevice *dev, *dev2;
+	u8 buf[4 * BLKSZ];
+	int order;
+
+	memset(&desc, '\0', sizeof(desc));
+	desc.if_type = IF_TYPE_MMC;
+	desc.blksz = BLKSZ;
+	desc.lba = 16;
+	desc.block_read = ram_block_read;
+	desc.block_write = ram_block_write;
+	fill_blocks(ram_disk, 0, 16);
+
+	ut_asserteq(-ENODEV, blk_find_desc(&desc, &dev));
+	ut_assertok(blk_get_from_desc(&desc, &dev));
+	ut_asserteq_str("mmc", dev->name);
+	ut_asserteq_str("blk_legacy", dev->driver->name);
+	ut_assertok(blk_get_from_desc(&desc, &dev2));
+	ut_asserteq_ptr(dev, dev2);
+
+	/* Requests complete as they are submitted */
+	init_req(&req, &sg[0], BLK_READ, 2, buf, 1, &order);
+	sg[1].buf = buf + BLKSZ;
+	sg[1].blkcnt = 3;
+	req.sg_count = 2;
+	ram_reads = 0;
+	ut_assertok(blk_submit(dev, &req));
+	ut_assertok(req.status);
+	ut_asserteq(4, req.done);
+	ut_asserteq(2, ram_reads);
+	ut_assertok(check_blocks(buf, 2, 4));
+
+	fill_blocks(buf, 100, 2);
+	ut_asserteq(2, blk_write(dev, 1, 2, buf));
+	ut_assertok(check_blocks(ram_disk + BLKSZ, 100, 2));
+
+	/* A short read fails the request */
+	ut_asserteq(-EIO, blk_read(dev, 6, 4, buf));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_legacy, 0);
+
+/* Starts requests but never completes them, having no poll() method */
+static int nopoll_start(struct udevice *dev, struct blk_request *req)
+{
+	return 0;
+}
+
+static const struct blk_ops nopoll_ops = {
+	.start	= nopoll_start,
+};
+
+U_BOOT_DRIVER(blk_test_nopoll) = {
+	.name	= "blk_test_nopoll",
+	.id	= UCLASS_BLK,
+	.ops	= &nopoll_ops,
+};
+
+/* Test that waiting on a driver which cannot complete requests fails */
+static int dm_test_blk_nopoll(struct dm_test_state *dms)
+{
+	block_dev_desc_t desc;
+	struct blk_request req[2];
+	struct blk_sg sg[2];
+	struct udevice *dev;
+	u8 buf[BLKSZ];
+	int order[2];
+
+	memset(&desc, '\0', sizeof(desc));
+	desc.blksz = BLKSZ;
+	desc.lba = 16;
+	ut_assertok(blk_bind(dm_root(), "blk_test_nopoll", "nopoll", &desc,
+			     &dev));
+	ut_assertok(device_probe(dev));
+
+	/* Both the started and the pending request fail, in order */
+	complete_count = 0;
+	init_req(&req[0], &sg[0], BLK_READ, 0, buf, 1, &order[0]);
+	init_req(&req[1], &sg[1], BLK_READ, 1, buf, 1, &order[1]);
+	ut_assertok(blk_submit(dev, &req[0]));
+	ut_assertok(blk_submit(dev, &req[1]));
+	ut_asserteq(-ENOSYS, blk_wait(dev, &req[1]));
+	ut_asserteq(-ENOSYS, req[0].status);
+	ut_asserteq(0, order[0]);
+	ut_asserteq(1, order[1]);
+	ut_asserteq(0, blk_poll(dev));
+	ut_asserteq(-ENOSYS, blk_read(dev, 2, 1, buf));
+
+	/* Removal does not wait for it either */
+	ut_assertok(blk_submit(dev, &req[0]));
+	ut_assertok(device_remove(dev));
+	ut_asserteq(-ENOSYS, req[0].status);
+	ut_assertok(device_unbind(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_nopoll, 0);
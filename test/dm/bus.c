@@ -6,6 +6,7 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
 #include <dm/device-internal.h>
 #include <dm/root.h>
 #include <dm/test.h>
@@ -240,3 +241,47 @@ static int dm_test_bus_parent_ops(struct dm_test_state *dms)
 	return 0;
 }
 DM_TEST(dm_test_bus_parent_ops, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that the data for a child is allocated in a single block */
+static int dm_test_bus_child_alloc(struct dm_test_state *dms)
+{
+	struct mallinfo start, end;
+	struct udevice *bus, *dev;
+	char *block, *pdata, *parent_data;
+	size_t size;
+
+	ut_assertok(uclass_get_device(UCLASS_TEST_BUS, 0, &bus));
+	ut_assertok(device_find_child_by_seq(bus, 0, true, &dev));
+	ut_asserteq_ptr(NULL, dev->auto_alloc);
+
+	start = mallinfo();
+	ut_assertok(device_probe(dev));
+	end = mallinfo();
+
+	/* The priv, platdata and parent data all lie within the block */
+	block = dev->auto_alloc;
+	ut_assert(NULL != block);
+	size = malloc_usable_size(block);
+	pdata = dev_get_platdata(dev);
+	parent_data = dev_get_parentdata(dev);
+	ut_asserteq_ptr(block, dev_get_priv(dev));
+	ut_assert(pdata >= block + sizeof(struct dm_test_priv));
+	ut_assert(parent_data >= pdata + sizeof(struct dm_test_pdata));
+	ut_assert(parent_data + sizeof(struct dm_test_parent_data) <=
+		  block + size);
+
+	/* That is the only allocation: each has one size_t of overhead */
+	ut_asserteq(size + sizeof(size_t), end.uordblks - start.uordblks);
+
+	/* Removing the device frees it all */
+	ut_assertok(device_remove(dev));
+	ut_asserteq_ptr(NULL, dev->auto_alloc);
+	ut_asserteq_ptr(NULL, dev_get_priv(dev));
+	ut_asserteq_ptr(NULL, dev_get_platdata(dev));
+	ut_asserteq_ptr(NULL, dev_get_parentdata(dev));
+	end = mallinfo();
+	ut_asserteq(start.uordblks, end.uordblks);
+
+	return 0;
+}
+DM_TEST(dm_test_bus_child_alloc, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -31,6 +31,10 @@ static void dm_display_line(struct udevice *dev, char *buf)
 	       dev->name, (ulong)map_to_sysmem(dev));
 	if (dev->req_seq != -1)
 		printf(", %d", dev->req_seq);
+#ifdef CONFIG_DM_PROBE_TIME
+	if (dev->flags & DM_FLAG_ACTIVATED)
+		printf(" (probe %lu us)", dev->probe_time_us);
+#endif
 	puts("\n");
 }
 
@@ -91,7 +95,7 @@ static int do_dm_dump_uclass(cmd_tbl_t *cmdtp, int flag, int argc,
 	for (id = 0; id < UCLASS_COUNT; id++) {
 		struct udevice *dev;
 
-		ret = uclass_get(id, &uc);
+		ret = uclass_get_bound(id, &uc);
 		if (ret)
 			continue;
 
@@ -10,6 +10,7 @@
 #include <fdtdec.h>
 #include <malloc.h>
 #include <asm/io.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <dm/root.h>
 #include <dm/ut.h>
@@ -258,3 +259,158 @@ static int dm_test_fdt_offset(struct dm_test_state *dms)
 	return 0;
 }
 DM_TEST(dm_test_fdt_offset, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Copy of the test device tree, with nodes marked to be bound on demand */
+static char defer_blob[4096];
+
+/* Check binding on demand, with gd->fdt_blob pointing at defer_blob */
+static int check_fdt_defer(struct dm_test_state *dms)
+{
+	struct udevice *bus, *dev;
+	struct uclass *uc, *bus_uc;
+
+	ut_assertok(dm_scan_fdt(gd->fdt_blob, false));
+	ut_assertok(uclass_get(UCLASS_TEST_FDT, &uc));
+	ut_asserteq(3, list_count_items(&uc->dev_head));
+	ut_asserteq(1, list_count_items(&uc->deferred_head));
+	ut_assertok(uclass_get(UCLASS_TEST_BUS, &bus_uc));
+	ut_asserteq(0, list_count_items(&bus_uc->dev_head));
+
+	/* Looking up any device in the uclass binds the rest of it */
+	ut_assertok(uclass_find_device(UCLASS_TEST_FDT, 3, &dev));
+	ut_asserteq_str("b-test", dev->name);
+	ut_asserteq(0, list_count_items(&uc->deferred_head));
+	ut_asserteq(0, list_count_items(&bus_uc->dev_head));
+
+	/* The bus is bound when needed, and binds its children when probed */
+	ut_assertok(uclass_get_bound(UCLASS_TEST_BUS, &bus_uc));
+	ut_asserteq(1, list_count_items(&bus_uc->dev_head));
+	ut_asserteq(0, list_count_items(&bus_uc->deferred_head));
+	ut_assertok(uclass_get_device(UCLASS_TEST_BUS, 0, &bus));
+	ut_asserteq_str("some-bus", bus->name);
+	ut_asserteq(2, list_count_items(&bus->child_head));
+	ut_asserteq(1, list_count_items(&uc->deferred_head));
+
+	/* A deferred node is forgotten when its parent goes away */
+	ut_assertok(device_remove(bus));
+	ut_assertok(device_unbind(bus));
+	ut_asserteq(0, list_count_items(&uc->deferred_head));
+	ut_asserteq(-ENODEV, uclass_find_device(UCLASS_TEST_FDT, 4, &dev));
+
+	return 0;
+}
+
+/* Test that deferred nodes are bound only when their uclass is needed */
+static int dm_test_fdt_defer(struct dm_test_state *dms)
+{
+	const void *blob = gd->fdt_blob;
+	int node, ret;
+
+	ut_assertok(fdt_open_into(blob, defer_blob, sizeof(defer_blob)));
+	node = fdt_path_offset(defer_blob, "/b-test");
+	ut_assertok(fdt_setprop(defer_blob, node, "u-boot,dm-defer", NULL, 0));
+	node = fdt_path_offset(defer_blob, "/some-bus");
+	ut_assertok(fdt_setprop(defer_blob, node, "u-boot,dm-defer", NULL, 0));
+	node = fdt_path_offset(defer_blob, "/some-bus/c-test@5");
+	ut_assertok(fdt_setprop(defer_blob, node, "u-boot,dm-defer", NULL, 0));
+
+	/* Put the real blob back even if a check fails */
+	gd->fdt_blob = defer_blob;
+	ret = check_fdt_defer(dms);
+	gd->fdt_blob = blob;
+
+	return ret;
+}
+DM_TEST(dm_test_fdt_defer, 0);
+
+#ifdef CONFIG_FDTDEC_CACHE
+/* Check the lookups when there is no room to build the cache */
+static int check_cache_no_space(struct dm_test_state *dms, const void *blob)
+{
+	int seq;
+
+	ut_asserteq(-ENOSYS, fdtdec_cache_get_alias_node(blob, "testfdt6"));
+	ut_asserteq_ptr(blob, gd->fdt_cache_failed);
+	ut_asserteq_ptr(NULL, gd->fdt_cache);
+	ut_asserteq(-ENOSYS, fdtdec_cache_lookup_phandle(blob, 1));
+	ut_asserteq(gd->malloc_limit, gd->malloc_ptr);
+	/* Without the cache, fdtdec_get_alias_seq() scans the tree */
+	seq = -1;
+	ut_assertok(fdtdec_get_alias_seq(blob, "testseq",
+					 fdt_path_offset(blob, "/e-test"), &seq));
+	ut_asserteq(1, seq);
+
+	return 0;
+}
+
+/* Test that cached lookups give the same results as scanning the tree */
+static int dm_test_fdt_cache(struct dm_test_state *dms)
+{
+	const void *blob = gd->fdt_blob;
+	const char *compat = "denx,u-boot-fdt-test";
+	ulong flags, malloc_ptr;
+	int node, seq, count, ret;
+
+	fdtdec_cache_invalidate();
+	node = fdt_path_offset(blob, "/e-test");
+	ut_assert(node > 0);
+	ut_asserteq(node, fdtdec_cache_get_alias_node(blob, "testfdt6"));
+	ut_asserteq(node, fdtdec_get_alias_node(blob, "testfdt6"));
+	ut_assertok(fdtdec_cache_get_alias_seq(blob, "testfdt", node, &seq));
+	ut_asserteq(6, seq);
+	/* The sequence number is at the end, as fdtdec_get_alias_seq() has it */
+	ut_assertok(fdtdec_cache_get_alias_seq(blob, "testseq", node, &seq));
+	ut_asserteq(1, seq);
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdtdec_cache_get_alias_node(blob, "nonexistent"));
+
+	/* Other blobs are never cached */
+	ut_asserteq(-ENOSYS, fdtdec_cache_get_alias_node(blob + 1,
+							 "testfdt6"));
+
+	count = 0;
+	node = -1;
+	do {
+		int expect = fdt_node_offset_by_compatible(blob, node, compat);
+
+		node = fdtdec_cache_next_compatible(blob, node, compat);
+		ut_asserteq(expect, node);
+		count++;
+	} while (node >= 0);
+	ut_assert(count > 4);
+
+	/* Every node with a phandle must be found by it */
+	for (node = 0; node >= 0; node = fdt_next_node(blob, node, NULL)) {
+		uint32_t phandle = fdt_get_phandle(blob, node);
+
+		if (phandle)
+			ut_asserteq(node,
+				    fdtdec_cache_lookup_phandle(blob, phandle));
+	}
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdtdec_cache_lookup_phandle(blob, 0xfffffff0));
+
+	/*
+	 * Before relocation a cache which does not fit in the early malloc()
+	 * area is not built, and not tried again for the same blob
+	 */
+	fdtdec_cache_invalidate();
+	flags = gd->flags;
+	malloc_ptr = gd->malloc_ptr;
+	gd->flags &= ~GD_FLG_RELOC;
+	gd->malloc_ptr = gd->malloc_limit;
+	ret = check_cache_no_space(dms, blob);
+	gd->flags = flags;
+	gd->malloc_ptr = malloc_ptr;
+	if (ret)
+		return ret;
+
+	/* Invalidating the cache allows another try */
+	fdtdec_cache_invalidate();
+	ut_assert(fdtdec_cache_get_alias_node(blob, "testfdt6") > 0);
+	ut_assert(NULL != gd->fdt_cache);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_cache, 0);
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <search.h>
+
+static void make_key(char *key, int size, int i)
+{
+	snprintf(key, size, "slot_%c_var%05d", 'a' + i % 3, i);
+}
+
+/* Visit the numbers 0..count-1 in a scrambled but repeatable order */
+static int scramble(int i, int count)
+{
+	return (int)(((unsigned long long)i * 7919) % count);
+}
+
+static int check_value(struct hsearch_data *htab, const char *key,
+		       const char *val)
+{
+	ENTRY e, *ep;
+
+	e.key = key;
+	e.data = NULL;
+	hsearch_r(e, FIND, &ep, htab, 0);
+	if (val ? !ep || strcmp(ep->data, val) : ep != NULL) {
+		printf("%s: wrong value for %s\n", __func__, key);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int do_ut_env_htab(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char *const argv[])
+{
+	struct hsearch_data htab, copy;
+	int count = 5000, i, n, ret = 0;
+	ulong start, insert_time, export_time;
+	char key[32], val[32], *res = NULL, *p, *prev;
+	ENTRY e, *ep;
+	ssize_t len;
+
+	if (argc > 1)
+		count = simple_strtoul(argv[1], NULL, 10);
+	if (count % 7919 == 0) {
+		puts("Count must not be a multiple of 7919\n");
+		return CMD_RET_USAGE;
+	}
+
+	/* Start small so that the table has to grow several times */
+	memset(&htab, '\0', sizeof(htab));
+	memset(&copy, '\0', sizeof(copy));
+	if (!hcreate_r(16, &htab)) {
+		puts("Cannot create table\n");
+		return CMD_RET_FAILURE;
+	}
+
+	start = get_timer(0);
+	for (i = 0; i < count && !ret; i++) {
+		n = scramble(i, count);
+		make_key(key, sizeof(key), n);
+		snprintf(val, sizeof(val), "%d", n);
+		e.key = key;
+		e.data = val;
+		if (!hsearch_r(e, ENTER, &ep, &htab, 0) || !ep)
+			ret = -1;
+	}
+	insert_time = get_timer(start);
+
+	/* Look everything up, delete every third entry, change others */
+	for (i = 0; i < count && !ret; i++) {
+		make_key(key, sizeof(key), i);
+		snprintf(val, sizeof(val), "%d", i);
+		ret = check_value(&htab, key, val);
+		if (!ret && i % 3 == 1 && !hdelete_r(key, &htab, 0))
+			ret = -1;
+		if (!ret && i % 3 == 2) {
+			strcpy(val, "changed");
+			e.key = key;
+			e.data = val;
+			if (!hsearch_r(e, ENTER, &ep, &htab, 0))
+				ret = -1;
+		}
+	}
+	for (i = 0; i < count && !ret; i++) {
+		make_key(key, sizeof(key), i);
+		snprintf(val, sizeof(val), "%d", i);
+		ret = check_value(&htab, key, i % 3 == 1 ? NULL :
+				  i % 3 == 2 ? "changed" : val);
+	}
+	if (!ret && htab.filled != count - (count + 1) / 3) {
+		printf("Wrong number of entries %d\n", htab.filled);
+		ret = -1;
+	}
+
+	/* The export must be in key order */
+	start = get_timer(0);
+	len = ret ? -1 : hexport_r(&htab, '\n', 0, &res, 0, 0, NULL);
+	export_time = get_timer(start);
+	if (len < 0)
+		ret = -1;
+	for (p = res, prev = NULL, n = 0; !ret && *p; n++) {
+		char *end = strchr(p, '\n');
+
+		*end = '\0';
+		if (prev && strcmp(prev, p) >= 0) {
+			printf("Export not sorted at %s\n", p);
+			ret = -1;
+		}
+		prev = p;
+		p = end + 1;
+	}
+	if (!ret && n != htab.filled) {
+		printf("Exported %d of %d entries\n", n, htab.filled);
+		ret = -1;
+	}
+
+	/* All matches for a prefix, in order */
+	for (i = 0, n = 0; !ret && (i = hmatch_r("slot_a_", i, &ep, &htab));
+	     n++) {
+		if (strncmp(ep->key, "slot_a_", 7)) {
+			printf("Bad match %s\n", ep->key);
+			ret = -1;
+		}
+	}
+	if (!ret && n != (count + 2) / 3) {
+		printf("Found %d matches\n", n);
+		ret = -1;
+	}
+
+	/* Round trip through himport_r() */
+	if (!ret) {
+		free(res);
+		res = NULL;
+		len = hexport_r(&htab, '\0', 0, &res, 0, 0, NULL);
+		if (len < 0 || !himport_r(&copy, res, len, '\0', 0, 0, 0,
+					  NULL) || copy.filled != htab.filled)
+			ret = -1;
+	}
+
+	printf("%d entries: insert %lu ms, export %lu ms\n", count,
+	       insert_time, export_time);
+	free(res);
+	hdestroy_r(&htab);
+	hdestroy_r(&copy);
+	if (ret) {
+		puts("failed\n");
+		return CMD_RET_FAILURE;
+	}
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_env_htab,	2,	1,	do_ut_env_htab,
+	"Test the environment hash table",
+	"[entries]"
+);
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <libfdt.h>
+#include <fdt_batch.h>
+#include <fdt_support.h>
+
+#define TEST_FDT_SIZE	(1 << 20)
+
+/* Build a synthetic tree with @count device nodes under /soc */
+static int make_test_fdt(void *buf, int size, int count)
+{
+	char name[32];
+	int i, ret;
+
+	ret = fdt_create(buf, size);
+	ret |= fdt_finish_reservemap(buf);
+	ret |= fdt_begin_node(buf, "");
+	ret |= fdt_property_cell(buf, "#address-cells", 1);
+	ret |= fdt_property_cell(buf, "#size-cells", 1);
+	ret |= fdt_begin_node(buf, "aliases");
+	ret |= fdt_end_node(buf);
+	ret |= fdt_begin_node(buf, "memory@0");
+	ret |= fdt_property_string(buf, "device_type", "memory");
+	ret |= fdt_end_node(buf);
+	ret |= fdt_begin_node(buf, "soc");
+	for (i = 0; i < count && !ret; i++) {
+		snprintf(name, sizeof(name), "dev@%x", 0x1000 * i);
+		ret |= fdt_begin_node(buf, name);
+		ret |= fdt_property_string(buf, "compatible", "test,device");
+		ret |= fdt_property_cell(buf, "reg", 0x1000 * i);
+		ret |= fdt_property_string(buf, "status", "disabled");
+		ret |= fdt_end_node(buf);
+	}
+	ret |= fdt_end_node(buf);
+	ret |= fdt_end_node(buf);
+	ret |= fdt_finish(buf);
+	if (ret)
+		return -1;
+
+	return fdt_open_into(buf, buf, size);
+}
+
+/* Check that a property has the value set by the fixups */
+static int check_prop(const void *fdt, const char *path, const char *name,
+		      const void *val, int len)
+{
+	const void *prop;
+	int node, plen;
+
+	node = fdt_path_offset(fdt, path);
+	prop = node < 0 ? NULL : fdt_getprop(fdt, node, name, &plen);
+	if (!prop || plen != len || memcmp(prop, val, len)) {
+		printf("%s: %s:%s does not match\n", __func__, path, name);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int do_ut_fdt_batch(cmd_tbl_t *cmdtp, int flag, int argc,
+			   char *const argv[])
+{
+	struct fdt_batch batch;
+	struct fdt_batch_node *node;
+	void *src, *inplace, *batched;
+	int count = 500, i, ret = 0;
+	ulong start, inplace_time, batched_time;
+	u64 bank_start = 0x80000000, bank_size = 0x40000000;
+	const void *reg;
+	char path[40];
+	int len;
+
+	if (argc > 1)
+		count = simple_strtoul(argv[1], NULL, 10);
+
+	src = malloc(TEST_FDT_SIZE);
+	inplace = malloc(TEST_FDT_SIZE);
+	batched = malloc(TEST_FDT_SIZE);
+	if (!src || !inplace || !batched) {
+		puts("Out of memory\n");
+		ret = -1;
+		goto out;
+	}
+	if (make_test_fdt(src, TEST_FDT_SIZE, count)) {
+		puts("Cannot create test tree\n");
+		ret = -1;
+		goto out;
+	}
+
+	/* Change one property and add two in every node, in place */
+	start = get_timer(0);
+	memcpy(inplace, src, TEST_FDT_SIZE);
+	for (i = 0; i < count && !ret; i++) {
+		snprintf(path, sizeof(path), "/soc/dev@%x", 0x1000 * i);
+		ret = fdt_path_offset(inplace, path);
+		if (ret >= 0)
+			ret = fdt_setprop_string(inplace, ret, "status",
+						 "okay");
+		if (!ret)
+			ret = fdt_setprop_cell(inplace,
+					       fdt_path_offset(inplace, path),
+					       "test,index", i);
+		if (!ret)
+			ret = fdt_setprop_string(inplace,
+						 fdt_path_offset(inplace, path),
+						 "test,label", path);
+	}
+	if (!ret)
+		ret = fdt_fixup_memory_banks(inplace, &bank_start, &bank_size,
+					     1);
+	inplace_time = get_timer(start);
+	if (ret) {
+		printf("In-place fixup failed: %s\n", fdt_strerror(ret));
+		goto out;
+	}
+
+	/* The same, with a batch */
+	start = get_timer(0);
+	ret = fdt_batch_init(&batch, src);
+	for (i = 0; i < count && !ret; i++) {
+		snprintf(path, sizeof(path), "/soc/dev@%x", 0x1000 * i);
+		node = fdt_batch_node(&batch, path);
+		if (!node)
+			ret = -FDT_ERR_NOSPACE;
+		if (!ret)
+			ret = fdt_batch_setprop_string(&batch, node, "status",
+						       "okay");
+		if (!ret)
+			ret = fdt_batch_setprop_u32(&batch, node,
+						    "test,index", i);
+		if (!ret)
+			ret = fdt_batch_setprop_string(&batch, node,
+						       "test,label", path);
+	}
+	node = fdt_batch_node(&batch, "/chosen");
+	if (!ret && node)
+		ret = fdt_batch_setprop_string(&batch, node, "bootargs",
+					       "console=ttyS0");
+	if (!ret)
+		ret = fdt_batch_fixup_memory_banks(&batch, &bank_start,
+						   &bank_size, 1);
+	if (!ret)
+		ret = fdt_batch_apply(&batch, batched, TEST_FDT_SIZE);
+	batched_time = get_timer(start);
+	fdt_batch_free(&batch);
+	if (ret) {
+		printf("Batched fixup failed: %s\n", fdt_strerror(ret));
+		goto out;
+	}
+
+	ret = fdt_check_header(batched);
+	for (i = 0; i < count && !ret; i++) {
+		fdt32_t index = cpu_to_fdt32(i);
+
+		snprintf(path, sizeof(path), "/soc/dev@%x", 0x1000 * i);
+		ret |= check_prop(batched, path, "status", "okay", 5);
+		ret |= check_prop(batched, path, "test,index", &index,
+				  sizeof(index));
+		ret |= check_prop(batched, path, "test,label", path,
+				  strlen(path) + 1);
+		ret |= check_prop(batched, path, "compatible", "test,device",
+				  sizeof("test,device"));
+	}
+	if (!ret)
+		ret = check_prop(batched, "/chosen", "bootargs",
+				 "console=ttyS0", sizeof("console=ttyS0"));
+	/* The memory banks match those fixed up in place */
+	reg = fdt_getprop(inplace, fdt_path_offset(inplace, "/memory"), "reg",
+			  &len);
+	if (!ret)
+		ret = reg ? check_prop(batched, "/memory", "reg", reg, len) : -1;
+	if (!ret)
+		ret = check_prop(batched, "/memory", "device_type", "memory",
+				 sizeof("memory"));
+
+	printf("%d nodes: in-place %lu ms, batched %lu ms\n", count,
+	       inplace_time, batched_time);
+out:
+	free(src);
+	free(inplace);
+	free(batched);
+	if (ret)
+		return CMD_RET_FAILURE;
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_fdt_batch,	2,	1,	do_ut_fdt_batch,
+	"Test batched device tree fixups against in-place ones",
+	"[nodes]"
+);
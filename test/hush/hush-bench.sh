@@ -0,0 +1,122 @@
+# Copyright (c) 2014
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+
+# Benchmark and sanity check for running hush scripts with sandbox
+#
+# The scripts below loop over partitions and devices by running variables,
+# as provisioning boot scripts do. Build sandbox with and without
+# CONFIG_HUSH_SCRIPT_CACHE to compare the times.
+#
+# Usage: test/hush/hush-bench.sh [build_dir] [iterations]
+
+OUTPUT_DIR=${1:-sandbox}
+LOOPS=${2:-20}
+
+fail() {
+	echo "Test failed: $1"
+	if [ -n ${tmp} ]; then
+		rm ${tmp}
+	fi
+	exit 1
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+run_scripts() {
+	loops=$(seq -s " " 1 ${LOOPS})
+
+	# Everything goes on one line, since ctrlc() eats any input that is
+	# waiting while a loop runs
+	${OUTPUT_DIR}/u-boot <<END
+	setenv parts "boot system vendor userdata cache misc recovery persist"; \
+	setenv devs "0 1 2 3"; \
+	setenv flash_part 'if test "\${part}" = "userdata"; then setenv erased "\${erased}e"; else setenv flashed "\${flashed}f"; setenv last \${dev}:\${part}; fi'; \
+	setenv flash_dev 'for part in \${parts}; do run flash_part; done'; \
+	setenv provision 'for dev in \${devs}; do run flash_dev; done'; \
+	setenv bench 'for i in ${loops}; do run provision; done'; \
+	run bench; \
+	echo erased \${erased}; echo flashed \${flashed}; echo last \${last}; \
+	setenv devs 7; setenv parts only; setenv erased; setenv flashed; \
+	run provision; echo last \${last}; \
+	setenv check 'echo one; exit; echo two'; run check check; \
+	setenv check 'if true; then echo three; fi; echo four'; run check check; \
+	reset
+END
+}
+
+check_results() {
+	echo "Check results"
+
+	parts=$(( ${LOOPS} * 4 * 8 ))
+	erased=$(awk '/^erased / { print length($2) }' ${tmp})
+	flashed=$(awk '/^flashed / { print length($2) }' ${tmp})
+	if [ "${erased}" != $(( ${parts} / 8 )) ] ||
+	   [ "${flashed}" != $(( ${parts} * 7 / 8 )) ]; then
+		fail "partition count"
+	fi
+	if ! grep -q "^last 3:persist" ${tmp}; then
+		fail "last partition"
+	fi
+
+	# A changed variable must not run the old script
+	if ! grep -q "^last 7:only" ${tmp}; then
+		fail "changed variable"
+	fi
+
+	# 'exit' stops the script but not the next one
+	if [ $(grep -c "^one" ${tmp}) -ne 2 ] ||
+	   [ $(grep -c "^two" ${tmp}) -ne 0 ]; then
+		fail "exit"
+	fi
+	if [ $(grep -c "^three" ${tmp}) -ne 2 ] ||
+	   [ $(grep -c "^four" ${tmp}) -ne 2 ]; then
+		fail "if"
+	fi
+}
+
+# Run scripts from scripts without loops, which call ctrlc() and so sleep
+# in sandbox's serial driver, to time the interpreter itself
+run_fanout() {
+	${OUTPUT_DIR}/u-boot <<END
+	setenv dev 1; setenv part boot; \
+	setenv leaf 'if test "\${part}" = "userdata"; then setenv op erase; elif test "\${part}" = "misc"; then setenv op skip; else setenv op flash; fi; if test "\${dev}" = 0; then setenv target mmc; else setenv target usb; fi'; \
+	setenv l1 'run leaf leaf leaf leaf leaf leaf leaf leaf'; \
+	setenv l2 'run l1 l1 l1 l1 l1 l1 l1 l1'; \
+	setenv l3 'run l2 l2 l2 l2 l2 l2 l2 l2'; \
+	run l3 l3 l3 l3 l3 l3 l3 l3; echo target \${target}; \
+	reset
+END
+}
+
+# Print the time taken by a function in milliseconds
+time_ms() {
+	start=$(date +%s%N)
+	$1 >${tmp}
+	end=$(date +%s%N)
+	echo $(( (${end} - ${start}) / 1000000 ))
+}
+
+echo "Hush script benchmark using sandbox"
+echo
+tmp="$(mktemp)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+loops_ms=$(time_ms run_scripts)
+check_results ${tmp}
+fanout_ms=$(time_ms run_fanout)
+if ! grep -q "^target usb" ${tmp}; then
+	fail "fan-out"
+fi
+rm ${tmp}
+echo "${LOOPS} loop iterations: ${loops_ms} ms"
+echo "4096 scripts run: ${fanout_ms} ms"
+echo "Test passed"
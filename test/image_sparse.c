@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <image-sparse.h>
+#include <malloc.h>
+
+#define TEST_BLKSZ		512
+#define TEST_DEV_BLOCKS		4096
+#define TEST_PART_START		100	/* Not aligned to the erase group */
+#define TEST_PART_SIZE		1000
+#define TEST_ERASE_GRP		64
+#define TEST_SPARSE_BLKSZ	4096
+#define TEST_IMAGE_SIZE		(64 << 10)
+
+/* A RAM block device which counts what is done to it */
+static u8 *test_dev_mem;
+static u8 test_erase_val;
+static lbaint_t test_written, test_erased;
+
+static unsigned long test_block_read(int dev, lbaint_t start,
+				     lbaint_t blkcnt, void *buffer)
+{
+	memcpy(buffer, test_dev_mem + start * TEST_BLKSZ, blkcnt * TEST_BLKSZ);
+
+	return blkcnt;
+}
+
+static unsigned long test_block_write(int dev, lbaint_t start,
+				      lbaint_t blkcnt, const void *buffer)
+{
+	if (start + blkcnt > TEST_PART_START + TEST_PART_SIZE)
+		return 0;
+	memcpy(test_dev_mem + start * TEST_BLKSZ, buffer, blkcnt * TEST_BLKSZ);
+	test_written += blkcnt;
+
+	return blkcnt;
+}
+
+static unsigned long test_block_erase(int dev, lbaint_t start,
+				      lbaint_t blkcnt)
+{
+	if (start % TEST_ERASE_GRP || blkcnt % TEST_ERASE_GRP)
+		return 0;
+	memset(test_dev_mem + start * TEST_BLKSZ, test_erase_val,
+	       blkcnt * TEST_BLKSZ);
+	test_erased += blkcnt;
+
+	return blkcnt;
+}
+
+static block_dev_desc_t test_dev = {
+	.blksz		= TEST_BLKSZ,
+	.lba		= TEST_DEV_BLOCKS,
+	.block_read	= test_block_read,
+	.block_write	= test_block_write,
+	.block_erase	= test_block_erase,
+};
+
+struct sparse_builder {
+	u8 *image;
+	u8 *ptr;
+	u8 *expect;		/* Expected contents of the partition */
+	int blk;		/* Current position in sparse blocks */
+	int chunks;
+};
+
+static void *add_chunk(struct sparse_builder *sb, u16 type, int blocks,
+		       int data_size)
+{
+	chunk_header_t *chunk = (chunk_header_t *)sb->ptr;
+
+	chunk->chunk_type = cpu_to_le16(type);
+	chunk->reserved1 = 0;
+	chunk->chunk_sz = cpu_to_le32(blocks);
+	chunk->total_sz = cpu_to_le32(sizeof(*chunk) + data_size);
+	sb->ptr += sizeof(*chunk) + data_size;
+	sb->blk += blocks;
+	sb->chunks++;
+
+	return chunk + 1;
+}
+
+static void add_raw(struct sparse_builder *sb, int blocks)
+{
+	u8 *expect = sb->expect + sb->blk * TEST_SPARSE_BLKSZ;
+	u8 *data;
+	int i;
+
+	data = add_chunk(sb, CHUNK_TYPE_RAW, blocks,
+			 blocks * TEST_SPARSE_BLKSZ);
+	for (i = 0; i < blocks * TEST_SPARSE_BLKSZ; i++)
+		data[i] = expect[i] = i * 13 + sb->chunks;
+}
+
+static void add_fill(struct sparse_builder *sb, int blocks, u32 val)
+{
+	u32 *expect = (u32 *)(sb->expect + sb->blk * TEST_SPARSE_BLKSZ);
+	int i;
+
+	memcpy(add_chunk(sb, CHUNK_TYPE_FILL, blocks, sizeof(val)), &val,
+	       sizeof(val));
+	for (i = 0; i < blocks * TEST_SPARSE_BLKSZ / sizeof(u32); i++)
+		expect[i] = val;
+}
+
+/* Build a sparse image with each type of chunk, returning its size */
+static int build_image(struct sparse_builder *sb)
+{
+	sparse_header_t *hdr = (sparse_header_t *)sb->image;
+
+	sb->ptr = sb->image + sizeof(*hdr);
+	sb->blk = 0;
+	sb->chunks = 0;
+	memset(sb->expect, 0xaa, TEST_PART_SIZE * TEST_BLKSZ);
+
+	add_raw(sb, 3);
+	add_fill(sb, 40, 0);
+	add_fill(sb, 2, 0xdeadbeef);
+	add_chunk(sb, CHUNK_TYPE_DONT_CARE, 5, 0);
+	add_chunk(sb, CHUNK_TYPE_CRC32, 0, sizeof(u32));
+	add_raw(sb, 1);
+	add_fill(sb, 1, 0);
+
+	hdr->magic = cpu_to_le32(SPARSE_HEADER_MAGIC);
+	hdr->major_version = cpu_to_le16(1);
+	hdr->minor_version = cpu_to_le16(0);
+	hdr->file_hdr_sz = cpu_to_le16(sizeof(sparse_header_t));
+	hdr->chunk_hdr_sz = cpu_to_le16(sizeof(chunk_header_t));
+	hdr->blk_sz = cpu_to_le32(TEST_SPARSE_BLKSZ);
+	hdr->total_blks = cpu_to_le32(sb->blk);
+	hdr->total_chunks = cpu_to_le32(sb->chunks);
+	hdr->image_checksum = 0;
+
+	return sb->ptr - sb->image;
+}
+
+static int run_test(struct sparse_builder *sb, int size, lbaint_t erase_grp,
+		    struct sparse_storage *st)
+{
+	int ret;
+
+	memset(test_dev_mem, 0xaa, TEST_DEV_BLOCKS * TEST_BLKSZ);
+	test_written = 0;
+	test_erased = 0;
+	memset(st, '\0', sizeof(*st));
+	st->dev = &test_dev;
+	st->start = TEST_PART_START;
+	st->size = TEST_PART_SIZE;
+	st->erase_grp = erase_grp;
+
+	ret = write_sparse_image(st, sb->image, size);
+	if (ret)
+		return ret;
+	if (memcmp(test_dev_mem + TEST_PART_START * TEST_BLKSZ, sb->expect,
+		   TEST_PART_SIZE * TEST_BLKSZ)) {
+		puts("Partition contents are wrong\n");
+		return -EIO;
+	}
+	if (st->written != test_written) {
+		puts("Wrong count of blocks written\n");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int do_ut_image_sparse(cmd_tbl_t *cmdtp, int flag, int argc,
+			      char *const argv[])
+{
+	struct sparse_builder sb;
+	struct sparse_storage st;
+	int factor = TEST_SPARSE_BLKSZ / TEST_BLKSZ;
+	int size, ret;
+
+	test_dev_mem = malloc(TEST_DEV_BLOCKS * TEST_BLKSZ);
+	sb.image = malloc(TEST_IMAGE_SIZE);
+	sb.expect = malloc(TEST_PART_SIZE * TEST_BLKSZ);
+	if (!test_dev_mem || !sb.image || !sb.expect) {
+		puts("Out of memory\n");
+		return CMD_RET_FAILURE;
+	}
+	size = build_image(&sb);
+
+	/* Without erase, everything except "don't care" is written */
+	ret = run_test(&sb, size, 0, &st);
+	if (!ret && (st.written != 47 * factor || st.skipped != 5 * factor ||
+		     st.erased)) {
+		puts("Wrong statistics without erase\n");
+		ret = -EINVAL;
+	}
+
+	/* With erase, whole erase groups of zeros are not written */
+	test_erase_val = 0;
+	if (!ret)
+		ret = run_test(&sb, size, TEST_ERASE_GRP, &st);
+	if (!ret && (st.erased != 256 || test_erased != 256 ||
+		     st.written != 47 * factor - 256)) {
+		printf("Wrong statistics with erase: written " LBAFU
+		       " erased " LBAFU "\n", st.written, st.erased);
+		ret = -EINVAL;
+	}
+
+	/* If erased blocks do not read as zero, zeros are written */
+	test_erase_val = 0xff;
+	if (!ret)
+		ret = run_test(&sb, size, TEST_ERASE_GRP, &st);
+	if (!ret && (st.erased || st.written != 47 * factor)) {
+		puts("Wrong statistics when erase does not zero\n");
+		ret = -EINVAL;
+	}
+
+	/* Images which are truncated or too large must be rejected */
+	if (!ret && run_test(&sb, size - 8, 0, &st) != -EINVAL) {
+		puts("Truncated image not detected\n");
+		ret = -EINVAL;
+	}
+	((sparse_header_t *)sb.image)->total_blks =
+		cpu_to_le32(TEST_PART_SIZE / factor + 1);
+	if (!ret && run_test(&sb, size, 0, &st) != -EFBIG) {
+		puts("Oversized image not detected\n");
+		ret = -EINVAL;
+	}
+
+	free(test_dev_mem);
+	free(sb.image);
+	free(sb.expect);
+	if (ret) {
+		printf("Failed: %d\n", ret);
+		return CMD_RET_FAILURE;
+	}
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_image_sparse,	1,	1,	do_ut_image_sparse,
+	"Test writing Android sparse images",
+	""
+);
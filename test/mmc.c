@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+#include <mmc.h>
+
+#define TEST_DEV	0
+#define TEST_START	0x100
+/* Longer than the 1MiB which mmc_bupdate() reads back at a time */
+#define TEST_BLOCKS	3000
+#define TEST_BATCH	2048
+
+/*
+ * Update the test area from @src, checking that it then holds @src and that
+ * @expect blocks were written to the card
+ */
+static int mmc_test_update(struct mmc *mmc, const u8 *src, u8 *buf,
+			   ulong expect)
+{
+	struct mmc_update_stats stats = { 0, 0 };
+	ulong size = TEST_BLOCKS * mmc->write_bl_len;
+	ulong reads, writes, before;
+	ulong n;
+
+	sandbox_mmc_get_counts(&reads, &before);
+	n = mmc_bupdate(TEST_DEV, TEST_START, TEST_BLOCKS, src, &stats);
+	sandbox_mmc_get_counts(&reads, &writes);
+	if (n != TEST_BLOCKS) {
+		printf("Update failed: %lu\n", n);
+		return -EIO;
+	}
+	if (writes - before != expect ||
+	    stats.written != (u64)expect * mmc->write_bl_len ||
+	    stats.written + stats.skipped != size) {
+		printf("Wrote %lu blocks, not %lu (%llu written, %llu skipped)\n",
+		       writes - before, expect, stats.written, stats.skipped);
+		return -EINVAL;
+	}
+	n = mmc->block_dev.block_read(TEST_DEV, TEST_START, TEST_BLOCKS, buf);
+	if (n != TEST_BLOCKS || memcmp(buf, src, size)) {
+		puts("Card does not hold the new data\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int mmc_test_bupdate(struct mmc *mmc)
+{
+	ulong blksz = mmc->write_bl_len, size = TEST_BLOCKS * blksz;
+	u8 *src, *buf, *unaligned;
+	ulong i, n;
+	int ret;
+
+	src = malloc(size);
+	buf = malloc(size);
+	unaligned = malloc(size + 1);
+	if (!src || !buf || !unaligned) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < size; i++)
+		src[i] = i * 5 + (i >> 9);
+	n = mmc->block_dev.block_write(TEST_DEV, TEST_START, TEST_BLOCKS, src);
+	if (n != TEST_BLOCKS) {
+		puts("Cannot write test data\n");
+		ret = -EIO;
+		goto out;
+	}
+
+	/* Nothing has changed */
+	ret = mmc_test_update(mmc, src, buf, 0);
+
+	/* Runs in the middle, one of them across a read-back batch */
+	if (!ret) {
+		for (i = 100 * blksz; i < 110 * blksz; i++)
+			src[i] ^= 0xff;
+		for (i = (TEST_BATCH - 8) * blksz; i < (TEST_BATCH + 8) * blksz;
+		     i += blksz)
+			src[i + blksz / 2] ^= 1;
+		ret = mmc_test_update(mmc, src, buf, 10 + 16);
+	}
+
+	/* Only the last byte of the last block differs */
+	if (!ret) {
+		src[size - 1] ^= 0x80;
+		ret = mmc_test_update(mmc, src, buf, 1);
+	}
+
+	/* The same through the memcmp() path, from an unaligned buffer */
+	if (!ret) {
+		src[size - 1] ^= 0x80;
+		src[blksz] ^= 0x01;
+		memcpy(unaligned + 1, src, size);
+		ret = mmc_test_update(mmc, unaligned + 1, buf, 2);
+	}
+
+	/* A failed read-back in the second batch must fail the update */
+	if (!ret) {
+		src[0] ^= 0xff;
+		sandbox_mmc_fail_read(TEST_START + TEST_BATCH + 100);
+		n = mmc_bupdate(TEST_DEV, TEST_START, TEST_BLOCKS, src, NULL);
+		sandbox_mmc_fail_read(-1);
+		if (n) {
+			printf("Update with a read error gave %lu\n", n);
+			ret = -EINVAL;
+		}
+	}
+
+out:
+	free(src);
+	free(buf);
+	free(unaligned);
+
+	return ret;
+}
+
+static int do_ut_mmc(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
+{
+	struct mmc *mmc = find_mmc_device(TEST_DEV);
+	int ret;
+
+	if (!mmc || mmc_init(mmc)) {
+		puts("No MMC device\n");
+		return CMD_RET_FAILURE;
+	}
+
+	ret = mmc_test_bupdate(mmc);
+	if (ret) {
+		printf("Failed: %d\n", ret);
+		return CMD_RET_FAILURE;
+	}
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_mmc,	1,	1,	do_ut_mmc,
+	"Test MMC update, which writes only the blocks which differ",
+	""
+);
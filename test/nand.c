@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+#include <nand.h>
+#include <asm/io.h>
+
+#define TEST_OFFSET	0x20000
+#define TEST_SIZE	(1 << 20)
+
+/* Reads which start, end and cross blocks in different ways */
+static const struct {
+	ulong offset;
+	ulong len;
+} test_reads[] = {
+	{ 0, TEST_SIZE },
+	{ 0x800, 0x800 },		/* one page */
+	{ 0x1f000, 0x2000 },		/* two pages, crossing a block */
+	{ 0x1234, 0x21000 },		/* unaligned start and end */
+	{ 0x3f800, 0x800 },		/* last page of a block */
+	{ 0x3f800, 0x1800 },		/* last page, then into the next */
+};
+
+/*
+ * Work out how many page reads (30h), which wait for tR, a read of
+ * offset..offset + len makes. Without read cache there is one per page.
+ * With it, each run of whole pages within a block needs only the first,
+ * and the partial pages at either end need their own.
+ */
+static ulong nand_test_page_reads(nand_info_t *nand, ulong offset, ulong len,
+				  bool cached)
+{
+	ulong ppb = nand->erasesize / nand->writesize;
+	ulong first = offset / nand->writesize;
+	ulong last = (offset + len - 1) / nand->writesize;
+	ulong page, count = 0;
+	bool full, prev_full = false;
+
+	for (page = first; page <= last; page++) {
+		full = page * nand->writesize >= offset &&
+			(page + 1) * nand->writesize <= offset + len;
+		if (!cached || !full || !prev_full || !(page % ppb))
+			count++;
+		prev_full = full;
+	}
+
+	return count;
+}
+
+/* Read the test area back, checking the data and the reads the chip saw */
+static int nand_test_read(nand_info_t *nand, const u8 *expect, u8 *buf,
+			  bool cached)
+{
+	struct nand_chip *chip = nand->priv;
+	ulong page_reads, cache_reads, before, cache_before, want;
+	size_t len;
+	loff_t offset;
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(test_reads); i++) {
+		offset = TEST_OFFSET + test_reads[i].offset;
+		len = test_reads[i].len;
+		memset(buf, '\0', len);
+		/* make sure that every page comes from the chip */
+		chip->pagebuf = -1;
+		sandbox_nand_get_counts(&before, &cache_before);
+		ret = nand_read(nand, offset, &len, buf);
+		sandbox_nand_get_counts(&page_reads, &cache_reads);
+		if (ret || len != test_reads[i].len) {
+			printf("Read %d failed: %d\n", i, ret);
+			return -EIO;
+		}
+		if (memcmp(buf, expect + test_reads[i].offset, len)) {
+			printf("Read %d has wrong data\n", i);
+			return -EINVAL;
+		}
+
+		/* Each page is read from the array exactly once */
+		page_reads -= before;
+		cache_reads -= cache_before;
+		want = nand_test_page_reads(nand, offset, len, cached);
+		if (page_reads != want ||
+		    page_reads + cache_reads !=
+		    nand_test_page_reads(nand, offset, len, false)) {
+			printf("Read %d: %lu page + %lu cache reads, not %lu\n",
+			       i, page_reads, cache_reads, want);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int do_ut_nand(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
+{
+	nand_info_t *nand = &nand_info[nand_curr_device];
+	struct nand_chip *chip = nand->priv;
+	size_t len = TEST_SIZE;
+	u8 *expect, *buf;
+	int i, ret;
+
+	if (nand_curr_device < 0 || !nand->size) {
+		puts("No NAND device\n");
+		return CMD_RET_FAILURE;
+	}
+	if (!NAND_HAS_CACHERD(chip)) {
+		puts("Read cache is not enabled\n");
+		return CMD_RET_FAILURE;
+	}
+	expect = malloc(TEST_SIZE);
+	buf = malloc(TEST_SIZE);
+	if (!expect || !buf) {
+		puts("Out of memory\n");
+		return CMD_RET_FAILURE;
+	}
+	for (i = 0; i < TEST_SIZE; i++)
+		expect[i] = i * 7 + (i >> 11);
+
+	ret = nand_erase(nand, TEST_OFFSET, TEST_SIZE);
+	if (!ret)
+		ret = nand_write_skip_bad(nand, TEST_OFFSET, &len, NULL,
+					  nand->size, expect, 0);
+	if (ret) {
+		printf("Cannot write test data: %d\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	ret = nand_test_read(nand, expect, buf, true);
+	if (!ret) {
+		chip->options &= ~NAND_CACHERD;
+		ret = nand_test_read(nand, expect, buf, false);
+		chip->options |= NAND_CACHERD;
+	}
+	free(expect);
+	free(buf);
+	if (ret)
+		return CMD_RET_FAILURE;
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_nand,	1,	1,	do_ut_nand,
+	"Test NAND reads with read cache sequential",
+	""
+);
+
+/* Factory bad blocks of the sandbox NAND chip */
+#define TEST_BAD_FIRST	200
+#define TEST_BAD_LAST	204
+#define TEST_BAD_LONE	210
+
+/* Check the next good block from each block around the bad ones */
+static int nand_test_next_good(nand_info_t *nand)
+{
+	loff_t good, expect;
+	int block;
+
+	for (block = TEST_BAD_FIRST - 2; block <= TEST_BAD_LONE + 1; block++) {
+		if (block >= TEST_BAD_FIRST && block <= TEST_BAD_LAST)
+			expect = TEST_BAD_LAST + 1;
+		else if (block == TEST_BAD_LONE)
+			expect = TEST_BAD_LONE + 1;
+		else
+			expect = block;
+		expect *= nand->erasesize;
+		good = nand_next_good_block(nand, (loff_t)block *
+					    nand->erasesize + 0x800);
+		if (good != expect) {
+			printf("Next good block from %d is at %llx, not %llx\n",
+			       block, good, expect);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/* Read across the bad blocks, checking the flash used to skip them */
+static int nand_test_skip(nand_info_t *nand)
+{
+	loff_t offset = (TEST_BAD_FIRST - 1) * nand->erasesize;
+	size_t len = 4 * nand->erasesize, actual;
+	nand_erase_options_t opts;
+	u8 *expect, *buf;
+	int i, ret;
+
+	expect = malloc(len);
+	buf = malloc(len);
+	if (!expect || !buf)
+		return -ENOMEM;
+	for (i = 0; i < len; i++)
+		expect[i] = i * 3 + (i >> 17);
+
+	memset(&opts, '\0', sizeof(opts));
+	opts.offset = offset;
+	opts.length = 9 * nand->erasesize;
+	opts.quiet = 1;
+	ret = nand_erase_opts(nand, &opts);
+	if (!ret)
+		ret = nand_write_skip_bad(nand, offset, &len, NULL, nand->size,
+					  expect, 0);
+	if (!ret)
+		ret = nand_read_skip_bad(nand, offset, &len, &actual,
+					 nand->size, buf);
+	/* One good block, five bad, then the other three good ones */
+	if (!ret && (actual != 9 * nand->erasesize || memcmp(buf, expect, len)))
+		ret = -EIO;
+	free(expect);
+	free(buf);
+
+	return ret;
+}
+
+static int nand_test_stash(nand_info_t *nand)
+{
+	struct nand_chip *chip = nand->priv;
+	int len = nand->size / nand->erasesize / 4;
+	struct nand_bbt_stash *hdr;
+	u8 *bbt = chip->bbt, *unchecked;
+	int ret;
+
+	/* U-Boot stashed the table when it scanned the chip */
+	hdr = map_sysmem(CONFIG_NAND_BBT_STASH_ADDR,
+			 CONFIG_NAND_BBT_STASH_SIZE);
+	if (hdr->magic != NAND_BBT_STASH_MAGIC ||
+	    memcmp(hdr + 1, bbt, len)) {
+		puts("Table was not stashed\n");
+		return -ENOENT;
+	}
+	unmap_sysmem(hdr);
+
+	hdr = malloc(sizeof(*hdr) + len);
+	if (!hdr)
+		return -ENOMEM;
+	ret = nand_bbt_stash(nand, hdr, sizeof(*hdr) + len - 1);
+	if (ret != -ENOSPC) {
+		printf("Stash into a small area gave %d\n", ret);
+		return -EINVAL;
+	}
+	ret = nand_bbt_stash(nand, hdr, sizeof(*hdr) + len);
+	if (ret) {
+		printf("Cannot stash: %d\n", ret);
+		return ret;
+	}
+
+	/* A fresh table must come back the same, and behave the same */
+	unchecked = chip->bbt_unchecked;
+	chip->bbt = NULL;
+	chip->bbt_unchecked = NULL;
+	ret = nand_bbt_unstash(nand, hdr, sizeof(*hdr) + len);
+	if (!ret && memcmp(chip->bbt, bbt, len))
+		ret = -EINVAL;
+	if (!ret)
+		ret = nand_test_next_good(nand);
+	free(chip->bbt);
+	free(chip->bbt_unchecked);
+	chip->bbt = bbt;
+	chip->bbt_unchecked = unchecked;
+	if (ret) {
+		printf("Unstashed table is wrong: %d\n", ret);
+		return ret;
+	}
+
+	/*
+	 * Blocks marked bad since the stash was made, e.g. by an OS before a
+	 * warm reset, must still be found when they are used
+	 */
+	chip->bbt = NULL;
+	chip->bbt_unchecked = NULL;
+	ret = nand_bbt_unstash(nand, hdr, sizeof(*hdr) + len);
+	if (!ret) {
+		chip->bbt[TEST_BAD_FIRST / 4] &=
+			~(3 << (TEST_BAD_FIRST % 4) * 2);
+		chip->bbt[TEST_BAD_LONE / 4] &= ~(3 << (TEST_BAD_LONE % 4) * 2);
+		if (nand_block_isbad(nand, (loff_t)TEST_BAD_FIRST *
+				     nand->erasesize) != 1)
+			ret = -EINVAL;
+	}
+	if (!ret)
+		ret = nand_test_next_good(nand);
+	free(chip->bbt);
+	free(chip->bbt_unchecked);
+	chip->bbt = bbt;
+	chip->bbt_unchecked = unchecked;
+	if (ret) {
+		printf("Stale stashed table was trusted: %d\n", ret);
+		return ret;
+	}
+
+	/* Corruption must be noticed */
+	((u8 *)(hdr + 1))[len / 2] ^= 1;
+	ret = nand_bbt_unstash(nand, hdr, sizeof(*hdr) + len);
+	free(hdr);
+	if (ret != -EINVAL) {
+		printf("Corrupt stash gave %d\n", ret);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int do_ut_nand_bbt(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char *const argv[])
+{
+	nand_info_t *nand = &nand_info[nand_curr_device];
+	struct nand_chip *chip = nand->priv;
+	u8 *bbt = chip->bbt;
+	int ret;
+
+	if (nand_curr_device < 0 || !nand->size || !bbt) {
+		puts("No NAND device with a bad block table\n");
+		return CMD_RET_FAILURE;
+	}
+
+	ret = nand_test_next_good(nand);
+	if (!ret) {
+		/* Without a table, each block's marker is read instead */
+		chip->bbt = NULL;
+		ret = nand_test_next_good(nand);
+		chip->bbt = bbt;
+	}
+	if (!ret)
+		ret = nand_test_skip(nand);
+	if (!ret)
+		ret = nand_test_stash(nand);
+	if (ret) {
+		printf("Failed: %d\n", ret);
+		return CMD_RET_FAILURE;
+	}
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_nand_bbt,	1,	1,	do_ut_nand_bbt,
+	"Test the NAND bad block table and its stash in RAM",
+	""
+);
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <spi_flash.h>
+#include "../drivers/mtd/spi/sf_internal.h"
+
+#define TEST_FLASH_SIZE		(4 << 20)
+#define TEST_MAX_RUNS		5
+
+/* A run of erase commands which are the same */
+struct sf_test_run {
+	u8 cmd;
+	u8 count;
+};
+
+/* An erase range and the runs of commands expected to erase it */
+static const struct {
+	const char *name;
+	u8 flags;		/* erase_flags of the part */
+	u32 offset;
+	u32 len;
+	struct sf_test_run expect[TEST_MAX_RUNS];
+} test_erases[] = {
+	{ "unaligned start", SECT_4K | SECT_32K, 0x1000, 0x2f000,
+		{ { CMD_ERASE_4K, 7 }, { CMD_ERASE_32K, 1 },
+		  { CMD_ERASE_64K, 2 } } },
+	{ "unaligned end", SECT_4K | SECT_32K, 0x10000, 0x1b000,
+		{ { CMD_ERASE_64K, 1 }, { CMD_ERASE_32K, 1 },
+		  { CMD_ERASE_4K, 3 } } },
+	{ "unaligned both", SECT_4K | SECT_32K, 0x7000, 0x22000,
+		{ { CMD_ERASE_4K, 1 }, { CMD_ERASE_32K, 1 },
+		  { CMD_ERASE_64K, 1 }, { CMD_ERASE_32K, 1 },
+		  { CMD_ERASE_4K, 1 } } },
+	{ "no 32K erase", SECT_4K, 0x1000, 0x2f000,
+		{ { CMD_ERASE_4K, 15 }, { CMD_ERASE_64K, 2 } } },
+	{ "exactly 32K", SECT_4K | SECT_32K, 0x18000, 0x8000,
+		{ { CMD_ERASE_32K, 1 } } },
+	{ "less than 32K", SECT_4K | SECT_32K, 0x8000, 0x7000,
+		{ { CMD_ERASE_4K, 7 } } },
+	{ "64K sectors only", 0, 0x30000, 0x20000,
+		{ { CMD_ERASE_64K, 2 } } },
+	{ "whole chip", SECT_4K | SECT_32K, 0, TEST_FLASH_SIZE,
+		{ { CMD_ERASE_CHIP, 1 } } },
+	{ "all but the last 4K", SECT_4K | SECT_32K, 0,
+		TEST_FLASH_SIZE - 0x1000,
+		{ { CMD_ERASE_64K, 63 }, { CMD_ERASE_32K, 1 },
+		  { CMD_ERASE_4K, 7 } } },
+};
+
+/* Plan an erase as spi_flash_cmd_erase_ops() does, checking each step */
+static int sf_test_erase_plan(struct spi_flash *flash, int i)
+{
+	u32 offset = test_erases[i].offset, len = test_erases[i].len;
+	const struct sf_test_run *run = test_erases[i].expect;
+	const struct sf_test_run *end = run + TEST_MAX_RUNS;
+	int count = 0;
+	u32 size;
+	u8 cmd;
+
+	while (len) {
+		size = spi_flash_erase_step(flash, offset, len, &cmd);
+		if (run < end && count == run->count) {
+			run++;
+			count = 0;
+		}
+		if (run == end || cmd != run->cmd || size > len ||
+		    offset % size) {
+			printf("%s: unexpected erase %02x of %x at %x\n",
+			       test_erases[i].name, cmd, size, offset);
+			return -1;
+		}
+		count++;
+		offset += size;
+		len -= size;
+	}
+	if (count != run->count || (run + 1 < end && run[1].count)) {
+		printf("%s: erase ended early at %x\n", test_erases[i].name,
+		       offset);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int do_ut_sf_erase(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char *const argv[])
+{
+	struct spi_slave slave;
+	struct spi_flash flash;
+	int i, ret = 0;
+	u8 cmd;
+
+	memset(&slave, '\0', sizeof(slave));
+	for (i = 0; i < ARRAY_SIZE(test_erases); i++) {
+		/* A W25Q32-like part, chosen as spi_flash_validate_params() */
+		memset(&flash, '\0', sizeof(flash));
+		flash.spi = &slave;
+		flash.size = TEST_FLASH_SIZE;
+		flash.sector_size = 64 << 10;
+		flash.erase_flags = test_erases[i].flags;
+		if (flash.erase_flags & SECT_4K) {
+			flash.erase_cmd = CMD_ERASE_4K;
+			flash.erase_size = 4 << 10;
+		} else {
+			flash.erase_cmd = CMD_ERASE_64K;
+			flash.erase_size = flash.sector_size;
+		}
+		if (sf_test_erase_plan(&flash, i))
+			ret = -1;
+	}
+
+	/* A chip erase would only erase one of a stacked pair */
+	flash.dual_flash = SF_DUAL_STACKED_FLASH;
+	flash.erase_flags = SECT_4K | SECT_32K;
+	flash.erase_cmd = CMD_ERASE_4K;
+	flash.erase_size = 4 << 10;
+	if (spi_flash_erase_step(&flash, 0, flash.size, &cmd) !=
+	    flash.sector_size) {
+		puts("whole stacked flash: chip erase used\n");
+		ret = -1;
+	}
+
+	/* Nor to a controller which cannot send it */
+	flash.dual_flash = SF_SINGLE_FLASH;
+	slave.op_mode_tx = SPI_OPM_TX_NO_CHIP_ERASE;
+	if (spi_flash_erase_step(&flash, 0, flash.size, &cmd) !=
+	    flash.sector_size) {
+		puts("whole flash without chip erase: chip erase used\n");
+		ret = -1;
+	}
+
+	if (ret) {
+		puts("Failed\n");
+		return CMD_RET_FAILURE;
+	}
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_sf_erase,	1,	1,	do_ut_sf_erase,
+	"Test the choice of SPI flash erase commands for a range",
+	""
+);
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+#include <ubispl.h>
+#include <u-boot/crc.h>
+#include "../drivers/mtd/ubi/ubi-media.h"
+
+#define TEST_PEB_SIZE		0x4000
+#define TEST_PEBS		128
+#define TEST_VID_OFFSET		512
+#define TEST_LEB_START		1024
+#define TEST_LEB_SIZE		(TEST_PEB_SIZE - TEST_LEB_START)
+#define TEST_ANCHOR		2
+
+/* A static volume of five LEBs, and a dynamic one with LEB 1 unmapped */
+#define TEST_STATIC_ID		0
+#define TEST_STATIC_LEBS	5
+#define TEST_STATIC_SIZE	(4 * TEST_LEB_SIZE + 1000)
+#define TEST_DYNAMIC_ID		3
+#define TEST_DYNAMIC_LEBS	3
+
+/* Where each LEB is, as the fastmap records it */
+static const int test_static_pebs[TEST_STATIC_LEBS] = { 70, 71, 100, 20, 90 };
+static const int test_dynamic_pebs[TEST_DYNAMIC_LEBS] = { 80, -1, 81 };
+
+/* Written since the fastmap, so in its pool */
+#define TEST_POOL_NEWER		96	/* A newer copy of static LEB 3 */
+#define TEST_POOL_BAD_COPY	95	/* An incomplete copy of static LEB 1 */
+#define TEST_STALE		30	/* An older copy of static LEB 2 */
+
+static u8 *test_flash;
+static unsigned long long test_sqnum;
+
+static int test_read(int pnum, int offset, int len, void *dst)
+{
+	if (pnum < 0 || pnum >= TEST_PEBS || offset + len > TEST_PEB_SIZE)
+		return -EINVAL;
+	memcpy(dst, test_flash + pnum * TEST_PEB_SIZE + offset, len);
+
+	return 0;
+}
+
+static u32 test_crc(const void *buf, int len)
+{
+	return crc32_no_comp(UBI_CRC32_INIT, buf, len);
+}
+
+/* Write a PEB; ubispl does not read the EC header so there is none */
+static void test_write_peb(int pnum, int vol_id, int lnum, int vol_type,
+			   const u8 *data, int data_size, int copy_flag)
+{
+	u8 *peb = test_flash + pnum * TEST_PEB_SIZE;
+	struct ubi_vid_hdr *vh = (struct ubi_vid_hdr *)(peb + TEST_VID_OFFSET);
+
+	memset(vh, '\0', sizeof(*vh));
+	vh->magic = cpu_to_be32(UBI_VID_HDR_MAGIC);
+	vh->version = UBI_VERSION;
+	vh->vol_type = vol_type;
+	vh->copy_flag = copy_flag;
+	vh->vol_id = cpu_to_be32(vol_id);
+	vh->lnum = cpu_to_be32(lnum);
+	vh->sqnum = cpu_to_be64(++test_sqnum);
+	if (vol_type == UBI_VID_STATIC) {
+		vh->data_size = cpu_to_be32(data_size);
+		vh->used_ebs = cpu_to_be32(TEST_STATIC_LEBS);
+		vh->data_crc = cpu_to_be32(test_crc(data, data_size));
+	}
+	vh->hdr_crc = cpu_to_be32(test_crc(vh, UBI_VID_HDR_SIZE_CRC));
+	memcpy(peb + TEST_LEB_START, data, data_size);
+}
+
+static void *test_fm_add(u8 **posp, int size)
+{
+	void *ptr = *posp;
+
+	*posp += size;
+
+	return ptr;
+}
+
+static void test_fm_volume(u8 **posp, int vol_id, int vol_type, int used_ebs,
+			   const int *pebs, int count)
+{
+	struct ubi_fm_volhdr *fmvhdr;
+	struct ubi_fm_eba *fm_eba;
+	int i;
+
+	fmvhdr = test_fm_add(posp, sizeof(*fmvhdr));
+	fmvhdr->magic = cpu_to_be32(UBI_FM_VHDR_MAGIC);
+	fmvhdr->vol_id = cpu_to_be32(vol_id);
+	fmvhdr->vol_type = vol_type;
+	fmvhdr->used_ebs = cpu_to_be32(used_ebs);
+	fm_eba = test_fm_add(posp, sizeof(*fm_eba) + count * sizeof(__be32));
+	fm_eba->magic = cpu_to_be32(UBI_FM_EBA_MAGIC);
+	fm_eba->reserved_pebs = cpu_to_be32(count);
+	for (i = 0; i < count; i++)
+		fm_eba->pnum[i] = cpu_to_be32(pebs[i]);
+}
+
+/* Write a one-block fastmap of the volumes, with two PEBs in the pool */
+static void test_write_fastmap(void)
+{
+	u8 *fm = malloc(TEST_LEB_SIZE), *pos = fm;
+	struct ubi_fm_scan_pool *pool1, *pool2;
+	struct ubi_fm_hdr *fmhdr;
+	struct ubi_fm_sb *fmsb;
+
+	memset(fm, '\0', TEST_LEB_SIZE);
+	fmsb = test_fm_add(&pos, sizeof(*fmsb));
+	fmsb->magic = cpu_to_be32(UBI_FM_SB_MAGIC);
+	fmsb->version = UBI_FM_FMT_VERSION;
+	fmsb->used_blocks = cpu_to_be32(1);
+	fmsb->block_loc[0] = cpu_to_be32(TEST_ANCHOR);
+	fmhdr = test_fm_add(&pos, sizeof(*fmhdr));
+	fmhdr->magic = cpu_to_be32(UBI_FM_HDR_MAGIC);
+	fmhdr->vol_count = cpu_to_be32(2);
+	pool1 = test_fm_add(&pos, sizeof(*pool1));
+	pool1->magic = cpu_to_be32(UBI_FM_POOL_MAGIC);
+	pool1->size = cpu_to_be16(2);
+	pool1->pebs[0] = cpu_to_be32(TEST_POOL_BAD_COPY);
+	pool1->pebs[1] = cpu_to_be32(TEST_POOL_NEWER);
+	pool2 = test_fm_add(&pos, sizeof(*pool2));
+	pool2->magic = cpu_to_be32(UBI_FM_POOL_MAGIC);
+
+	test_fm_volume(&pos, TEST_STATIC_ID, UBI_VID_STATIC, TEST_STATIC_LEBS,
+		       test_static_pebs, TEST_STATIC_LEBS);
+	test_fm_volume(&pos, TEST_DYNAMIC_ID, UBI_VID_DYNAMIC,
+		       TEST_DYNAMIC_LEBS, test_dynamic_pebs, TEST_DYNAMIC_LEBS);
+	fmsb->data_crc = cpu_to_be32(test_crc(fm, TEST_LEB_SIZE));
+
+	test_write_peb(TEST_ANCHOR, UBI_FM_SB_VOLUME_ID, 0, UBI_VID_DYNAMIC,
+		       fm, TEST_LEB_SIZE, 0);
+	free(fm);
+}
+
+/* Build the UBI device, returning the expected contents of each volume */
+static void test_build(u8 *expect_static, u8 *expect_dynamic)
+{
+	u8 *data;
+	int i, lnum, len;
+
+	memset(test_flash, 0xff, TEST_PEBS * TEST_PEB_SIZE);
+	test_sqnum = 0;
+	for (i = 0; i < TEST_STATIC_SIZE; i++)
+		expect_static[i] = i * 5 + (i >> 10);
+	for (i = 0; i < TEST_DYNAMIC_LEBS * TEST_LEB_SIZE; i++)
+		expect_dynamic[i] = i * 3 + 1;
+	memset(expect_dynamic + TEST_LEB_SIZE, 0xff, TEST_LEB_SIZE);
+
+	/* The stale copy of LEB 2 is older, so has different data */
+	data = malloc(TEST_LEB_SIZE);
+	memset(data, 0x55, TEST_LEB_SIZE);
+	test_write_peb(TEST_STALE, TEST_STATIC_ID, 2, UBI_VID_STATIC, data,
+		       TEST_LEB_SIZE, 0);
+	free(data);
+
+	for (lnum = 0; lnum < TEST_STATIC_LEBS; lnum++) {
+		data = expect_static + lnum * TEST_LEB_SIZE;
+		len = min(TEST_STATIC_SIZE - lnum * TEST_LEB_SIZE,
+			  TEST_LEB_SIZE);
+		/* LEB 3 is changed later, so start it with other data */
+		if (lnum == 3)
+			memset(data, 0xaa, len);
+		test_write_peb(test_static_pebs[lnum], TEST_STATIC_ID, lnum,
+			       UBI_VID_STATIC, data, len, 0);
+	}
+	for (lnum = 0; lnum < TEST_DYNAMIC_LEBS; lnum++) {
+		if (test_dynamic_pebs[lnum] >= 0)
+			test_write_peb(test_dynamic_pebs[lnum],
+				       TEST_DYNAMIC_ID, lnum, UBI_VID_DYNAMIC,
+				       expect_dynamic + lnum * TEST_LEB_SIZE,
+				       TEST_LEB_SIZE, 0);
+	}
+	test_write_fastmap();
+
+	/* Since the fastmap: LEB 1 is being copied, LEB 3 is rewritten */
+	data = expect_static + TEST_LEB_SIZE;
+	test_write_peb(TEST_POOL_BAD_COPY, TEST_STATIC_ID, 1, UBI_VID_STATIC,
+		       data, TEST_LEB_SIZE, 1);
+	test_flash[TEST_POOL_BAD_COPY * TEST_PEB_SIZE + TEST_LEB_START +
+		   TEST_LEB_SIZE / 2] ^= 0xff;
+	data = expect_static + 3 * TEST_LEB_SIZE;
+	for (i = 0; i < TEST_LEB_SIZE; i++)
+		data[i] = i * 5 + ((i + 3 * TEST_LEB_SIZE) >> 10);
+	test_write_peb(TEST_POOL_NEWER, TEST_STATIC_ID, 3, UBI_VID_STATIC, data,
+		       TEST_LEB_SIZE, 0);
+}
+
+static int test_load(struct ubispl_info *info, const u8 *expect_static,
+		     const u8 *expect_dynamic, u8 *buf)
+{
+	struct ubispl_load lvols[2];
+	int ret;
+
+	lvols[0].vol_id = TEST_STATIC_ID;
+	lvols[0].load_addr = buf;
+	lvols[1].vol_id = TEST_DYNAMIC_ID;
+	lvols[1].load_addr = buf + TEST_STATIC_LEBS * TEST_LEB_SIZE;
+	memset(buf, '\0', (TEST_STATIC_LEBS + TEST_DYNAMIC_LEBS) *
+	       TEST_LEB_SIZE);
+
+	ret = ubispl_load_volumes(info, lvols, 2);
+	if (ret)
+		return ret;
+	if (lvols[0].size != TEST_STATIC_SIZE ||
+	    memcmp(lvols[0].load_addr, expect_static, TEST_STATIC_SIZE)) {
+		puts("Static volume is wrong\n");
+		return -EIO;
+	}
+	if (lvols[1].size != TEST_DYNAMIC_LEBS * TEST_LEB_SIZE ||
+	    memcmp(lvols[1].load_addr, expect_dynamic, lvols[1].size)) {
+		puts("Dynamic volume is wrong\n");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int do_ut_ubispl(cmd_tbl_t *cmdtp, int flag, int argc,
+			char *const argv[])
+{
+	struct ubispl_info info;
+	u8 *expect_static, *expect_dynamic, *buf;
+	int ret;
+
+	test_flash = malloc(TEST_PEBS * TEST_PEB_SIZE);
+	expect_static = malloc(TEST_STATIC_LEBS * TEST_LEB_SIZE);
+	expect_dynamic = malloc(TEST_DYNAMIC_LEBS * TEST_LEB_SIZE);
+	buf = malloc((TEST_STATIC_LEBS + TEST_DYNAMIC_LEBS) * TEST_LEB_SIZE);
+	info.scan = malloc(sizeof(*info.scan));
+	if (!test_flash || !expect_static || !expect_dynamic || !buf ||
+	    !info.scan) {
+		puts("Out of memory\n");
+		return CMD_RET_FAILURE;
+	}
+	info.read = test_read;
+	info.peb_size = TEST_PEB_SIZE;
+	info.peb_count = TEST_PEBS;
+	info.vid_offset = TEST_VID_OFFSET;
+	info.leb_start = TEST_LEB_START;
+	test_build(expect_static, expect_dynamic);
+
+	/* The fastmap saves reading the headers beyond its search area */
+	info.fastmap = true;
+	ret = test_load(&info, expect_static, expect_dynamic, buf);
+	if (!ret && (!info.fastmap_used || info.hdr_reads >= TEST_PEBS)) {
+		printf("Fastmap not used: %d headers read\n", info.hdr_reads);
+		ret = -EINVAL;
+	}
+	printf("With fastmap: %d headers read\n", info.hdr_reads);
+
+	/* Scanning must find the same */
+	info.fastmap = false;
+	if (!ret)
+		ret = test_load(&info, expect_static, expect_dynamic, buf);
+	if (!ret && (info.fastmap_used || info.hdr_reads != TEST_PEBS))
+		ret = -EINVAL;
+
+	/* As it must if the fastmap is corrupt */
+	test_flash[TEST_ANCHOR * TEST_PEB_SIZE + TEST_LEB_START + 600] ^= 1;
+	info.fastmap = true;
+	if (!ret)
+		ret = test_load(&info, expect_static, expect_dynamic, buf);
+	if (!ret && info.fastmap_used) {
+		puts("Corrupt fastmap used\n");
+		ret = -EINVAL;
+	}
+
+	/* A static volume with a LEB missing cannot be loaded */
+	memset(test_flash + test_static_pebs[0] * TEST_PEB_SIZE, 0xff,
+	       TEST_PEB_SIZE);
+	if (!ret && test_load(&info, expect_static, expect_dynamic, buf) !=
+	    -ENOENT) {
+		puts("Missing LEB not detected\n");
+		ret = -EINVAL;
+	}
+
+	free(test_flash);
+	free(expect_static);
+	free(expect_dynamic);
+	free(buf);
+	free(info.scan);
+	if (ret) {
+		printf("Failed: %d\n", ret);
+		return CMD_RET_FAILURE;
+	}
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_ubispl,	1,	1,	do_ut_ubispl,
+	"Test the SPL UBI loader with and without fastmap",
+	""
+);
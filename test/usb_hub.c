@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2014
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <usb.h>
+
+#define TEST_START	1000	/* Time at which the hub's ports are powered */
+#define TEST_QUERY	(TEST_START + 100)
+#define TEST_CONNECT	(TEST_QUERY + 1000)
+
+#define CONN		USB_PORT_STAT_CONNECTION
+#define C_CONN		USB_PORT_STAT_C_CONNECTION
+
+/* One poll of a port, with its debounce time before and after */
+static const struct usb_hub_test_poll {
+	ulong now;
+	unsigned short status;
+	unsigned short change;
+	ulong debounce;
+	bool settled;
+	ulong debounce_after;
+} usb_hub_test_polls[] = {
+	/* Nothing connects */
+	{ TEST_QUERY, 0, 0, 0, false, 0 },
+	{ TEST_CONNECT - 1, 0, 0, 0, false, 0 },
+	{ TEST_CONNECT, 0, 0, 0, true, 0 },
+	/* A device connects and is debounced from when it is first seen */
+	{ TEST_QUERY + 50, CONN, C_CONN, 0, false, TEST_QUERY + 250 },
+	{ TEST_QUERY + 249, CONN, C_CONN, TEST_QUERY + 250, false,
+	  TEST_QUERY + 250 },
+	{ TEST_QUERY + 250, CONN, C_CONN, TEST_QUERY + 250, true,
+	  TEST_QUERY + 250 },
+	/* Debouncing is not limited by the connect timeout */
+	{ TEST_CONNECT + 5, CONN, C_CONN, 0, false, TEST_CONNECT + 205 },
+	/* A change with no connection is waited for, for up to 10s */
+	{ TEST_CONNECT, 0, C_CONN, 0, false, 0 },
+	{ TEST_QUERY + 9999, 0, C_CONN, 0, false, 0 },
+	{ TEST_QUERY + 10000, 0, C_CONN, 0, true, 0 },
+	/* Without a connection change, the port is left once devices had time */
+	{ TEST_QUERY, CONN, 0, 0, false, 0 },
+	{ TEST_CONNECT, CONN, 0, 0, true, 0 },
+};
+
+static int usb_hub_test_settled(void)
+{
+	struct usb_hub_device hub;
+	int i;
+
+	usb_hub_set_deadlines(&hub, TEST_START, 20);
+	if (hub.query_delay != TEST_QUERY ||
+	    hub.connect_timeout != TEST_CONNECT) {
+		printf("Deadlines %lu, %lu\n", hub.query_delay,
+		       hub.connect_timeout);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(usb_hub_test_polls); i++) {
+		const struct usb_hub_test_poll *poll = &usb_hub_test_polls[i];
+		ulong debounce = poll->debounce;
+		bool settled;
+
+		settled = usb_hub_port_settled(&hub, &debounce, poll->now,
+					       poll->status, poll->change);
+		if (settled != poll->settled ||
+		    debounce != poll->debounce_after) {
+			printf("Poll %d: settled %d, debounce %lu\n", i,
+			       settled, debounce);
+			return -EINVAL;
+		}
+	}
+
+	/* A slow hub delays the queries, and the connect timeout with them */
+	usb_hub_set_deadlines(&hub, TEST_START, 500);
+	if (hub.query_delay != TEST_START + 500 ||
+	    hub.connect_timeout != TEST_START + 1500) {
+		printf("Slow hub deadlines %lu, %lu\n", hub.query_delay,
+		       hub.connect_timeout);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int do_ut_usb_hub(cmd_tbl_t *cmdtp, int flag, int argc,
+			 char *const argv[])
+{
+	int ret;
+
+	ret = usb_hub_test_settled();
+	if (ret) {
+		printf("Failed: %d\n", ret);
+		return CMD_RET_FAILURE;
+	}
+	puts("ok\n");
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_usb_hub,	1,	1,	do_ut_usb_hub,
+	"Test when the hub port scan handles each port",
+	""
+);